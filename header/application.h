@@ -1,9 +1,11 @@
 #pragma once
+#include <atomic>
 #include <memory>
 #include <vulkan/vulkan.hpp>
 // #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <future>
 #include <optional>
 #include <set>
 
@@ -12,6 +14,15 @@
 #include "shader.h"
 #include "swapchain.h"
 #include "commandManager.h"
+#include "deletionQueue.h"
+#include "resourceRegistry.h"
+#include "image.h"
+#include "stagingRing.h"
+#include "resourceTracker.h"
+#include "profiler.h"
+#include "framePacer.h"
+#include "frameSnapshot.h"
+#include "tripleBuffer.h"
 #include "tool.h"
 
 namespace app {
@@ -22,14 +33,20 @@ const std::vector<const char *> validationLayers = {
 const std::vector<const char *> deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
-// 图形与显示队列信息
+// 图形、显示与计算队列信息
 struct QueueFamilyIndices {
   std::optional<uint32_t> graphicQueue;
   std::optional<uint32_t> presentQueue;
+  // 优先选没有图形能力的队列族，没有时与图形相同
+  std::optional<uint32_t> computeQueue;
   operator bool() {
     return graphicQueue.has_value() &&
            presentQueue.has_value();
   }
+  // 计算队列族独立时才能与图形队列并行
+  [[nodiscard]] auto AsyncCompute() const -> bool {
+    return computeQueue && computeQueue != graphicQueue;
+  }
 };
 
 // 应用实例（单例模式）
@@ -38,20 +55,26 @@ private:
   // 单例
   static std::unique_ptr<Application> instance_;
   // 私有构造函数，防止外部实例化
-  Application(uint32_t w, uint32_t h)
-      : width(w), height(h){};
+  Application(uint32_t w, uint32_t h,
+      const FramePacer::Config &pacing)
+      : width(w), height(h), pacer(pacing){};
 
 public:
   static auto GetInstance() -> Application & {
     return *instance_;
   }
-  static void Init(uint32_t w, uint32_t h);
+  // 帧节奏决定在途帧数与 swapchain 参数，只能在创建时指定
+  static void Init(uint32_t w, uint32_t h,
+      const FramePacer::Config &pacing = {});
   static void Quit();
 
 public:
   uint32_t width, height;
   // glfw 窗口
   GLFWwindow *window = nullptr;
+  // 窗口尺寸变化后由 renderer 重建 swapchain
+  // 主线程的回调写，渲染线程读
+  std::atomic<bool> framebufferResized{false};
   // vk 实例
   vk::Instance instance;
   // 选用的显卡
@@ -64,12 +87,22 @@ public:
   QueueFamilyIndices queueFamilyIndices;
   vk::Queue graphicQueue;
   vk::Queue presentQueue;
+  vk::Queue computeQueue;
   // 交换链
   std::unique_ptr<Swapchain> swapchain;
   // shader
   std::unique_ptr<Shader> shader;
   // commandManger
   std::unique_ptr<CommandManager> commandManager;
+  // 不再使用的对象等最后使用它的帧完成后销毁
+  // 与 device 同生命周期，最先创建、最后释放
+  std::unique_ptr<DeletionQueue> deletionQueue;
+  // 缓冲 / 纹理 / 采样器 / 管线，通过句柄访问
+  std::unique_ptr<ResourceRegistry> resources;
+  // 共享的上传 staging 缓冲
+  std::unique_ptr<StagingRing> stagingRing;
+  // 图像 / 缓冲的布局与访问状态，自动生成屏障
+  std::unique_ptr<ResourceTracker> resourceTracker;
   // pipeline
   std::unique_ptr<RenderProcess> renderProcess;
   // renderer
@@ -77,6 +110,19 @@ public:
   // // 采样器
   // vk::Sampler sampler;
 
+  // 启动计时
+  StartupProfiler startup;
+  // 帧节奏与延迟统计（只在渲染线程使用）
+  FramePacer pacer;
+  // 主线程模拟 -> 渲染线程
+  TripleBuffer<FrameSnapshot> snapshots;
+  // 与设备创建并行，在后台线程提前读取的资源
+  struct Preload {
+    std::future<std::string> vertexSpv;
+    std::future<std::string> fragSpv;
+    std::future<ImageData> texture;
+  } preload;
+
 public:
   void run();
 
@@ -89,6 +135,9 @@ private:
   void initwindow();
   void initVulkan();
   void mainLoop();
+  // 推进场景并发布一份快照
+  void simulate();
+  uint64_t simulated_ = 0;
   void cleanup();
 
   // 创建实例
@@ -100,9 +149,10 @@ private:
   void createSwapchain();
   void createShaderModules();
   void createRenderProcess();
-  void createGraphicsPipeline();
   void createCommandManager();
+  void createStagingRing();
   void createRenderer();
+  void startPreload();
 
   // 输出一些信息
   void showPropInfo();
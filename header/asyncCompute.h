@@ -0,0 +1,46 @@
+#pragma once
+
+#include "commandManager.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace app {
+
+/*
+    异步计算：命令提交到独立的计算队列族，与图形队列的光栅化重叠
+    每帧一个命令缓冲，提交时时间线信号量发出递增的值，
+    图形提交在用到结果的阶段等待这个值
+    图形等了计算，该帧的 fence 完成时计算也已完成，
+    所以命令缓冲与该帧的缓冲跟着 fence 复用即可
+    两个队列族共用的缓冲用 CONCURRENT 创建，不做所有权转移
+*/
+class AsyncCompute final {
+public:
+  explicit AsyncCompute(uint32_t frameCount);
+  // 调用时设备已经空闲
+  ~AsyncCompute();
+
+  AsyncCompute(const AsyncCompute &) = delete;
+  auto operator=(const AsyncCompute &) -> AsyncCompute & = delete;
+
+  // 设备有独立的计算队列族
+  static auto Supported() -> bool;
+
+  // 该帧的 fence 已经完成
+  auto Begin(uint32_t frame) -> vk::CommandBuffer;
+  // 结束录制并提交，返回完成时信号量的值
+  auto Submit(uint32_t frame) -> uint64_t;
+  // 放进图形提交的等待列表，stages 为第一次用到结果的阶段
+  [[nodiscard]] auto Wait(uint64_t value,
+      vk::PipelineStageFlags2 stages) const -> vk::SemaphoreSubmitInfo;
+
+private:
+  std::unique_ptr<CommandManager> commands_;
+  std::vector<vk::CommandBuffer> cmdBufs_;
+  vk::Semaphore timeline_;
+  uint64_t value_ = 0;
+};
+
+} // namespace app
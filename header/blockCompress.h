@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+    块压缩编码（CPU 离线 / 首次加载时使用）
+    输入都是 4x4 的 RGBA8 块，按行排列共 64 字节
+    BC1：8 字节 / 块，只有不透明 4 色模式
+    BC7：16 字节 / 块，只用 mode 6（单分区 RGBA，4 位索引）
+*/
+
+namespace app {
+
+void EncodeBC1Block(const uint8_t *rgba, uint8_t *out);
+void EncodeBC7Block(const uint8_t *rgba, uint8_t *out);
+
+// 整张图按块编码，边缘不足 4 的块复制最后一行 / 列补齐
+// blockBytes 为 8（BC1）或 16（BC7）
+void CompressImage(const uint8_t *rgba, uint32_t w, uint32_t h,
+    size_t blockBytes, uint8_t *out);
+
+// 每行 / 每列的块数
+inline auto BlockCount(uint32_t texels) -> uint32_t {
+  return (texels + 3) / 4;
+}
+
+} // namespace app
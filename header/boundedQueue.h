@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+
+namespace app {
+
+/*
+    有界无锁队列（多生产者多消费者，Vyukov 算法）
+    容量向上取整到 2 的幂，满时 TryPush 失败而不是阻塞
+*/
+template <typename T> class BoundedQueue final {
+public:
+  explicit BoundedQueue(size_t capacity) {
+    size_t cap = 2;
+    while (cap < capacity) {
+      cap <<= 1;
+    }
+    mask_ = cap - 1;
+    cells_ = std::make_unique<Cell[]>(cap);
+    for (size_t i = 0; i < cap; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  BoundedQueue(const BoundedQueue &) = delete;
+  auto operator=(const BoundedQueue &)
+      -> BoundedQueue & = delete;
+
+  auto TryPush(T &&value) -> bool {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      size_t seq =
+          cell->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq) -
+                  static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // 队列已满
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->value = std::move(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  auto TryPop() -> std::optional<T> {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      size_t seq =
+          cell->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq) -
+                  static_cast<std::ptrdiff_t>(pos + 1);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // 队列为空
+        return std::nullopt;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    std::optional<T> result(std::move(cell->value));
+    cell->sequence.store(
+        pos + mask_ + 1, std::memory_order_release);
+    return result;
+  }
+
+  [[nodiscard]] auto Capacity() const -> size_t {
+    return mask_ + 1;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  // head / tail 分开缓存行，避免伪共享
+  static constexpr size_t CacheLine = 64;
+
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_ = 0;
+  alignas(CacheLine) std::atomic<size_t> tail_{0};
+  alignas(CacheLine) std::atomic<size_t> head_{0};
+};
+
+} // namespace app
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <initializer_list>
+#include <optional>
 #include <vulkan/vulkan.hpp>
 
 namespace app {
@@ -11,15 +13,25 @@ struct BufferPkg {
   size_t size;
   size_t requireSize;
 
+  // shared：图形与异步计算两个队列族都会访问，
+  // 两者不同时用 CONCURRENT 共享，省去所有权转移
   BufferPkg(size_t size, vk::BufferUsageFlags usage,
-      vk::MemoryPropertyFlags property);
+      vk::MemoryPropertyFlags property, bool shared = false);
   ~BufferPkg();
 
   BufferPkg(const BufferPkg &) = delete;
   auto operator=(const BufferPkg &) -> BufferPkg & = delete;
+  // 移动后源对象为空，析构时什么也不做
+  BufferPkg(BufferPkg &&other) noexcept;
+  auto operator=(BufferPkg &&other) noexcept -> BufferPkg &;
 };
 
+// 满足全部属性的第一个内存类型，没有时返回 nullopt
 auto QueryBufferMemTypeIndex(std::uint32_t requirementBit,
-    vk::MemoryPropertyFlags) -> std::uint32_t;
+    vk::MemoryPropertyFlags) -> std::optional<std::uint32_t>;
+// 按顺序返回第一组 usage 的缓冲能用的内存属性，都不支持时抛异常
+auto PickBufferMemory(vk::BufferUsageFlags usage,
+    std::initializer_list<vk::MemoryPropertyFlags> candidates)
+    -> vk::MemoryPropertyFlags;
 
 } // namespace app
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+    颜色转换内核（SSE2 + 标量回退）
+    swapchain 常见格式为 B8G8R8A8，截图 / 编码需要 RGBA 或 YUV420
+*/
+
+namespace app {
+
+// BGRA <-> RGBA 交换 R/B 通道，src 与 dst 可以相同
+void SwizzleBGRA2RGBA(
+    const uint8_t *src, uint8_t *dst, size_t pixelCount);
+
+// RGB8 扩展为 RGBA8（alpha = 255），src 与 dst 不能重叠
+void ExpandRGB2RGBA(
+    const uint8_t *src, uint8_t *dst, size_t pixelCount);
+
+// RGBA8 2x2 盒式滤波缩小一级（mip），dst 尺寸为
+// max(1, w/2) * max(1, h/2)，奇数边最后一行 / 列被丢弃
+// 按线性数据平均，只适合法线等非颜色数据
+void DownsampleRGBA2x2(const uint8_t *src, uint32_t w,
+    uint32_t h, uint8_t *dst);
+
+// 同上，但 RGB 为 sRGB 编码：查表解码到线性、平均后再编码，
+// alpha 按线性平均。直接平均 sRGB 值会让缩小后的图偏暗
+void DownsampleSRGBA2x2(const uint8_t *src, uint32_t w,
+    uint32_t h, uint8_t *dst);
+
+// 32 位像素转 I420（BT.601 limited range）
+// yPlane: w * h，uPlane / vPlane: ((w+1)/2) * ((h+1)/2)
+void RGBA2YUV420(const uint8_t *src, uint32_t w, uint32_t h,
+    uint32_t rowPitch, bool bgra, uint8_t *yPlane,
+    uint8_t *uPlane, uint8_t *vPlane);
+
+} // namespace app
\ No newline at end of file
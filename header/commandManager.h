@@ -7,7 +7,8 @@ namespace app {
 
 class CommandManager final {
 public:
-  CommandManager();
+  // 命令缓冲只能提交到 queueFamily 的队列
+  explicit CommandManager(uint32_t queueFamily);
   ~CommandManager();
 
   auto CreateOneCommandBuffer() -> vk::CommandBuffer;
@@ -18,12 +19,15 @@ public:
 
   using RecordCmdFunc =
       std::function<void(vk::CommandBuffer &)>;
+  // 提交并等待这次提交完成（不等设备空闲）
   void ExecuteCmd(vk::Queue, RecordCmdFunc);
 
 private:
   vk::CommandPool pool_;
+  // ExecuteCmd 的完成信号
+  vk::Fence fence_;
 
-  auto createCommandPool() -> vk::CommandPool;
+  auto createCommandPool(uint32_t queueFamily) -> vk::CommandPool;
 };
 
 } // namespace app
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "resourceRegistry.h"
+#include <array>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+/*
+    计算管线：一个 compute shader、set 0 的描述符布局与 push constant
+    布局可以从 SPIR-V 反射得到，也可以手动声明
+    描述符集从自己的池里分配，销毁时池和管线交给延迟销毁队列
+*/
+
+namespace app {
+
+class ComputeProcess final {
+public:
+  // 绑定、push constant 大小与 local size 都从 shader 反射
+  explicit ComputeProcess(const std::string &spv);
+  // bindings 为 set 0 的全部绑定，localSizeX 与 shader 中一致
+  ComputeProcess(const std::string &spv,
+      const std::vector<vk::DescriptorSetLayoutBinding> &bindings,
+      uint32_t pushConstantSize, uint32_t localSizeX);
+  ~ComputeProcess();
+
+  ComputeProcess(const ComputeProcess &) = delete;
+  auto operator=(const ComputeProcess &) -> ComputeProcess & = delete;
+
+  // 分配 count 个 set 0 的描述符集
+  auto AllocSets(uint32_t count) -> std::vector<vk::DescriptorSet>;
+  // 调用者保证该描述符集没有在途的帧在用
+  void WriteBuffer(vk::DescriptorSet set, uint32_t binding,
+      vk::Buffer buffer, vk::DeviceSize range = VK_WHOLE_SIZE) const;
+  // 采样图像或存储图像，sampler 只用于 combined image sampler
+  void WriteImage(vk::DescriptorSet set, uint32_t binding,
+      vk::ImageView view, vk::ImageLayout layout,
+      vk::Sampler sampler = nullptr) const;
+
+  void Bind(vk::CommandBuffer cmdBuf, vk::DescriptorSet set) const;
+  template <typename T>
+  void Push(vk::CommandBuffer cmdBuf, const T &constants) const {
+    cmdBuf.pushConstants(layout, vk::ShaderStageFlagBits::eCompute, 0,
+        sizeof(T), &constants);
+  }
+  void Dispatch(vk::CommandBuffer cmdBuf, uint32_t x, uint32_t y = 1,
+      uint32_t z = 1) const;
+  // 一维：每个元素一次调用，组数向上取整
+  void DispatchFor(vk::CommandBuffer cmdBuf, uint32_t count) const;
+  // 二维：每个像素一次调用
+  void DispatchFor(
+      vk::CommandBuffer cmdBuf, uint32_t width, uint32_t height) const;
+
+  vk::DescriptorSetLayout setLayout;
+  vk::PipelineLayout layout;
+  PipelineId pipeline;
+
+private:
+  std::vector<vk::DescriptorSetLayoutBinding> bindings_;
+
+  [[nodiscard]] auto typeOf(uint32_t binding) const -> vk::DescriptorType;
+  std::vector<vk::DescriptorPool> pools_;
+  std::array<uint32_t, 3> localSize_;
+
+  void create(const std::string &spv, uint32_t pushConstantSize);
+};
+
+} // namespace app
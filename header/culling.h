@@ -0,0 +1,176 @@
+#pragma once
+
+#include "math.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+/*
+    视锥裁剪：包围盒按 SoA 存放，一次测试 4 / 8 个（见 simd.h）
+    物体按 BVH 叶子顺序排列，每个节点覆盖一段连续的物体，
+    节点完全在视锥内时整段直接可见，不再逐个测试
+    物体移动后只重算所在叶子及其祖先的包围盒（refit），
+    物体增删后下次 Refit 时重建
+    物体多时把顶层子树分给 worker 线程
+*/
+
+namespace app {
+
+// 平面 n·p + d >= 0 为内侧，法线已归一化
+struct Frustum {
+  static constexpr int PlaneCount = 6;
+  static constexpr uint32_t AllPlanes = (1u << PlaneCount) - 1;
+  // 左 右 下 上 近 远
+  glm::vec4 planes[PlaneCount];
+
+  // viewProj 为 Vulkan 约定的裁剪矩阵（深度 0 ~ 1）
+  static auto FromMatrix(const glm::mat4 &viewProj) -> Frustum;
+};
+
+// 轴对齐包围盒：中心与半边长
+struct AabbSoaView {
+  const float *cx = nullptr, *cy = nullptr, *cz = nullptr;
+  const float *ex = nullptr, *ey = nullptr, *ez = nullptr;
+};
+
+struct SphereSoaView {
+  const float *cx = nullptr, *cy = nullptr, *cz = nullptr;
+  const float *radius = nullptr;
+};
+
+// 测试 [begin, end) 中的包围体，只检查 planeMask 中的平面，
+// 可见的下标写入 out（至少 end - begin 个），返回可见个数
+auto CullAabbs(const Frustum &frustum, uint32_t planeMask,
+    const AabbSoaView &boxes, uint32_t begin, uint32_t end,
+    uint32_t *out) -> uint32_t;
+auto CullSpheres(const Frustum &frustum, uint32_t planeMask,
+    const SphereSoaView &spheres, uint32_t begin, uint32_t end,
+    uint32_t *out) -> uint32_t;
+
+class FrustumCuller final {
+public:
+  struct Config {
+    // 每个叶子的物体数，取 SIMD 宽度的倍数
+    uint32_t leafSize = 8;
+    // 物体数达到这个值才分给 worker
+    uint32_t parallelThreshold = 16384;
+    // 0 表示按硬件线程数，连同调用线程最多 4 个
+    uint32_t workerCount = 0;
+  };
+
+  struct Stats {
+    uint32_t visible = 0;
+    uint32_t culled = 0;
+    // 测试过的节点与逐个测试的物体
+    uint32_t nodesTested = 0;
+    uint32_t objectsTested = 0;
+    // 参与的线程数（含调用线程）
+    uint32_t threads = 1;
+    double ms = 0;
+  };
+
+  FrustumCuller();
+  explicit FrustumCuller(const Config &config);
+  ~FrustumCuller();
+
+  FrustumCuller(const FrustumCuller &) = delete;
+  auto operator=(const FrustumCuller &) -> FrustumCuller & = delete;
+
+  // 物体编号从 0 连续分配，Clear 后重新开始
+  auto Add(const glm::vec3 &center, const glm::vec3 &extent) -> uint32_t;
+  void Update(
+      uint32_t object, const glm::vec3 &center, const glm::vec3 &extent);
+  void Clear();
+  // 有增删时重建，否则只重算移动过的叶子和祖先
+  void Refit();
+
+  // 可见物体的编号写入 visible（按 BVH 顺序），需要先 Refit
+  auto Cull(const Frustum &frustum, std::vector<uint32_t> &visible)
+      -> Stats;
+
+  [[nodiscard]] auto Size() const -> uint32_t {
+    return static_cast<uint32_t>(slot_.size());
+  }
+  [[nodiscard]] auto WorkerCount() const -> uint32_t {
+    return static_cast<uint32_t>(workers_.size());
+  }
+
+  // 每秒输出一次平均的可见 / 裁剪数量与耗时
+  void Report(const Stats &stats);
+
+private:
+  struct Node {
+    float min[3];
+    float max[3];
+    // 覆盖的物体位置 [begin, end)
+    uint32_t begin;
+    uint32_t end;
+    // 内部节点的左孩子，右孩子紧随左子树之后；叶子为 0
+    uint32_t left;
+    uint32_t right;
+    uint32_t parent;
+  };
+  // 一棵子树的裁剪结果
+  struct Task {
+    uint32_t node;
+    std::vector<uint32_t> visible;
+    uint32_t nodesTested;
+    uint32_t objectsTested;
+  };
+
+  Config config_;
+  // 按 BVH 顺序存放的包围盒
+  std::vector<float> cx_, cy_, cz_, ex_, ey_, ez_;
+  // 位置 -> 物体编号，物体编号 -> 位置
+  std::vector<uint32_t> object_;
+  std::vector<uint32_t> slot_;
+  // 位置 -> 所在叶子
+  std::vector<uint32_t> leafOf_;
+  std::vector<Node> nodes_;
+  // 等待 refit 的叶子
+  std::vector<uint32_t> dirtyLeaves_;
+  std::vector<uint8_t> nodeDirty_;
+  bool rebuild_ = true;
+  // 建树时的位置排列，buildOrder_[新位置] = 旧位置
+  std::vector<uint32_t> buildOrder_;
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  uint64_t job_ = 0;
+  uint32_t running_ = 0;
+  bool quit_ = false;
+  // 当前任务，由 Cull 设置
+  const Frustum *frustum_ = nullptr;
+  std::vector<Task> tasks_;
+  std::atomic<uint32_t> nextTask_{0};
+
+  // Report 的统计窗口
+  std::chrono::steady_clock::time_point windowStart_;
+  uint32_t windowFrames_ = 0;
+  double windowVisible_ = 0;
+  double windowCulled_ = 0;
+  double windowMs_ = 0;
+
+  void build();
+  auto buildNode(uint32_t begin, uint32_t end, uint32_t parent)
+      -> uint32_t;
+  void fitLeaf(Node &node);
+  void runTasks();
+  void cullNode(uint32_t node, uint32_t planeMask, Task &task);
+  void workerLoop();
+  [[nodiscard]] auto view() const -> AabbSoaView;
+};
+
+// 视锥裁剪对比：逐个标量测试、SIMD 逐个测试、BVH 单线程与多线程，
+// 以及 1% 物体移动后的 refit 耗时
+void BenchmarkCulling(uint32_t count);
+
+} // namespace app
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vulkan/vulkan.hpp>
+
+/*
+    延迟销毁队列：不再使用的 Vulkan 对象记上当前正在录制的帧，
+    等这一帧在 GPU 上执行完（renderer 的 fence 返回）再销毁
+    这样替换资源时不需要 waitIdle，
+    按同一队列提交顺序，更早的帧一定先完成
+    Retire 可以在任意线程调用，Collect / Flush 在渲染线程
+*/
+
+namespace app {
+
+class DeletionQueue final {
+public:
+  DeletionQueue() = default;
+  // 调用前设备必须空闲
+  ~DeletionQueue();
+
+  DeletionQueue(const DeletionQueue &) = delete;
+  auto operator=(const DeletionQueue &) -> DeletionQueue & = delete;
+
+  // 开始录制 frame，之后退休的对象都要等它完成
+  void BeginFrame(uint64_t frame);
+  // completed 及之前的帧已经完成，销毁到期的对象
+  void Collect(uint64_t completed);
+  // 设备空闲后销毁全部
+  void Flush();
+
+  void Retire(vk::Buffer buffer);
+  void Retire(vk::Image image);
+  void Retire(vk::ImageView view);
+  void Retire(vk::DeviceMemory memory);
+  void Retire(vk::Pipeline pipeline);
+  void Retire(vk::Sampler sampler);
+  // 其他对象（描述符集、整块资源）
+  void Retire(std::function<void()> destroy);
+
+  [[nodiscard]] auto Pending() const -> size_t;
+
+  struct Stats {
+    uint64_t retired = 0;
+    uint64_t destroyed = 0;
+    // 单次 Collect 之后还在等待的最大数量
+    size_t peakPending = 0;
+  };
+  [[nodiscard]] auto GetStats() const -> Stats;
+
+private:
+  enum class Kind : uint8_t {
+    Buffer,
+    Image,
+    ImageView,
+    Memory,
+    Pipeline,
+    Sampler,
+    Function,
+  };
+  struct Entry {
+    uint64_t frame;
+    Kind kind;
+    // 非 Function 时的句柄
+    uint64_t handle = 0;
+    std::function<void()> destroy;
+  };
+
+  mutable std::mutex mutex_;
+  // 帧号单调不减，队首总是最早到期的
+  std::deque<Entry> entries_;
+  uint64_t frame_ = 0;
+  Stats stats_;
+
+  void push(Kind kind, uint64_t handle);
+  static void destroy(Entry &entry);
+};
+
+} // namespace app
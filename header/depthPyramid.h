@@ -0,0 +1,90 @@
+#pragma once
+
+#include "computeProcess.h"
+#include "resourceRegistry.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+/*
+    深度金字塔（Hi-Z）：R32 图像，每级保存上一级 2x2 区域的最大深度
+    第 0 级是不大于深度图的 2 的幂，用计算着色器逐级缩小
+    图像一直处于 GENERAL 布局，各级之间的屏障由 ResourceTracker 生成
+    包围盒投影到屏幕后，在覆盖不超过 2x2 像素的那一级比较深度，
+    最近点比这些像素的最大深度还远就一定被挡住
+*/
+
+namespace app {
+
+class DepthPyramid final {
+public:
+  // frameCount 为在途帧数，每帧一组描述符集
+  explicit DepthPyramid(uint32_t frameCount);
+  ~DepthPyramid();
+
+  DepthPyramid(const DepthPyramid &) = delete;
+  auto operator=(const DepthPyramid &) -> DepthPyramid & = delete;
+
+  // 深度图尺寸变化时重建，旧图像交给延迟销毁，内容失效
+  void Resize(vk::Extent2D depthExtent);
+  // 在 rendering 之外录制；depth 已处于 SHADER_READ_ONLY 布局，
+  // viewProj 为绘制这张深度图时的矩阵
+  void Build(vk::CommandBuffer cmdBuf, uint32_t frame, vk::ImageView depth,
+      const glm::mat4 &viewProj);
+  // 之后的计算着色器可以读取所有层级
+  void PrepareRead(vk::CommandBuffer cmdBuf);
+
+  // 所有层级的 view，供 texelFetch 使用
+  [[nodiscard]] auto View() const -> vk::ImageView {
+    return view_;
+  }
+  [[nodiscard]] auto Sampler() const -> vk::Sampler;
+  [[nodiscard]] auto Extent() const -> vk::Extent2D {
+    return extent_;
+  }
+  // 重建后还没有构建过时内容无效
+  [[nodiscard]] auto Valid() const -> bool {
+    return valid_;
+  }
+  // 最近一次构建使用的矩阵
+  [[nodiscard]] auto ViewProj() const -> const glm::mat4 & {
+    return viewProj_;
+  }
+  // 每次重建加一，引用图像的描述符集据此改写
+  [[nodiscard]] auto Generation() const -> uint64_t {
+    return generation_;
+  }
+
+private:
+  // 第 0 级最大 32768，足够任何深度图
+  static constexpr uint32_t MaxLevels = 16;
+
+  std::unique_ptr<ComputeProcess> reduce_;
+  SamplerId sampler_;
+  vk::Extent2D depthExtent_;
+  vk::Extent2D extent_;
+  uint32_t levels_ = 0;
+  vk::Image image_;
+  vk::DeviceMemory memory_;
+  vk::ImageView view_;
+  std::vector<vk::ImageView> levelViews_;
+  bool valid_ = false;
+  uint64_t generation_ = 0;
+  glm::mat4 viewProj_{1.0f};
+
+  // 每帧 MaxLevels 个集合，第 i 个把第 i - 1 级（或深度图）缩小到第 i 级
+  std::vector<vk::DescriptorSet> sets_;
+  // 各帧集合写入时的深度 view 与图像代数
+  struct Written {
+    vk::ImageView depth;
+    uint64_t generation = 0;
+  };
+  std::vector<Written> written_;
+
+  void destroy();
+};
+
+} // namespace app
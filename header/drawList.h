@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+/*
+    不透明物体的绘制列表：按模型原点在视空间的深度排序
+    从近到远绘制时，被遮挡的片元在 early-Z 阶段就被拒绝，
+    不会执行片元着色器
+*/
+
+namespace app {
+
+// 与 shader.vert 的 push constant 对应
+struct DrawConstants {
+  // 间接绘制：节点下标由 firstInstance 给出
+  static constexpr int32_t InstanceNode = -2;
+
+  glm::mat4 model{1.0f};
+  // 场景节点在实例缓冲中的下标，-1 表示不是场景节点
+  int32_t node = -1;
+};
+
+class DrawList final {
+public:
+  enum class Order {
+    FrontToBack,
+    // 只用于对照（最坏情况），透明物体将来也需要
+    BackToFront,
+  };
+
+  void Clear() {
+    items_.clear();
+  }
+  // 场景节点的矩阵在实例缓冲里，这里的 model 只用来排序
+  void Add(const glm::mat4 &model, int32_t node = -1) {
+    items_.push_back({model, 0.0f, node});
+  }
+  // view 为 uniform 中的 view * model，即每次绘制之外的全部变换
+  void Sort(const glm::mat4 &view, Order order);
+
+  struct Item {
+    glm::mat4 model;
+    // 到相机的距离（视空间 -z）
+    float depth;
+    int32_t node;
+  };
+  [[nodiscard]] auto Items() const -> const std::vector<Item> & {
+    return items_;
+  }
+
+private:
+  std::vector<Item> items_;
+};
+
+} // namespace app
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "boundedQueue.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <optional>
+#include <semaphore>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/*
+    截帧输出：渲染线程只负责把帧交给队列，
+    颜色转换 / 编码 / 写文件都在 worker 线程完成
+    Png    - 每帧一个文件（output 为目录）
+    Rgba   - 原始 RGBA 连续写入 output
+    Yuv420 - I420 原始流，output 为 "-" 时写 stdout 方便接外部编码器
+*/
+
+namespace app {
+
+class FrameCapture final {
+public:
+  enum class Format { Png, Rgba, Yuv420 };
+
+  struct Config {
+    Format format = Format::Png;
+    std::string output = "capture";
+    // 0 表示按 CPU 核数自动选择
+    uint32_t workerCount = 0;
+    uint32_t queueCapacity = 8;
+  };
+
+  // 渲染线程提交的一帧，pixels 在 worker 处理完成前必须有效
+  // 处理完成后 worker 把 *busy 置为 false 归还缓冲
+  struct Frame {
+    const uint8_t *pixels = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t rowPitch = 0;
+    bool bgra = false;
+    std::atomic<bool> *busy = nullptr;
+  };
+
+  explicit FrameCapture(const Config &config);
+  ~FrameCapture();
+
+  FrameCapture(const FrameCapture &) = delete;
+  auto operator=(const FrameCapture &)
+      -> FrameCapture & = delete;
+
+  // 队列满时返回 false（记为丢帧），调用者自行归还缓冲
+  auto Submit(const Frame &frame) -> bool;
+  // 没有空闲缓冲时由调用者记录丢帧
+  void NoteDropped();
+
+  [[nodiscard]] auto WorkerCount() const -> uint32_t {
+    return static_cast<uint32_t>(workers_.size());
+  }
+  [[nodiscard]] auto QueueCapacity() const -> uint32_t {
+    return static_cast<uint32_t>(queue_.Capacity());
+  }
+  [[nodiscard]] auto Written() const -> uint64_t {
+    return written_.load();
+  }
+  [[nodiscard]] auto Dropped() const -> uint64_t {
+    return dropped_.load();
+  }
+
+  static auto ParseFormat(std::string_view name)
+      -> std::optional<Format>;
+
+private:
+  struct Job {
+    Frame frame;
+    uint64_t sequence = 0;
+  };
+
+  Config config_;
+  BoundedQueue<Job> queue_;
+  std::counting_semaphore<> pending_{0};
+  std::vector<std::thread> workers_;
+  std::atomic<bool> stop_{false};
+
+  // 只由渲染线程修改
+  uint64_t nextSequence_ = 0;
+
+  // 流式输出需要按提交顺序写入
+  FILE *stream_ = nullptr;
+  std::mutex writeMutex_;
+  std::condition_variable writeCond_;
+  uint64_t nextWrite_ = 0;
+
+  std::atomic<uint64_t> written_{0};
+  std::atomic<uint64_t> dropped_{0};
+
+  void workerLoop();
+  void process(
+      const Job &job, std::vector<uint8_t> &encoded);
+  void writeInOrder(
+      uint64_t sequence, const std::vector<uint8_t> &data);
+  void writeFile(
+      uint64_t sequence, const std::vector<uint8_t> &data);
+};
+
+// 快速 PNG 编码（Sub / Up 行滤波 + 固定 Huffman 的 LZ77），
+// 输入为 RGBA8 / BGRA8
+void EncodePng(const uint8_t *pixels, uint32_t w, uint32_t h,
+    uint32_t rowPitch, bool bgra, std::vector<uint8_t> &out);
+
+} // namespace app
\ No newline at end of file
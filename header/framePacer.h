@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace app {
+
+/*
+    帧节奏：决定同时在途的帧数、swapchain 图像数与 present 模式，
+    限帧时精确睡眠到截止时间，并统计实际的队列深度与延迟
+    - Latency：1 帧在途，输入在 acquire 之后才采样，mailbox / immediate
+    - Throughput：3 帧在途，CPU 与 GPU 充分重叠，fifo
+    - Capped：2 帧在途，按目标帧率睡眠，fifo
+    延迟为 输入采样 -> GPU 完成该帧（轮询 fence 观察到），
+    不含合成与扫描输出，不是输入到显示的延迟
+*/
+class FramePacer final {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  enum class Mode { Latency, Throughput, Capped };
+
+  struct Config {
+    Mode mode = Mode::Throughput;
+    // 0 表示使用模式的默认值
+    uint32_t framesInFlight = 0;
+    // 只在 Capped 模式下生效
+    double fpsCap = 60.0;
+    // 指定 present 模式，设备不支持时退回模式的默认选择
+    std::optional<vk::PresentModeKHR> presentMode;
+  };
+
+  explicit FramePacer(const Config &config);
+
+  static auto ParseMode(std::string_view name) -> std::optional<Mode>;
+  // fifo / mailbox / immediate
+  static auto ParsePresentMode(std::string_view name)
+      -> std::optional<vk::PresentModeKHR>;
+
+  [[nodiscard]] auto FramesInFlight() const -> uint32_t {
+    return framesInFlight_;
+  }
+  // 延迟模式在 acquire 之后再处理一次输入
+  [[nodiscard]] auto SamplesInputLate() const -> bool {
+    return config_.mode == Mode::Latency;
+  }
+  [[nodiscard]] auto ChoosePresentMode(
+      const std::vector<vk::PresentModeKHR> &available) const
+      -> vk::PresentModeKHR;
+  [[nodiscard]] auto ChooseImageCount(
+      const vk::SurfaceCapabilitiesKHR &capabilities) const
+      -> uint32_t;
+
+  // 帧开始（等待 fence 之前），限帧时在这里睡眠
+  void BeginFrame();
+  // frame 为帧序号
+  void InputSampled(uint64_t frame);
+  void Submitted(uint64_t frame, uint64_t completedFrame);
+  // completedFrame 及之前的帧都已完成，观察到时立即调用，
+  // 调用时刻就是这些帧的完成时间
+  void Completed(uint64_t completedFrame);
+  // 每秒输出一次统计，输出了返回 true
+  auto EndFrame() -> bool;
+
+  struct Stats {
+    double fps = 0;
+    // 提交时仍在 GPU 上的帧数（含本帧）
+    double queueDepth = 0;
+    // 输入采样 -> GPU 完成
+    double latencyMs = 0;
+  };
+  [[nodiscard]] auto LastStats() const -> const Stats & {
+    return last_;
+  }
+
+private:
+  // 在途帧数的上限远小于它
+  static constexpr size_t HistorySize = 16;
+
+  Config config_;
+  uint32_t framesInFlight_;
+  Clock::duration period_{};
+  Clock::time_point deadline_;
+
+  // 1ms sleep 实际耗时的在线估计（均值 + 标准差）
+  double sleepEstimate_ = 5e-3;
+  double sleepMean_ = 5e-3;
+  double sleepM2_ = 0;
+  uint64_t sleepCount_ = 1;
+
+  std::array<Clock::time_point, HistorySize> inputTimes_{};
+  uint64_t lastCompleted_ = 0;
+
+  // 当前统计窗口
+  Clock::time_point windowStart_;
+  uint32_t frames_ = 0;
+  double depthSum_ = 0;
+  uint32_t depthSamples_ = 0;
+  double latencySum_ = 0;
+  uint32_t latencySamples_ = 0;
+  Stats last_;
+
+  void sleepUntil(Clock::time_point deadline);
+};
+
+} // namespace app
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <vulkan/vulkan.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+namespace app {
+
+/*
+    主线程每次模拟产生的场景状态，经三缓冲交给渲染线程
+    渲染线程只读，内容在一帧内不变
+*/
+struct FrameSnapshot {
+  // 0 表示主线程还没有发布过
+  uint64_t sequence = 0;
+  // 模拟时间（秒）
+  double time = 0;
+  // 默认场景中四边形的旋转
+  glm::mat4 model{1.0f};
+  // 窗口 framebuffer 尺寸，最小化时为 0
+  vk::Extent2D framebuffer;
+};
+
+} // namespace app
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace app {
+
+/*
+    GPU 时间戳计时：每个 in-flight 帧一对 timestamp
+    Begin / End 录制在该帧的命令缓冲里，
+    等到该帧的 fence 之后 Read 得到毫秒数
+    帧内还可以有若干区段（如某个计算 pass），各自一对 timestamp
+*/
+class GpuTimer final {
+public:
+  explicit GpuTimer(uint32_t frameCount, uint32_t sectionCount = 0);
+  ~GpuTimer();
+
+  GpuTimer(const GpuTimer &) = delete;
+  auto operator=(const GpuTimer &) -> GpuTimer & = delete;
+
+  void Begin(vk::CommandBuffer cmdBuf, uint32_t frame);
+  void End(vk::CommandBuffer cmdBuf, uint32_t frame);
+  // 该帧没有录制过或队列不支持 timestamp 时返回 nullopt
+  auto Read(uint32_t frame) -> std::optional<double>;
+
+  // 在 Begin 与 End 之间录制，每帧每个区段最多一次
+  void BeginSection(
+      vk::CommandBuffer cmdBuf, uint32_t frame, uint32_t section);
+  void EndSection(
+      vk::CommandBuffer cmdBuf, uint32_t frame, uint32_t section);
+  // 该帧没有录制这个区段时返回 nullopt
+  auto ReadSection(uint32_t frame, uint32_t section)
+      -> std::optional<double>;
+
+  [[nodiscard]] auto Supported() const -> bool {
+    return supported_;
+  }
+
+private:
+  vk::QueryPool pool_;
+  // 一个 tick 对应的纳秒数
+  double period_ = 1.0;
+  bool supported_ = false;
+  // 每帧的 query 数：整帧一对加上每个区段一对
+  uint32_t stride_ = 2;
+  std::vector<bool> recorded_;
+  // 每帧录制过的区段，按位
+  std::vector<uint32_t> sections_;
+
+  auto readPair(uint32_t first) -> std::optional<double>;
+};
+
+} // namespace app
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+namespace app {
+
+// stbi 分配的内存需要用 stbi_image_free 释放
+struct ImageFree {
+  void operator()(uint8_t *pixels) const;
+};
+
+// 解码后的 RGBA8 图像，与 Vulkan 无关，可以在任意线程加载
+struct ImageData {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::unique_ptr<uint8_t, ImageFree> pixels;
+};
+
+auto LoadImageData(std::string_view filename) -> ImageData;
+
+// 解码后一次写入调用者提供的 w * h * 4 字节内存（如 staging）
+struct DecodeInfo {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t channels = 0;
+  // 解码之后写入目标的字节数
+  size_t bytesCopied = 0;
+  // 旧的“解码到堆、转换格式、再 memcpy”路径需要拷贝的字节数
+  size_t legacyBytesCopied = 0;
+};
+// 读到图像尺寸后调用，返回 nullptr 表示放弃（不解码）
+using PixelTarget =
+    std::function<uint8_t *(uint32_t w, uint32_t h)>;
+auto DecodeImageInto(std::string_view filename,
+    const PixelTarget &target) -> std::optional<DecodeInfo>;
+
+} // namespace app
\ No newline at end of file
@@ -1,67 +1,92 @@
 #pragma once
 
-#include "vulkan/vulkan.hpp"
-#include <initializer_list>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+
+/*
+    批量变换内核（AVX2 / SSE2 + 标量回退，见 simd.h）
+    矩阵列主序，与 glm::mat4 逐字节相同，可以直接 memcpy 互转
+    向量按 SoA 存放：每个分量一个数组，一次处理 4 / 8 个
+*/
 
 namespace app {
 
-// struct Vec final {
-//   union {
-//     struct {
-//       float x, y;
-//     };
-//     struct {
-//       float w, h;
-//     };
-//   };
-
-//   static auto GetAttributeDescription()
-//       ->
-//       std::vector<vk::VertexInputAttributeDescription>;
-//   static auto GetBindingDescription()
-//       -> std::vector<vk::VertexInputBindingDescription>;
-// };
-
-// struct Vertex final {
-//   Vec position;
-//   Vec texcoord;
-// };
-
-// struct Color final {
-//   float r, g, b;
-// };
-
-// using Size = Vec;
-
-// class Mat4 {
-// public:
-//   static auto CreateIdentity() -> Mat4;
-//   static auto CreateOnes() -> Mat4;
-//   static auto CreateOrtho(int left, int right, int top,
-//   int bottom, int near,
-//                           int far) -> Mat4;
-//   static auto CreateTranslate(const Vec &) -> Mat4;
-//   static auto CreateScale(const Vec &) -> Mat4;
-//   static auto Create(const std::initializer_list<float>
-//   &) -> Mat4;
-
-//   Mat4();
-//   [[nodiscard]] auto GetData() const -> const float * {
-//   return data_; } void Set(int x, int y, float value) {
-//   data_[x * 4 + y] = value; }
-//   [[nodiscard]] auto Get(int x, int y) const -> float {
-//     return data_[x * 4 + y];
-//   }
-
-//   [[nodiscard]] auto Mul(const Mat4 &m) const -> Mat4;
-
-// private:
-//   float data_[4 * 4];
-// };
-
-// struct Rect {
-//   Vec position;
-//   Size size;
-// };
-
-} // namespace app
\ No newline at end of file
+struct alignas(16) Mat4 {
+  // m[col * 4 + row]
+  float m[16];
+
+  static auto Identity() -> Mat4;
+  [[nodiscard]] auto Column(int col) const -> const float * {
+    return m + col * 4;
+  }
+};
+
+struct Quat {
+  float x = 0.0f, y = 0.0f, z = 0.0f, w = 1.0f;
+};
+
+inline auto FromGlm(const glm::mat4 &mat) -> Mat4 {
+  Mat4 out;
+  std::memcpy(out.m, &mat[0][0], sizeof(out.m));
+  return out;
+}
+
+inline auto ToGlm(const Mat4 &mat) -> glm::mat4 {
+  glm::mat4 out;
+  std::memcpy(&out[0][0], mat.m, sizeof(mat.m));
+  return out;
+}
+
+// 只读的 SoA 向量数组，w 为空时按 1 处理（点）
+struct Vec4SoaView {
+  const float *x = nullptr;
+  const float *y = nullptr;
+  const float *z = nullptr;
+  const float *w = nullptr;
+};
+
+struct Vec4SoaSpan {
+  float *x = nullptr;
+  float *y = nullptr;
+  float *z = nullptr;
+  float *w = nullptr;
+};
+
+// 平移 / 旋转 / 缩放分量数组，T 或 S 为空时为 0 / 1
+struct TrsSoaView {
+  const float *tx = nullptr, *ty = nullptr, *tz = nullptr;
+  const float *qx = nullptr, *qy = nullptr, *qz = nullptr,
+              *qw = nullptr;
+  const float *sx = nullptr, *sy = nullptr, *sz = nullptr;
+};
+
+// out = a * b，out 可以与 a 或 b 相同
+void MulMat4(const Mat4 &a, const Mat4 &b, Mat4 &out);
+
+// out[i] = lhs * rhs[i]，典型用法是 viewProj * model[i]
+void MulMat4Batch(
+    const Mat4 &lhs, const Mat4 *rhs, Mat4 *out, size_t count);
+
+// out[i] = a[i] * b[i]，用于 parent * local
+void MulMat4Pairs(
+    const Mat4 *a, const Mat4 *b, Mat4 *out, size_t count);
+
+// out = mat * in，in 与 out 的分量数组不能重叠
+void TransformBatch(const Mat4 &mat, const Vec4SoaView &in,
+    const Vec4SoaSpan &out, size_t count);
+
+// 单位四元数转旋转矩阵
+auto QuatToMat4(const Quat &q) -> Mat4;
+
+// out[i] = T * R * S，四元数需要归一化
+void ComposeTrsBatch(const TrsSoaView &in, Mat4 *out, size_t count);
+
+// 当前编译使用的指令集
+auto SimdLevel() -> const char *;
+
+// 与 glm 逐个计算对比，输出每个元素的耗时与最大误差
+void BenchmarkMath(uint32_t count);
+
+} // namespace app
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace app {
+
+/*
+    管线统计查询：每个 in-flight 帧一个查询，
+    统计片元着色器的调用次数（衡量 overdraw）
+    用法与 GpuTimer 相同，Begin / End 必须在 rendering 之外
+*/
+class PipelineStats final {
+public:
+  explicit PipelineStats(uint32_t frameCount);
+  ~PipelineStats();
+
+  PipelineStats(const PipelineStats &) = delete;
+  auto operator=(const PipelineStats &) -> PipelineStats & = delete;
+
+  void Begin(vk::CommandBuffer cmdBuf, uint32_t frame);
+  void End(vk::CommandBuffer cmdBuf, uint32_t frame);
+  // 该帧没有录制过或设备不支持时返回 nullopt
+  auto FragmentInvocations(uint32_t frame) -> std::optional<uint64_t>;
+
+  [[nodiscard]] auto Supported() const -> bool {
+    return supported_;
+  }
+
+private:
+  vk::QueryPool pool_;
+  bool supported_ = false;
+  std::vector<bool> recorded_;
+};
+
+} // namespace app
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace app {
+
+/*
+    启动阶段计时：记录每个阶段相对启动时刻的起止时间
+    后台线程中的阶段同样可以记录（加锁）
+*/
+class StartupProfiler final {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Phase {
+    std::string name;
+    double beginMs;
+    double endMs;
+    bool background;
+  };
+
+  // RAII，析构时记录一个阶段
+  class Scope {
+  public:
+    Scope(StartupProfiler &profiler, std::string name)
+        : profiler_(profiler), name_(std::move(name)),
+          begin_(Clock::now()) {}
+    ~Scope() {
+      profiler_.Record(name_, begin_, Clock::now());
+    }
+    Scope(const Scope &) = delete;
+    auto operator=(const Scope &) -> Scope & = delete;
+
+  private:
+    StartupProfiler &profiler_;
+    std::string name_;
+    Clock::time_point begin_;
+  };
+
+  StartupProfiler();
+
+  [[nodiscard]] auto Measure(std::string name) -> Scope {
+    return Scope(*this, std::move(name));
+  }
+  void Record(const std::string &name,
+      Clock::time_point begin, Clock::time_point end);
+  // 第一帧 present 完成，输出报告
+  void MarkFirstFrame();
+  void Report() const;
+
+private:
+  Clock::time_point start_;
+  std::thread::id mainThread_;
+  double firstFrameMs_ = 0;
+  std::vector<Phase> phases_;
+  mutable std::mutex mutex_;
+
+  [[nodiscard]] auto sinceStart(Clock::time_point t) const
+      -> double;
+};
+
+} // namespace app
\ No newline at end of file
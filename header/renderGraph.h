@@ -0,0 +1,208 @@
+#pragma once
+
+#include "resourceTracker.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+/*
+    帧图：pass 声明对命名资源的读写，Compile 一次完成
+    1. 剔除结果没人用的 pass（从导入资源与 SideEffect 反推）
+    2. 按声明顺序排列并检查先写后读
+    3. 推导每个 pass 前的屏障与布局转换
+    4. 生命周期不重叠的临时图像共用同一块显存
+    之后每帧只需 SetImported 更新外部资源再 Execute，
+    结构变化（增删 pass）时 Reset 重建
+*/
+
+namespace app {
+
+class RenderGraph final {
+public:
+  using ResourceId = uint32_t;
+  using PassId = uint32_t;
+
+  // 资源在 pass 中的用法，决定同步状态与图像 usage
+  enum class Access {
+    ColorAttachment,
+    DepthAttachment,
+    // 只读深度（深度测试但不写）
+    DepthRead,
+    Sampled,
+    StorageRead,
+    StorageWrite,
+    TransferSrc,
+    TransferDst,
+    IndirectRead,
+    VertexRead,
+  };
+
+  struct TextureDesc {
+    vk::Extent2D extent;
+    vk::Format format = vk::Format::eUndefined;
+    vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor;
+    vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+    // 内容只在一次 rendering 内有效（store 为 DontCare），
+    // 只作附件时加 TRANSIENT_ATTACHMENT 并优先用
+    // lazily allocated 内存，tiled GPU 上可以完全不占显存
+    bool memoryless = false;
+  };
+
+  class PassBuilder final {
+  public:
+    // 本 pass 创建的临时图像，只在帧内有效
+    auto Create(const std::string &name, const TextureDesc &desc)
+        -> ResourceId;
+    // 每个资源在一个 pass 里只能声明一次，重复声明在 Compile 时报错
+    void Read(ResourceId id, Access access);
+    void Write(ResourceId id, Access access);
+    // 结果在图外被使用（如回读），不会被剔除
+    void SideEffect();
+
+  private:
+    friend class RenderGraph;
+    PassBuilder(RenderGraph &graph, PassId pass)
+        : graph_(graph), pass_(pass) {}
+    RenderGraph &graph_;
+    PassId pass_;
+  };
+
+  // 执行期查询资源的实际句柄
+  class Resources final {
+  public:
+    [[nodiscard]] auto Image(ResourceId id) const -> vk::Image;
+    [[nodiscard]] auto View(ResourceId id) const -> vk::ImageView;
+    // 着色器采样用的 view：深度模板图像只含深度，其余同 View
+    [[nodiscard]] auto SampledView(ResourceId id) const -> vk::ImageView;
+    [[nodiscard]] auto Buffer(ResourceId id) const -> vk::Buffer;
+    [[nodiscard]] auto Desc(ResourceId id) const
+        -> const TextureDesc &;
+
+  private:
+    friend class RenderGraph;
+    explicit Resources(const RenderGraph &graph) : graph_(graph) {}
+    const RenderGraph &graph_;
+  };
+
+  using SetupFunc = std::function<void(PassBuilder &)>;
+  using ExecuteFunc =
+      std::function<void(vk::CommandBuffer, const Resources &)>;
+
+  struct Stats {
+    uint32_t passes = 0;
+    uint32_t culled = 0;
+    uint32_t barriers = 0;
+    // 临时图像各自分配 / 别名后的显存
+    vk::DeviceSize transientBytes = 0;
+    vk::DeviceSize allocatedBytes = 0;
+    // 其中落在 lazily allocated 内存上的部分
+    vk::DeviceSize lazyBytes = 0;
+  };
+
+  RenderGraph() = default;
+  ~RenderGraph();
+
+  RenderGraph(const RenderGraph &) = delete;
+  auto operator=(const RenderGraph &) -> RenderGraph & = delete;
+
+  // 外部图像（如 swapchain）：帧开始时处于 initial，
+  // 帧结束时转换到 final
+  auto ImportImage(const std::string &name, const TextureDesc &desc,
+      const ResourceState &initial, const ResourceState &final)
+      -> ResourceId;
+  auto ImportBuffer(const std::string &name,
+      const ResourceState &initial, const ResourceState &final)
+      -> ResourceId;
+  // 每帧更新导入资源的句柄，空句柄的屏障会被跳过
+  void SetImported(ResourceId id, vk::Image image,
+      vk::ImageView view = nullptr);
+  void SetImported(ResourceId id, vk::Buffer buffer);
+
+  auto AddPass(const std::string &name, const SetupFunc &setup,
+      ExecuteFunc execute) -> PassId;
+
+  void Compile();
+  void Execute(vk::CommandBuffer cmdBuf);
+  // 销毁临时资源并清空所有 pass，调用者保证 GPU 不再使用
+  void Reset();
+  // 同 Reset，但临时资源交给返回的函数销毁，
+  // 调用者在仍使用它们的帧完成后执行
+  [[nodiscard]] auto Release() -> std::function<void()>;
+
+  [[nodiscard]] auto Compiled() const -> bool {
+    return compiled_;
+  }
+  [[nodiscard]] auto GetStats() const -> const Stats & {
+    return stats_;
+  }
+  void PrintPlan() const;
+
+private:
+  struct Resource {
+    std::string name;
+    bool imported = false;
+    bool isBuffer = false;
+    TextureDesc desc;
+    ResourceState initial;
+    ResourceState final;
+    vk::Image image;
+    vk::ImageView view;
+    // 被采样的深度模板图像另建一个只含深度的 view
+    vk::ImageView sampledView;
+    vk::Buffer buffer;
+    vk::ImageUsageFlags usage;
+    // 临时资源：首末使用的 pass 与所在的显存块
+    uint32_t firstPass = ~0u;
+    uint32_t lastPass = 0;
+    int32_t block = -1;
+  };
+  struct Use {
+    ResourceId id;
+    Access access;
+    bool write;
+  };
+  struct Pass {
+    std::string name;
+    std::vector<Use> uses;
+    std::vector<ResourceId> creates;
+    bool sideEffect = false;
+    bool alive = false;
+    ExecuteFunc execute;
+  };
+  // 编译期确定的转换，句柄在执行时填入
+  struct Transition {
+    ResourceId id;
+    ResourceState src;
+    ResourceState dst;
+  };
+  struct MemoryBlock {
+    vk::DeviceMemory memory;
+    vk::DeviceSize size = 0;
+    uint32_t typeBits = ~0u;
+    bool lazy = false;
+    std::vector<ResourceId> residents;
+  };
+
+  std::vector<Resource> resources_;
+  std::vector<Pass> passes_;
+  // 存活 pass 的执行顺序，以及每个 pass 之前的转换
+  std::vector<PassId> order_;
+  std::vector<std::vector<Transition>> transitions_;
+  // 帧末导入资源转换到 final
+  std::vector<Transition> finalTransitions_;
+  std::vector<MemoryBlock> blocks_;
+  bool compiled_ = false;
+  Stats stats_;
+
+  void validate() const;
+  void cull();
+  void computeLifetimes();
+  void allocateTransients();
+  void planTransitions();
+  void recordTransitions(vk::CommandBuffer cmdBuf,
+      const std::vector<Transition> &transitions) const;
+};
+
+} // namespace app
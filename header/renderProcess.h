@@ -1,26 +1,57 @@
 #pragma once
 
 #include <vulkan/vulkan.hpp>
+#include "resourceRegistry.h"
 #include "shader.h"
 
 namespace app {
 class RenderProcess {
 public:
-  vk::RenderPass renderPass;
   vk::PipelineLayout layout;
-  vk::Pipeline graphicsPipeline;
+  // 管线登记在 ResourceRegistry 里，这里只持有句柄
+  // 深度测试 + 写入（LESS_OR_EQUAL）
+  PipelineId graphicsPipeline;
+  // 深度预渲染：只有顶点阶段，不写颜色
+  PipelineId depthPrepassPipeline;
+  // 预渲染之后的着色：EQUAL 测试，不写深度
+  PipelineId depthEqualPipeline;
+
+  // 三种变体的管线对象，还没有登记
+  struct Pipelines {
+    vk::Pipeline opaque;
+    vk::Pipeline depthPrepass;
+    vk::Pipeline depthEqual;
+  };
 
   RenderProcess();
   ~RenderProcess();
 
   void RecreateGraphicsPipeline(const Shader &shader);
-  void RecreateRenderPass();
+  // 只创建管线，不访问 ResourceRegistry，可以在后台线程调用
+  auto BuildPipelines(const Shader &shader) -> Pipelines;
+  // 登记新管线，旧管线交给延迟销毁；只在持有登记表的线程调用
+  void InstallPipelines(const Pipelines &pipelines);
+
+  // 不超过 requested 的最大可用采样数，
+  // 颜色与深度附件都要支持
+  [[nodiscard]] auto SupportedSampleCount(uint32_t requested) const
+      -> vk::SampleCountFlagBits;
+  // 旧管线交给延迟销毁
+  void SetSampleCount(
+      vk::SampleCountFlagBits count, const Shader &shader);
+
+  // 管线渲染到的颜色附件格式（swapchain 格式）
+  vk::Format colorFormat = vk::Format::eUndefined;
+  vk::Format depthFormat = vk::Format::eUndefined;
+  vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
 
 private:
+  enum class Variant { Opaque, DepthPrepass, DepthEqual };
+
   auto createLayout() -> vk::PipelineLayout;
-  auto createGraphicsPipeline(const Shader &shader)
+  auto createGraphicsPipeline(const Shader &shader, Variant variant)
       -> vk::Pipeline;
-  auto createRenderPass() -> vk::RenderPass;
+  void destroyPipelines();
   // void InitRenderPass();
   // void InitLayout();
   // void createGraphicsPipeline(const Shader& shader);
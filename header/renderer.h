@@ -1,56 +1,286 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <vector>
 #include <chrono>
+#include <functional>
+#include <string>
+#include <string_view>
 #include <vulkan/vulkan.hpp>
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include "asyncCompute.h"
 #include "buffer.h"
+#include "computeProcess.h"
+#include "culling.h"
+#include "depthPyramid.h"
 #include "descriptorManager.h"
+#include "drawList.h"
+#include "frameSnapshot.h"
+#include "frameCapture.h"
+#include "gpuTimer.h"
+#include "pipelineStats.h"
+#include "renderGraph.h"
+#include "resourceRegistry.h"
+#include "scene.h"
 #include "vertex.h"
 #include "texture.h"
+#include "textureManager.h"
+#include "textureStreamer.h"
+#include "tiledImage.h"
 
 namespace app {
 
+constexpr std::string_view DefaultTexturePath =
+    "resources/RT.png";
+
 class Renderer {
 public:
   Renderer(int maxFlightCount = 2);
   ~Renderer();
 
+  // 在渲染线程调用，场景状态取自主线程发布的最新快照
   void Render();
 
+  // 截帧：把每帧的 swapchain 图像回读并交给后台线程编码
+  void StartCapture(const FrameCapture::Config &config);
+  void StopCapture();
+
+  // 缩小纹理基准：同一场景分别只用第 0 层 / 用完整 mip 链
+  // 各渲染 framesPerMode 帧，比较 GPU 时间后关闭窗口
+  void StartMinifyBenchmark(uint32_t framesPerMode);
+
+  // overdraw 基准：层叠的全屏四边形依次按从远到近、从近到远、
+  // 深度预渲染三种方式绘制，比较片元着色器调用次数与 GPU 时间
+  void StartOverdrawBenchmark(uint32_t framesPerMode);
+
+  // 深度预渲染：先只写深度，再用 EQUAL 测试着色，
+  // 每个像素只执行一次片元着色器，代价是顶点处理两遍
+  void SetDepthPrepass(bool enable);
+
+  // GPU 裁剪：计算着色器做视锥裁剪并压缩出间接绘制参数，
+  // 场景只用一次 drawIndexedIndirectCount 绘制，CPU 开销与物体数无关
+  // 设备不支持间接计数绘制时保持 CPU 裁剪
+  void SetGpuCulling(bool enable);
+
+  // Hi-Z 遮挡裁剪（会同时开启 GPU 裁剪）：早期阶段用上一帧的
+  // 深度金字塔测试，后期阶段用本帧重建的金字塔重测被挡住的物体
+  // 多重采样或深度预渲染时只做视锥裁剪
+  void SetOcclusionCulling(bool enable);
+
+  // 异步计算（会同时开启 GPU 裁剪）：裁剪提交到独立的计算队列，
+  // 与上一帧的光栅化重叠，图形提交用时间线信号量等它完成
+  // 没有独立的计算队列族或两阶段遮挡裁剪时仍在图形队列上裁剪
+  void SetAsyncCompute(bool enable);
+
+  // 每次重建帧图都打印执行计划，默认只打印第一次
+  void SetPrintGraph(bool enable) {
+    printGraph = enable;
+  }
+
+  // 在根节点下铺开 count 个静止的四边形，用于大量物体的场景
+  void SpawnObjects(uint32_t count);
+
+  // 多重采样：取不超过 samples 的最大支持值，1 为关闭
+  // 多重采样图像在 rendering 结束时 resolve 到 swapchain
+  void SetMsaa(uint32_t samples);
+
+  // 用分块金字塔（BuildTilePyramid 生成）代替默认纹理显示
+  void ShowTiledImage(const std::string &path);
+  // 通过 TextureStreamer 异步加载图像代替默认纹理，
+  // 驻留之前显示占位纹理
+  void ShowStreamedTexture(const std::string &path);
+
+  // 正在录制的帧序号（从 1 开始递增）
+  [[nodiscard]] auto FrameIndex() const -> uint64_t {
+    return frameIndex;
+  }
+  // GPU 已经执行完的最后一帧，0 表示还没有
+  [[nodiscard]] auto CompletedFrame() const -> uint64_t {
+    return completedFrame;
+  }
+
+  // 异步纹理加载服务
+  auto Streamer() -> TextureStreamer & {
+    return *streamer;
+  }
+
 private:
   int maxFlightCount;
   int curFrame;
+  uint64_t frameIndex = 1;
+  uint64_t completedFrame = 0;
+  // 每个 slot 最近一次提交的帧序号
+  std::vector<uint64_t> frameSerials;
   std::vector<vk::Fence> fences;
   std::vector<vk::Semaphore> imageAvaliableSems;
   std::vector<vk::Semaphore> renderFinishSems;
   std::vector<vk::CommandBuffer> cmdBufs;
+  RenderGraph graph;
+  RenderGraph::ResourceId backbuffer = 0;
+  RenderGraph::ResourceId captureTarget = 0;
+  RenderGraph::ResourceId depth = 0;
+  RenderGraph::ResourceId msaaColor = 0;
+  RenderGraph::ResourceId drawArgs = 0;
+  RenderGraph::ResourceId drawCount = 0;
+  RenderGraph::ResourceId retestFlags = 0;
+  RenderGraph::ResourceId cullStats = 0;
+  bool depthPrepass = false;
+  bool gpuCulling = false;
+  bool occlusionCulling = false;
+  // 当前帧图是否按两阶段遮挡裁剪构建
+  bool twoPhase = false;
+  bool asyncCompute = false;
+  // 当前帧图的裁剪是否在计算队列上
+  bool asyncCull = false;
+  bool printGraph = false;
+  bool graphPrinted = false;
+
+  // 本帧的不透明物体，录制前排好序
+  DrawList opaque;
 
-  std::unique_ptr<BufferPkg> hostVertexBuffer;
-  std::unique_ptr<BufferPkg> deviceVertexBuffer;
+  // 缓冲与采样器登记在这里，成员只保存句柄
+  ResourceRegistry &resources;
 
-  std::unique_ptr<BufferPkg> hostIndexsBuffer;
-  std::unique_ptr<BufferPkg> deviceIndexsBuffer;
+  BufferId hostVertexBuffer;
+  BufferId deviceVertexBuffer;
 
-  std::vector<std::unique_ptr<BufferPkg>>
-      hostUniformBuffers;
-  std::vector<std::unique_ptr<BufferPkg>>
-      deviceUniformBuffers;
+  BufferId hostIndexsBuffer;
+  BufferId deviceIndexsBuffer;
+
+  std::vector<BufferId> hostUniformBuffers;
+  std::vector<BufferId> deviceUniformBuffers;
+
+  // 默认场景：中心的四边形和绕它公转的子节点
+  Scene scene;
+  Scene::NodeId sceneRoot = 0;
+  std::vector<Scene::NodeId> satellites;
+  // 每个 slot 一块主机可见的实例缓冲，直接写世界矩阵
+  std::vector<BufferId> instanceBuffers;
+  // 各 slot 实例缓冲已经写到的场景版本
+  std::vector<uint64_t> instanceVersions;
+  // 场景节点的包围盒，物体编号就是节点下标
+  FrustumCuller culler;
+  std::vector<uint32_t> visibleNodes;
+  // GPU 裁剪的管线与每个 slot 的缓冲
+  std::unique_ptr<ComputeProcess> cullProcess;
+  std::unique_ptr<DepthPyramid> pyramid;
+  std::unique_ptr<AsyncCompute> asyncQueue;
+  struct CullSlot {
+    vk::DescriptorSet set;
+    // 物体的局部包围盒与绘制参数（主机可见，重排后重写）
+    BufferId objects;
+    // 压缩后的间接绘制参数与数量（显存），两个阶段各占一半
+    BufferId draws;
+    BufferId count;
+    // 早期阶段被挡住的物体（显存）
+    BufferId retest;
+    // 矩阵、平面等（主机可见）
+    BufferId params;
+    // 数量的回读
+    BufferId stats;
+    bool statsPending = false;
+    // 描述符集当前指向的实例缓冲与金字塔
+    BufferId instances;
+    uint64_t pyramidGeneration = 0;
+    uint64_t layoutVersion = 0;
+    uint32_t capacity = 0;
+  };
+  std::vector<CullSlot> cullSlots;
+  // GPU 裁剪的区段计时
+  enum GpuSection : uint32_t {
+    SectionCullEarly,
+    SectionHiZBuild,
+    SectionCullLate,
+    SectionCount,
+  };
+  // 每秒输出一次 GPU 裁剪的平均结果
+  struct CullReport {
+    std::chrono::steady_clock::time_point start;
+    uint32_t frames = 0;
+    double visible = 0;
+    double late = 0;
+    double inFrustum = 0;
+    double occluded = 0;
+    double ms[SectionCount] = {};
+    uint32_t timed[SectionCount] = {};
+  } cullReport;
 
   glm::mat4 projectMat_;
   glm::mat4 viewMat_;
+  // 最近一次写入 uniform 的 project * view * model
+  glm::mat4 mvpMat_{1.0f};
+  // view * model，排序用
+  glm::mat4 sceneView_{1.0f};
+  // 本帧使用的场景快照
+  FrameSnapshot snapshot_;
 
   std::vector<DescriptorSetManager::SetInfo> descriptorSets;
+  // 内容变了但还没改写的 slot
+  std::vector<bool> descriptorDirty;
 
-  std::unique_ptr<Texture> texture;
-  vk::Sampler sampler;
+  TextureHandle texture;
+  SamplerId sampler;
+  // maxLod = 0，只采样第 0 层（基准对照组）
+  SamplerId baseLevelSampler;
+  std::unique_ptr<TextureStreamer> streamer;
+  // 正在显示的流式纹理，描述符集指向的 view 随驻留切换
+  TextureStreamer::Handle streamed;
+  bool streamedResident = false;
+  std::unique_ptr<TiledImage> tiled;
+
+  // 回读缓冲在 worker 编码完成前保持 busy
+  struct CaptureSlot {
+    std::unique_ptr<BufferPkg> buffer;
+    std::atomic<bool> busy{false};
+  };
+  std::unique_ptr<FrameCapture> capture;
+  // StopCapture 之后等在途帧的回读交出，期间不再录制回读
+  bool captureStopping = false;
+  std::vector<std::unique_ptr<CaptureSlot>> captureSlots;
+  // 回读缓冲按开始截帧时的尺寸分配，其他尺寸的帧丢弃
+  vk::Extent2D captureExtent;
+  // 每个 in-flight 帧对应的回读槽，-1 表示没有
+  std::vector<int> pendingCaptures;
   // std::unique_ptr<DescriptorSetManager>
   // descriptorManager;
 
+  // 每帧图执行的 GPU 时间与片元着色器调用次数
+  std::unique_ptr<GpuTimer> gpuTimer;
+  std::unique_ptr<PipelineStats> pipelineStats;
+  struct MinifyBench {
+    uint32_t framesPerMode = 0;
+    uint32_t warmup = 0;
+    // 当前模式的第一帧，更早的帧结果丢弃
+    uint64_t modeStart = 0;
+    bool mipmapped = false;
+    double gpuMs[2] = {};
+    uint32_t samples[2] = {};
+  };
+  std::optional<MinifyBench> bench;
+  struct OverdrawBench {
+    // 0 从远到近，1 从近到远，2 深度预渲染
+    static constexpr int Modes = 3;
+    uint32_t framesPerMode = 0;
+    uint32_t warmup = 0;
+    uint64_t modeStart = 0;
+    int mode = 0;
+    // 基准结束后恢复
+    bool prepassBefore = false;
+    double gpuMs[Modes] = {};
+    uint32_t samples[Modes] = {};
+    uint64_t fragments[Modes] = {};
+    uint32_t fragmentSamples[Modes] = {};
+  };
+  std::optional<OverdrawBench> overdraw;
+
+  // 窗口尺寸变化或 swapchain 过期时重建，不等待设备空闲
+  // 窗口最小化时返回 false，本帧跳过
+  auto recreateSwapchain() -> bool;
   void createFences();
   void createSemaphores();
   void createCmdBuffers();
@@ -62,9 +292,55 @@ private:
   // void bufferMVPData(const glm::mat4& model);
 
   auto updateUniformBuffer(uint32_t curFrame) -> void;
+  // 把本帧的 uniform 从 staging 拷到显存，录制在帧命令缓冲里
+  void recordUniformUpload(
+      vk::CommandBuffer cmdBuf, uint32_t curFrame);
+  // 标记所有 slot 需要改写，实际写入在各自的 fence 之后
   auto updateDescriptorSets() -> void;
+  void writeDescriptorSet(size_t slot);
+  // 轮询各 slot 的 fence，更新 completedFrame 并交给帧节奏统计
+  void pollCompleted();
+  void createScene();
+  // 推进场景动画，把该 slot 错过的世界矩阵写进实例缓冲
+  void updateScene(uint32_t curFrame);
+  // 把变化节点的包围盒交给裁剪器
+  void updateBounds();
+  // 按场景大小准备该 slot 的 GPU 裁剪缓冲与描述符集
+  void updateGpuCull(uint32_t curFrame);
+  // phase 0 为早期（或唯一）阶段，1 为后期阶段
+  void recordGpuCull(vk::CommandBuffer cmdBuf, uint32_t phase);
+  // 在计算队列上清零并裁剪，返回图形提交要等的信号量值
+  auto submitAsyncCull() -> uint64_t;
+  // 该 slot 的帧已经完成，累计裁剪数量与计时
+  void readGpuCull(uint32_t curFrame);
+  // 本帧的场景由 GPU 裁剪后间接绘制（基准与分块图像除外）
+  [[nodiscard]] auto gpuDriven() const -> bool;
   auto createTexture() -> void;
   auto createSampler() -> void;
+  auto createStreamer() -> void;
+  auto acquireCaptureSlot() -> int;
+  void recordCapture(
+      vk::CommandBuffer cmdBuf, vk::Image image, vk::Buffer dst);
+  // 帧结构（是否截帧）变化后重新构建
+  void buildGraph();
+  // 两阶段时 phase 1 接着 phase 0 的颜色与深度绘制
+  void recordScene(vk::CommandBuffer cmdBuf,
+      const RenderGraph::Resources &res, uint32_t phase = 0);
+  void recordDepthPrepass(
+      vk::CommandBuffer cmdBuf, const RenderGraph::Resources &res);
+  // 绑定 pipeline 后按 opaque 的顺序逐个绘制，
+  // GPU 裁剪时绘制该阶段的间接参数
+  void recordDraws(vk::CommandBuffer cmdBuf, PipelineId pipeline,
+      uint32_t phase = 0);
+  void buildOpaqueList();
+  void submitCapture(int frame);
+  // 释放截帧线程与回读缓冲，还没交出的回读丢弃
+  void finishCapture();
+  // frame 为结果所属的帧序号
+  void stepBenchmark(uint64_t frame, std::optional<double> gpuMs);
+  void stepOverdrawBenchmark(uint64_t frame,
+      std::optional<double> gpuMs, std::optional<uint64_t> fragments);
+  [[nodiscard]] auto activeSampler() const -> vk::Sampler;
   // auto createDescriptorPool(uint32_t maxFlightCount) ->
   // void; auto allocDescriptorSets(uint32_t maxFlightCount)
   // -> void;
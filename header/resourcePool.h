@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/*
+    slot map：对象连续存放在 values_ 里，删除时用末尾元素填洞，
+    遍历就是扫一个数组，不需要逐个解引用指针
+    句柄 32 位：低 20 位是槽位下标，高 12 位是代数，
+    槽位复用时代数加一，旧句柄因此失效
+    Debug 下 Get 会检查代数，Release 下只有 TryGet 检查
+*/
+
+namespace app {
+
+template <typename Tag>
+class Handle final {
+public:
+  static constexpr uint32_t IndexBits = 20;
+  static constexpr uint32_t IndexMask = (1u << IndexBits) - 1;
+  static constexpr uint32_t MaxGeneration = (1u << (32 - IndexBits)) - 1;
+
+  Handle() = default;
+  Handle(uint32_t index, uint32_t generation)
+      : value_(generation << IndexBits | index) {}
+
+  [[nodiscard]] auto Index() const -> uint32_t {
+    return value_ & IndexMask;
+  }
+  [[nodiscard]] auto Generation() const -> uint32_t {
+    return value_ >> IndexBits;
+  }
+  [[nodiscard]] auto Value() const -> uint32_t {
+    return value_;
+  }
+  // 代数从 1 开始，值为 0 的句柄总是无效
+  explicit operator bool() const {
+    return value_ != 0;
+  }
+  auto operator==(const Handle &) const -> bool = default;
+
+private:
+  uint32_t value_ = 0;
+};
+
+template <typename T, typename Tag = T>
+class Pool final {
+public:
+  using Id = Handle<Tag>;
+
+  Pool() = default;
+
+  Pool(const Pool &) = delete;
+  auto operator=(const Pool &) -> Pool & = delete;
+
+  template <typename... Args>
+  auto Emplace(Args &&...args) -> Id {
+    const uint32_t slot = allocSlot();
+    values_.emplace_back(std::forward<Args>(args)...);
+    owners_.push_back(slot);
+    slots_[slot].dense = static_cast<uint32_t>(values_.size() - 1);
+    return {slot, slots_[slot].generation};
+  }
+
+  // 删除后末尾元素移到空出的位置，元素的地址不稳定
+  void Erase(Id id) {
+    const uint32_t slot = check(id);
+    const uint32_t dense = slots_[slot].dense;
+    const uint32_t last = static_cast<uint32_t>(values_.size() - 1);
+    if (dense != last) {
+      // 交换而不是覆盖，被删的对象在 pop_back 时析构
+      std::swap(values_[dense], values_[last]);
+      owners_[dense] = owners_[last];
+      slots_[owners_[dense]].dense = dense;
+    }
+    values_.pop_back();
+    owners_.pop_back();
+    freeSlot(slot);
+  }
+
+  auto Get(Id id) -> T & {
+#ifndef NDEBUG
+    return values_[slots_[check(id)].dense];
+#else
+    return values_[slots_[id.Index()].dense];
+#endif
+  }
+  auto Get(Id id) const -> const T & {
+#ifndef NDEBUG
+    return values_[slots_[check(id)].dense];
+#else
+    return values_[slots_[id.Index()].dense];
+#endif
+  }
+  // 句柄失效时返回空指针
+  auto TryGet(Id id) -> T * {
+    return Contains(id) ? &values_[slots_[id.Index()].dense] : nullptr;
+  }
+  [[nodiscard]] auto Contains(Id id) const -> bool {
+    return id && id.Index() < slots_.size() &&
+           slots_[id.Index()].generation == id.Generation() &&
+           slots_[id.Index()].dense != Free;
+  }
+
+  [[nodiscard]] auto Size() const -> size_t {
+    return values_.size();
+  }
+  [[nodiscard]] auto Empty() const -> bool {
+    return values_.empty();
+  }
+  // 按存放顺序遍历，第 i 个元素的句柄为 IdAt(i)
+  auto begin() {
+    return values_.begin();
+  }
+  auto end() {
+    return values_.end();
+  }
+  auto begin() const {
+    return values_.begin();
+  }
+  auto end() const {
+    return values_.end();
+  }
+  [[nodiscard]] auto IdAt(size_t dense) const -> Id {
+    const uint32_t slot = owners_[dense];
+    return {slot, slots_[slot].generation};
+  }
+
+  void Clear() {
+    while (!values_.empty()) {
+      Erase(IdAt(values_.size() - 1));
+    }
+  }
+
+private:
+  static constexpr uint32_t Free = ~0u;
+  struct Slot {
+    // 占用时是 values_ 的下标，空闲时为 Free
+    uint32_t dense = Free;
+    uint32_t generation = 1;
+    // 空闲链表
+    uint32_t next = Free;
+  };
+
+  std::vector<T> values_;
+  // values_ 下标 -> 槽位
+  std::vector<uint32_t> owners_;
+  std::vector<Slot> slots_;
+  uint32_t freeHead_ = Free;
+
+  auto allocSlot() -> uint32_t {
+    if (freeHead_ != Free) {
+      const uint32_t slot = freeHead_;
+      freeHead_ = slots_[slot].next;
+      return slot;
+    }
+    if (slots_.size() > Id::IndexMask) {
+      throw std::runtime_error("resource pool is full");
+    }
+    slots_.emplace_back();
+    return static_cast<uint32_t>(slots_.size() - 1);
+  }
+
+  void freeSlot(uint32_t slot) {
+    auto &s = slots_[slot];
+    s.dense = Free;
+    // 代数回绕时跳过 0，保证空句柄永远无效
+    s.generation = s.generation == Id::MaxGeneration ? 1 : s.generation + 1;
+    s.next = freeHead_;
+    freeHead_ = slot;
+  }
+
+  auto check(Id id) const -> uint32_t {
+    if (!Contains(id)) {
+      throw std::runtime_error("stale or invalid resource handle");
+    }
+    return id.Index();
+  }
+};
+
+// 比较句柄解析与 unique_ptr 逐个解引用的耗时
+void BenchmarkHandles(uint32_t count);
+
+} // namespace app
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "buffer.h"
+#include "resourcePool.h"
+#include <vulkan/vulkan.hpp>
+
+/*
+    GPU 资源登记表：缓冲、采样器、管线各放在一个 slot map 里，
+    外部只持有 32 位句柄，解析是两次数组下标
+    Destroy 后对象交给延迟销毁队列，旧句柄立即失效
+    谁创建谁销毁，析构时剩下的资源一并退休
+    纹理由 TextureManager 按共享句柄管理，不在这里登记
+*/
+
+namespace app {
+
+struct SamplerTag;
+struct PipelineTag;
+
+using BufferId = Handle<BufferPkg>;
+using SamplerId = Handle<SamplerTag>;
+using PipelineId = Handle<PipelineTag>;
+
+class ResourceRegistry final {
+public:
+  ResourceRegistry() = default;
+  ~ResourceRegistry();
+
+  ResourceRegistry(const ResourceRegistry &) = delete;
+  auto operator=(const ResourceRegistry &)
+      -> ResourceRegistry & = delete;
+
+  // shared 见 BufferPkg
+  auto CreateBuffer(size_t size, vk::BufferUsageFlags usage,
+      vk::MemoryPropertyFlags property, bool shared = false) -> BufferId;
+  auto CreateSampler(const vk::SamplerCreateInfo &info) -> SamplerId;
+  // 接管已经创建好的管线
+  auto AddPipeline(vk::Pipeline pipeline) -> PipelineId;
+
+  // 空句柄直接忽略
+  void Destroy(BufferId id);
+  void Destroy(SamplerId id);
+  void Destroy(PipelineId id);
+
+  auto Get(BufferId id) -> BufferPkg & {
+    return buffers_.Get(id);
+  }
+  [[nodiscard]] auto Get(SamplerId id) const -> vk::Sampler {
+    return samplers_.Get(id);
+  }
+  [[nodiscard]] auto Get(PipelineId id) const -> vk::Pipeline {
+    return pipelines_.Get(id);
+  }
+
+  [[nodiscard]] auto Buffers() const -> const Pool<BufferPkg> & {
+    return buffers_;
+  }
+
+private:
+  Pool<BufferPkg> buffers_;
+  Pool<vk::Sampler, SamplerTag> samplers_;
+  Pool<vk::Pipeline, PipelineTag> pipelines_;
+};
+
+} // namespace app
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+/*
+    资源状态跟踪：记录每个图像子资源（mip x 层）与缓冲
+    最后一次使用的 stage / access / layout
+    Use 声明接下来的用法，只在需要时生成屏障并暂存，
+    Flush 把暂存的屏障合并成一次 pipelineBarrier2
+    状态按录制顺序推进，要求命令缓冲按录制顺序提交到同一队列
+*/
+
+namespace app {
+
+struct ResourceState {
+  vk::PipelineStageFlags2 stage = vk::PipelineStageFlagBits2::eNone;
+  vk::AccessFlags2 access = vk::AccessFlagBits2::eNone;
+  vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+
+  // 常用状态
+  static auto TransferDst() -> ResourceState;
+  static auto TransferSrc() -> ResourceState;
+  static auto FragmentRead() -> ResourceState;
+
+  // access 中的写操作，屏障只需要 flush 这部分
+  [[nodiscard]] auto Writes() const -> vk::AccessFlags2;
+};
+
+// 从 current 转到 next 是否需要屏障，
+// 不需要时（读后读）把 next 的读者并入 current
+auto NeedsBarrier(ResourceState &current, const ResourceState &next)
+    -> bool;
+
+class ResourceTracker final {
+public:
+  ResourceTracker() = default;
+
+  ResourceTracker(const ResourceTracker &) = delete;
+  auto operator=(const ResourceTracker &)
+      -> ResourceTracker & = delete;
+
+  // 新建的图像所有子资源为 initial（默认 undefined）
+  void Track(vk::Image image, uint32_t mipLevels,
+      uint32_t layers = 1,
+      vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor,
+      const ResourceState &initial = {});
+  void Track(vk::Buffer buffer, const ResourceState &initial = {});
+  // 销毁资源前调用
+  void Forget(vk::Image image);
+  void Forget(vk::Buffer buffer);
+
+  // levelCount / layerCount 可以是 VK_REMAINING_*
+  void Use(vk::Image image, const ResourceState &next,
+      uint32_t baseLevel = 0,
+      uint32_t levelCount = VK_REMAINING_MIP_LEVELS,
+      uint32_t baseLayer = 0,
+      uint32_t layerCount = VK_REMAINING_ARRAY_LAYERS);
+  // 缓冲按整体跟踪，layout 被忽略
+  void Use(vk::Buffer buffer, const ResourceState &next);
+
+  // 没有暂存的屏障时不录制任何命令
+  void Flush(vk::CommandBuffer cmdBuf);
+
+  [[nodiscard]] auto State(vk::Image image, uint32_t level,
+      uint32_t layer = 0) const -> const ResourceState &;
+
+  struct Stats {
+    // 录制的 pipelineBarrier2 次数
+    uint64_t flushes = 0;
+    uint64_t imageBarriers = 0;
+    uint64_t bufferBarriers = 0;
+    // 被合并掉的屏障（相邻子资源或同一子资源的连续转换）
+    uint64_t merged = 0;
+  };
+  [[nodiscard]] auto GetStats() const -> const Stats & {
+    return stats_;
+  }
+
+private:
+  struct ImageEntry {
+    uint32_t levels;
+    uint32_t layers;
+    vk::ImageAspectFlags aspect;
+    // 下标 layer * levels + level
+    std::vector<ResourceState> states;
+    // 子资源在 pending_ 中的下标，-1 表示没有
+    std::vector<int32_t> pending;
+  };
+  struct PendingImage {
+    vk::Image image;
+    uint32_t level;
+    uint32_t layer;
+    vk::ImageMemoryBarrier2 barrier;
+  };
+  struct BufferEntry {
+    ResourceState state;
+    int32_t pending = -1;
+  };
+
+  std::unordered_map<VkImage, ImageEntry> images_;
+  std::unordered_map<VkBuffer, BufferEntry> buffers_;
+  std::vector<PendingImage> pendingImages_;
+  std::vector<vk::BufferMemoryBarrier2> pendingBuffers_;
+  Stats stats_;
+};
+
+} // namespace app
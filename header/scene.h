@@ -0,0 +1,138 @@
+#pragma once
+
+#include "math.h"
+#include <cstdint>
+#include <deque>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/*
+    场景层级：节点的平移 / 旋转 / 缩放按分量 SoA 存放，
+    节点按深度优先先序排列，父节点总在子节点之前，
+    每棵子树是一段连续下标 [i, i + subtreeSize[i])
+    SetLocal 只做标记，Update 时只重算脏节点所在的子树，
+    变化的世界矩阵按版本记录，实例缓冲据此只写变化的区间
+*/
+
+namespace app {
+
+class Scene final {
+public:
+  // 创建顺序编号，重排后不变
+  using NodeId = uint32_t;
+  static constexpr NodeId NoParent = UINT32_MAX;
+
+  struct Transform {
+    glm::vec3 translation{0.0f};
+    glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
+    glm::vec3 scale{1.0f};
+  };
+
+  // 下标区间 [begin, end)
+  struct Range {
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  struct Stats {
+    // 本次 Update 重算的局部矩阵与世界矩阵个数
+    uint32_t localUpdated = 0;
+    uint32_t worldUpdated = 0;
+    // 重算的连续区间个数
+    uint32_t ranges = 0;
+    // 本次 Update 是否重排了节点（所有实例都要重写）
+    bool relayout = false;
+  };
+
+  // 父节点必须已经存在，新节点在下次 Update 时排入
+  auto AddNode(NodeId parent, const Transform &local) -> NodeId;
+  auto AddNode(NodeId parent = NoParent) -> NodeId {
+    return AddNode(parent, Transform{});
+  }
+  void SetLocal(NodeId node, const Transform &local);
+  void Clear();
+
+  // 重算脏子树，返回前一次 Update 之后是否有变化
+  auto Update() -> bool;
+
+  [[nodiscard]] auto Size() const -> uint32_t {
+    return static_cast<uint32_t>(parent_.size());
+  }
+  // 节点在世界矩阵数组（也是实例缓冲）中的下标，Update 后有效
+  [[nodiscard]] auto IndexOf(NodeId node) const -> uint32_t {
+    return index_[node];
+  }
+  [[nodiscard]] auto World(uint32_t index) const -> const Mat4 & {
+    return world_[index];
+  }
+  [[nodiscard]] auto WorldMatrices() const -> const Mat4 * {
+    return world_.data();
+  }
+  [[nodiscard]] auto Version() const -> uint64_t {
+    return version_;
+  }
+  // 最近一次重排（下标整体变化）时的版本
+  [[nodiscard]] auto LayoutVersion() const -> uint64_t {
+    return layoutVersion_;
+  }
+  [[nodiscard]] auto LastStats() const -> const Stats & {
+    return stats_;
+  }
+  // 最近一次 Update 中世界矩阵变化的区间，重排时为全部节点
+  [[nodiscard]] auto LastChanges() const -> const std::vector<Range> & {
+    return lastChanges_;
+  }
+
+  // 把 since 版本之后变化的世界矩阵写进 dst（按下标排列，
+  // 至少 Size() 个），返回当前版本；since 为 0 或太旧时整体写入
+  auto WriteWorld(Mat4 *dst, uint64_t since) const -> uint64_t;
+
+private:
+  struct Change {
+    uint64_t version;
+    std::vector<Range> ranges;
+  };
+  // 保留的版本数，不少于在途帧数即可
+  static constexpr size_t HistoryLength = 8;
+
+  // 按下标排列（Update 后为先序）
+  std::vector<uint32_t> parent_;
+  std::vector<uint32_t> subtreeSize_;
+  std::vector<float> tx_, ty_, tz_;
+  std::vector<float> qx_, qy_, qz_, qw_;
+  std::vector<float> sx_, sy_, sz_;
+  std::vector<Mat4> local_;
+  std::vector<Mat4> world_;
+  std::vector<uint8_t> localDirty_;
+  // 下标 -> NodeId 与 NodeId -> 下标
+  std::vector<NodeId> node_;
+  std::vector<uint32_t> index_;
+
+  // SetLocal 标记过的下标，可能重复
+  std::vector<uint32_t> dirty_;
+  bool layoutDirty_ = false;
+
+  uint64_t version_ = 0;
+  // 最近一次重排的版本，更早的实例内容全部作废
+  uint64_t layoutVersion_ = 0;
+  std::deque<Change> history_;
+  Stats stats_;
+  std::vector<Range> lastChanges_;
+
+  // 批量组合局部矩阵用的临时 SoA
+  std::vector<float> scratch_;
+  std::vector<Mat4> scratchMats_;
+  std::vector<uint32_t> scratchIndices_;
+
+  void relayout();
+  // 重算 indices 中各节点的局部矩阵
+  void composeLocals(const std::vector<uint32_t> &indices);
+  void propagate(uint32_t begin, uint32_t end);
+};
+
+// 10 万级节点、每帧 1% 移动，对比全量重算与增量更新
+void BenchmarkScene(uint32_t count);
+
+} // namespace app
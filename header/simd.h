@@ -0,0 +1,23 @@
+#pragma once
+
+/*
+    SIMD 指令集检测，x64 下 SSE2 总是可用
+    AVX2 由编译选项打开（CMake 的 APP_SIMD），
+    定义 APP_NO_SIMD 时全部走标量实现（对照用）
+    其余内核在对应宏未定义时走标量实现
+*/
+
+#ifndef APP_NO_SIMD
+
+#if defined(__SSE2__) || defined(_M_X64) ||                \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define APP_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define APP_SIMD_AVX2 1
+#include <immintrin.h>
+#endif
+
+#endif
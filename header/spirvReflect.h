@@ -0,0 +1,28 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+/*
+    SPIR-V 反射：只解析 compute shader 建管线需要的部分
+    set 0 的描述符绑定、push constant 的大小、local size
+    不依赖 spirv-cross，只认 glslc 生成的常见指令
+*/
+
+namespace app {
+
+struct ComputeReflection {
+  // 按 binding 升序，stageFlags 为 compute
+  std::vector<vk::DescriptorSetLayoutBinding> bindings;
+  // 最后一个成员的末尾，没有 push constant 时为 0
+  uint32_t pushConstantSize = 0;
+  std::array<uint32_t, 3> localSize{1, 1, 1};
+};
+
+// 格式不对、用到 set 0 以外或者不支持的描述符时抛异常
+auto ReflectCompute(const std::string &spv) -> ComputeReflection;
+
+} // namespace app
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "buffer.h"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vulkan/vulkan.hpp>
+
+namespace app {
+
+/*
+    共享的环形 staging 缓冲（常驻映射）
+    Allocate 从 head 顺序分配，Retire 标记该块被哪个批次使用，
+    Reclaim(completed) 从尾部回收批次已完成的块
+*/
+class StagingRing final {
+public:
+  // 没有提交给任何批次的块
+  static constexpr uint64_t Unsubmitted = ~0ull;
+
+  struct Block {
+    vk::Buffer buffer;
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize size = 0;
+    void *ptr = nullptr;
+  };
+
+  explicit StagingRing(vk::DeviceSize size);
+
+  StagingRing(const StagingRing &) = delete;
+  auto operator=(const StagingRing &)
+      -> StagingRing & = delete;
+
+  // 空间不足返回 nullopt，调用者下一帧再试
+  auto Allocate(vk::DeviceSize size,
+      vk::DeviceSize alignment = 16) -> std::optional<Block>;
+  // 块的内容已经被 batch 对应的提交引用
+  void Retire(const Block &block, uint64_t batch);
+  // 块已不再（或从未）被 GPU 使用，位于尾部时立即回收
+  void Free(const Block &block);
+  // batch <= completed 的块全部回收
+  void Reclaim(uint64_t completed);
+
+  [[nodiscard]] auto Size() const -> vk::DeviceSize {
+    return buffer_->size;
+  }
+  [[nodiscard]] auto Used() const -> vk::DeviceSize;
+
+private:
+  struct Entry {
+    vk::DeviceSize begin;
+    vk::DeviceSize end;
+    uint64_t batch;
+  };
+
+  std::unique_ptr<BufferPkg> buffer_;
+  std::deque<Entry> entries_;
+  vk::DeviceSize head_ = 0;
+  mutable std::mutex mutex_;
+
+  void setBatch(const Block &block, uint64_t batch);
+};
+
+} // namespace app
\ No newline at end of file
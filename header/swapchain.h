@@ -3,11 +3,10 @@
 #include "vulkan/vulkan.hpp"
 
 /*
-    framebuffer - 帧缓冲
-    attachment - 纹理附件 - Texture - vk::Image
-    1 color Attachment - 1 + 颜色附件
-    0 Stencil / Depth Attachment - 0 + 模板/深度附件
-
+    swapchain 图像直接作为 dynamic rendering 的颜色附件，
+    不需要 framebuffer
+    深度附件与 swapchain 同尺寸，格式在这里选定，
+    图像本身由帧图作为临时资源创建
 */
 
 namespace app {
@@ -16,7 +15,10 @@ class Swapchain {
 public:
   vk::SwapchainKHR swapchain;
 
-  Swapchain(uint32_t width, uint32_t height);
+  // oldSwapchain 不为空时由它过渡，调用者在它的帧
+  // 全部完成后再销毁旧对象
+  Swapchain(uint32_t width, uint32_t height,
+      vk::SwapchainKHR oldSwapchain = nullptr);
   ~Swapchain();
 
   struct SwapchainInfo {
@@ -25,17 +27,22 @@ public:
     vk::SurfaceFormatKHR format;
     vk::SurfaceTransformFlagBitsKHR transform;
     vk::PresentModeKHR present;
+    vk::ImageUsageFlags usage;
+    // 深度附件格式，带模板的格式 aspect 同时包含两者
+    vk::Format depthFormat;
+    vk::ImageAspectFlags depthAspect;
   };
 
   SwapchainInfo info;
   std::vector<vk::Image> images;
   std::vector<vk::ImageView> imageViews;
-  std::vector<vk::Framebuffer> framebuffers;
 
   void queryInfo(uint32_t width, uint32_t height);
   void getImages();
   void createImageViews();
-  void createFrameBuffers();
+
+private:
+  void pickDepthFormat();
 };
 
 } // namespace app
\ No newline at end of file
@@ -2,62 +2,79 @@
 
 #include "buffer.h"
 #include "descriptorManager.h"
+#include "image.h"
+#include "textureCache.h"
 #include "vulkan/vulkan.hpp"
+#include <functional>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <vector>
 
 namespace app {
 
-class TextureManager;
-
 class Texture final {
 public:
-  // friend class TextureManager;
   Texture(std::string_view filename, vk::Sampler sampler);
+  // 已经解码好的图像（可在后台线程提前解码）
+  Texture(const ImageData &image, vk::Sampler sampler);
   Texture(void *data, uint32_t w, uint32_t h,
       vk::Sampler sampler);
+  // 块压缩缓存，mip 链已经预先生成
+  explicit Texture(const TextureCache &cache);
+  // 只创建图像（所有 mip 布局为 undefined），数据由调用者上传
+  Texture(uint32_t w, uint32_t h, bool mipmapped = true);
   ~Texture();
 
+  Texture(const Texture &) = delete;
+  auto operator=(const Texture &) -> Texture & = delete;
+  // 移动后源对象为空，可以放进连续存放的资源池
+  Texture(Texture &&other) noexcept;
+  auto operator=(Texture &&other) noexcept -> Texture &;
+
+  // 完整 mip 链的层数 floor(log2(max(w, h))) + 1
+  static auto MipLevelsFor(uint32_t w, uint32_t h) -> uint32_t;
+  // 纹理格式能否用线性过滤的 blit 生成 mip
+  static auto SupportsLinearBlit() -> bool;
+
+  // 录制 blit 链：要求所有层处于 TransferDst 且第 0 层已写入，
+  // 结束后所有层为 ShaderReadOnly（布局由 ResourceTracker 记录）
+  void RecordMipmaps(vk::CommandBuffer cmdBuf);
+
   vk::Image image;
   vk::DeviceMemory memory;
   vk::ImageView view;
   DescriptorSetManager::SetInfo set;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t mipLevels = 1;
+  vk::Format format = vk::Format::eR8G8B8A8Srgb;
+  // 实际分配的显存大小
+  vk::DeviceSize memorySize = 0;
 
 private:
   void createImage(uint32_t w, uint32_t h);
   void createImageView();
   void allocMemory();
   auto queryImageMemoryIndex() -> uint32_t;
-  void transitionImageLayoutFromUndefine2Dst();
-  void transitionImageLayoutFromDst2Optimal();
-  void transformData2Image(
-      BufferPkg &, uint32_t w, uint32_t h);
+  // 第 0 层，图像需处于 TransferDst
+  void recordCopy(vk::CommandBuffer cmdBuf, vk::Buffer buffer,
+      vk::DeviceSize offset);
+  void create(uint32_t w, uint32_t h, bool mipmapped);
+  void createStorage();
+  // pixels 为第 0 层在 CPU 上可读的地址，CPU 生成 mip 时使用
+  void upload(vk::Buffer buffer, vk::DeviceSize offset,
+      const uint8_t *pixels);
+  auto generateMipmapsOnCpu(const uint8_t *pixels,
+      std::vector<vk::BufferImageCopy> &regions)
+      -> std::vector<uint8_t>;
+  // 数据放进 staging 后调用 func(buffer, offset)，返回后释放
+  static void withStaging(const void *data, vk::DeviceSize size,
+      const std::function<void(vk::Buffer, vk::DeviceSize)> &func);
   void updateDescriptorSet(vk::Sampler sampler);
 
   void init(void *data, uint32_t w, uint32_t h,
       vk::Sampler sampler);
 };
 
-// class TextureManager final {
-// public:
-//   static TextureManager &Instance() {
-//     if (!instance_) {
-//       instance_ = std::make_unique<TextureManager>();
-//     }
-//     return *instance_;
-//   }
-
-//   auto Load(const std::string &filename) -> Texture *;
-
-//   // data must be a RGBA8888 format data
-//   auto Create(void *data, uint32_t w, uint32_t h) ->
-//   Texture *; void Destroy(Texture *); void Clear();
-
-// private:
-//   static std::unique_ptr<TextureManager> instance_;
-
-//   std::vector<std::unique_ptr<Texture>> datas_;
-// };
-
 } // namespace app
\ No newline at end of file
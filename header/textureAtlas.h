@@ -0,0 +1,143 @@
+#pragma once
+
+#include "stagingRing.h"
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+/*
+    小图集：大量小图打包进同一个 2D array 图像的各层
+    每层用 skyline（bottom-left）装箱，图块四周复制边缘像素
+    作为 padding，避免线性过滤采样到相邻图块
+    Add 先把像素放进共享的 staging ring，Flush 把全部拷贝录制进
+    调用者本帧的命令缓冲，staging 块在该帧完成后回收，不阻塞 CPU
+    布局转换都交给 ResourceTracker
+*/
+
+namespace app {
+
+// 单个矩形区域的 skyline 装箱
+class SkylinePacker final {
+public:
+  struct Rect {
+    uint32_t x, y, w, h;
+  };
+
+  SkylinePacker(uint32_t width, uint32_t height);
+
+  auto Insert(uint32_t w, uint32_t h) -> std::optional<Rect>;
+  void Clear();
+  [[nodiscard]] auto UsedArea() const -> uint64_t {
+    return usedArea_;
+  }
+
+private:
+  // 天际线上的一段：[x, x + width) 高度为 y
+  struct Segment {
+    uint32_t x, y, width;
+  };
+
+  uint32_t width_;
+  uint32_t height_;
+  uint64_t usedArea_ = 0;
+  std::vector<Segment> skyline_;
+
+  // 放在第 index 段起点时的底部高度，放不下返回 nullopt
+  auto fit(size_t index, uint32_t w, uint32_t h) const
+      -> std::optional<uint32_t>;
+  void place(size_t index, const Rect &rect);
+};
+
+class TextureAtlas final {
+public:
+  struct Config {
+    uint32_t size = 1024;
+    uint32_t layers = 4;
+    uint32_t padding = 2;
+  };
+
+  // 采样用的 UV 矩形（不含 padding）与数组层
+  struct Region {
+    uint32_t layer;
+    float u0, v0, u1, v1;
+  };
+  using Id = uint32_t;
+
+  explicit TextureAtlas(const Config &config);
+  ~TextureAtlas();
+
+  TextureAtlas(const TextureAtlas &) = delete;
+  auto operator=(const TextureAtlas &)
+      -> TextureAtlas & = delete;
+
+  // RGBA8 像素，所有层都放不下或 staging 暂时满了返回 nullopt，
+  // 后者在之前 Flush 的帧完成后再试
+  auto Add(const void *pixels, uint32_t w, uint32_t h)
+      -> std::optional<Id>;
+  // 空间要到 Repack 之后才会回收
+  void Remove(Id id);
+  [[nodiscard]] auto Get(Id id) const -> const Region &;
+
+  // 在 render pass 之外把 Add 积累的拷贝录制进 cmdBuf，
+  // frame 为 cmdBuf 所属的帧序号；采样前至少调用一次（第一次会清空图像）
+  void Flush(vk::CommandBuffer cmdBuf, uint64_t frame);
+  // 按高度重新装箱，搬运录制进 cmdBuf，返回后 view 会变化
+  void Repack(vk::CommandBuffer cmdBuf, uint64_t frame);
+  [[nodiscard]] auto HasPending() const -> bool {
+    return !pending_.empty();
+  }
+
+  // 存活图块面积 / 已用层的总面积
+  [[nodiscard]] auto Occupancy() const -> double;
+  [[nodiscard]] auto View() const -> vk::ImageView {
+    return storage_.view;
+  }
+  // 每次 Repack 加一，用来判断描述符是否需要更新
+  [[nodiscard]] auto Generation() const -> uint32_t {
+    return generation_;
+  }
+
+private:
+  struct Storage {
+    vk::Image image;
+    vk::DeviceMemory memory;
+    vk::ImageView view;
+    bool cleared = false;
+  };
+  struct Entry {
+    uint32_t layer;
+    // 含 padding 的像素矩形
+    SkylinePacker::Rect rect;
+    Region region;
+  };
+  struct PendingCopy {
+    StagingRing::Block block;
+    uint32_t layer;
+    SkylinePacker::Rect rect;
+  };
+
+  Config config_;
+  Storage storage_;
+  std::vector<SkylinePacker> packers_;
+  std::unordered_map<Id, Entry> entries_;
+  std::vector<PendingCopy> pending_;
+  Id nextId_ = 0;
+  uint32_t generation_ = 0;
+
+  auto createStorage() -> Storage;
+  void destroyStorage(Storage &storage);
+  // 第一次使用前清空，调用时图像须处于 TransferDst
+  void clear(vk::CommandBuffer cmdBuf, Storage &storage);
+  auto allocate(uint32_t w, uint32_t h)
+      -> std::optional<std::pair<uint32_t, SkylinePacker::Rect>>;
+  auto makeRegion(uint32_t layer,
+      const SkylinePacker::Rect &rect) const -> Region;
+};
+
+// count 张随机尺寸的小图走一遍 Add / Flush / Remove 一半 / Repack，
+// 输出各步耗时、占用率变化，并检查搬运后的图块互不重叠
+void BenchmarkAtlas(uint32_t count);
+
+} // namespace app
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "image.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+/*
+    块压缩纹理缓存：
+    源图像第一次加载时（或用 --transcode 离线）生成完整 mip 链，
+    逐级压缩后写入 cache/ 下的容器文件；之后直接 mmap，
+    所有层连续存放，一次 memcpy 进 staging 即可上传
+*/
+
+namespace app {
+
+enum class BlockFormat : uint32_t {
+  Rgba8,
+  BC1,
+  BC7,
+  // 只能加载外部工具生成的缓存，不做编码
+  Astc4x4,
+};
+
+auto ToVkFormat(BlockFormat format) -> vk::Format;
+auto BlockFormatName(BlockFormat format) -> const char *;
+auto ParseBlockFormat(std::string_view name)
+    -> std::optional<BlockFormat>;
+// 采样时每个 texel 占用的位数
+auto BitsPerTexel(BlockFormat format) -> uint32_t;
+// 当前设备可采样的压缩格式，按偏好排序
+auto SupportedBlockFormats() -> std::vector<BlockFormat>;
+
+// 只读内存映射
+class MappedFile final {
+public:
+  static auto Open(const std::string &path)
+      -> std::unique_ptr<MappedFile>;
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  auto operator=(const MappedFile &) -> MappedFile & = delete;
+
+  [[nodiscard]] auto Data() const -> const uint8_t * {
+    return data_;
+  }
+  [[nodiscard]] auto Size() const -> size_t {
+    return size_;
+  }
+
+private:
+  MappedFile() = default;
+
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void *file_ = nullptr;
+  void *mapping_ = nullptr;
+#else
+  int fd_ = -1;
+#endif
+};
+
+class TextureCache final {
+public:
+  struct Level {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+  };
+
+  // cache/<源路径>.<格式>.tcache
+  static auto PathFor(std::string_view source, BlockFormat format)
+      -> std::string;
+  // 缓存存在且与源文件（大小 + 修改时间）一致时返回
+  static auto Open(std::string_view source, BlockFormat format)
+      -> std::unique_ptr<TextureCache>;
+  // 生成 mip 链并压缩写入缓存，BC1 遇到半透明图像时失败
+  static auto Build(std::string_view source, BlockFormat format,
+      const ImageData &image) -> bool;
+
+  [[nodiscard]] auto Format() const -> BlockFormat {
+    return format_;
+  }
+  [[nodiscard]] auto Width() const -> uint32_t {
+    return levels_.front().width;
+  }
+  [[nodiscard]] auto Height() const -> uint32_t {
+    return levels_.front().height;
+  }
+  [[nodiscard]] auto Levels() const -> const std::vector<Level> & {
+    return levels_;
+  }
+  // 所有层连续存放，offset 相对于 Data()
+  [[nodiscard]] auto Data() const -> const uint8_t *;
+  [[nodiscard]] auto DataSize() const -> uint64_t;
+
+  // 输出显存占用以及与 RGBA8 的对比
+  void PrintFootprint(std::string_view source) const;
+
+private:
+  std::unique_ptr<MappedFile> file_;
+  BlockFormat format_ = BlockFormat::Rgba8;
+  uint64_t dataOffset_ = 0;
+  std::vector<Level> levels_;
+};
+
+// 按设备偏好打开缓存，都没有时用 decode 得到的图像生成一份
+// 设备不支持任何压缩格式时返回 nullptr
+auto LoadTextureCache(std::string_view source,
+    const std::function<const ImageData &()> &decode)
+    -> std::unique_ptr<TextureCache>;
+
+} // namespace app
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "image.h"
+#include "texture.h"
+#include "tool.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace app {
+
+using TextureHandle = std::shared_ptr<Texture>;
+
+/*
+    纹理管理：
+    同一路径或同样内容只创建一份 GPU 图像，返回共享句柄
+    内容按 128 位哈希 + 大小 + 标记识别，不保留像素副本
+    句柄全部释放后纹理仍然缓存，显存超出预算时按 LRU 淘汰，
+    淘汰时直接释放最后一个句柄，Texture 析构交给 DeletionQueue 延迟销毁
+*/
+class TextureManager final {
+public:
+  struct Config {
+    vk::DeviceSize vramBudget = 256 * 1024 * 1024;
+  };
+
+  struct Stats {
+    uint64_t requests = 0;
+    uint64_t pathHits = 0;
+    uint64_t contentHits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t textureCount = 0;
+    vk::DeviceSize residentBytes = 0;
+
+    [[nodiscard]] auto HitRate() const -> double {
+      return requests == 0
+                 ? 0.0
+                 : double(pathHits + contentHits) / requests;
+    }
+  };
+
+  static void Init(const Config &config) {
+    instance = std::make_unique<TextureManager>(config);
+  }
+
+  static void Quit() {
+    instance.reset();
+  }
+
+  static auto Instance() -> TextureManager & {
+    return *instance;
+  }
+
+  explicit TextureManager(const Config &config);
+  ~TextureManager();
+
+  // decode 为空时直接解码文件；设备支持块压缩时优先走缓存
+  auto Load(std::string_view path,
+      const std::function<ImageData()> &decode = {})
+      -> TextureHandle;
+  // pixels 为 RGBA8
+  auto Create(const void *pixels, uint32_t w, uint32_t h)
+      -> TextureHandle;
+
+  void SetBudget(vk::DeviceSize bytes);
+  // 渲染线程每帧调用，frame 为正在录制的帧
+  void Update(uint64_t frame);
+
+  [[nodiscard]] auto GetStats() const -> Stats;
+  // 一行输出命中率与显存占用
+  void PrintStats() const;
+
+private:
+  struct ContentKey {
+    Hash128 hash;
+    uint64_t size = 0;
+    // 像素为 (w << 32) | h，压缩数据为格式，两者不会相等
+    uint64_t tag = 0;
+
+    auto operator==(const ContentKey &) const -> bool = default;
+  };
+  struct ContentKeyHash {
+    auto operator()(const ContentKey &key) const -> size_t {
+      return static_cast<size_t>(key.hash.lo);
+    }
+  };
+  struct Entry {
+    TextureHandle texture;
+    ContentKey key;
+    std::vector<std::string> paths;
+    uint64_t lastUsed = 0;
+  };
+
+  Config config_;
+  // id -> 纹理
+  std::unordered_map<uint64_t, Entry> entries_;
+  // 内容 -> id
+  std::unordered_map<ContentKey, uint64_t, ContentKeyHash> contents_;
+  // 路径 -> id
+  std::unordered_map<std::string, uint64_t> paths_;
+  uint64_t nextId_ = 0;
+  uint64_t frame_ = 0;
+  Stats stats_;
+  mutable std::mutex mutex_;
+
+  static auto keyOf(const void *data, size_t size, uint64_t tag)
+      -> ContentKey;
+  auto find(const ContentKey &key) const -> std::optional<uint64_t>;
+  auto acquire(uint64_t id, std::string_view path)
+      -> TextureHandle;
+  auto insert(const ContentKey &key, TextureHandle texture,
+      std::string_view path) -> TextureHandle;
+  void evict();
+
+  static std::unique_ptr<TextureManager> instance;
+};
+
+} // namespace app
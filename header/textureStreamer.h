@@ -0,0 +1,160 @@
+#pragma once
+
+#include "image.h"
+#include "stagingRing.h"
+#include "texture.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+/*
+    纹理流式加载：
+    1. Load 把请求放进优先级队列，立即返回句柄
+    2. worker 线程按优先级解码，解码后尽量直接写入 staging ring
+    3. 渲染线程每帧 Update，按字节预算把解码好的行通过
+       staging ring 批量上传，一个批次一次提交
+    ring 是自己独占的：等预算的解码块会长期占着 ring 的尾部，
+    放在共享 ring 里会挡住同步加载的纹理
+    句柄在驻留之前 View() 返回占位纹理
+*/
+
+namespace app {
+
+class TextureStreamer final {
+public:
+  struct Config {
+    uint32_t workerCount = 2;
+    // 每帧最多上传的字节数
+    vk::DeviceSize uploadBudget = 8 * 1024 * 1024;
+    // 独占的 staging ring 大小
+    vk::DeviceSize stagingSize = 32 * 1024 * 1024;
+  };
+
+  enum class State {
+    Queued,
+    Decoding,
+    Decoded,
+    Uploading,
+    Resident,
+    Cancelled,
+    Failed,
+  };
+
+  struct Request {
+    std::string path;
+    int priority = 0;
+    uint64_t order = 0;
+    std::atomic<State> state{State::Queued};
+
+    // 以下由 worker 写入（Decoded 之前）或渲染线程使用
+    // 优先写入 staging，放不下时才解码到堆上的 image
+    ImageData image;
+    std::optional<StagingRing::Block> staging;
+    std::unique_ptr<Texture> texture;
+    uint32_t uploadedRows = 0;
+  };
+  using Handle = std::shared_ptr<Request>;
+
+  struct Stats {
+    uint64_t requested = 0;
+    uint64_t resident = 0;
+    uint64_t cancelled = 0;
+    uint64_t failed = 0;
+    vk::DeviceSize uploadedLastFrame = 0;
+  };
+
+  TextureStreamer(vk::Sampler sampler, const Config &config);
+  ~TextureStreamer();
+
+  TextureStreamer(const TextureStreamer &) = delete;
+  auto operator=(const TextureStreamer &)
+      -> TextureStreamer & = delete;
+
+  // 数值越大越先加载
+  auto Load(const std::string &path, int priority = 0)
+      -> Handle;
+  void Cancel(const Handle &handle);
+  void SetUploadBudget(vk::DeviceSize bytes);
+
+  // 渲染线程每帧调用一次
+  void Update();
+
+  // 未驻留时返回占位纹理
+  [[nodiscard]] auto View(const Handle &handle) const
+      -> vk::ImageView;
+  [[nodiscard]] static auto IsResident(const Handle &handle)
+      -> bool {
+    return handle->state.load(std::memory_order_acquire) ==
+           State::Resident;
+  }
+  [[nodiscard]] auto GetStats() const -> Stats;
+
+private:
+  struct Compare {
+    auto operator()(const Handle &a, const Handle &b) const
+        -> bool {
+      if (a->priority != b->priority) {
+        return a->priority < b->priority;
+      }
+      return a->order > b->order;
+    }
+  };
+
+  // 一次提交，fence 完成后回收 staging 与已取消的纹理
+  struct Batch {
+    vk::CommandBuffer cmdBuf;
+    vk::Fence fence;
+    // 提交时才分配，ring 按它回收
+    uint64_t id = 0;
+    bool submitted = false;
+    std::vector<Handle> completing;
+    std::vector<std::unique_ptr<Texture>> retired;
+    // 录制期间用完的 staging 块，提交之后才交给 ring
+    std::vector<StagingRing::Block> staging;
+  };
+
+  StagingRing ring_;
+  Config config_;
+  std::unique_ptr<Texture> placeholder_;
+
+  // worker 队列
+  std::priority_queue<Handle, std::vector<Handle>, Compare>
+      queue_;
+  std::mutex queueMutex_;
+  std::condition_variable queueCond_;
+  bool stop_ = false;
+  std::vector<std::thread> workers_;
+  uint64_t nextOrder_ = 0;
+
+  // 解码完成、等待上传
+  std::vector<Handle> decoded_;
+  std::mutex decodedMutex_;
+
+  // 以下只在渲染线程访问
+  std::vector<Handle> uploading_;
+  std::vector<Batch> batches_;
+  size_t nextBatch_ = 0;
+  uint64_t batchCounter_ = 0;
+  uint64_t completedBatch_ = 0;
+  Stats stats_;
+  std::atomic<uint64_t> failed_{0};
+
+  void workerLoop();
+  void decode(Request &request);
+  void reclaimBatches();
+  void recordUploads(Batch &batch);
+  auto uploadRows(Batch &batch, Request &request,
+      vk::DeviceSize budget) -> vk::DeviceSize;
+  void retire(Batch &batch, Handle &request);
+  void submit(Batch &batch);
+};
+
+} // namespace app
\ No newline at end of file
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "buffer.h"
+#include "image.h"
+#include "textureCache.h"
+#include "vertex.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+
+/*
+    超大图像分块显示：
+    1. BuildTilePyramid 离线把图像切成金字塔（每级 2x2 缩小），
+       每块 tileSize 加 1 像素的邻块边框，按级、按行连续存放
+    2. TiledImage mmap 金字塔文件，每帧根据 MVP 在四叉树上选出
+       可见且精度足够的块，只把这些块放进固定大小的缓存纹理
+    3. 间接表只记录驻留块所在的缓存槽，槽满时按 LRU 淘汰；
+       未驻留的块用最近的已驻留祖先代替
+    显存、staging 和间接表的占用只取决于 Config，与源图像大小无关
+*/
+
+namespace app {
+
+// 返回 false 表示写文件失败
+auto BuildTilePyramid(const ImageData &image,
+    const std::string &output, uint32_t tileSize = 256) -> bool;
+
+class TiledImage final {
+public:
+  struct Config {
+    // 缓存纹理为 slotsPerSide x slotsPerSide 个槽
+    uint32_t slotsPerSide = 8;
+    uint32_t uploadsPerFrame = 8;
+    uint32_t maxQuads = 1024;
+  };
+
+  struct Stats {
+    uint32_t visibleTiles = 0;
+    uint32_t residentTiles = 0;
+    uint32_t uploadsLastFrame = 0;
+    uint64_t evictions = 0;
+  };
+
+  TiledImage(const std::string &path, const Config &config,
+      uint32_t frameCount);
+  ~TiledImage();
+
+  TiledImage(const TiledImage &) = delete;
+  auto operator=(const TiledImage &) -> TiledImage & = delete;
+
+  // render pass 之前调用：选块、录制上传、生成顶点
+  void Update(vk::CommandBuffer cmdBuf, uint32_t frame,
+      const glm::mat4 &mvp, vk::Extent2D viewport);
+  // render pass 内调用，管线与描述符由调用者绑定
+  void Draw(vk::CommandBuffer cmdBuf, uint32_t frame);
+
+  [[nodiscard]] auto View() const -> vk::ImageView {
+    return view_;
+  }
+  [[nodiscard]] auto GetStats() const -> Stats {
+    return stats_;
+  }
+
+private:
+  struct Level {
+    uint32_t width, height;
+    uint32_t tilesX, tilesY;
+    uint64_t firstTile;
+  };
+  struct TileId {
+    uint32_t level, x, y;
+  };
+  struct Slot {
+    // 全局块序号，-1 表示空
+    int64_t tile = -1;
+    uint64_t lastUsed = 0;
+  };
+  // 每个 in-flight 帧一块上传缓冲
+  struct FrameData {
+    std::unique_ptr<BufferPkg> staging;
+    std::unique_ptr<BufferPkg> vertices;
+    uint32_t quadCount = 0;
+  };
+
+  Config config_;
+  std::unique_ptr<MappedFile> file_;
+  uint32_t tileSize_ = 0;
+  uint32_t border_ = 0;
+  uint32_t slotSize_ = 0;
+  uint64_t dataOffset_ = 0;
+  std::vector<Level> levels_;
+
+  // 间接表：驻留块的全局序号 -> 缓存槽，大小不超过槽数
+  std::unordered_map<uint64_t, int32_t> indirection_;
+  std::vector<Slot> slots_;
+  std::vector<uint32_t> freeSlots_;
+  uint64_t frame_ = 0;
+
+  vk::Image image_;
+  vk::DeviceMemory memory_;
+  vk::ImageView view_;
+  std::vector<FrameData> frames_;
+  std::unique_ptr<BufferPkg> indices_;
+  Stats stats_;
+
+  auto tileIndex(const TileId &id) const -> uint64_t {
+    const auto &level = levels_[id.level];
+    return level.firstTile + uint64_t(id.y) * level.tilesX + id.x;
+  }
+  // 未驻留返回 -1
+  auto slotOf(uint64_t index) const -> int32_t {
+    const auto found = indirection_.find(index);
+    return found == indirection_.end() ? -1 : found->second;
+  }
+  auto tileData(uint64_t index) const -> const uint8_t *;
+  void createCache();
+  void select(const glm::mat4 &mvp, vk::Extent2D viewport,
+      std::vector<TileId> &visible) const;
+  auto acquireSlot() -> int32_t;
+  void emitQuad(const TileId &id, Vertex *out) const;
+};
+
+} // namespace app
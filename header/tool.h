@@ -1,8 +1,24 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 
 namespace app {
 auto readSpvFile(const std::string &filename)
     -> std::string;
+// 64 位非加密哈希，每次处理 8 字节
+auto HashBytes(const void *data, size_t size,
+    uint64_t seed = 0) -> uint64_t;
+
+// 128 位非加密哈希：两条乘数、种子都不同的链同时计算，
+// 用来按内容去重，碰撞概率可以忽略
+struct Hash128 {
+  uint64_t lo = 0;
+  uint64_t hi = 0;
+
+  auto operator==(const Hash128 &) const -> bool = default;
+};
+auto HashBytes128(const void *data, size_t size,
+    uint64_t seed = 0) -> Hash128;
 }
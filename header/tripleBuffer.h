@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace app {
+
+/*
+    单生产者单消费者的三缓冲：生产者总有一个可写的槽，
+    消费者总能拿到最新发布的一份，双方都不会等待对方
+    中间槽的下标与“有新数据”标记放在同一个原子变量里交换
+*/
+template <typename T>
+class TripleBuffer final {
+public:
+  TripleBuffer() = default;
+
+  TripleBuffer(const TripleBuffer &) = delete;
+  auto operator=(const TripleBuffer &) -> TripleBuffer & = delete;
+
+  // 生产者：写入 Back 后 Publish
+  auto Back() -> T & {
+    return slots_[back_];
+  }
+  void Publish() {
+    const uint8_t prev = middle_.exchange(
+        back_ | Dirty, std::memory_order_acq_rel);
+    back_ = prev & IndexMask;
+  }
+
+  // 消费者：有新数据时换成最新的一份，否则沿用上一份
+  auto Consume() -> const T & {
+    if (middle_.load(std::memory_order_relaxed) & Dirty) {
+      const uint8_t prev =
+          middle_.exchange(front_, std::memory_order_acq_rel);
+      front_ = prev & IndexMask;
+    }
+    return slots_[front_];
+  }
+
+private:
+  static constexpr uint8_t IndexMask = 3;
+  static constexpr uint8_t Dirty = 4;
+
+  std::array<T, 3> slots_{};
+  // 只由生产者访问
+  uint8_t back_ = 0;
+  std::atomic<uint8_t> middle_{1};
+  // 只由消费者访问
+  uint8_t front_ = 2;
+};
+
+} // namespace app
@@ -1,20 +1,286 @@
 #include "header/application.h"
+#include "header/culling.h"
+#include "header/math.h"
+#include "header/scene.h"
+#include "header/textureAtlas.h"
+#include <array>
+#include <cstdlib>
 #include <iostream>
+#include <string_view>
 
 
-void initRender(uint32_t width = 800, uint32_t height = 600) {
-  app::Application::Init(width, height);
+void initRender(const app::FramePacer::Config &pacing,
+    uint32_t width = 800, uint32_t height = 600) {
+  app::Application::Init(width, height, pacing);
 }
 
-auto main() -> int {
-  initRender();
+// --pacing <latency|throughput|capped> [fps]
+// --frames-in-flight <n>
+auto parsePacing(int argc, char **argv) -> app::FramePacer::Config {
+  app::FramePacer::Config config;
+  for (int i = 1; i + 1 < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg == "--pacing") {
+      auto mode = app::FramePacer::ParseMode(argv[i + 1]);
+      if (!mode) {
+        std::cerr << "unknown pacing mode : " << argv[i + 1]
+                  << '\n';
+        continue;
+      }
+      config.mode = *mode;
+      if (i + 2 < argc && argv[i + 2][0] != '-') {
+        config.fpsCap = std::atof(argv[i + 2]);
+      }
+    } else if (arg == "--present") {
+      config.presentMode = app::FramePacer::ParsePresentMode(argv[i + 1]);
+      if (!config.presentMode) {
+        std::cerr << "unknown present mode : " << argv[i + 1] << '\n';
+      }
+    } else if (arg == "--frames-in-flight") {
+      config.framesInFlight =
+          static_cast<uint32_t>(std::atoi(argv[i + 1]));
+    }
+  }
+  return config;
+}
+
+// --capture <png|rgba|yuv> <output>
+auto parseCapture(int argc, char **argv)
+    -> std::optional<app::FrameCapture::Config> {
+  for (int i = 1; i + 2 < argc; ++i) {
+    if (std::string_view(argv[i]) != "--capture") {
+      continue;
+    }
+    auto format = app::FrameCapture::ParseFormat(argv[i + 1]);
+    if (!format) {
+      std::cerr << "unknown capture format : " << argv[i + 1]
+                << '\n';
+      return std::nullopt;
+    }
+    app::FrameCapture::Config config;
+    config.format = *format;
+    config.output = argv[i + 2];
+    return config;
+  }
+  return std::nullopt;
+}
+
+// --bench <minify|overdraw> [frames]
+// --bench atlas [count]
+void startBenchmark(int argc, char **argv) {
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (std::string_view(argv[i]) != "--bench") {
+      continue;
+    }
+    std::string_view name = argv[i + 1];
+    uint32_t frames = 300;
+    if (i + 2 < argc && argv[i + 2][0] != '-') {
+      frames = static_cast<uint32_t>(std::atoi(argv[i + 2]));
+    }
+    if (name == "minify") {
+      app::Application::GetInstance()
+          .renderer->StartMinifyBenchmark(frames);
+    } else if (name == "overdraw") {
+      app::Application::GetInstance()
+          .renderer->StartOverdrawBenchmark(frames);
+    } else if (name == "atlas") {
+      app::BenchmarkAtlas(frames);
+    } else {
+      std::cerr << "unknown benchmark : " << name << '\n';
+    }
+    return;
+  }
+}
+
+// --bench <handles|math|scene|cull> [count]
+// 纯 CPU 的对比测试，不需要创建窗口和设备
+auto benchOffline(int argc, char **argv) -> std::optional<int> {
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (std::string_view(argv[i]) != "--bench") {
+      continue;
+    }
+    const std::string_view name = argv[i + 1];
+    void (*bench)(uint32_t) = nullptr;
+    uint32_t count = 0;
+    if (name == "handles") {
+      bench = app::BenchmarkHandles;
+      count = 100000;
+    } else if (name == "math") {
+      bench = app::BenchmarkMath;
+      count = 10000;
+    } else if (name == "scene") {
+      bench = app::BenchmarkScene;
+      count = 100000;
+    } else if (name == "cull") {
+      bench = app::BenchmarkCulling;
+      count = 100000;
+    } else {
+      continue;
+    }
+    if (i + 2 < argc && argv[i + 2][0] != '-') {
+      count = static_cast<uint32_t>(std::atoi(argv[i + 2]));
+    }
+    bench(count);
+    return EXIT_SUCCESS;
+  }
+  return std::nullopt;
+}
+
+// --transcode <bc1|bc7> <image>...
+// 离线生成块压缩缓存，不需要创建窗口和设备
+auto transcode(int argc, char **argv) -> std::optional<int> {
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (std::string_view(argv[i]) != "--transcode") {
+      continue;
+    }
+    auto format = app::ParseBlockFormat(argv[i + 1]);
+    if (!format) {
+      std::cerr << "unknown block format : " << argv[i + 1]
+                << '\n';
+      return EXIT_FAILURE;
+    }
+    int result = EXIT_SUCCESS;
+    for (int j = i + 2; j < argc; ++j) {
+      try {
+        auto image = app::LoadImageData(argv[j]);
+        if (app::TextureCache::Build(argv[j], *format, image)) {
+          app::TextureCache::Open(argv[j], *format)
+              ->PrintFootprint(argv[j]);
+          continue;
+        }
+      } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+      }
+      std::cerr << "transcode failed : " << argv[j] << '\n';
+      result = EXIT_FAILURE;
+    }
+    return result;
+  }
+  return std::nullopt;
+}
+
+// --build-pyramid <image> <output>
+// 离线把大图切成分块金字塔，源图需要能完整解码进内存
+auto buildPyramid(int argc, char **argv) -> std::optional<int> {
+  for (int i = 1; i + 2 < argc; ++i) {
+    if (std::string_view(argv[i]) != "--build-pyramid") {
+      continue;
+    }
+    try {
+      auto image = app::LoadImageData(argv[i + 1]);
+      if (app::BuildTilePyramid(image, argv[i + 2])) {
+        return EXIT_SUCCESS;
+      }
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << '\n';
+    }
+    std::cerr << "build pyramid failed : " << argv[i + 1]
+              << '\n';
+    return EXIT_FAILURE;
+  }
+  return std::nullopt;
+}
+
+// 渲染器开关：argv 只扫描一遍，再按表的顺序应用
+// （GPU 裁剪要在 Hi-Z 和异步计算之前打开）
+struct RendererFlag {
+  std::string_view name;
+  bool hasArg;
+  void (*apply)(app::Renderer &renderer, const char *arg);
+};
+
+constexpr RendererFlag RendererFlags[] = {
+    // --tiled <pyramid>
+    {"--tiled", true,
+        [](app::Renderer &r, const char *arg) {
+          r.ShowTiledImage(arg);
+        }},
+    // --stream <image>
+    {"--stream", true,
+        [](app::Renderer &r, const char *arg) {
+          r.ShowStreamedTexture(arg);
+        }},
+    {"--print-graph", false,
+        [](app::Renderer &r, const char *) { r.SetPrintGraph(true); }},
+    {"--depth-prepass", false,
+        [](app::Renderer &r, const char *) {
+          r.SetDepthPrepass(true);
+        }},
+    // --msaa <samples>
+    {"--msaa", true,
+        [](app::Renderer &r, const char *arg) {
+          r.SetMsaa(static_cast<uint32_t>(std::atoi(arg)));
+        }},
+    // --objects <count>
+    {"--objects", true,
+        [](app::Renderer &r, const char *arg) {
+          r.SpawnObjects(static_cast<uint32_t>(std::atoi(arg)));
+        }},
+    {"--gpu-cull", false,
+        [](app::Renderer &r, const char *) { r.SetGpuCulling(true); }},
+    {"--hiz", false,
+        [](app::Renderer &r, const char *) {
+          r.SetOcclusionCulling(true);
+        }},
+    {"--async-compute", false,
+        [](app::Renderer &r, const char *) {
+          r.SetAsyncCompute(true);
+        }},
+};
+
+void applyRendererFlags(int argc, char **argv, app::Renderer &renderer) {
+  constexpr size_t Count = std::size(RendererFlags);
+  std::array<const char *, Count> args{};
+  std::array<bool, Count> present{};
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    for (size_t f = 0; f < Count; ++f) {
+      const auto &flag = RendererFlags[f];
+      if (arg != flag.name) {
+        continue;
+      }
+      if (flag.hasArg) {
+        if (i + 1 >= argc) {
+          std::cerr << "missing argument : " << arg << '\n';
+          break;
+        }
+        args[f] = argv[++i];
+      }
+      // 重复出现时以最后一次为准
+      present[f] = true;
+      break;
+    }
+  }
+  for (size_t f = 0; f < Count; ++f) {
+    if (present[f]) {
+      RendererFlags[f].apply(renderer, args[f]);
+    }
+  }
+}
+
+auto main(int argc, char **argv) -> int {
+  if (auto result = transcode(argc, argv)) {
+    return *result;
+  }
+  if (auto result = buildPyramid(argc, argv)) {
+    return *result;
+  }
+  if (auto result = benchOffline(argc, argv)) {
+    return *result;
+  }
+  initRender(parsePacing(argc, argv));
   auto &app = app::Application::GetInstance();
   std::cout << "Prepare!"<< "\n";
   try {
+    if (auto config = parseCapture(argc, argv)) {
+      app.renderer->StartCapture(*config);
+    }
+    applyRendererFlags(argc, argv, *app.renderer);
+    startBenchmark(argc, argv);
     app.run();
   } catch (const std::exception &e) {
     std::cerr << e.what() << '\n';
     return EXIT_FAILURE;
   }
   return EXIT_SUCCESS;
-}
+}
\ No newline at end of file
@@ -6,6 +6,19 @@ layout(binding = 0) uniform UniformBufferObject {
     mat4 proj;
 } ubo;
 
+// 场景节点的世界矩阵，按节点下标排列，每帧只写变化的部分
+layout(std430, binding = 2) readonly buffer Instances {
+    mat4 world[];
+} instances;
+
+// 每次绘制的模型矩阵，叠加在 ubo.model 之后；
+// node 不小于 0 时再乘上该场景节点的世界矩阵，
+// 为 -2 时是 GPU 裁剪生成的间接绘制，节点下标在 firstInstance 里
+layout(push_constant) uniform DrawConstants {
+    mat4 model;
+    int node;
+} draw;
+
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
@@ -13,8 +26,16 @@ layout(location = 2) in vec2 inTexCoord;
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
+// 深度预渲染与主 pass 用 EQUAL 比较，两次的深度必须一致
+invariant gl_Position;
+
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 0.0, 1.0);
+    mat4 model = draw.model;
+    int node = draw.node == -2 ? gl_InstanceIndex : draw.node;
+    if (node >= 0) {
+        model = model * instances.world[node];
+    }
+    gl_Position = ubo.proj * ubo.view * ubo.model * model * vec4(inPosition, 0.0, 1.0);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
 }
\ No newline at end of file
@@ -1,17 +1,25 @@
 #include "../header/application.h"
+#include "../header/textureManager.h"
 #include <cstdint>
 #include <memory>
 #include <chrono>
+#include <exception>
+#include <future>
+#include <thread>
 
 namespace app {
 // 实例
 std::unique_ptr<Application> Application::instance_ =
     nullptr;
 // 实例初始化
-void Application::Init(uint32_t w, uint32_t h) {
+void Application::Init(uint32_t w, uint32_t h,
+    const FramePacer::Config &pacing) {
   if (instance_ == nullptr) {
-    instance_.reset(new Application(w, h));
-    instance_->initwindow();
+    instance_.reset(new Application(w, h, pacing));
+    {
+      auto scope = instance_->startup.Measure("window");
+      instance_->initwindow();
+    }
     instance_->initVulkan();
   } else {
     std::cout << "repeat create Application" << '\n';
@@ -32,56 +40,151 @@ void Application::initwindow() {
   glfwInit();
 
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-  glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+  glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
   window = glfwCreateWindow(
       width, height, "Vulkan", nullptr, nullptr);
+  // 有些平台尺寸变化时 present 不会返回 out of date
+  glfwSetFramebufferSizeCallback(
+      window, [](GLFWwindow *, int, int) {
+        Application::GetInstance().framebufferResized = true;
+      });
 }
 // vulkan 程序初始化
 void Application::initVulkan() {
-  // 创建实例
-  createInstance();
-  createSurface();
-  pickPhysicalDevice();
-  queryQueueFamilyIndices();
-  createDevice();
-  getGQueue();
-  createSwapchain();
-  createShaderModules();
-  createRenderProcess();
-  createGraphicsPipeline();
-  createCommandManager();
-  createRenderer();
+  // 图像解码与 SPIR-V 读取不依赖设备，先在后台开始
+  startPreload();
+  {
+    auto scope = startup.Measure("instance");
+    createInstance();
+  }
+  {
+    auto scope = startup.Measure("surface");
+    createSurface();
+  }
+  {
+    auto scope = startup.Measure("physical device");
+    pickPhysicalDevice();
+    queryQueueFamilyIndices();
+  }
+  {
+    auto scope = startup.Measure("device");
+    createDevice();
+    getGQueue();
+    deletionQueue = std::make_unique<DeletionQueue>();
+    resources = std::make_unique<ResourceRegistry>();
+  }
+  {
+    auto scope = startup.Measure("swapchain");
+    createSwapchain();
+  }
+  {
+    auto scope = startup.Measure("shader");
+    createShaderModules();
+  }
+  {
+    auto scope = startup.Measure("render process");
+    createRenderProcess();
+  }
+  // 管线编译与纹理上传互不依赖，编译放到后台线程；
+  // 登记表没有锁，编译完回到主线程再登记
+  auto pipeline = std::async(std::launch::async, [this] {
+    auto scope = startup.Measure("pipeline compile");
+    return renderProcess->BuildPipelines(*shader);
+  });
+  {
+    auto scope = startup.Measure("command manager");
+    createCommandManager();
+    createStagingRing();
+    resourceTracker = std::make_unique<ResourceTracker>();
+  }
+  {
+    auto scope = startup.Measure("renderer");
+    createRenderer();
+  }
+  renderProcess->InstallPipelines(pipeline.get());
+}
+// 后台读取启动资源
+void Application::startPreload() {
+  auto load = [this](const char *name, std::string path) {
+    auto scope = startup.Measure(name);
+    return readSpvFile(path);
+  };
+  preload.vertexSpv = std::async(
+      std::launch::async, load, "load vert.spv", "spv/vert.spv");
+  preload.fragSpv = std::async(
+      std::launch::async, load, "load frag.spv", "spv/frag.spv");
+  preload.texture = std::async(std::launch::async, [this] {
+    auto scope = startup.Measure("texture decode");
+    return LoadImageData(DefaultTexturePath);
+  });
 }
-// 窗口内的渲染循环
+// 主线程只处理窗口事件与模拟，录制和提交在渲染线程，
+// 拖动窗口或慢帧不会互相阻塞
 void Application::mainLoop() {
-  auto startTime =
-      std::chrono::high_resolution_clock::now();
-  uint64_t frame = 0;
-  while (!glfwWindowShouldClose(window)) {
-    renderer->Render();
-    glfwPollEvents();
-    auto nowTime =
-        std::chrono::high_resolution_clock::now();
-    auto duration =
-        std::chrono::duration_cast<std::chrono::seconds>(
-            nowTime - startTime);
-    if (duration.count() >= 1) {
-      std::cout << "FPS : " << frame << "\n";
-      frame = 0;
-      startTime = nowTime;
+  std::atomic<bool> running{true};
+  std::exception_ptr renderError;
+  simulate();
+  std::thread renderThread([&] {
+    try {
+      while (running.load(std::memory_order_relaxed)) {
+        renderer->Render();
+        startup.MarkFirstFrame();
+        // 每秒输出帧率、队列深度与延迟，以及纹理缓存的情况
+        if (pacer.EndFrame()) {
+          TextureManager::Instance().PrintStats();
+        }
+      }
+    } catch (...) {
+      renderError = std::current_exception();
+      running = false;
+      glfwPostEmptyEvent();
     }
-    frame++;
+  });
+
+  // 没有事件时按固定步长模拟，有输入立即响应
+  constexpr double SimulationStep = 1.0 / 240.0;
+  while (running && !glfwWindowShouldClose(window)) {
+    glfwWaitEventsTimeout(SimulationStep);
+    simulate();
   }
+  running = false;
+  renderThread.join();
   device.waitIdle();
+  if (renderError) {
+    std::rethrow_exception(renderError);
+  }
+}
+
+void Application::simulate() {
+  static const auto startTime = std::chrono::steady_clock::now();
+  auto &snapshot = snapshots.Back();
+  snapshot.sequence = ++simulated_;
+  snapshot.time = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - startTime)
+                      .count();
+  snapshot.model = glm::rotate(glm::mat4(1.0f),
+      float(snapshot.time) * glm::radians(90.0f),
+      glm::vec3(0.0f, 0.0f, 1.0f));
+  int w = 0;
+  int h = 0;
+  glfwGetFramebufferSize(window, &w, &h);
+  snapshot.framebuffer =
+      vk::Extent2D{uint32_t(w), uint32_t(h)};
+  snapshots.Publish();
 }
 // 销毁（与创建顺序需要相反）
 void Application::cleanup() {
-  commandManager.reset();
   renderer.reset();
+  resourceTracker.reset();
+  stagingRing.reset();
+  commandManager.reset();
   renderProcess.reset();
   shader.reset();
   swapchain.reset();
+  resources.reset();
+  // 上面释放的对象都还在队列里
+  deletionQueue.reset();
   device.destroy();
   vkDestroySurfaceKHR(instance, surface, nullptr);
   instance.destroy();
@@ -137,32 +240,49 @@ void Application::pickPhysicalDevice() {
 void Application::createDevice() {
   vk::DeviceCreateInfo createInfo;
 
+  // 三种队列族可能相同，每个族只创建一个队列
+  std::set<uint32_t> families{queueFamilyIndices.graphicQueue.value(),
+      queueFamilyIndices.presentQueue.value(),
+      queueFamilyIndices.computeQueue.value()};
   std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
   float proprities = 1.0;
-  if (queueFamilyIndices.presentQueue.value() ==
-      queueFamilyIndices.graphicQueue.value()) {
+  for (auto family : families) {
     vk::DeviceQueueCreateInfo queueCreateInfo;
     queueCreateInfo.setPQueuePriorities(&proprities)
         .setQueueCount(1)
-        .setQueueFamilyIndex(
-            queueFamilyIndices.graphicQueue.value());
+        .setQueueFamilyIndex(family);
     queueCreateInfos.push_back(queueCreateInfo);
-  } else {
-    vk::DeviceQueueCreateInfo queueCreateInfo1;
-    queueCreateInfo1.setPQueuePriorities(&proprities)
-        .setQueueCount(1)
-        .setQueueFamilyIndex(
-            queueFamilyIndices.graphicQueue.value());
-    queueCreateInfos.push_back(queueCreateInfo1);
-    vk::DeviceQueueCreateInfo queueCreateInfo2;
-    queueCreateInfo2.setPQueuePriorities(&proprities)
-        .setQueueCount(1)
-        .setQueueFamilyIndex(
-            queueFamilyIndices.presentQueue.value());
-    queueCreateInfos.push_back(queueCreateInfo2);
   }
+  // 块压缩纹理与管线统计查询（overdraw 基准）需要显式开启
+  auto supported = phyDevice.getFeatures();
+  vk::PhysicalDeviceFeatures features;
+  features.setTextureCompressionBC(supported.textureCompressionBC)
+      .setTextureCompressionASTC_LDR(
+          supported.textureCompressionASTC_LDR)
+      .setPipelineStatisticsQuery(
+          supported.pipelineStatisticsQuery)
+      // GPU 裁剪：一次间接绘制多个物体，节点下标放在 firstInstance
+      .setMultiDrawIndirect(supported.multiDrawIndirect)
+      .setDrawIndirectFirstInstance(
+          supported.drawIndirectFirstInstance);
+  auto supported12 =
+      phyDevice
+          .getFeatures2<vk::PhysicalDeviceFeatures2,
+              vk::PhysicalDeviceVulkan12Features>()
+          .get<vk::PhysicalDeviceVulkan12Features>();
+  vk::PhysicalDeviceVulkan12Features features12;
+  features12.setDrawIndirectCount(supported12.drawIndirectCount);
+  // 1.2 起必须支持，异步计算与图形之间用时间线信号量同步
+  features12.setTimelineSemaphore(true);
+  // 1.3 核心功能仍需开启：屏障统一用 pipelineBarrier2，
+  // 渲染用 beginRendering，不再创建 RenderPass / Framebuffer
+  vk::PhysicalDeviceVulkan13Features features13;
+  features13.setSynchronization2(true).setDynamicRendering(true);
+  features13.setPNext(&features12);
   createInfo.setPEnabledExtensionNames(deviceExtensions)
-      .setQueueCreateInfos(queueCreateInfos);
+      .setQueueCreateInfos(queueCreateInfos)
+      .setPEnabledFeatures(&features)
+      .setPNext(&features13);
 
   createInfo
       .setEnabledExtensionCount(
@@ -170,12 +290,14 @@ void Application::createDevice() {
       .setPpEnabledExtensionNames(deviceExtensions.data());
   device = phyDevice.createDevice(createInfo);
 }
-// 获得虚拟设备对应的两种队列
+// 获得虚拟设备对应的三种队列
 void Application::getGQueue() {
   graphicQueue = device.getQueue(
       queueFamilyIndices.graphicQueue.value(), 0);
   presentQueue = device.getQueue(
       queueFamilyIndices.presentQueue.value(), 0);
+  computeQueue = device.getQueue(
+      queueFamilyIndices.computeQueue.value(), 0);
 }
 // 创建交换链
 void Application::createSwapchain() {
@@ -185,8 +307,8 @@ void Application::createSwapchain() {
 void Application::createShaderModules() {
   std::string vertexSource, fragSource;
   try {
-    vertexSource = readSpvFile("spv/vert.spv");
-    fragSource = readSpvFile("spv/frag.spv");
+    vertexSource = preload.vertexSpv.get();
+    fragSource = preload.fragSpv.get();
     if (vertexSource.size() == 0 ||
         fragSource.size() == 0) {
       throw std::runtime_error(
@@ -206,17 +328,19 @@ void Application::createRenderProcess() {
   renderProcess = std::make_unique<RenderProcess>();
 }
 
-void Application::createGraphicsPipeline() {
-  swapchain->createFrameBuffers();
-  renderProcess->RecreateGraphicsPipeline(*shader);
+void Application::createCommandManager() {
+  commandManager = std::make_unique<CommandManager>(
+      queueFamilyIndices.graphicQueue.value());
 }
 
-void Application::createCommandManager() {
-  commandManager = std::make_unique<CommandManager>();
+void Application::createStagingRing() {
+  constexpr vk::DeviceSize StagingSize = 64 * 1024 * 1024;
+  stagingRing = std::make_unique<StagingRing>(StagingSize);
 }
 // 创建渲染器
 void Application::createRenderer() {
-  renderer = std::make_unique<Renderer>();
+  renderer = std::make_unique<Renderer>(
+      static_cast<int>(pacer.FramesInFlight()));
 }
 
 // show some GPU support
@@ -236,17 +360,26 @@ void Application::showPropInfo() {
 
 void Application::queryQueueFamilyIndices() {
   auto properties = phyDevice.getQueueFamilyProperties();
-  for (int i = 0; i < properties.size(); ++i) {
-    auto propertie = properties[i];
-    if (propertie.queueFlags |
-        vk::QueueFlagBits::eGraphics) {
+  for (uint32_t i = 0; i < properties.size(); ++i) {
+    const auto flags = properties[i].queueFlags;
+    if (!queueFamilyIndices.graphicQueue &&
+        (flags & vk::QueueFlagBits::eGraphics)) {
       queueFamilyIndices.graphicQueue = i;
     }
-    if (phyDevice.getSurfaceSupportKHR(i, surface)) {
+    if (!queueFamilyIndices.presentQueue &&
+        phyDevice.getSurfaceSupportKHR(i, surface)) {
       queueFamilyIndices.presentQueue = i;
     }
-    if (queueFamilyIndices)
-      break;
+    // 只有计算能力的队列族一般对应独立的异步计算引擎
+    if (!queueFamilyIndices.computeQueue &&
+        (flags & vk::QueueFlagBits::eCompute) &&
+        !(flags & vk::QueueFlagBits::eGraphics)) {
+      queueFamilyIndices.computeQueue = i;
+    }
+  }
+  // 图形队列族一定支持计算
+  if (!queueFamilyIndices.computeQueue) {
+    queueFamilyIndices.computeQueue = queueFamilyIndices.graphicQueue;
   }
 }
 // 检查物理设备是否支持拓展
@@ -0,0 +1,56 @@
+#include "../header/asyncCompute.h"
+#include "../header/application.h"
+
+namespace app {
+
+AsyncCompute::AsyncCompute(uint32_t frameCount) {
+  auto &app = Application::GetInstance();
+  if (!Supported()) {
+    throw std::runtime_error("no dedicated compute queue family");
+  }
+  commands_ = std::make_unique<CommandManager>(
+      app.queueFamilyIndices.computeQueue.value());
+  cmdBufs_ = commands_->CreateCommandBuffers(frameCount);
+
+  vk::SemaphoreTypeCreateInfo typeInfo;
+  typeInfo.setSemaphoreType(vk::SemaphoreType::eTimeline)
+      .setInitialValue(0);
+  vk::SemaphoreCreateInfo createInfo;
+  createInfo.setPNext(&typeInfo);
+  timeline_ = app.device.createSemaphore(createInfo);
+}
+
+AsyncCompute::~AsyncCompute() {
+  Application::GetInstance().device.destroySemaphore(timeline_);
+}
+
+auto AsyncCompute::Supported() -> bool {
+  return Application::GetInstance().queueFamilyIndices.AsyncCompute();
+}
+
+auto AsyncCompute::Begin(uint32_t frame) -> vk::CommandBuffer {
+  auto cmdBuf = cmdBufs_[frame];
+  cmdBuf.reset();
+  vk::CommandBufferBeginInfo beginInfo;
+  beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+  cmdBuf.begin(beginInfo);
+  return cmdBuf;
+}
+
+auto AsyncCompute::Submit(uint32_t frame) -> uint64_t {
+  cmdBufs_[frame].end();
+  vk::CommandBufferSubmitInfo cmdInfo(cmdBufs_[frame]);
+  vk::SemaphoreSubmitInfo signal(timeline_, ++value_,
+      vk::PipelineStageFlagBits2::eAllCommands);
+  vk::SubmitInfo2 submit;
+  submit.setCommandBufferInfos(cmdInfo).setSignalSemaphoreInfos(signal);
+  Application::GetInstance().computeQueue.submit2(submit);
+  return value_;
+}
+
+auto AsyncCompute::Wait(uint64_t value,
+    vk::PipelineStageFlags2 stages) const -> vk::SemaphoreSubmitInfo {
+  return {timeline_, value, stages};
+}
+
+} // namespace app
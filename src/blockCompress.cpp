@@ -0,0 +1,287 @@
+#include "../header/blockCompress.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace app {
+
+namespace {
+
+struct Axis {
+  float mean[4];
+  float dir[4];
+};
+
+// 主成分方向（幂迭代），channels 为 3 时忽略 alpha
+auto principalAxis(const uint8_t *rgba, int channels) -> Axis {
+  Axis axis{};
+  for (int i = 0; i < 16; ++i) {
+    for (int c = 0; c < channels; ++c) {
+      axis.mean[c] += rgba[i * 4 + c];
+    }
+  }
+  for (int c = 0; c < channels; ++c) {
+    axis.mean[c] /= 16.0f;
+  }
+
+  float cov[4][4] = {};
+  for (int i = 0; i < 16; ++i) {
+    float d[4];
+    for (int c = 0; c < channels; ++c) {
+      d[c] = rgba[i * 4 + c] - axis.mean[c];
+    }
+    for (int a = 0; a < channels; ++a) {
+      for (int b = 0; b < channels; ++b) {
+        cov[a][b] += d[a] * d[b];
+      }
+    }
+  }
+
+  float v[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+  for (int iter = 0; iter < 8; ++iter) {
+    float next[4] = {};
+    for (int a = 0; a < channels; ++a) {
+      for (int b = 0; b < channels; ++b) {
+        next[a] += cov[a][b] * v[b];
+      }
+    }
+    float len = 0;
+    for (int c = 0; c < channels; ++c) {
+      len = std::max(len, std::fabs(next[c]));
+    }
+    if (len < 1e-6f) {
+      break;
+    }
+    for (int c = 0; c < channels; ++c) {
+      v[c] = next[c] / len;
+    }
+  }
+  std::memcpy(axis.dir, v, sizeof(v));
+  return axis;
+}
+
+// 沿主轴投影，取两端作为端点
+void axisEndpoints(const uint8_t *rgba, int channels,
+    float lo[4], float hi[4]) {
+  auto axis = principalAxis(rgba, channels);
+  float minT = 1e30f;
+  float maxT = -1e30f;
+  for (int i = 0; i < 16; ++i) {
+    float t = 0;
+    for (int c = 0; c < channels; ++c) {
+      t += (rgba[i * 4 + c] - axis.mean[c]) * axis.dir[c];
+    }
+    minT = std::min(minT, t);
+    maxT = std::max(maxT, t);
+  }
+  float len2 = 0;
+  for (int c = 0; c < channels; ++c) {
+    len2 += axis.dir[c] * axis.dir[c];
+  }
+  len2 = std::max(len2, 1e-6f);
+  for (int c = 0; c < channels; ++c) {
+    lo[c] = std::clamp(
+        axis.mean[c] + axis.dir[c] * minT / len2, 0.0f, 255.0f);
+    hi[c] = std::clamp(
+        axis.mean[c] + axis.dir[c] * maxT / len2, 0.0f, 255.0f);
+  }
+}
+
+auto distance(const uint8_t *a, const int *b, int channels)
+    -> int {
+  int d = 0;
+  for (int c = 0; c < channels; ++c) {
+    int e = a[c] - b[c];
+    d += e * e;
+  }
+  return d;
+}
+
+auto pack565(const float *c) -> uint16_t {
+  auto r = static_cast<int>(std::lround(c[0] * 31 / 255.0f));
+  auto g = static_cast<int>(std::lround(c[1] * 63 / 255.0f));
+  auto b = static_cast<int>(std::lround(c[2] * 31 / 255.0f));
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void unpack565(uint16_t v, int *c) {
+  int r = (v >> 11) & 31;
+  int g = (v >> 5) & 63;
+  int b = v & 31;
+  c[0] = (r << 3) | (r >> 2);
+  c[1] = (g << 2) | (g >> 4);
+  c[2] = (b << 3) | (b >> 2);
+}
+
+// 低位在前写入比特流
+class BitWriter {
+public:
+  explicit BitWriter(uint8_t *out) : out_(out) {
+    std::memset(out_, 0, 16);
+  }
+  void Write(uint32_t value, int bits) {
+    for (int i = 0; i < bits; ++i, ++pos_) {
+      if (value >> i & 1) {
+        out_[pos_ / 8] |= static_cast<uint8_t>(1 << pos_ % 8);
+      }
+    }
+  }
+
+private:
+  uint8_t *out_;
+  int pos_ = 0;
+};
+
+constexpr int BC7Weights4[16] = {
+    0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+// 7 位端点 + 共享 p 位，挑误差更小的 p
+void quantizeBC7Endpoint(
+    const float *color, uint8_t q[4], uint8_t &p) {
+  float best = 1e30f;
+  for (uint8_t bit = 0; bit < 2; ++bit) {
+    uint8_t candidate[4];
+    float err = 0;
+    for (int c = 0; c < 4; ++c) {
+      int v = static_cast<int>(
+          std::lround((color[c] - bit) / 2.0f));
+      candidate[c] = static_cast<uint8_t>(std::clamp(v, 0, 127));
+      float e = float((candidate[c] << 1) | bit) - color[c];
+      err += e * e;
+    }
+    if (err < best) {
+      best = err;
+      p = bit;
+      std::memcpy(q, candidate, 4);
+    }
+  }
+}
+
+} // namespace
+
+void EncodeBC1Block(const uint8_t *rgba, uint8_t *out) {
+  float lo[4], hi[4];
+  axisEndpoints(rgba, 3, lo, hi);
+  uint16_t c0 = pack565(hi);
+  uint16_t c1 = pack565(lo);
+  if (c0 < c1) {
+    std::swap(c0, c1);
+  }
+
+  uint32_t indices = 0;
+  if (c0 != c1) {
+    // c0 > c1：4 色模式，2/3 与 1/3 插值
+    int palette[4][3];
+    unpack565(c0, palette[0]);
+    unpack565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    for (int i = 0; i < 16; ++i) {
+      int best = 0;
+      int bestDist = distance(rgba + i * 4, palette[0], 3);
+      for (int k = 1; k < 4; ++k) {
+        int d = distance(rgba + i * 4, palette[k], 3);
+        if (d < bestDist) {
+          bestDist = d;
+          best = k;
+        }
+      }
+      indices |= uint32_t(best) << (i * 2);
+    }
+  }
+  out[0] = static_cast<uint8_t>(c0 & 0xFF);
+  out[1] = static_cast<uint8_t>(c0 >> 8);
+  out[2] = static_cast<uint8_t>(c1 & 0xFF);
+  out[3] = static_cast<uint8_t>(c1 >> 8);
+  std::memcpy(out + 4, &indices, 4);
+}
+
+void EncodeBC7Block(const uint8_t *rgba, uint8_t *out) {
+  float lo[4], hi[4];
+  axisEndpoints(rgba, 4, lo, hi);
+
+  uint8_t q[2][4];
+  uint8_t p[2];
+  quantizeBC7Endpoint(lo, q[0], p[0]);
+  quantizeBC7Endpoint(hi, q[1], p[1]);
+
+  int e[2][4];
+  for (int k = 0; k < 2; ++k) {
+    for (int c = 0; c < 4; ++c) {
+      e[k][c] = (q[k][c] << 1) | p[k];
+    }
+  }
+  int palette[16][4];
+  for (int i = 0; i < 16; ++i) {
+    for (int c = 0; c < 4; ++c) {
+      palette[i][c] = ((64 - BC7Weights4[i]) * e[0][c] +
+                          BC7Weights4[i] * e[1][c] + 32) >>
+                      6;
+    }
+  }
+
+  uint8_t indices[16];
+  for (int i = 0; i < 16; ++i) {
+    int best = 0;
+    int bestDist = distance(rgba + i * 4, palette[0], 4);
+    for (int k = 1; k < 16; ++k) {
+      int d = distance(rgba + i * 4, palette[k], 4);
+      if (d < bestDist) {
+        bestDist = d;
+        best = k;
+      }
+    }
+    indices[i] = static_cast<uint8_t>(best);
+  }
+
+  // 第一个像素的索引最高位隐含为 0，否则交换端点
+  if (indices[0] & 8) {
+    std::swap(q[0], q[1]);
+    std::swap(p[0], p[1]);
+    for (auto &index : indices) {
+      index = static_cast<uint8_t>(15 - index);
+    }
+  }
+
+  BitWriter writer(out);
+  writer.Write(1 << 6, 7);
+  for (int c = 0; c < 4; ++c) {
+    writer.Write(q[0][c], 7);
+    writer.Write(q[1][c], 7);
+  }
+  writer.Write(p[0], 1);
+  writer.Write(p[1], 1);
+  writer.Write(indices[0], 3);
+  for (int i = 1; i < 16; ++i) {
+    writer.Write(indices[i], 4);
+  }
+}
+
+void CompressImage(const uint8_t *rgba, uint32_t w, uint32_t h,
+    size_t blockBytes, uint8_t *out) {
+  const uint32_t blocksX = BlockCount(w);
+  const uint32_t blocksY = BlockCount(h);
+  uint8_t block[64];
+  for (uint32_t by = 0; by < blocksY; ++by) {
+    for (uint32_t bx = 0; bx < blocksX; ++bx) {
+      for (uint32_t y = 0; y < 4; ++y) {
+        const uint32_t sy = std::min(by * 4 + y, h - 1);
+        for (uint32_t x = 0; x < 4; ++x) {
+          const uint32_t sx = std::min(bx * 4 + x, w - 1);
+          std::memcpy(block + (y * 4 + x) * 4,
+              rgba + (size_t(sy) * w + sx) * 4, 4);
+        }
+      }
+      if (blockBytes == 8) {
+        EncodeBC1Block(block, out);
+      } else {
+        EncodeBC7Block(block, out);
+      }
+      out += blockBytes;
+    }
+  }
+}
+
+} // namespace app
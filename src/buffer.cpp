@@ -1,18 +1,28 @@
 #include "../header/buffer.h"
 #include "../header/application.h"
+#include <array>
 #include <stdexcept>
+#include <utility>
 
 namespace app {
 
 BufferPkg::BufferPkg(size_t size,
     vk::BufferUsageFlags usage,
-    vk::MemoryPropertyFlags memProperty) {
-  auto &device = Application::GetInstance().device;
+    vk::MemoryPropertyFlags memProperty, bool shared) {
+  auto &app = Application::GetInstance();
+  auto &device = app.device;
 
   this->size = size;
   vk::BufferCreateInfo createInfo;
   createInfo.setUsage(usage).setSize(size).setSharingMode(
       vk::SharingMode::eExclusive);
+  const auto &families = app.queueFamilyIndices;
+  const std::array<uint32_t, 2> indices{
+      families.graphicQueue.value(), families.computeQueue.value()};
+  if (shared && families.AsyncCompute()) {
+    createInfo.setSharingMode(vk::SharingMode::eConcurrent)
+        .setQueueFamilyIndices(indices);
+  }
 
   buffer = device.createBuffer(createInfo);
   // vk 需要的内存大小，与我们申请的不同
@@ -21,13 +31,15 @@ BufferPkg::BufferPkg(size_t size,
   requireSize = requirements.size;
   auto index = QueryBufferMemTypeIndex(
       requirements.memoryTypeBits, memProperty);
-  if (index == 0) {
+  if (!index) {
+    // 构造失败不会调用析构函数
+    device.destroyBuffer(buffer);
     throw std::runtime_error(
         "Pht Device can not support such memory!");
   }
 
   vk::MemoryAllocateInfo allocInfo;
-  allocInfo.setMemoryTypeIndex(index).setAllocationSize(
+  allocInfo.setMemoryTypeIndex(*index).setAllocationSize(
       requirements.size);
 
   memory = device.allocateMemory(allocInfo);
@@ -46,29 +58,66 @@ BufferPkg::BufferPkg(size_t size,
   }
 }
 
+BufferPkg::BufferPkg(BufferPkg &&other) noexcept
+    : buffer(std::exchange(other.buffer, nullptr)),
+      memory(std::exchange(other.memory, nullptr)),
+      map(std::exchange(other.map, nullptr)),
+      size(std::exchange(other.size, 0)),
+      requireSize(std::exchange(other.requireSize, 0)) {}
+
+// 交换，原来的资源随 other 析构
+auto BufferPkg::operator=(BufferPkg &&other) noexcept -> BufferPkg & {
+  std::swap(buffer, other.buffer);
+  std::swap(memory, other.memory);
+  std::swap(map, other.map);
+  std::swap(size, other.size);
+  std::swap(requireSize, other.requireSize);
+  return *this;
+}
+
 BufferPkg::~BufferPkg() {
-  auto &device = Application::GetInstance().device;
-  if (map) {
-    device.unmapMemory(memory);
-  }
-  device.freeMemory(memory);
-  device.destroyBuffer(buffer);
+  // 在途的帧可能还在读写，等它们完成后再释放
+  // 释放内存时自动解除映射
+  auto &queue = *Application::GetInstance().deletionQueue;
+  queue.Retire(buffer);
+  queue.Retire(memory);
 }
 // 查询硬件设备的内存信息，返回支持的一块内存
 auto QueryBufferMemTypeIndex(std::uint32_t type,
-    vk::MemoryPropertyFlags flag) -> std::uint32_t {
+    vk::MemoryPropertyFlags flag) -> std::optional<std::uint32_t> {
   auto property = Application::GetInstance()
                       .phyDevice.getMemoryProperties();
 
   for (std::uint32_t i = 0; i < property.memoryTypeCount;
        i++) {
+    // 需要同时满足全部属性
     if ((1 << i) & type &&
-        property.memoryTypes[i].propertyFlags & flag) {
+        (property.memoryTypes[i].propertyFlags & flag) ==
+            flag) {
       return i;
     }
   }
 
-  return 0;
+  return std::nullopt;
+}
+
+auto PickBufferMemory(vk::BufferUsageFlags usage,
+    std::initializer_list<vk::MemoryPropertyFlags> candidates)
+    -> vk::MemoryPropertyFlags {
+  // 同样 usage 的缓冲 memoryTypeBits 相同，不必真的创建
+  vk::BufferCreateInfo createInfo;
+  createInfo.setUsage(usage).setSize(1).setSharingMode(
+      vk::SharingMode::eExclusive);
+  const auto requirements =
+      Application::GetInstance().device.getBufferMemoryRequirements(
+          vk::DeviceBufferMemoryRequirements(&createInfo));
+  for (auto candidate : candidates) {
+    if (QueryBufferMemTypeIndex(
+            requirements.memoryRequirements.memoryTypeBits, candidate)) {
+      return candidate;
+    }
+  }
+  throw std::runtime_error("Pht Device can not support such memory!");
 }
 
 } // namespace app
\ No newline at end of file
@@ -0,0 +1,332 @@
+#include "../header/colorConvert.h"
+#include "../header/simd.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace app {
+
+void SwizzleBGRA2RGBA(
+    const uint8_t *src, uint8_t *dst, size_t pixelCount) {
+  size_t i = 0;
+#ifdef APP_SIMD_SSE2
+  // 每次 4 个像素：保留 G/A，R 与 B 互换
+  const __m128i keep = _mm_set1_epi32(
+      static_cast<int>(0xFF00FF00u));
+  const __m128i low = _mm_set1_epi32(0xFF);
+  for (; i + 4 <= pixelCount; i += 4) {
+    __m128i v = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(src + i * 4));
+    __m128i r = _mm_and_si128(_mm_srli_epi32(v, 16), low);
+    __m128i b = _mm_slli_epi32(_mm_and_si128(v, low), 16);
+    v = _mm_or_si128(_mm_and_si128(v, keep),
+        _mm_or_si128(r, b));
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(dst + i * 4), v);
+  }
+#endif
+  for (; i < pixelCount; ++i) {
+    uint8_t b = src[i * 4 + 0];
+    uint8_t g = src[i * 4 + 1];
+    uint8_t r = src[i * 4 + 2];
+    uint8_t a = src[i * 4 + 3];
+    dst[i * 4 + 0] = r;
+    dst[i * 4 + 1] = g;
+    dst[i * 4 + 2] = b;
+    dst[i * 4 + 3] = a;
+  }
+}
+
+void ExpandRGB2RGBA(
+    const uint8_t *src, uint8_t *dst, size_t pixelCount) {
+  size_t i = 0;
+#ifdef APP_SIMD_SSE2
+  // 每次读 16 字节处理 4 个像素，末尾留出越界余量
+  const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+  const __m128i alpha = _mm_set1_epi32(
+      static_cast<int>(0xFF000000u));
+  for (; i + 6 <= pixelCount; i += 4) {
+    __m128i v = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(src + i * 3));
+    // 把第 1/2/3 个像素移到低 32 位后交织
+    __m128i p01 =
+        _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3));
+    __m128i p23 = _mm_unpacklo_epi32(
+        _mm_srli_si128(v, 6), _mm_srli_si128(v, 9));
+    __m128i rgba = _mm_unpacklo_epi64(p01, p23);
+    rgba = _mm_or_si128(_mm_and_si128(rgba, rgbMask), alpha);
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(dst + i * 4), rgba);
+  }
+#endif
+  for (; i < pixelCount; ++i) {
+    dst[i * 4 + 0] = src[i * 3 + 0];
+    dst[i * 4 + 1] = src[i * 3 + 1];
+    dst[i * 4 + 2] = src[i * 3 + 2];
+    dst[i * 4 + 3] = 255;
+  }
+}
+
+void DownsampleRGBA2x2(const uint8_t *src, uint32_t w,
+    uint32_t h, uint8_t *dst) {
+  const uint32_t dstW = std::max(1u, w / 2);
+  const uint32_t dstH = std::max(1u, h / 2);
+  const size_t pitch = size_t(w) * 4;
+
+  for (uint32_t y = 0; y < dstH; ++y) {
+    // 只有一行时上下两行相同
+    const uint8_t *row0 = src + size_t(y) * 2 * pitch;
+    const uint8_t *row1 = h > 1 ? row0 + pitch : row0;
+    uint8_t *out = dst + size_t(y) * dstW * 4;
+
+    uint32_t x = 0;
+#ifdef APP_SIMD_SSE2
+    // 每次输出 4 个像素：展开到 16 位，上下相加后左右相加
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(2);
+    auto pair = [&](const uint8_t *p0, const uint8_t *p1) {
+      __m128i a = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(p0));
+      __m128i b = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(p1));
+      __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+          _mm_unpacklo_epi8(b, zero));
+      __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+          _mm_unpackhi_epi8(b, zero));
+      __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi),
+          _mm_unpackhi_epi64(lo, hi));
+      return _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+    };
+    if (w > 1) {
+      for (; x + 4 <= dstW; x += 4) {
+        const size_t offset = size_t(x) * 8;
+        __m128i p01 = pair(row0 + offset, row1 + offset);
+        __m128i p23 =
+            pair(row0 + offset + 16, row1 + offset + 16);
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i *>(out + x * 4),
+            _mm_packus_epi16(p01, p23));
+      }
+    }
+#endif
+    for (; x < dstW; ++x) {
+      const uint32_t x0 = x * 2;
+      const uint32_t x1 = w > 1 ? x0 + 1 : x0;
+      for (uint32_t c = 0; c < 4; ++c) {
+        const int sum = row0[x0 * 4 + c] + row0[x1 * 4 + c] +
+                        row1[x0 * 4 + c] + row1[x1 * 4 + c];
+        out[x * 4 + c] = static_cast<uint8_t>((sum + 2) >> 2);
+      }
+    }
+  }
+}
+
+namespace {
+
+// sRGB 8 位 <-> 线性 16 位定点，首次使用时建表
+struct SrgbTables {
+  std::array<uint16_t, 256> toLinear;
+  std::array<uint8_t, 65536> toSrgb;
+
+  SrgbTables() {
+    for (uint32_t i = 0; i < toLinear.size(); ++i) {
+      const double c = i / 255.0;
+      const double l = c <= 0.04045
+                           ? c / 12.92
+                           : std::pow((c + 0.055) / 1.055, 2.4);
+      toLinear[i] = static_cast<uint16_t>(std::lround(l * 65535.0));
+    }
+    for (uint32_t i = 0; i < toSrgb.size(); ++i) {
+      const double l = i / 65535.0;
+      const double c = l <= 0.0031308
+                           ? l * 12.92
+                           : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+      toSrgb[i] = static_cast<uint8_t>(std::lround(c * 255.0));
+    }
+  }
+};
+
+auto srgbTables() -> const SrgbTables & {
+  static const SrgbTables tables;
+  return tables;
+}
+
+} // namespace
+
+void DownsampleSRGBA2x2(const uint8_t *src, uint32_t w,
+    uint32_t h, uint8_t *dst) {
+  const auto &tables = srgbTables();
+  const uint32_t dstW = std::max(1u, w / 2);
+  const uint32_t dstH = std::max(1u, h / 2);
+  const size_t pitch = size_t(w) * 4;
+
+  for (uint32_t y = 0; y < dstH; ++y) {
+    const uint8_t *row0 = src + size_t(y) * 2 * pitch;
+    const uint8_t *row1 = h > 1 ? row0 + pitch : row0;
+    uint8_t *out = dst + size_t(y) * dstW * 4;
+
+    for (uint32_t x = 0; x < dstW; ++x) {
+      const uint32_t x0 = x * 2;
+      const uint32_t x1 = w > 1 ? x0 + 1 : x0;
+      // 颜色在线性空间求平均再编码回 sRGB
+      for (uint32_t c = 0; c < 3; ++c) {
+        const uint32_t sum = tables.toLinear[row0[x0 * 4 + c]] +
+                             tables.toLinear[row0[x1 * 4 + c]] +
+                             tables.toLinear[row1[x0 * 4 + c]] +
+                             tables.toLinear[row1[x1 * 4 + c]];
+        out[x * 4 + c] = tables.toSrgb[(sum + 2) >> 2];
+      }
+      // alpha 本身就是线性的
+      const int alpha = row0[x0 * 4 + 3] + row0[x1 * 4 + 3] +
+                        row1[x0 * 4 + 3] + row1[x1 * 4 + 3];
+      out[x * 4 + 3] = static_cast<uint8_t>((alpha + 2) >> 2);
+    }
+  }
+}
+
+namespace {
+
+// BT.601 limited range，全部系数 8 位定点
+inline auto lumaOf(int r, int g, int b) -> uint8_t {
+  return static_cast<uint8_t>(
+      ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+inline auto chromaUOf(int r, int g, int b) -> uint8_t {
+  return static_cast<uint8_t>(
+      ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+inline auto chromaVOf(int r, int g, int b) -> uint8_t {
+  return static_cast<uint8_t>(
+      ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+struct Channel {
+  int r, g, b;
+};
+
+inline auto loadPixel(const uint8_t *p, bool bgra)
+    -> Channel {
+  if (bgra) {
+    return {p[2], p[1], p[0]};
+  }
+  return {p[0], p[1], p[2]};
+}
+
+#ifdef APP_SIMD_SSE2
+// 8 个 32 位像素拆成 16 位的 R/G/B 三个向量
+inline void deinterleave8(const uint8_t *p, bool bgra,
+    __m128i &r, __m128i &g, __m128i &b) {
+  const __m128i mask = _mm_set1_epi32(0xFF);
+  __m128i p0 = _mm_loadu_si128(
+      reinterpret_cast<const __m128i *>(p));
+  __m128i p1 = _mm_loadu_si128(
+      reinterpret_cast<const __m128i *>(p + 16));
+  __m128i c0 = _mm_packs_epi32(
+      _mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+  __m128i c1 =
+      _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask),
+          _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+  __m128i c2 = _mm_packs_epi32(
+      _mm_and_si128(_mm_srli_epi32(p0, 16), mask),
+      _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+  r = bgra ? c2 : c0;
+  g = c1;
+  b = bgra ? c0 : c2;
+}
+
+// 和不超过 56228，按无符号 16 位计算不会溢出
+inline void storeLuma8(
+    __m128i r, __m128i g, __m128i b, uint8_t *dst) {
+  __m128i y = _mm_add_epi16(
+      _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)),
+          _mm_mullo_epi16(g, _mm_set1_epi16(129))),
+      _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)),
+          _mm_set1_epi16(128)));
+  y = _mm_add_epi16(
+      _mm_srli_epi16(y, 8), _mm_set1_epi16(16));
+  _mm_storel_epi64(reinterpret_cast<__m128i *>(dst),
+      _mm_packus_epi16(y, y));
+}
+
+// 两行相加后横向两两相加，得到 4 个 2x2 块的均值
+inline auto average2x2(__m128i row0, __m128i row1)
+    -> __m128i {
+  __m128i sum = _mm_madd_epi16(
+      _mm_add_epi16(row0, row1), _mm_set1_epi16(1));
+  sum = _mm_packs_epi32(sum, sum);
+  return _mm_srli_epi16(
+      _mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+
+inline void storeChroma4(__m128i r, __m128i g, __m128i b,
+    int cr, int cg, int cb, uint8_t *dst) {
+  __m128i c = _mm_add_epi16(
+      _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(cr)),
+          _mm_mullo_epi16(g, _mm_set1_epi16(cg))),
+      _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(cb)),
+          _mm_set1_epi16(128)));
+  c = _mm_add_epi16(
+      _mm_srai_epi16(c, 8), _mm_set1_epi16(128));
+  int packed = _mm_cvtsi128_si32(_mm_packus_epi16(c, c));
+  std::memcpy(dst, &packed, 4);
+}
+#endif
+
+} // namespace
+
+void RGBA2YUV420(const uint8_t *src, uint32_t w, uint32_t h,
+    uint32_t rowPitch, bool bgra, uint8_t *yPlane,
+    uint8_t *uPlane, uint8_t *vPlane) {
+  const uint32_t chromaW = (w + 1) / 2;
+  const uint32_t chromaH = (h + 1) / 2;
+
+  for (uint32_t cy = 0; cy < chromaH; ++cy) {
+    // 奇数高度时最后一行重复使用
+    const uint32_t y0 = cy * 2;
+    const uint32_t y1 = std::min(y0 + 1, h - 1);
+    const uint8_t *row0 = src + size_t(y0) * rowPitch;
+    const uint8_t *row1 = src + size_t(y1) * rowPitch;
+    uint8_t *luma0 = yPlane + size_t(y0) * w;
+    uint8_t *luma1 = yPlane + size_t(y1) * w;
+    uint8_t *u = uPlane + size_t(cy) * chromaW;
+    uint8_t *v = vPlane + size_t(cy) * chromaW;
+
+    uint32_t x = 0;
+#ifdef APP_SIMD_SSE2
+    for (; x + 8 <= w; x += 8) {
+      __m128i r0, g0, b0, r1, g1, b1;
+      deinterleave8(row0 + x * 4, bgra, r0, g0, b0);
+      deinterleave8(row1 + x * 4, bgra, r1, g1, b1);
+      storeLuma8(r0, g0, b0, luma0 + x);
+      storeLuma8(r1, g1, b1, luma1 + x);
+
+      __m128i r = average2x2(r0, r1);
+      __m128i g = average2x2(g0, g1);
+      __m128i b = average2x2(b0, b1);
+      storeChroma4(r, g, b, -38, -74, 112, u + x / 2);
+      storeChroma4(r, g, b, 112, -94, -18, v + x / 2);
+    }
+#endif
+    // 标量处理剩余列（以及奇数宽度）
+    for (; x < w; ++x) {
+      auto p0 = loadPixel(row0 + x * 4, bgra);
+      auto p1 = loadPixel(row1 + x * 4, bgra);
+      luma0[x] = lumaOf(p0.r, p0.g, p0.b);
+      luma1[x] = lumaOf(p1.r, p1.g, p1.b);
+      if (x % 2 != 0) {
+        continue;
+      }
+      const uint32_t x1 = std::min(x + 1, w - 1);
+      auto q0 = loadPixel(row0 + x1 * 4, bgra);
+      auto q1 = loadPixel(row1 + x1 * 4, bgra);
+      int r = (p0.r + p1.r + q0.r + q1.r + 2) >> 2;
+      int g = (p0.g + p1.g + q0.g + q1.g + 2) >> 2;
+      int b = (p0.b + p1.b + q0.b + q1.b + 2) >> 2;
+      u[x / 2] = chromaUOf(r, g, b);
+      v[x / 2] = chromaVOf(r, g, b);
+    }
+  }
+}
+
+} // namespace app
\ No newline at end of file
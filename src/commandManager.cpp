@@ -1,14 +1,18 @@
 #include "../header/commandManager.h"
 #include "../header/application.h"
+#include <limits>
+#include <stdexcept>
 
 namespace app {
 
-CommandManager::CommandManager() {
-  pool_ = createCommandPool();
+CommandManager::CommandManager(uint32_t queueFamily) {
+  pool_ = createCommandPool(queueFamily);
+  fence_ = Application::GetInstance().device.createFence({});
 }
 
 CommandManager::~CommandManager() {
   auto &app = Application::GetInstance();
+  app.device.destroyFence(fence_);
   app.device.destroyCommandPool(pool_);
 }
 
@@ -16,15 +20,14 @@ void CommandManager::ResetCmds() {
   Application::GetInstance().device.resetCommandPool(pool_);
 }
 
-auto CommandManager::createCommandPool()
+auto CommandManager::createCommandPool(uint32_t queueFamily)
     -> vk::CommandPool {
   auto &app = Application::GetInstance();
 
   vk::CommandPoolCreateInfo createInfo;
 
   createInfo
-      .setQueueFamilyIndex(
-          app.queueFamilyIndices.graphicQueue.value())
+      .setQueueFamilyIndex(queueFamily)
       .setFlags(vk::CommandPoolCreateFlagBits::
               eResetCommandBuffer);
 
@@ -37,7 +40,7 @@ auto CommandManager::CreateCommandBuffers(
 
   vk::CommandBufferAllocateInfo allocInfo;
   allocInfo.setCommandPool(pool_)
-      .setCommandBufferCount(1)
+      .setCommandBufferCount(count)
       .setLevel(vk::CommandBufferLevel::ePrimary);
 
   return app.device.allocateCommandBuffers(allocInfo);
@@ -68,9 +71,15 @@ void CommandManager::ExecuteCmd(
 
   vk::SubmitInfo submitInfo;
   submitInfo.setCommandBuffers(cmdBuf);
-  queue.submit(submitInfo);
-  queue.waitIdle();
-  Application::GetInstance().device.waitIdle();
+  // 只等这一次提交，不必等队列里在途的帧
+  auto &device = Application::GetInstance().device;
+  queue.submit(submitInfo, fence_);
+  if (device.waitForFences(fence_, true,
+          std::numeric_limits<uint64_t>::max()) !=
+      vk::Result::eSuccess) {
+    throw std::runtime_error("wait for one time command failed");
+  }
+  device.resetFences(fence_);
   FreeCmd(cmdBuf);
 }
 
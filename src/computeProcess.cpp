@@ -0,0 +1,169 @@
+#include "../header/computeProcess.h"
+#include "../header/application.h"
+#include "../header/spirvReflect.h"
+#include <map>
+
+namespace app {
+
+ComputeProcess::ComputeProcess(const std::string &spv) {
+  if (spv.empty()) {
+    throw std::runtime_error("compute shader is empty");
+  }
+  auto reflection = ReflectCompute(spv);
+  bindings_ = std::move(reflection.bindings);
+  localSize_ = reflection.localSize;
+  create(spv, reflection.pushConstantSize);
+}
+
+ComputeProcess::ComputeProcess(const std::string &spv,
+    const std::vector<vk::DescriptorSetLayoutBinding> &bindings,
+    uint32_t pushConstantSize, uint32_t localSizeX)
+    : bindings_(bindings), localSize_{localSizeX, 1, 1} {
+  if (spv.empty()) {
+    throw std::runtime_error("compute shader is empty");
+  }
+  create(spv, pushConstantSize);
+}
+
+void ComputeProcess::create(
+    const std::string &spv, uint32_t pushConstantSize) {
+  auto &app = Application::GetInstance();
+  auto &device = app.device;
+
+  vk::DescriptorSetLayoutCreateInfo setInfo;
+  setInfo.setBindings(bindings_);
+  setLayout = device.createDescriptorSetLayout(setInfo);
+
+  vk::PushConstantRange range;
+  range.setStageFlags(vk::ShaderStageFlagBits::eCompute)
+      .setOffset(0)
+      .setSize(pushConstantSize);
+  vk::PipelineLayoutCreateInfo layoutInfo;
+  layoutInfo.setSetLayouts(setLayout);
+  if (pushConstantSize > 0) {
+    layoutInfo.setPushConstantRanges(range);
+  }
+  layout = device.createPipelineLayout(layoutInfo);
+
+  vk::ShaderModuleCreateInfo moduleInfo;
+  moduleInfo.setCodeSize(spv.size())
+      .setPCode(reinterpret_cast<const uint32_t *>(spv.data()));
+  auto module = device.createShaderModule(moduleInfo);
+  vk::ComputePipelineCreateInfo createInfo;
+  createInfo.setLayout(layout).setStage(
+      vk::PipelineShaderStageCreateInfo()
+          .setStage(vk::ShaderStageFlagBits::eCompute)
+          .setModule(module)
+          .setPName("main"));
+  auto result = device.createComputePipeline(nullptr, createInfo);
+  // 管线创建完就不再需要模块
+  device.destroyShaderModule(module);
+  if (result.result != vk::Result::eSuccess) {
+    throw std::runtime_error("compute pipeline create failed");
+  }
+  pipeline = app.resources->AddPipeline(result.value);
+}
+
+ComputeProcess::~ComputeProcess() {
+  auto &app = Application::GetInstance();
+  app.resources->Destroy(pipeline);
+  // 描述符集和布局可能还被在途的帧使用
+  app.deletionQueue->Retire(
+      [device = app.device, pools = pools_, setLayout = setLayout,
+          layout = layout] {
+        for (auto pool : pools) {
+          device.destroyDescriptorPool(pool);
+        }
+        device.destroyPipelineLayout(layout);
+        device.destroyDescriptorSetLayout(setLayout);
+      });
+}
+
+auto ComputeProcess::AllocSets(uint32_t count)
+    -> std::vector<vk::DescriptorSet> {
+  auto &device = Application::GetInstance().device;
+  // 每次分配单独建一个刚好够用的池
+  std::map<vk::DescriptorType, uint32_t> counts;
+  for (const auto &binding : bindings_) {
+    counts[binding.descriptorType] += binding.descriptorCount * count;
+  }
+  std::vector<vk::DescriptorPoolSize> sizes;
+  for (auto [type, n] : counts) {
+    sizes.emplace_back(type, n);
+  }
+  vk::DescriptorPoolCreateInfo poolInfo;
+  poolInfo.setMaxSets(count).setPoolSizes(sizes);
+  auto pool = device.createDescriptorPool(poolInfo);
+  pools_.push_back(pool);
+
+  std::vector<vk::DescriptorSetLayout> layouts(count, setLayout);
+  vk::DescriptorSetAllocateInfo allocInfo;
+  allocInfo.setDescriptorPool(pool).setSetLayouts(layouts);
+  return device.allocateDescriptorSets(allocInfo);
+}
+
+auto ComputeProcess::typeOf(uint32_t binding) const
+    -> vk::DescriptorType {
+  for (const auto &b : bindings_) {
+    if (b.binding == binding) {
+      return b.descriptorType;
+    }
+  }
+  throw std::runtime_error("compute binding not declared");
+}
+
+void ComputeProcess::WriteBuffer(vk::DescriptorSet set, uint32_t binding,
+    vk::Buffer buffer, vk::DeviceSize range) const {
+  vk::DescriptorBufferInfo bufferInfo(buffer, 0, range);
+  vk::WriteDescriptorSet write;
+  write.setDstSet(set)
+      .setDstBinding(binding)
+      .setDescriptorType(typeOf(binding))
+      .setBufferInfo(bufferInfo);
+  Application::GetInstance().device.updateDescriptorSets(write, {});
+}
+
+void ComputeProcess::WriteImage(vk::DescriptorSet set, uint32_t binding,
+    vk::ImageView view, vk::ImageLayout layout,
+    vk::Sampler sampler) const {
+  vk::DescriptorImageInfo imageInfo(sampler, view, layout);
+  vk::WriteDescriptorSet write;
+  write.setDstSet(set)
+      .setDstBinding(binding)
+      .setDescriptorType(typeOf(binding))
+      .setImageInfo(imageInfo);
+  Application::GetInstance().device.updateDescriptorSets(write, {});
+}
+
+void ComputeProcess::Bind(
+    vk::CommandBuffer cmdBuf, vk::DescriptorSet set) const {
+  auto &resources = *Application::GetInstance().resources;
+  cmdBuf.bindPipeline(
+      vk::PipelineBindPoint::eCompute, resources.Get(pipeline));
+  cmdBuf.bindDescriptorSets(
+      vk::PipelineBindPoint::eCompute, layout, 0, set, {});
+}
+
+void ComputeProcess::Dispatch(
+    vk::CommandBuffer cmdBuf, uint32_t x, uint32_t y, uint32_t z) const {
+  cmdBuf.dispatch(x, y, z);
+}
+
+void ComputeProcess::DispatchFor(
+    vk::CommandBuffer cmdBuf, uint32_t count) const {
+  if (count == 0) {
+    return;
+  }
+  cmdBuf.dispatch((count + localSize_[0] - 1) / localSize_[0], 1, 1);
+}
+
+void ComputeProcess::DispatchFor(
+    vk::CommandBuffer cmdBuf, uint32_t width, uint32_t height) const {
+  if (width == 0 || height == 0) {
+    return;
+  }
+  cmdBuf.dispatch((width + localSize_[0] - 1) / localSize_[0],
+      (height + localSize_[1] - 1) / localSize_[1], 1);
+}
+
+} // namespace app
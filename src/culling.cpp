@@ -0,0 +1,742 @@
+#include "../header/culling.h"
+#include "../header/simd.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace app {
+
+namespace {
+
+// planeMask 选中的平面，法线取绝对值后用于包围盒的投影半径
+struct ActivePlanes {
+  int count = 0;
+  float nx[Frustum::PlaneCount], ny[Frustum::PlaneCount],
+      nz[Frustum::PlaneCount], d[Frustum::PlaneCount];
+  float ax[Frustum::PlaneCount], ay[Frustum::PlaneCount],
+      az[Frustum::PlaneCount];
+
+  ActivePlanes(const Frustum &frustum, uint32_t mask) {
+    for (int p = 0; p < Frustum::PlaneCount; ++p) {
+      if (mask & (1u << p)) {
+        const auto &plane = frustum.planes[p];
+        nx[count] = plane.x, ny[count] = plane.y, nz[count] = plane.z;
+        d[count] = plane.w;
+        ax[count] = std::abs(plane.x), ay[count] = std::abs(plane.y);
+        az[count] = std::abs(plane.z);
+        ++count;
+      }
+    }
+  }
+};
+
+// 把 bits 中置位的通道下标写出
+inline auto emitLanes(uint32_t bits, uint32_t base, uint32_t *out)
+    -> uint32_t {
+  uint32_t n = 0;
+  while (bits) {
+    out[n++] = base + static_cast<uint32_t>(std::countr_zero(bits));
+    bits &= bits - 1;
+  }
+  return n;
+}
+
+} // namespace
+
+auto Frustum::FromMatrix(const glm::mat4 &m) -> Frustum {
+  // 第 i 行 = (m[0][i], m[1][i], m[2][i], m[3][i])
+  auto row = [&](int i) {
+    return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+  };
+  const glm::vec4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+  Frustum frustum;
+  frustum.planes[0] = r3 + r0;
+  frustum.planes[1] = r3 - r0;
+  frustum.planes[2] = r3 + r1;
+  frustum.planes[3] = r3 - r1;
+  // 深度范围 0 ~ 1，近平面就是 z >= 0
+  frustum.planes[4] = r2;
+  frustum.planes[5] = r3 - r2;
+  for (auto &plane : frustum.planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  return frustum;
+}
+
+auto CullAabbs(const Frustum &frustum, uint32_t planeMask,
+    const AabbSoaView &boxes, uint32_t begin, uint32_t end,
+    uint32_t *out) -> uint32_t {
+  const ActivePlanes planes(frustum, planeMask);
+  uint32_t n = 0;
+  uint32_t i = begin;
+#if defined(APP_SIMD_AVX2)
+  const __m256 zero = _mm256_setzero_ps();
+  for (; i + 8 <= end; i += 8) {
+    const __m256 cx = _mm256_loadu_ps(boxes.cx + i);
+    const __m256 cy = _mm256_loadu_ps(boxes.cy + i);
+    const __m256 cz = _mm256_loadu_ps(boxes.cz + i);
+    const __m256 ex = _mm256_loadu_ps(boxes.ex + i);
+    const __m256 ey = _mm256_loadu_ps(boxes.ey + i);
+    const __m256 ez = _mm256_loadu_ps(boxes.ez + i);
+    __m256 outside = zero;
+    for (int p = 0; p < planes.count; ++p) {
+      // 中心到平面的距离加上包围盒在法线上的投影半径
+      __m256 s = _mm256_fmadd_ps(_mm256_set1_ps(planes.nx[p]), cx,
+          _mm256_set1_ps(planes.d[p]));
+      s = _mm256_fmadd_ps(_mm256_set1_ps(planes.ny[p]), cy, s);
+      s = _mm256_fmadd_ps(_mm256_set1_ps(planes.nz[p]), cz, s);
+      s = _mm256_fmadd_ps(_mm256_set1_ps(planes.ax[p]), ex, s);
+      s = _mm256_fmadd_ps(_mm256_set1_ps(planes.ay[p]), ey, s);
+      s = _mm256_fmadd_ps(_mm256_set1_ps(planes.az[p]), ez, s);
+      outside = _mm256_or_ps(outside, _mm256_cmp_ps(s, zero, _CMP_LT_OQ));
+    }
+    const auto bits =
+        static_cast<uint32_t>(~_mm256_movemask_ps(outside) & 0xFF);
+    n += emitLanes(bits, i, out + n);
+  }
+#elif defined(APP_SIMD_SSE2)
+  const __m128 zero = _mm_setzero_ps();
+  for (; i + 4 <= end; i += 4) {
+    const __m128 cx = _mm_loadu_ps(boxes.cx + i);
+    const __m128 cy = _mm_loadu_ps(boxes.cy + i);
+    const __m128 cz = _mm_loadu_ps(boxes.cz + i);
+    const __m128 ex = _mm_loadu_ps(boxes.ex + i);
+    const __m128 ey = _mm_loadu_ps(boxes.ey + i);
+    const __m128 ez = _mm_loadu_ps(boxes.ez + i);
+    __m128 outside = zero;
+    for (int p = 0; p < planes.count; ++p) {
+      const __m128 s = _mm_add_ps(
+          _mm_add_ps(
+              _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.nx[p]), cx),
+                  _mm_mul_ps(_mm_set1_ps(planes.ny[p]), cy)),
+              _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.nz[p]), cz),
+                  _mm_set1_ps(planes.d[p]))),
+          _mm_add_ps(
+              _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.ax[p]), ex),
+                  _mm_mul_ps(_mm_set1_ps(planes.ay[p]), ey)),
+              _mm_mul_ps(_mm_set1_ps(planes.az[p]), ez)));
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(s, zero));
+    }
+    const auto bits =
+        static_cast<uint32_t>(~_mm_movemask_ps(outside) & 0xF);
+    n += emitLanes(bits, i, out + n);
+  }
+#endif
+  for (; i < end; ++i) {
+    bool inside = true;
+    for (int p = 0; p < planes.count && inside; ++p) {
+      const float s = planes.nx[p] * boxes.cx[i] +
+                      planes.ny[p] * boxes.cy[i] +
+                      planes.nz[p] * boxes.cz[i] + planes.d[p] +
+                      planes.ax[p] * boxes.ex[i] +
+                      planes.ay[p] * boxes.ey[i] +
+                      planes.az[p] * boxes.ez[i];
+      inside = s >= 0.0f;
+    }
+    if (inside) {
+      out[n++] = i;
+    }
+  }
+  return n;
+}
+
+auto CullSpheres(const Frustum &frustum, uint32_t planeMask,
+    const SphereSoaView &spheres, uint32_t begin, uint32_t end,
+    uint32_t *out) -> uint32_t {
+  const ActivePlanes planes(frustum, planeMask);
+  uint32_t n = 0;
+  uint32_t i = begin;
+#if defined(APP_SIMD_AVX2)
+  const __m256 zero = _mm256_setzero_ps();
+  for (; i + 8 <= end; i += 8) {
+    const __m256 cx = _mm256_loadu_ps(spheres.cx + i);
+    const __m256 cy = _mm256_loadu_ps(spheres.cy + i);
+    const __m256 cz = _mm256_loadu_ps(spheres.cz + i);
+    const __m256 r = _mm256_loadu_ps(spheres.radius + i);
+    __m256 outside = zero;
+    for (int p = 0; p < planes.count; ++p) {
+      __m256 s = _mm256_fmadd_ps(
+          _mm256_set1_ps(planes.nx[p]), cx, _mm256_add_ps(r,
+              _mm256_set1_ps(planes.d[p])));
+      s = _mm256_fmadd_ps(_mm256_set1_ps(planes.ny[p]), cy, s);
+      s = _mm256_fmadd_ps(_mm256_set1_ps(planes.nz[p]), cz, s);
+      outside = _mm256_or_ps(outside, _mm256_cmp_ps(s, zero, _CMP_LT_OQ));
+    }
+    const auto bits =
+        static_cast<uint32_t>(~_mm256_movemask_ps(outside) & 0xFF);
+    n += emitLanes(bits, i, out + n);
+  }
+#elif defined(APP_SIMD_SSE2)
+  const __m128 zero = _mm_setzero_ps();
+  for (; i + 4 <= end; i += 4) {
+    const __m128 cx = _mm_loadu_ps(spheres.cx + i);
+    const __m128 cy = _mm_loadu_ps(spheres.cy + i);
+    const __m128 cz = _mm_loadu_ps(spheres.cz + i);
+    const __m128 r = _mm_loadu_ps(spheres.radius + i);
+    __m128 outside = zero;
+    for (int p = 0; p < planes.count; ++p) {
+      const __m128 s = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.nx[p]), cx),
+              _mm_mul_ps(_mm_set1_ps(planes.ny[p]), cy)),
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.nz[p]), cz),
+              _mm_add_ps(r, _mm_set1_ps(planes.d[p]))));
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(s, zero));
+    }
+    const auto bits =
+        static_cast<uint32_t>(~_mm_movemask_ps(outside) & 0xF);
+    n += emitLanes(bits, i, out + n);
+  }
+#endif
+  for (; i < end; ++i) {
+    bool inside = true;
+    for (int p = 0; p < planes.count && inside; ++p) {
+      const float s = planes.nx[p] * spheres.cx[i] +
+                      planes.ny[p] * spheres.cy[i] +
+                      planes.nz[p] * spheres.cz[i] + planes.d[p] +
+                      spheres.radius[i];
+      inside = s >= 0.0f;
+    }
+    if (inside) {
+      out[n++] = i;
+    }
+  }
+  return n;
+}
+
+FrustumCuller::FrustumCuller() : FrustumCuller(Config{}) {}
+
+FrustumCuller::FrustumCuller(const Config &config)
+    : config_(config), windowStart_(std::chrono::steady_clock::now()) {
+  config_.leafSize = std::max(config_.leafSize, 1u);
+  uint32_t workers = config_.workerCount;
+  if (workers == 0) {
+    workers = std::min(std::thread::hardware_concurrency(), 4u);
+    workers = workers > 1 ? workers - 1 : 0;
+  }
+  for (uint32_t i = 0; i < workers; ++i) {
+    workers_.emplace_back([this] { workerLoop(); });
+  }
+}
+
+FrustumCuller::~FrustumCuller() {
+  {
+    std::lock_guard lock(mutex_);
+    quit_ = true;
+  }
+  wake_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+auto FrustumCuller::Add(const glm::vec3 &center, const glm::vec3 &extent)
+    -> uint32_t {
+  const auto object = static_cast<uint32_t>(slot_.size());
+  // 先追加在末尾，Refit 时建树再排序
+  cx_.push_back(center.x), cy_.push_back(center.y);
+  cz_.push_back(center.z);
+  ex_.push_back(extent.x), ey_.push_back(extent.y);
+  ez_.push_back(extent.z);
+  object_.push_back(object);
+  slot_.push_back(object);
+  rebuild_ = true;
+  return object;
+}
+
+void FrustumCuller::Update(
+    uint32_t object, const glm::vec3 &center, const glm::vec3 &extent) {
+  const uint32_t i = slot_[object];
+  cx_[i] = center.x, cy_[i] = center.y, cz_[i] = center.z;
+  ex_[i] = extent.x, ey_[i] = extent.y, ez_[i] = extent.z;
+  if (rebuild_) {
+    return;
+  }
+  const uint32_t leaf = leafOf_[i];
+  if (!nodeDirty_[leaf]) {
+    nodeDirty_[leaf] = 1;
+    dirtyLeaves_.push_back(leaf);
+  }
+}
+
+void FrustumCuller::Clear() {
+  for (auto *v : {&cx_, &cy_, &cz_, &ex_, &ey_, &ez_}) {
+    v->clear();
+  }
+  object_.clear();
+  slot_.clear();
+  leafOf_.clear();
+  nodes_.clear();
+  dirtyLeaves_.clear();
+  nodeDirty_.clear();
+  rebuild_ = true;
+}
+
+void FrustumCuller::Refit() {
+  if (rebuild_) {
+    build();
+    return;
+  }
+  if (dirtyLeaves_.empty()) {
+    return;
+  }
+  // 先序建树，子节点下标总比父节点大，
+  // 按下标从大到小处理就是自底向上
+  std::vector<uint32_t> &heap = dirtyLeaves_;
+  std::make_heap(heap.begin(), heap.end());
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end());
+    const uint32_t i = heap.back();
+    heap.pop_back();
+    nodeDirty_[i] = 0;
+    Node &node = nodes_[i];
+    const Node before = node;
+    if (node.left == 0) {
+      fitLeaf(node);
+    } else {
+      const Node &l = nodes_[node.left];
+      const Node &r = nodes_[node.right];
+      for (int k = 0; k < 3; ++k) {
+        node.min[k] = std::min(l.min[k], r.min[k]);
+        node.max[k] = std::max(l.max[k], r.max[k]);
+      }
+    }
+    // 包围盒没变，祖先也不用动
+    const bool changed =
+        !std::equal(node.min, node.max + 3, before.min);
+    if (changed && i != 0 && !nodeDirty_[node.parent]) {
+      nodeDirty_[node.parent] = 1;
+      heap.push_back(node.parent);
+      std::push_heap(heap.begin(), heap.end());
+    }
+  }
+}
+
+void FrustumCuller::build() {
+  rebuild_ = false;
+  nodes_.clear();
+  dirtyLeaves_.clear();
+  const auto count = static_cast<uint32_t>(slot_.size());
+  if (count == 0) {
+    nodeDirty_.clear();
+    return;
+  }
+  buildOrder_.resize(count);
+  std::iota(buildOrder_.begin(), buildOrder_.end(), 0u);
+  buildNode(0, count, 0);
+
+  // 包围盒与编号按叶子顺序重排
+  for (auto *v : {&cx_, &cy_, &cz_, &ex_, &ey_, &ez_}) {
+    std::vector<float> sorted(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      sorted[i] = (*v)[buildOrder_[i]];
+    }
+    v->swap(sorted);
+  }
+  std::vector<uint32_t> object(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    object[i] = object_[buildOrder_[i]];
+    slot_[object[i]] = i;
+  }
+  object_.swap(object);
+
+  leafOf_.resize(count);
+  nodeDirty_.assign(nodes_.size(), 0);
+  for (auto i = static_cast<uint32_t>(nodes_.size()); i-- > 0;) {
+    Node &node = nodes_[i];
+    if (node.left == 0) {
+      fitLeaf(node);
+      std::fill(leafOf_.begin() + node.begin, leafOf_.begin() + node.end, i);
+    } else {
+      const Node &l = nodes_[node.left];
+      const Node &r = nodes_[node.right];
+      for (int k = 0; k < 3; ++k) {
+        node.min[k] = std::min(l.min[k], r.min[k]);
+        node.max[k] = std::max(l.max[k], r.max[k]);
+      }
+    }
+  }
+}
+
+auto FrustumCuller::buildNode(uint32_t begin, uint32_t end,
+    uint32_t parent) -> uint32_t {
+  const auto index = static_cast<uint32_t>(nodes_.size());
+  nodes_.push_back({{}, {}, begin, end, 0, 0, parent});
+  const uint32_t count = end - begin;
+  if (count <= config_.leafSize) {
+    return index;
+  }
+  // 中心点跨度最大的轴上取中位数，
+  // 切分点对齐到叶子大小，叶子尽量装满
+  const std::vector<float> *centers[3] = {&cx_, &cy_, &cz_};
+  int axis = 0;
+  float widest = -1.0f;
+  for (int k = 0; k < 3; ++k) {
+    const auto &c = *centers[k];
+    float lo = c[buildOrder_[begin]], hi = lo;
+    for (uint32_t i = begin + 1; i < end; ++i) {
+      lo = std::min(lo, c[buildOrder_[i]]);
+      hi = std::max(hi, c[buildOrder_[i]]);
+    }
+    if (hi - lo > widest) {
+      widest = hi - lo;
+      axis = k;
+    }
+  }
+  const uint32_t leafSize = config_.leafSize;
+  uint32_t mid =
+      begin + (count / 2 + leafSize - 1) / leafSize * leafSize;
+  mid = std::min(mid, end - 1);
+  const auto &c = *centers[axis];
+  std::nth_element(buildOrder_.begin() + begin, buildOrder_.begin() + mid,
+      buildOrder_.begin() + end,
+      [&](uint32_t a, uint32_t b) { return c[a] < c[b]; });
+  const uint32_t left = buildNode(begin, mid, index);
+  const uint32_t right = buildNode(mid, end, index);
+  nodes_[index].left = left;
+  nodes_[index].right = right;
+  return index;
+}
+
+void FrustumCuller::fitLeaf(Node &node) {
+  float lo[3] = {INFINITY, INFINITY, INFINITY};
+  float hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+  for (uint32_t i = node.begin; i < node.end; ++i) {
+    const float c[3] = {cx_[i], cy_[i], cz_[i]};
+    const float e[3] = {ex_[i], ey_[i], ez_[i]};
+    for (int k = 0; k < 3; ++k) {
+      lo[k] = std::min(lo[k], c[k] - e[k]);
+      hi[k] = std::max(hi[k], c[k] + e[k]);
+    }
+  }
+  std::copy(lo, lo + 3, node.min);
+  std::copy(hi, hi + 3, node.max);
+}
+
+auto FrustumCuller::Cull(
+    const Frustum &frustum, std::vector<uint32_t> &visible) -> Stats {
+  const auto start = std::chrono::steady_clock::now();
+  Stats stats;
+  visible.clear();
+  if (nodes_.empty()) {
+    return stats;
+  }
+
+  // 物体多时从根往下展开，直到子树数足够分给所有线程
+  std::vector<uint32_t> roots{0};
+  const bool parallel =
+      !workers_.empty() && Size() >= config_.parallelThreshold;
+  if (parallel) {
+    const size_t target = (workers_.size() + 1) * 4;
+    bool expanded = true;
+    while (roots.size() < target && expanded) {
+      expanded = false;
+      std::vector<uint32_t> next;
+      for (uint32_t i : roots) {
+        if (nodes_[i].left != 0) {
+          next.push_back(nodes_[i].left);
+          next.push_back(nodes_[i].right);
+          expanded = true;
+        } else {
+          next.push_back(i);
+        }
+      }
+      roots.swap(next);
+    }
+  }
+  // 复用上一帧的结果数组
+  tasks_.resize(roots.size());
+  for (size_t i = 0; i < roots.size(); ++i) {
+    tasks_[i].node = roots[i];
+  }
+  frustum_ = &frustum;
+  nextTask_.store(0);
+  if (parallel) {
+    {
+      std::lock_guard lock(mutex_);
+      ++job_;
+      running_ = static_cast<uint32_t>(workers_.size());
+    }
+    wake_.notify_all();
+    runTasks();
+    std::unique_lock lock(mutex_);
+    done_.wait(lock, [this] { return running_ == 0; });
+    stats.threads = static_cast<uint32_t>(workers_.size()) + 1;
+  } else {
+    runTasks();
+  }
+  frustum_ = nullptr;
+
+  // 子树按先序排列，结果依次拼接
+  for (const auto &task : tasks_) {
+    for (uint32_t i : task.visible) {
+      visible.push_back(object_[i]);
+    }
+    stats.nodesTested += task.nodesTested;
+    stats.objectsTested += task.objectsTested;
+  }
+  stats.visible = static_cast<uint32_t>(visible.size());
+  stats.culled = Size() - stats.visible;
+  stats.ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start)
+                 .count();
+  return stats;
+}
+
+void FrustumCuller::runTasks() {
+  for (uint32_t i = nextTask_.fetch_add(1); i < tasks_.size();
+       i = nextTask_.fetch_add(1)) {
+    auto &task = tasks_[i];
+    task.visible.clear();
+    task.nodesTested = 0;
+    task.objectsTested = 0;
+    cullNode(task.node, Frustum::AllPlanes, task);
+  }
+}
+
+void FrustumCuller::cullNode(uint32_t index, uint32_t planeMask, Task &task) {
+  const Node &node = nodes_[index];
+  ++task.nodesTested;
+  const glm::vec3 lo(node.min[0], node.min[1], node.min[2]);
+  const glm::vec3 hi(node.max[0], node.max[1], node.max[2]);
+  const glm::vec3 center = (lo + hi) * 0.5f;
+  const glm::vec3 extent = (hi - lo) * 0.5f;
+  for (int p = 0; p < Frustum::PlaneCount; ++p) {
+    if (!(planeMask & (1u << p))) {
+      continue;
+    }
+    const auto &plane = frustum_->planes[p];
+    const glm::vec3 normal(plane);
+    const float s = glm::dot(normal, center) + plane.w;
+    const float r = glm::dot(glm::abs(normal), extent);
+    if (s + r < 0.0f) {
+      return;
+    }
+    // 整个节点都在这个平面内侧，子节点不用再测
+    if (s - r >= 0.0f) {
+      planeMask &= ~(1u << p);
+    }
+  }
+  if (planeMask == 0) {
+    for (uint32_t i = node.begin; i < node.end; ++i) {
+      task.visible.push_back(i);
+    }
+    return;
+  }
+  if (node.left == 0) {
+    const auto offset = task.visible.size();
+    task.visible.resize(offset + node.end - node.begin);
+    const uint32_t n = CullAabbs(*frustum_, planeMask, view(), node.begin,
+        node.end, task.visible.data() + offset);
+    task.visible.resize(offset + n);
+    task.objectsTested += node.end - node.begin;
+    return;
+  }
+  cullNode(node.left, planeMask, task);
+  cullNode(node.right, planeMask, task);
+}
+
+void FrustumCuller::workerLoop() {
+  uint64_t seen = 0;
+  for (;;) {
+    {
+      std::unique_lock lock(mutex_);
+      wake_.wait(lock, [&] { return quit_ || job_ != seen; });
+      if (quit_) {
+        return;
+      }
+      seen = job_;
+    }
+    runTasks();
+    std::lock_guard lock(mutex_);
+    if (--running_ == 0) {
+      done_.notify_all();
+    }
+  }
+}
+
+auto FrustumCuller::view() const -> AabbSoaView {
+  AabbSoaView boxes;
+  boxes.cx = cx_.data(), boxes.cy = cy_.data(), boxes.cz = cz_.data();
+  boxes.ex = ex_.data(), boxes.ey = ey_.data(), boxes.ez = ez_.data();
+  return boxes;
+}
+
+void FrustumCuller::Report(const Stats &stats) {
+  windowFrames_++;
+  windowVisible_ += stats.visible;
+  windowCulled_ += stats.culled;
+  windowMs_ += stats.ms;
+  const auto now = std::chrono::steady_clock::now();
+  if (now - windowStart_ < std::chrono::seconds(1)) {
+    return;
+  }
+  std::cout << "cull : " << std::lround(windowVisible_ / windowFrames_)
+            << " visible, " << std::lround(windowCulled_ / windowFrames_)
+            << " culled, " << windowMs_ / windowFrames_ << " ms ("
+            << stats.threads << " threads)\n";
+  windowStart_ = now;
+  windowFrames_ = 0;
+  windowVisible_ = 0;
+  windowCulled_ = 0;
+  windowMs_ = 0;
+}
+
+void BenchmarkCulling(uint32_t count) {
+  using Clock = std::chrono::steady_clock;
+  count = std::max(count, 1u);
+  constexpr uint32_t Views = 64;
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<float> pos(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> size(0.5f, 2.0f);
+  std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+
+  std::vector<float> cx(count), cy(count), cz(count);
+  std::vector<float> ex(count), ey(count), ez(count), radius(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    cx[i] = pos(rng), cy[i] = pos(rng), cz[i] = pos(rng);
+    ex[i] = size(rng), ey[i] = size(rng), ez[i] = size(rng);
+    radius[i] = std::sqrt(ex[i] * ex[i] + ey[i] * ey[i] + ez[i] * ez[i]);
+  }
+  AabbSoaView boxes;
+  boxes.cx = cx.data(), boxes.cy = cy.data(), boxes.cz = cz.data();
+  boxes.ex = ex.data(), boxes.ey = ey.data(), boxes.ez = ez.data();
+  SphereSoaView spheres;
+  spheres.cx = cx.data(), spheres.cy = cy.data(), spheres.cz = cz.data();
+  spheres.radius = radius.data();
+
+  // 相机在中心附近朝随机方向看
+  std::vector<Frustum> frustums;
+  const glm::mat4 proj =
+      glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+  for (uint32_t v = 0; v < Views; ++v) {
+    const float yaw = angle(rng), pitch = angle(rng) * 0.2f - 0.6f;
+    const glm::vec3 dir(std::cos(pitch) * std::cos(yaw),
+        std::cos(pitch) * std::sin(yaw), std::sin(pitch));
+    const glm::mat4 view =
+        glm::lookAt(glm::vec3(0.0f), dir, glm::vec3(0.0f, 0.0f, 1.0f));
+    frustums.push_back(Frustum::FromMatrix(proj * view));
+  }
+
+  std::vector<uint32_t> out(count);
+  auto measure = [&](auto &&cull) {
+    uint64_t visible = 0;
+    const auto start = Clock::now();
+    for (const auto &frustum : frustums) {
+      visible += cull(frustum);
+    }
+    const double ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count() /
+        Views;
+    return std::pair{ms, double(visible) / Views};
+  };
+
+  // 逐个测试 6 个平面的标量版本作为基准
+  const auto scalar = measure([&](const Frustum &frustum) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      bool inside = true;
+      for (const auto &plane : frustum.planes) {
+        const glm::vec3 normal(plane);
+        const float s =
+            glm::dot(normal, glm::vec3(cx[i], cy[i], cz[i])) + plane.w +
+            glm::dot(glm::abs(normal), glm::vec3(ex[i], ey[i], ez[i]));
+        if (s < 0.0f) {
+          inside = false;
+          break;
+        }
+      }
+      if (inside) {
+        out[n++] = i;
+      }
+    }
+    return n;
+  });
+  const auto simdBoxes = measure([&](const Frustum &frustum) {
+    return CullAabbs(frustum, Frustum::AllPlanes, boxes, 0, count,
+        out.data());
+  });
+  const auto simdSpheres = measure([&](const Frustum &frustum) {
+    return CullSpheres(frustum, Frustum::AllPlanes, spheres, 0, count,
+        out.data());
+  });
+
+  FrustumCuller::Config serialConfig;
+  serialConfig.workerCount = 1;
+  serialConfig.parallelThreshold = UINT32_MAX;
+  FrustumCuller serial(serialConfig);
+  FrustumCuller parallel;
+  for (uint32_t i = 0; i < count; ++i) {
+    const glm::vec3 c(cx[i], cy[i], cz[i]), e(ex[i], ey[i], ez[i]);
+    serial.Add(c, e);
+    parallel.Add(c, e);
+  }
+  auto start = Clock::now();
+  serial.Refit();
+  const double buildMs =
+      std::chrono::duration<double, std::milli>(Clock::now() - start)
+          .count();
+  parallel.Refit();
+  std::vector<uint32_t> visible;
+  const auto bvh = measure([&](const Frustum &frustum) {
+    return serial.Cull(frustum, visible).visible;
+  });
+  const auto threaded = measure([&](const Frustum &frustum) {
+    return parallel.Cull(frustum, visible).visible;
+  });
+
+  // 1% 的物体小幅移动后 refit
+  const uint32_t moving = std::max(count / 100, 1u);
+  std::uniform_real_distribution<float> step(-1.0f, 1.0f);
+  start = Clock::now();
+  for (uint32_t k = 0; k < moving; ++k) {
+    const uint32_t i = rng() % count;
+    cx[i] += step(rng), cy[i] += step(rng), cz[i] += step(rng);
+    serial.Update(i, glm::vec3(cx[i], cy[i], cz[i]),
+        glm::vec3(ex[i], ey[i], ez[i]));
+  }
+  serial.Refit();
+  const double refitMs =
+      std::chrono::duration<double, std::milli>(Clock::now() - start)
+          .count();
+
+  // refit 后 BVH 与逐个测试的结果应该一致
+  uint32_t mismatched = 0;
+  for (const auto &frustum : frustums) {
+    const uint32_t n = CullAabbs(
+        frustum, Frustum::AllPlanes, boxes, 0, count, out.data());
+    serial.Cull(frustum, visible);
+    std::sort(visible.begin(), visible.end());
+    if (n != visible.size() ||
+        !std::equal(visible.begin(), visible.end(), out.begin())) {
+      ++mismatched;
+    }
+  }
+
+  auto line = [&](const char *name, std::pair<double, double> r) {
+    std::cout << "  " << name << r.first << " ms ("
+              << scalar.first / r.first << "x), " << r.second
+              << " visible\n";
+  };
+  std::cout << "culling benchmark : " << count << " boxes, " << Views
+            << " views, " << SimdLevel() << '\n';
+  line("scalar boxes      : ", scalar);
+  line("simd boxes        : ", simdBoxes);
+  line("simd spheres      : ", simdSpheres);
+  line("bvh, 1 thread     : ", bvh);
+  const std::string threads =
+      "bvh, " + std::to_string(parallel.WorkerCount() + 1) + " threads";
+  std::cout << "  " << threads << std::string(18 - threads.size(), ' ')
+            << ": " << threaded.first << " ms ("
+            << scalar.first / threaded.first << "x)\n"
+            << "  bvh build " << buildMs << " ms, refit after " << moving
+            << " moves " << refitMs << " ms, " << mismatched
+            << " mismatched views\n";
+}
+
+} // namespace app
@@ -0,0 +1,140 @@
+#include "../header/deletionQueue.h"
+#include "../header/application.h"
+#include <algorithm>
+
+namespace app {
+
+DeletionQueue::~DeletionQueue() {
+  Flush();
+}
+
+void DeletionQueue::BeginFrame(uint64_t frame) {
+  std::lock_guard lock(mutex_);
+  frame_ = std::max(frame_, frame);
+}
+
+void DeletionQueue::Collect(uint64_t completed) {
+  std::deque<Entry> expired;
+  {
+    std::lock_guard lock(mutex_);
+    while (!entries_.empty() && entries_.front().frame <= completed) {
+      expired.push_back(std::move(entries_.front()));
+      entries_.pop_front();
+    }
+    stats_.destroyed += expired.size();
+    stats_.peakPending = std::max(stats_.peakPending, entries_.size());
+  }
+  // 回调可能再退休别的对象，不能持锁执行
+  for (auto &entry : expired) {
+    destroy(entry);
+  }
+}
+
+void DeletionQueue::Flush() {
+  // 销毁回调里退休的对象也要处理掉
+  while (true) {
+    std::deque<Entry> expired;
+    {
+      std::lock_guard lock(mutex_);
+      if (entries_.empty()) {
+        return;
+      }
+      expired.swap(entries_);
+      stats_.destroyed += expired.size();
+    }
+    for (auto &entry : expired) {
+      destroy(entry);
+    }
+  }
+}
+
+void DeletionQueue::Retire(vk::Buffer buffer) {
+  if (buffer) {
+    push(Kind::Buffer, uint64_t(VkBuffer(buffer)));
+  }
+}
+
+void DeletionQueue::Retire(vk::Image image) {
+  if (image) {
+    push(Kind::Image, uint64_t(VkImage(image)));
+  }
+}
+
+void DeletionQueue::Retire(vk::ImageView view) {
+  if (view) {
+    push(Kind::ImageView, uint64_t(VkImageView(view)));
+  }
+}
+
+void DeletionQueue::Retire(vk::DeviceMemory memory) {
+  if (memory) {
+    push(Kind::Memory, uint64_t(VkDeviceMemory(memory)));
+  }
+}
+
+void DeletionQueue::Retire(vk::Pipeline pipeline) {
+  if (pipeline) {
+    push(Kind::Pipeline, uint64_t(VkPipeline(pipeline)));
+  }
+}
+
+void DeletionQueue::Retire(vk::Sampler sampler) {
+  if (sampler) {
+    push(Kind::Sampler, uint64_t(VkSampler(sampler)));
+  }
+}
+
+void DeletionQueue::Retire(std::function<void()> destroy) {
+  if (!destroy) {
+    return;
+  }
+  std::lock_guard lock(mutex_);
+  entries_.push_back({frame_, Kind::Function, 0, std::move(destroy)});
+  stats_.retired++;
+}
+
+auto DeletionQueue::Pending() const -> size_t {
+  std::lock_guard lock(mutex_);
+  return entries_.size();
+}
+
+auto DeletionQueue::GetStats() const -> Stats {
+  std::lock_guard lock(mutex_);
+  return stats_;
+}
+
+void DeletionQueue::push(Kind kind, uint64_t handle) {
+  std::lock_guard lock(mutex_);
+  entries_.push_back({frame_, kind, handle, {}});
+  stats_.retired++;
+}
+
+void DeletionQueue::destroy(Entry &entry) {
+  auto &device = Application::GetInstance().device;
+  switch (entry.kind) {
+  case Kind::Buffer:
+    device.destroyBuffer(vk::Buffer(VkBuffer(entry.handle)));
+    break;
+  case Kind::Image:
+    device.destroyImage(vk::Image(VkImage(entry.handle)));
+    break;
+  case Kind::ImageView:
+    device.destroyImageView(vk::ImageView(VkImageView(entry.handle)));
+    break;
+  case Kind::Memory:
+    // 仍处于映射状态的内存释放时自动解除映射
+    device.freeMemory(vk::DeviceMemory(VkDeviceMemory(entry.handle)));
+    break;
+  case Kind::Pipeline:
+    device.destroyPipeline(vk::Pipeline(VkPipeline(entry.handle)));
+    break;
+  case Kind::Sampler:
+    device.destroySampler(vk::Sampler(VkSampler(entry.handle)));
+    break;
+  case Kind::Function:
+    entry.destroy();
+    break;
+  }
+}
+
+} // namespace app
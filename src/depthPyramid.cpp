@@ -0,0 +1,179 @@
+#include "../header/depthPyramid.h"
+#include "../header/application.h"
+#include <algorithm>
+#include <bit>
+
+namespace app {
+
+namespace {
+
+// 与 hiz.comp 的 push constant 对应
+struct ReduceConstants {
+  int32_t srcSize[2];
+  int32_t dstSize[2];
+};
+
+auto levelExtent(vk::Extent2D extent, uint32_t level) -> vk::Extent2D {
+  return {std::max(extent.width >> level, 1u),
+      std::max(extent.height >> level, 1u)};
+}
+
+} // namespace
+
+DepthPyramid::DepthPyramid(uint32_t frameCount) : written_(frameCount) {
+  auto &app = Application::GetInstance();
+  reduce_ = std::make_unique<ComputeProcess>(readSpvFile("spv/hiz.spv"));
+  sets_ = reduce_->AllocSets(frameCount * MaxLevels);
+
+  // 只用 texelFetch，过滤方式无关紧要
+  vk::SamplerCreateInfo samplerInfo;
+  samplerInfo.setMagFilter(vk::Filter::eNearest)
+      .setMinFilter(vk::Filter::eNearest)
+      .setMipmapMode(vk::SamplerMipmapMode::eNearest)
+      .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+      .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+      .setAddressModeW(vk::SamplerAddressMode::eClampToEdge)
+      .setMaxLod(VK_LOD_CLAMP_NONE);
+  sampler_ = app.resources->CreateSampler(samplerInfo);
+}
+
+DepthPyramid::~DepthPyramid() {
+  destroy();
+  Application::GetInstance().resources->Destroy(sampler_);
+}
+
+auto DepthPyramid::Sampler() const -> vk::Sampler {
+  return Application::GetInstance().resources->Get(sampler_);
+}
+
+void DepthPyramid::destroy() {
+  if (!image_) {
+    return;
+  }
+  auto &app = Application::GetInstance();
+  app.resourceTracker->Forget(image_);
+  // 在途的帧可能还在读，交给延迟销毁
+  auto &queue = *app.deletionQueue;
+  for (auto view : levelViews_) {
+    queue.Retire(view);
+  }
+  queue.Retire(view_);
+  queue.Retire(image_);
+  queue.Retire(memory_);
+  levelViews_.clear();
+  view_ = nullptr;
+  image_ = nullptr;
+  memory_ = nullptr;
+}
+
+void DepthPyramid::Resize(vk::Extent2D depthExtent) {
+  if (image_ && depthExtent == depthExtent_) {
+    return;
+  }
+  destroy();
+  auto &app = Application::GetInstance();
+  auto &device = app.device;
+  depthExtent_ = depthExtent;
+  extent_ = vk::Extent2D{std::bit_floor(std::max(depthExtent.width, 1u)),
+      std::bit_floor(std::max(depthExtent.height, 1u))};
+  levels_ = std::min<uint32_t>(
+      std::bit_width(std::max(extent_.width, extent_.height)), MaxLevels);
+
+  vk::ImageCreateInfo createInfo;
+  createInfo.setImageType(vk::ImageType::e2D)
+      .setArrayLayers(1)
+      .setMipLevels(levels_)
+      .setExtent({extent_.width, extent_.height, 1})
+      .setFormat(vk::Format::eR32Sfloat)
+      .setTiling(vk::ImageTiling::eOptimal)
+      .setInitialLayout(vk::ImageLayout::eUndefined)
+      .setUsage(vk::ImageUsageFlagBits::eStorage |
+                vk::ImageUsageFlagBits::eSampled)
+      .setSamples(vk::SampleCountFlagBits::e1);
+  image_ = device.createImage(createInfo);
+
+  auto requirements = device.getImageMemoryRequirements(image_);
+  vk::MemoryAllocateInfo allocInfo;
+  allocInfo.setAllocationSize(requirements.size)
+      .setMemoryTypeIndex(
+          QueryBufferMemTypeIndex(requirements.memoryTypeBits,
+              vk::MemoryPropertyFlagBits::eDeviceLocal)
+              .value());
+  memory_ = device.allocateMemory(allocInfo);
+  device.bindImageMemory(image_, memory_, 0);
+
+  vk::ImageViewCreateInfo viewInfo;
+  viewInfo.setImage(image_)
+      .setViewType(vk::ImageViewType::e2D)
+      .setFormat(vk::Format::eR32Sfloat)
+      .setSubresourceRange(
+          {vk::ImageAspectFlagBits::eColor, 0, levels_, 0, 1});
+  view_ = device.createImageView(viewInfo);
+  for (uint32_t level = 0; level < levels_; ++level) {
+    viewInfo.setSubresourceRange(
+        {vk::ImageAspectFlagBits::eColor, level, 1, 0, 1});
+    levelViews_.push_back(device.createImageView(viewInfo));
+  }
+
+  app.resourceTracker->Track(image_, levels_);
+  valid_ = false;
+  ++generation_;
+}
+
+void DepthPyramid::Build(vk::CommandBuffer cmdBuf, uint32_t frame,
+    vk::ImageView depth, const glm::mat4 &viewProj) {
+  auto &tracker = *Application::GetInstance().resourceTracker;
+  // 该帧的集合已经没有在途的命令在用
+  auto &written = written_[frame];
+  if (written.depth != depth || written.generation != generation_) {
+    for (uint32_t level = 0; level < levels_; ++level) {
+      const auto set = sets_[frame * MaxLevels + level];
+      if (level == 0) {
+        reduce_->WriteImage(set, 0, depth,
+            vk::ImageLayout::eShaderReadOnlyOptimal, Sampler());
+      } else {
+        reduce_->WriteImage(set, 0, levelViews_[level - 1],
+            vk::ImageLayout::eGeneral, Sampler());
+      }
+      reduce_->WriteImage(
+          set, 1, levelViews_[level], vk::ImageLayout::eGeneral);
+    }
+    written = {depth, generation_};
+  }
+
+  const ResourceState write{vk::PipelineStageFlagBits2::eComputeShader,
+      vk::AccessFlagBits2::eShaderStorageWrite, vk::ImageLayout::eGeneral};
+  const ResourceState read{vk::PipelineStageFlagBits2::eComputeShader,
+      vk::AccessFlagBits2::eShaderSampledRead, vk::ImageLayout::eGeneral};
+  vk::Extent2D src = depthExtent_;
+  for (uint32_t level = 0; level < levels_; ++level) {
+    const auto dst = levelExtent(extent_, level);
+    // 上一级写完才能读；本级旧内容直接覆盖
+    if (level > 0) {
+      tracker.Use(image_, read, level - 1, 1);
+    }
+    tracker.Use(image_, write, level, 1);
+    tracker.Flush(cmdBuf);
+
+    ReduceConstants constants{
+        {int32_t(src.width), int32_t(src.height)},
+        {int32_t(dst.width), int32_t(dst.height)}};
+    reduce_->Bind(cmdBuf, sets_[frame * MaxLevels + level]);
+    reduce_->Push(cmdBuf, constants);
+    reduce_->DispatchFor(cmdBuf, dst.width, dst.height);
+    src = dst;
+  }
+  valid_ = true;
+  viewProj_ = viewProj;
+}
+
+void DepthPyramid::PrepareRead(vk::CommandBuffer cmdBuf) {
+  auto &tracker = *Application::GetInstance().resourceTracker;
+  tracker.Use(image_,
+      {vk::PipelineStageFlagBits2::eComputeShader,
+          vk::AccessFlagBits2::eShaderSampledRead,
+          vk::ImageLayout::eGeneral});
+  tracker.Flush(cmdBuf);
+}
+
+} // namespace app
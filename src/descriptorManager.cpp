@@ -10,13 +10,16 @@ std::unique_ptr<DescriptorSetManager>
 DescriptorSetManager::DescriptorSetManager(
     uint32_t maxFlight)
     : maxFlight(maxFlight) {
-  std::array<vk::DescriptorPoolSize, 2> size;
+  std::array<vk::DescriptorPoolSize, 3> size;
   size[0]
       .setType(vk::DescriptorType::eUniformBuffer)
       .setDescriptorCount(maxFlight);
   size[1]
       .setType(vk::DescriptorType::eCombinedImageSampler)
       .setDescriptorCount(maxFlight);
+  size[2]
+      .setType(vk::DescriptorType::eStorageBuffer)
+      .setDescriptorCount(maxFlight);
   vk::DescriptorPoolCreateInfo createInfo;
   createInfo.setMaxSets(maxFlight).setPoolSizes(size);
   auto pool = Application::GetInstance()
@@ -0,0 +1,24 @@
+#include "../header/drawList.h"
+#include <algorithm>
+
+namespace app {
+
+void DrawList::Sort(const glm::mat4 &view, Order order) {
+  for (auto &item : items_) {
+    item.depth = -(view * item.model[3]).z;
+  }
+  // 深度相同的保持提交顺序，避免帧间闪烁
+  if (order == Order::FrontToBack) {
+    std::stable_sort(items_.begin(), items_.end(),
+        [](const Item &a, const Item &b) {
+          return a.depth < b.depth;
+        });
+  } else {
+    std::stable_sort(items_.begin(), items_.end(),
+        [](const Item &a, const Item &b) {
+          return a.depth > b.depth;
+        });
+  }
+}
+
+} // namespace app
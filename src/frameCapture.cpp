@@ -0,0 +1,510 @@
+#include "../header/frameCapture.h"
+#include "../header/colorConvert.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace app {
+
+namespace {
+
+// CRC32（slicing-by-8），PNG chunk 校验
+struct Crc32Table {
+  std::array<std::array<uint32_t, 256>, 8> t{};
+  Crc32Table() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      t[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; ++i) {
+      for (int s = 1; s < 8; ++s) {
+        t[s][i] =
+            (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xFF];
+      }
+    }
+  }
+};
+
+auto crc32(const uint8_t *data, size_t len) -> uint32_t {
+  static const Crc32Table table;
+  const auto &t = table.t;
+  uint32_t c = 0xFFFFFFFFu;
+  while (len >= 8) {
+    uint32_t lo, hi;
+    std::memcpy(&lo, data, 4);
+    std::memcpy(&hi, data + 4, 4);
+    lo ^= c;
+    c = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^
+        t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+        t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^
+        t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    data += 8;
+    len -= 8;
+  }
+  while (len--) {
+    c = t[0][(c ^ *data++) & 0xFF] ^ (c >> 8);
+  }
+  return c ^ 0xFFFFFFFFu;
+}
+
+// Adler32，NMAX 个字节内不会溢出，无需每字节取模
+struct Adler32 {
+  uint32_t a = 1, b = 0;
+  void Update(const uint8_t *data, size_t len) {
+    constexpr size_t NMAX = 5552;
+    while (len > 0) {
+      size_t n = std::min(len, NMAX);
+      len -= n;
+      while (n--) {
+        a += *data++;
+        b += a;
+      }
+      a %= 65521;
+      b %= 65521;
+    }
+  }
+  [[nodiscard]] auto Value() const -> uint32_t {
+    return (b << 16) | a;
+  }
+};
+
+void putU32BE(uint8_t *p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v >> 24);
+  p[1] = static_cast<uint8_t>(v >> 16);
+  p[2] = static_cast<uint8_t>(v >> 8);
+  p[3] = static_cast<uint8_t>(v);
+}
+
+// deflate 位流，低位在前
+class BitWriter {
+public:
+  explicit BitWriter(std::vector<uint8_t> &out) : out_(out) {}
+
+  void Put(uint32_t bits, uint32_t count) {
+    acc_ |= uint64_t(bits) << used_;
+    used_ += count;
+    while (used_ >= 8) {
+      out_.push_back(static_cast<uint8_t>(acc_));
+      acc_ >>= 8;
+      used_ -= 8;
+    }
+  }
+
+  void Flush() {
+    if (used_ > 0) {
+      out_.push_back(static_cast<uint8_t>(acc_));
+    }
+    acc_ = 0;
+    used_ = 0;
+  }
+
+private:
+  std::vector<uint8_t> &out_;
+  uint64_t acc_ = 0;
+  uint32_t used_ = 0;
+};
+
+constexpr std::array<uint16_t, 29> LengthBase = {3, 4, 5, 6, 7, 8,
+    9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83,
+    99, 115, 131, 163, 195, 227, 258};
+constexpr std::array<uint8_t, 29> LengthExtra = {0, 0, 0, 0, 0, 0,
+    0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5,
+    0};
+constexpr std::array<uint16_t, 30> DistanceBase = {1, 2, 3, 4, 5,
+    7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr std::array<uint8_t, 30> DistanceExtra = {0, 0, 0, 0, 1,
+    1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11,
+    11, 12, 12, 13, 13};
+
+constexpr uint32_t WindowSize = 32768;
+constexpr uint32_t MinMatch = 4;
+constexpr uint32_t MaxMatch = 258;
+
+// 固定 Huffman 码表（已按位流顺序翻转），以及长度 / 距离到码号的映射
+struct FixedCodes {
+  struct Code {
+    uint16_t bits;
+    uint8_t length;
+  };
+  std::array<Code, 288> literal{};
+  std::array<Code, 30> distance{};
+  std::array<uint8_t, MaxMatch + 1> lengthCode{};
+  std::array<uint8_t, WindowSize + 1> distanceCode{};
+
+  FixedCodes() {
+    auto reversed = [](uint32_t code, uint32_t length) {
+      uint32_t r = 0;
+      for (uint32_t i = 0; i < length; ++i) {
+        r = (r << 1) | ((code >> i) & 1);
+      }
+      return static_cast<uint16_t>(r);
+    };
+    for (uint32_t s = 0; s < literal.size(); ++s) {
+      uint32_t code, length;
+      if (s < 144) {
+        code = 0x30 + s;
+        length = 8;
+      } else if (s < 256) {
+        code = 0x190 + s - 144;
+        length = 9;
+      } else if (s < 280) {
+        code = s - 256;
+        length = 7;
+      } else {
+        code = 0xC0 + s - 280;
+        length = 8;
+      }
+      literal[s] = {reversed(code, length),
+          static_cast<uint8_t>(length)};
+    }
+    for (uint32_t d = 0; d < distance.size(); ++d) {
+      distance[d] = {reversed(d, 5), 5};
+    }
+    for (uint32_t c = 0; c < LengthBase.size(); ++c) {
+      const uint32_t end = c + 1 < LengthBase.size()
+                               ? LengthBase[c + 1]
+                               : MaxMatch + 1;
+      for (uint32_t l = LengthBase[c]; l < end; ++l) {
+        lengthCode[l] = static_cast<uint8_t>(c);
+      }
+    }
+    // 258 单独占一个码
+    lengthCode[MaxMatch] = 28;
+    for (uint32_t c = 0; c < DistanceBase.size(); ++c) {
+      const uint32_t end = c + 1 < DistanceBase.size()
+                               ? DistanceBase[c + 1]
+                               : WindowSize + 1;
+      for (uint32_t d = DistanceBase[c]; d < end; ++d) {
+        distanceCode[d] = static_cast<uint8_t>(c);
+      }
+    }
+  }
+};
+
+// 单个固定 Huffman 块 + 单候选哈希的 LZ77（类似 zlib 的 level 1），
+// 经过行滤波的截图大部分是 0 和重复的行，用不着动态码表
+void deflateFast(
+    const uint8_t *data, size_t size, std::vector<uint8_t> &out) {
+  static const FixedCodes codes;
+  BitWriter bits(out);
+  bits.Put(1, 1); // BFINAL
+  bits.Put(1, 2); // BTYPE = 固定 Huffman
+
+  auto literal = [&](uint32_t symbol) {
+    const auto &code = codes.literal[symbol];
+    bits.Put(code.bits, code.length);
+  };
+
+  constexpr uint32_t HashBits = 15;
+  std::vector<int64_t> head(size_t(1) << HashBits, -1);
+  auto hashAt = [data](size_t i) {
+    uint32_t v;
+    std::memcpy(&v, data + i, 4);
+    return (v * 2654435761u) >> (32 - HashBits);
+  };
+
+  size_t i = 0;
+  while (i < size) {
+    size_t length = 0;
+    size_t distance = 0;
+    if (i + MinMatch <= size) {
+      auto &slot = head[hashAt(i)];
+      const int64_t candidate = slot;
+      slot = static_cast<int64_t>(i);
+      if (candidate >= 0 && i - candidate <= WindowSize) {
+        const size_t limit = std::min<size_t>(MaxMatch, size - i);
+        const uint8_t *a = data + candidate;
+        const uint8_t *b = data + i;
+        while (length < limit && a[length] == b[length]) {
+          ++length;
+        }
+        distance = i - candidate;
+      }
+    }
+    if (length < MinMatch) {
+      literal(data[i]);
+      ++i;
+      continue;
+    }
+
+    const uint32_t lc = codes.lengthCode[length];
+    literal(257 + lc);
+    bits.Put(static_cast<uint32_t>(length - LengthBase[lc]),
+        LengthExtra[lc]);
+    const uint32_t dc = codes.distanceCode[distance];
+    bits.Put(codes.distance[dc].bits, codes.distance[dc].length);
+    bits.Put(static_cast<uint32_t>(distance - DistanceBase[dc]),
+        DistanceExtra[dc]);
+
+    // 匹配内部的位置也登记，后面的行才能匹配到它们
+    const size_t end = i + length;
+    for (++i; i < end; ++i) {
+      if (i + MinMatch <= size) {
+        head[hashAt(i)] = static_cast<int64_t>(i);
+      }
+    }
+  }
+  literal(256);
+  bits.Flush();
+}
+
+// PNG 行滤波：每行在 Sub 与 Up 之间选绝对值和较小的（规范推荐的启发式）
+void filterRow(const uint8_t *cur, const uint8_t *prev,
+    size_t rowBytes, uint8_t *sub, uint8_t *up, uint8_t *out) {
+  uint64_t subCost = 0;
+  uint64_t upCost = 0;
+  auto cost = [](uint8_t v) { return v < 128 ? v : 256u - v; };
+  for (size_t x = 0; x < rowBytes; ++x) {
+    sub[x] = static_cast<uint8_t>(cur[x] - (x >= 4 ? cur[x - 4] : 0));
+    up[x] = static_cast<uint8_t>(cur[x] - prev[x]);
+    subCost += cost(sub[x]);
+    upCost += cost(up[x]);
+  }
+  out[0] = subCost <= upCost ? 1 : 2;
+  std::memcpy(out + 1, subCost <= upCost ? sub : up, rowBytes);
+}
+
+auto binaryStdout() -> FILE * {
+#ifdef _WIN32
+  _setmode(_fileno(stdout), _O_BINARY);
+#endif
+  return stdout;
+}
+
+} // namespace
+
+void EncodePng(const uint8_t *pixels, uint32_t w, uint32_t h,
+    uint32_t rowPitch, bool bgra, std::vector<uint8_t> &out) {
+  static constexpr uint8_t signature[8] = {
+      0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  const size_t rowBytes = size_t(w) * 4;
+
+  // 先整幅滤波，再整体压缩，匹配可以跨行
+  std::vector<uint8_t> filtered((rowBytes + 1) * h);
+  std::vector<uint8_t> rows(rowBytes * 4, 0);
+  uint8_t *cur = rows.data();
+  uint8_t *prev = cur + rowBytes;
+  uint8_t *sub = prev + rowBytes;
+  uint8_t *up = sub + rowBytes;
+  for (uint32_t y = 0; y < h; ++y) {
+    const uint8_t *src = pixels + size_t(y) * rowPitch;
+    if (bgra) {
+      SwizzleBGRA2RGBA(src, cur, w);
+    } else {
+      std::memcpy(cur, src, rowBytes);
+    }
+    // 第一行的上一行视为全 0
+    filterRow(cur, prev, rowBytes, sub, up,
+        filtered.data() + size_t(y) * (rowBytes + 1));
+    std::swap(cur, prev);
+  }
+
+  // zlib 头 2 字节 + deflate + adler 4 字节
+  std::vector<uint8_t> zlib;
+  zlib.reserve(filtered.size() / 2 + 64);
+  zlib.push_back(0x78);
+  zlib.push_back(0x01);
+  deflateFast(filtered.data(), filtered.size(), zlib);
+  Adler32 adler;
+  adler.Update(filtered.data(), filtered.size());
+  zlib.resize(zlib.size() + 4);
+  putU32BE(zlib.data() + zlib.size() - 4, adler.Value());
+
+  // signature + IHDR(25) + IDAT(12 + data) + IEND(12)
+  out.resize(8 + 25 + 12 + zlib.size() + 12);
+  uint8_t *p = out.data();
+  std::memcpy(p, signature, 8);
+  p += 8;
+
+  // IHDR：8 位 RGBA，不隔行
+  putU32BE(p, 13);
+  std::memcpy(p + 4, "IHDR", 4);
+  putU32BE(p + 8, w);
+  putU32BE(p + 12, h);
+  p[16] = 8;
+  p[17] = 6;
+  p[18] = 0;
+  p[19] = 0;
+  p[20] = 0;
+  putU32BE(p + 21, crc32(p + 4, 17));
+  p += 25;
+
+  putU32BE(p, static_cast<uint32_t>(zlib.size()));
+  std::memcpy(p + 4, "IDAT", 4);
+  std::memcpy(p + 8, zlib.data(), zlib.size());
+  putU32BE(p + 8 + zlib.size(), crc32(p + 4, zlib.size() + 4));
+  p += 12 + zlib.size();
+
+  putU32BE(p, 0);
+  std::memcpy(p + 4, "IEND", 4);
+  putU32BE(p + 8, crc32(p + 4, 4));
+}
+
+FrameCapture::FrameCapture(const Config &config)
+    : config_(config), queue_(config.queueCapacity) {
+  if (config_.format == Format::Png) {
+    std::filesystem::create_directories(config_.output);
+  } else if (config_.output == "-") {
+    stream_ = binaryStdout();
+  } else {
+    stream_ = std::fopen(config_.output.c_str(), "wb");
+    if (!stream_) {
+      throw std::runtime_error(
+          "open capture output failed : " + config_.output);
+    }
+  }
+
+  uint32_t count = config_.workerCount;
+  if (count == 0) {
+    // 留一个核给渲染线程；取不到核数时返回 0
+    const uint32_t hw = std::thread::hardware_concurrency();
+    count = hw > 1 ? hw - 1 : 1;
+  }
+  workers_.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    workers_.emplace_back([this] { workerLoop(); });
+  }
+}
+
+FrameCapture::~FrameCapture() {
+  stop_.store(true);
+  pending_.release(static_cast<std::ptrdiff_t>(
+      workers_.size()));
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+  if (stream_ && stream_ != stdout) {
+    std::fclose(stream_);
+  } else if (stream_) {
+    std::fflush(stream_);
+  }
+  std::cerr << "Capture : written " << written_.load()
+            << ", dropped " << dropped_.load() << '\n';
+}
+
+auto FrameCapture::ParseFormat(std::string_view name)
+    -> std::optional<Format> {
+  if (name == "png") {
+    return Format::Png;
+  }
+  if (name == "rgba") {
+    return Format::Rgba;
+  }
+  if (name == "yuv" || name == "yuv420") {
+    return Format::Yuv420;
+  }
+  return std::nullopt;
+}
+
+auto FrameCapture::Submit(const Frame &frame) -> bool {
+  Job job{frame, nextSequence_};
+  if (!queue_.TryPush(std::move(job))) {
+    NoteDropped();
+    return false;
+  }
+  nextSequence_++;
+  pending_.release();
+  return true;
+}
+
+void FrameCapture::NoteDropped() {
+  dropped_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameCapture::workerLoop() {
+  // 每个 worker 复用自己的缓冲，稳定后不再分配内存
+  std::vector<uint8_t> encoded;
+  for (;;) {
+    pending_.acquire();
+    auto job = queue_.TryPop();
+    if (!job) {
+      if (stop_.load()) {
+        return;
+      }
+      continue;
+    }
+    process(*job, encoded);
+    if (stream_) {
+      writeInOrder(job->sequence, encoded);
+    } else {
+      writeFile(job->sequence, encoded);
+    }
+    written_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void FrameCapture::process(
+    const Job &job, std::vector<uint8_t> &encoded) {
+  const auto &f = job.frame;
+  const size_t rowBytes = size_t(f.width) * 4;
+
+  switch (config_.format) {
+  case Format::Png:
+    EncodePng(f.pixels, f.width, f.height, f.rowPitch,
+        f.bgra, encoded);
+    break;
+  case Format::Rgba:
+    encoded.resize(rowBytes * f.height);
+    for (uint32_t y = 0; y < f.height; ++y) {
+      const uint8_t *src = f.pixels + size_t(y) * f.rowPitch;
+      uint8_t *dst = encoded.data() + y * rowBytes;
+      if (f.bgra) {
+        SwizzleBGRA2RGBA(src, dst, f.width);
+      } else {
+        std::memcpy(dst, src, rowBytes);
+      }
+    }
+    break;
+  case Format::Yuv420: {
+    const size_t lumaSize = size_t(f.width) * f.height;
+    const size_t chromaSize = size_t((f.width + 1) / 2) *
+                              ((f.height + 1) / 2);
+    encoded.resize(lumaSize + chromaSize * 2);
+    RGBA2YUV420(f.pixels, f.width, f.height, f.rowPitch,
+        f.bgra, encoded.data(), encoded.data() + lumaSize,
+        encoded.data() + lumaSize + chromaSize);
+    break;
+  }
+  }
+  // 源像素已经用完，尽早归还 GPU 回读缓冲
+  f.busy->store(false, std::memory_order_release);
+}
+
+void FrameCapture::writeInOrder(
+    uint64_t sequence, const std::vector<uint8_t> &data) {
+  std::unique_lock lock(writeMutex_);
+  writeCond_.wait(
+      lock, [&] { return nextWrite_ == sequence; });
+  std::fwrite(data.data(), 1, data.size(), stream_);
+  nextWrite_++;
+  lock.unlock();
+  writeCond_.notify_all();
+}
+
+void FrameCapture::writeFile(
+    uint64_t sequence, const std::vector<uint8_t> &data) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "frame_%06llu.png",
+      static_cast<unsigned long long>(sequence));
+  auto path = std::filesystem::path(config_.output) / name;
+  FILE *file = std::fopen(path.string().c_str(), "wb");
+  if (!file) {
+    std::cerr << "capture write failed : " << path << '\n';
+    return;
+  }
+  std::fwrite(data.data(), 1, data.size(), file);
+  std::fclose(file);
+}
+
+} // namespace app
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include "../header/framePacer.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+namespace app {
+
+namespace {
+
+auto modeName(FramePacer::Mode mode) -> const char * {
+  switch (mode) {
+  case FramePacer::Mode::Latency:
+    return "latency";
+  case FramePacer::Mode::Throughput:
+    return "throughput";
+  case FramePacer::Mode::Capped:
+    return "capped";
+  }
+  return "";
+}
+
+} // namespace
+
+FramePacer::FramePacer(const Config &config) : config_(config) {
+  switch (config.mode) {
+  case Mode::Latency:
+    framesInFlight_ = 1;
+    break;
+  case Mode::Throughput:
+    framesInFlight_ = 3;
+    break;
+  case Mode::Capped:
+    framesInFlight_ = 2;
+    break;
+  }
+  if (config.framesInFlight > 0) {
+    framesInFlight_ = std::min<uint32_t>(
+        config.framesInFlight, HistorySize / 2);
+  }
+  if (config.mode == Mode::Capped && config.fpsCap > 0) {
+    period_ = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / config.fpsCap));
+  }
+  deadline_ = Clock::now();
+  windowStart_ = deadline_;
+}
+
+auto FramePacer::ParseMode(std::string_view name)
+    -> std::optional<Mode> {
+  if (name == "latency") {
+    return Mode::Latency;
+  }
+  if (name == "throughput") {
+    return Mode::Throughput;
+  }
+  if (name == "capped") {
+    return Mode::Capped;
+  }
+  return std::nullopt;
+}
+
+auto FramePacer::ParsePresentMode(std::string_view name)
+    -> std::optional<vk::PresentModeKHR> {
+  if (name == "fifo") {
+    return vk::PresentModeKHR::eFifo;
+  }
+  if (name == "mailbox") {
+    return vk::PresentModeKHR::eMailbox;
+  }
+  if (name == "immediate") {
+    return vk::PresentModeKHR::eImmediate;
+  }
+  return std::nullopt;
+}
+
+auto FramePacer::ChoosePresentMode(
+    const std::vector<vk::PresentModeKHR> &available) const
+    -> vk::PresentModeKHR {
+  auto has = [&](vk::PresentModeKHR mode) {
+    return std::find(available.begin(), available.end(), mode) !=
+           available.end();
+  };
+  if (config_.presentMode && has(*config_.presentMode)) {
+    return *config_.presentMode;
+  }
+  if (config_.mode == Mode::Latency) {
+    // mailbox 不排队，总是显示最新的一帧
+    if (has(vk::PresentModeKHR::eMailbox)) {
+      return vk::PresentModeKHR::eMailbox;
+    }
+    // 没有 mailbox 时宁可撕裂也不等 vblank
+    if (has(vk::PresentModeKHR::eImmediate)) {
+      return vk::PresentModeKHR::eImmediate;
+    }
+  }
+  // 吞吐与限帧按 vblank 排队，不丢帧也不撕裂（一定支持）
+  return vk::PresentModeKHR::eFifo;
+}
+
+auto FramePacer::ChooseImageCount(
+    const vk::SurfaceCapabilitiesKHR &capabilities) const
+    -> uint32_t {
+  // 吞吐优先多一张图像，acquire 不会等 present
+  const uint32_t wanted =
+      config_.mode == Mode::Throughput ? 3 : 2;
+  uint32_t count = std::max(wanted, capabilities.minImageCount);
+  // maxImageCount 为 0 表示没有上限
+  if (capabilities.maxImageCount > 0) {
+    count = std::min(count, capabilities.maxImageCount);
+  }
+  return count;
+}
+
+void FramePacer::BeginFrame() {
+  if (period_ == Clock::duration::zero()) {
+    return;
+  }
+  const auto now = Clock::now();
+  // 落后超过一帧（如窗口被拖动）不追赶，从现在重新计时
+  if (deadline_ + period_ < now) {
+    deadline_ = now;
+  }
+  sleepUntil(deadline_);
+  deadline_ += period_;
+}
+
+// 系统 sleep 的精度通常只有毫秒级：按 1ms 分段睡，
+// 剩余时间小于 sleep 误差的估计后只 yield 补齐最后一小段
+void FramePacer::sleepUntil(Clock::time_point deadline) {
+  using Seconds = std::chrono::duration<double>;
+  while (Seconds(deadline - Clock::now()).count() > sleepEstimate_) {
+    const auto start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    const double observed = Seconds(Clock::now() - start).count();
+
+    // Welford 在线更新均值与方差
+    sleepCount_++;
+    const double delta = observed - sleepMean_;
+    sleepMean_ += delta / double(sleepCount_);
+    sleepM2_ += delta * (observed - sleepMean_);
+    const double stddev =
+        std::sqrt(sleepM2_ / double(sleepCount_ - 1));
+    sleepEstimate_ = sleepMean_ + stddev;
+  }
+  while (Clock::now() < deadline) {
+    std::this_thread::yield();
+  }
+}
+
+void FramePacer::InputSampled(uint64_t frame) {
+  inputTimes_[frame % HistorySize] = Clock::now();
+}
+
+void FramePacer::Submitted(uint64_t frame, uint64_t completedFrame) {
+  depthSum_ += double(frame - completedFrame);
+  depthSamples_++;
+}
+
+void FramePacer::Completed(uint64_t completedFrame) {
+  if (completedFrame <= lastCompleted_) {
+    return;
+  }
+  const auto now = Clock::now();
+  for (uint64_t frame = lastCompleted_ + 1; frame <= completedFrame;
+       ++frame) {
+    if (completedFrame - frame >= HistorySize) {
+      continue;
+    }
+    const auto input = inputTimes_[frame % HistorySize];
+    latencySum_ +=
+        std::chrono::duration<double, std::milli>(now - input)
+            .count();
+    latencySamples_++;
+  }
+  lastCompleted_ = completedFrame;
+}
+
+auto FramePacer::EndFrame() -> bool {
+  frames_++;
+  const auto now = Clock::now();
+  const double elapsed =
+      std::chrono::duration<double>(now - windowStart_).count();
+  if (elapsed < 1.0) {
+    return false;
+  }
+  last_.fps = frames_ / elapsed;
+  last_.queueDepth =
+      depthSamples_ > 0 ? depthSum_ / depthSamples_ : 0.0;
+  last_.latencyMs =
+      latencySamples_ > 0 ? latencySum_ / latencySamples_ : 0.0;
+  std::cout << "FPS : " << std::lround(last_.fps) << " ("
+            << modeName(config_.mode) << ", " << framesInFlight_
+            << " in flight, queue depth " << last_.queueDepth
+            << ", input->gpu " << last_.latencyMs << " ms)\n";
+
+  windowStart_ = now;
+  frames_ = 0;
+  depthSum_ = 0;
+  depthSamples_ = 0;
+  latencySum_ = 0;
+  latencySamples_ = 0;
+  return true;
+}
+
+} // namespace app
@@ -0,0 +1,93 @@
+#include "../header/gpuTimer.h"
+#include "../header/application.h"
+
+namespace app {
+
+GpuTimer::GpuTimer(uint32_t frameCount, uint32_t sectionCount)
+    : stride_(2 + sectionCount * 2), recorded_(frameCount, false),
+      sections_(frameCount, 0) {
+  auto &app = Application::GetInstance();
+  auto families = app.phyDevice.getQueueFamilyProperties();
+  const auto family = app.queueFamilyIndices.graphicQueue.value();
+  supported_ = families[family].timestampValidBits > 0;
+  period_ = app.phyDevice.getProperties().limits.timestampPeriod;
+
+  vk::QueryPoolCreateInfo info;
+  info.setQueryType(vk::QueryType::eTimestamp)
+      .setQueryCount(frameCount * stride_);
+  pool_ = app.device.createQueryPool(info);
+}
+
+GpuTimer::~GpuTimer() {
+  Application::GetInstance().device.destroyQueryPool(pool_);
+}
+
+void GpuTimer::Begin(vk::CommandBuffer cmdBuf, uint32_t frame) {
+  if (!supported_) {
+    return;
+  }
+  cmdBuf.resetQueryPool(pool_, frame * stride_, stride_);
+  cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,
+      pool_, frame * stride_);
+}
+
+void GpuTimer::End(vk::CommandBuffer cmdBuf, uint32_t frame) {
+  if (!supported_) {
+    return;
+  }
+  cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+      pool_, frame * stride_ + 1);
+  recorded_[frame] = true;
+}
+
+// 区段两端都等之前的命令完成再写，得到的是区段本身的耗时
+void GpuTimer::BeginSection(
+    vk::CommandBuffer cmdBuf, uint32_t frame, uint32_t section) {
+  if (!supported_) {
+    return;
+  }
+  cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+      pool_, frame * stride_ + 2 + section * 2);
+}
+
+void GpuTimer::EndSection(
+    vk::CommandBuffer cmdBuf, uint32_t frame, uint32_t section) {
+  if (!supported_) {
+    return;
+  }
+  cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+      pool_, frame * stride_ + 3 + section * 2);
+  sections_[frame] |= 1u << section;
+}
+
+auto GpuTimer::Read(uint32_t frame) -> std::optional<double> {
+  if (!recorded_[frame]) {
+    return std::nullopt;
+  }
+  recorded_[frame] = false;
+  return readPair(frame * stride_);
+}
+
+auto GpuTimer::ReadSection(uint32_t frame, uint32_t section)
+    -> std::optional<double> {
+  const uint32_t bit = 1u << section;
+  if (!(sections_[frame] & bit)) {
+    return std::nullopt;
+  }
+  sections_[frame] &= ~bit;
+  return readPair(frame * stride_ + 2 + section * 2);
+}
+
+auto GpuTimer::readPair(uint32_t first) -> std::optional<double> {
+  uint64_t ticks[2] = {};
+  auto result =
+      Application::GetInstance().device.getQueryPoolResults(pool_,
+          first, 2, sizeof(ticks), ticks, sizeof(uint64_t),
+          vk::QueryResultFlagBits::e64);
+  if (result != vk::Result::eSuccess) {
+    return std::nullopt;
+  }
+  return double(ticks[1] - ticks[0]) * period_ / 1e6;
+}
+
+} // namespace app
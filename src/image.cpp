@@ -0,0 +1,76 @@
+#include "../header/image.h"
+#include "../header/colorConvert.h"
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../external/stb_image.h"
+
+namespace app {
+
+void ImageFree::operator()(uint8_t *pixels) const {
+  stbi_image_free(pixels);
+}
+
+auto LoadImageData(std::string_view filename) -> ImageData {
+  std::string path(filename);
+  int w, h, channel;
+  stbi_uc *pixels =
+      stbi_load(path.c_str(), &w, &h, &channel, STBI_rgb_alpha);
+  if (!pixels) {
+    std::cerr << "image load failed : " << path << '\n';
+    throw std::runtime_error("image load failed");
+  }
+  ImageData image;
+  image.width = static_cast<uint32_t>(w);
+  image.height = static_cast<uint32_t>(h);
+  image.pixels.reset(pixels);
+  return image;
+}
+
+auto DecodeImageInto(std::string_view filename,
+    const PixelTarget &target) -> std::optional<DecodeInfo> {
+  std::string path(filename);
+  int w, h, channel;
+  if (!stbi_info(path.c_str(), &w, &h, &channel)) {
+    std::cerr << "image load failed : " << path << '\n';
+    throw std::runtime_error("image load failed");
+  }
+
+  DecodeInfo info;
+  info.width = static_cast<uint32_t>(w);
+  info.height = static_cast<uint32_t>(h);
+  info.channels = static_cast<uint32_t>(channel);
+  const size_t pixelCount = size_t(w) * h;
+  const size_t size = pixelCount * 4;
+  // 旧路径：stbi 输出 RGBA（非 4 通道时多一次格式转换），
+  // 再整张 memcpy 到新建的 staging buffer
+  info.legacyBytesCopied = channel == 4 ? size : size * 2;
+  info.bytesCopied = size;
+
+  uint8_t *dst = target(info.width, info.height);
+  if (!dst) {
+    return std::nullopt;
+  }
+
+  // stbi 在堆上解码（中间缓冲的大小和次数由格式决定，
+  // 不能让它落在 staging 上），再一次写入目标；
+  // RGB 的扩展与这次拷贝合并，用 SIMD 完成
+  const int reqComp = channel == 3 ? 0 : STBI_rgb_alpha;
+  std::unique_ptr<uint8_t, ImageFree> pixels(
+      stbi_load(path.c_str(), &w, &h, &channel, reqComp));
+  if (!pixels) {
+    std::cerr << "image load failed : " << path << '\n';
+    throw std::runtime_error("image load failed");
+  }
+  if (reqComp == 0 && channel == 3) {
+    ExpandRGB2RGBA(pixels.get(), dst, pixelCount);
+  } else {
+    std::memcpy(dst, pixels.get(), size);
+  }
+  return info;
+}
+
+} // namespace app
\ No newline at end of file
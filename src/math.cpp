@@ -1,106 +1,472 @@
 #include "../header/math.h"
+#include "../header/simd.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 namespace app {
 
-// auto Vec::GetAttributeDescription()
-//     -> std::vector<vk::VertexInputAttributeDescription> {
-//   std::vector<vk::VertexInputAttributeDescription>
-//   descriptions(2); descriptions[0]
-//       .setBinding(0)
-//       .setFormat(vk::Format::eR32G32Sfloat)
-//       .setLocation(0)
-//       .setOffset(0);
-//   descriptions[1]
-//       .setBinding(0)
-//       .setFormat(vk::Format::eR32G32Sfloat)
-//       .setLocation(1)
-//       .setOffset(offsetof(Vertex, texcoord));
-//   return descriptions;
-// }
-
-// std::vector<vk::VertexInputBindingDescription>
-// Vec::GetBindingDescription() {
-//   std::vector<vk::VertexInputBindingDescription>
-//   descriptions(1); descriptions[0]
-//       .setBinding(0)
-//       .setStride(sizeof(Vertex))
-//       .setInputRate(vk::VertexInputRate::eVertex);
-//   return descriptions;
-// }
-
-// auto Mat4::Create(const std::initializer_list<float>
-// &initList) -> Mat4 {
-//   Mat4 mat;
-//   int counter = 0;
-//   for (auto &value : initList) {
-//     int x = counter % 4;
-//     int y = counter / 4;
-//     mat.Set(y, x, value);
-//     counter++;
-//   }
-//   return mat;
-// }
-
-// Mat4::Mat4() {
-//   memset(data_, 0, sizeof(float) * 4 * 4);
-//   for (int i = 0; i < 4; i++) {
-//     Set(i, i, 1);
-//   }
-// }
-
-// auto Mat4::CreateOnes() -> Mat4 {
-//   Mat4 mat;
-//   memset(mat.data_, 1, sizeof(float) * 4 * 4);
-//   return mat;
-// }
-
-// auto Mat4::CreateIdentity() -> Mat4 { return Mat4{}; }
-
-// auto Mat4::CreateOrtho(int left, int right, int top, int
-// bottom, int near,
-//                        int far) -> Mat4 {
-//   Mat4 mat = CreateIdentity();
-
-//   mat.Set(0, 0, 2.0 / (right - left));
-//   mat.Set(1, 1, 2.0 / (top - bottom));
-//   mat.Set(2, 2, 2.0 / (near - far));
-//   mat.Set(3, 0, (left + right) / (left - right));
-//   mat.Set(3, 1, (top + bottom) / (bottom - top));
-//   mat.Set(3, 2, (near + far) / (far - near));
-
-//   return mat;
-// }
-
-// auto Mat4::CreateTranslate(const Vec &pos) -> Mat4 {
-//   Mat4 mat = CreateIdentity();
-
-//   mat.Set(3, 0, pos.x);
-//   mat.Set(3, 1, pos.y);
-
-//   return mat;
-// }
-
-// auto Mat4::CreateScale(const Vec &scale) -> Mat4 {
-//   Mat4 mat = CreateIdentity();
-
-//   mat.Set(0, 0, scale.x);
-//   mat.Set(1, 1, scale.y);
-
-//   return mat;
-// }
-
-// Mat4 Mat4::Mul(const Mat4 &m) const {
-//   Mat4 mat;
-//   for (int i = 0; i < 4; i++) {
-//     for (int j = 0; j < 4; j++) {
-//       int sum = 0;
-//       for (int k = 0; k < 4; k++) {
-//         sum += Get(k, i) * m.Get(j, k);
-//       }
-//       mat.Set(j, i, sum);
-//     }
-//   }
-//   return mat;
-// }
-
-} // namespace app
\ No newline at end of file
+static_assert(sizeof(Mat4) == sizeof(glm::mat4),
+    "Mat4 must match glm::mat4 layout");
+
+namespace {
+
+#ifndef APP_SIMD_SSE2
+void mulMat4Scalar(const float *a, const float *b, float *out) {
+  float r[16];
+  for (int col = 0; col < 4; ++col) {
+    for (int row = 0; row < 4; ++row) {
+      r[col * 4 + row] = a[row] * b[col * 4] +
+                         a[4 + row] * b[col * 4 + 1] +
+                         a[8 + row] * b[col * 4 + 2] +
+                         a[12 + row] * b[col * 4 + 3];
+    }
+  }
+  std::memcpy(out, r, sizeof(r));
+}
+#endif
+
+#ifdef APP_SIMD_SSE2
+// a 的列已经在寄存器里：out 的第 j 列 = sum_k a[k] * b[j][k]
+// 四列都算完再写，out 与 b 相同也没问题
+inline void mulMat4Sse(const __m128 a[4], const float *b, float *out) {
+  __m128 r[4];
+  for (int col = 0; col < 4; ++col) {
+    const float *c = b + col * 4;
+    r[col] = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(a[0], _mm_set1_ps(c[0])),
+            _mm_mul_ps(a[1], _mm_set1_ps(c[1]))),
+        _mm_add_ps(_mm_mul_ps(a[2], _mm_set1_ps(c[2])),
+            _mm_mul_ps(a[3], _mm_set1_ps(c[3]))));
+  }
+  for (int col = 0; col < 4; ++col) {
+    _mm_storeu_ps(out + col * 4, r[col]);
+  }
+}
+
+inline void loadColumns(const float *a, __m128 cols[4]) {
+  for (int col = 0; col < 4; ++col) {
+    cols[col] = _mm_loadu_ps(a + col * 4);
+  }
+}
+#endif
+
+#ifdef APP_SIMD_AVX2
+inline auto fmadd(__m256 a, __m256 b, __m256 c) -> __m256 {
+  return _mm256_fmadd_ps(a, b, c);
+}
+
+// 一次算两列：a 的每一列复制到高低两半，
+// b 的两列分别在高低两半里广播第 k 个元素
+inline void mulMat4Avx(const __m256 a[4], const float *b, float *out) {
+  const __m256 b01 = _mm256_loadu_ps(b);
+  const __m256 b23 = _mm256_loadu_ps(b + 8);
+  __m256 r01 = _mm256_mul_ps(a[0], _mm256_shuffle_ps(b01, b01, 0x00));
+  __m256 r23 = _mm256_mul_ps(a[0], _mm256_shuffle_ps(b23, b23, 0x00));
+  r01 = fmadd(a[1], _mm256_shuffle_ps(b01, b01, 0x55), r01);
+  r23 = fmadd(a[1], _mm256_shuffle_ps(b23, b23, 0x55), r23);
+  r01 = fmadd(a[2], _mm256_shuffle_ps(b01, b01, 0xAA), r01);
+  r23 = fmadd(a[2], _mm256_shuffle_ps(b23, b23, 0xAA), r23);
+  r01 = fmadd(a[3], _mm256_shuffle_ps(b01, b01, 0xFF), r01);
+  r23 = fmadd(a[3], _mm256_shuffle_ps(b23, b23, 0xFF), r23);
+  _mm256_storeu_ps(out, r01);
+  _mm256_storeu_ps(out + 8, r23);
+}
+
+inline void loadColumnsTwice(const float *a, __m256 cols[4]) {
+  for (int col = 0; col < 4; ++col) {
+    cols[col] = _mm256_broadcast_ps(
+        reinterpret_cast<const __m128 *>(a + col * 4));
+  }
+}
+#endif
+
+// 单个元素的 T * R * S，按列写出
+void composeTrsScalar(const TrsSoaView &in, size_t i, float *out) {
+  const float x = in.qx[i], y = in.qy[i], z = in.qz[i], w = in.qw[i];
+  const float sx = in.sx ? in.sx[i] : 1.0f;
+  const float sy = in.sy ? in.sy[i] : 1.0f;
+  const float sz = in.sz ? in.sz[i] : 1.0f;
+  const float xx = x * x, yy = y * y, zz = z * z;
+  const float xy = x * y, xz = x * z, yz = y * z;
+  const float wx = w * x, wy = w * y, wz = w * z;
+  const float m[16] = {
+      (1.0f - 2.0f * (yy + zz)) * sx, 2.0f * (xy + wz) * sx,
+      2.0f * (xz - wy) * sx, 0.0f,
+      2.0f * (xy - wz) * sy, (1.0f - 2.0f * (xx + zz)) * sy,
+      2.0f * (yz + wx) * sy, 0.0f,
+      2.0f * (xz + wy) * sz, 2.0f * (yz - wx) * sz,
+      (1.0f - 2.0f * (xx + yy)) * sz, 0.0f,
+      in.tx ? in.tx[i] : 0.0f, in.ty ? in.ty[i] : 0.0f,
+      in.tz ? in.tz[i] : 0.0f, 1.0f};
+  std::memcpy(out, m, sizeof(m));
+}
+
+} // namespace
+
+auto Mat4::Identity() -> Mat4 {
+  return {{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1}};
+}
+
+void MulMat4(const Mat4 &a, const Mat4 &b, Mat4 &out) {
+#ifdef APP_SIMD_SSE2
+  __m128 cols[4];
+  loadColumns(a.m, cols);
+  mulMat4Sse(cols, b.m, out.m);
+#else
+  mulMat4Scalar(a.m, b.m, out.m);
+#endif
+}
+
+void MulMat4Batch(
+    const Mat4 &lhs, const Mat4 *rhs, Mat4 *out, size_t count) {
+#if defined(APP_SIMD_AVX2)
+  __m256 cols[4];
+  loadColumnsTwice(lhs.m, cols);
+  for (size_t i = 0; i < count; ++i) {
+    mulMat4Avx(cols, rhs[i].m, out[i].m);
+  }
+#elif defined(APP_SIMD_SSE2)
+  // lhs 的列只加载一次
+  __m128 cols[4];
+  loadColumns(lhs.m, cols);
+  for (size_t i = 0; i < count; ++i) {
+    mulMat4Sse(cols, rhs[i].m, out[i].m);
+  }
+#else
+  for (size_t i = 0; i < count; ++i) {
+    mulMat4Scalar(lhs.m, rhs[i].m, out[i].m);
+  }
+#endif
+}
+
+void MulMat4Pairs(
+    const Mat4 *a, const Mat4 *b, Mat4 *out, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+#if defined(APP_SIMD_AVX2)
+    __m256 cols[4];
+    loadColumnsTwice(a[i].m, cols);
+    mulMat4Avx(cols, b[i].m, out[i].m);
+#elif defined(APP_SIMD_SSE2)
+    __m128 cols[4];
+    loadColumns(a[i].m, cols);
+    mulMat4Sse(cols, b[i].m, out[i].m);
+#else
+    mulMat4Scalar(a[i].m, b[i].m, out[i].m);
+#endif
+  }
+}
+
+void TransformBatch(const Mat4 &mat, const Vec4SoaView &in,
+    const Vec4SoaSpan &out, size_t count) {
+  const float *m = mat.m;
+  size_t i = 0;
+#if defined(APP_SIMD_AVX2)
+  __m256 c[16];
+  for (int k = 0; k < 16; ++k) {
+    c[k] = _mm256_set1_ps(m[k]);
+  }
+  const __m256 one = _mm256_set1_ps(1.0f);
+  for (; i + 8 <= count; i += 8) {
+    const __m256 x = _mm256_loadu_ps(in.x + i);
+    const __m256 y = _mm256_loadu_ps(in.y + i);
+    const __m256 z = _mm256_loadu_ps(in.z + i);
+    const __m256 w = in.w ? _mm256_loadu_ps(in.w + i) : one;
+    float *dst[4] = {out.x, out.y, out.z, out.w};
+    for (int row = 0; row < 4; ++row) {
+      if (!dst[row]) {
+        continue;
+      }
+      __m256 r = _mm256_mul_ps(c[row], x);
+      r = fmadd(c[4 + row], y, r);
+      r = fmadd(c[8 + row], z, r);
+      r = fmadd(c[12 + row], w, r);
+      _mm256_storeu_ps(dst[row] + i, r);
+    }
+  }
+#elif defined(APP_SIMD_SSE2)
+  __m128 c[16];
+  for (int k = 0; k < 16; ++k) {
+    c[k] = _mm_set1_ps(m[k]);
+  }
+  const __m128 one = _mm_set1_ps(1.0f);
+  for (; i + 4 <= count; i += 4) {
+    const __m128 x = _mm_loadu_ps(in.x + i);
+    const __m128 y = _mm_loadu_ps(in.y + i);
+    const __m128 z = _mm_loadu_ps(in.z + i);
+    const __m128 w = in.w ? _mm_loadu_ps(in.w + i) : one;
+    float *dst[4] = {out.x, out.y, out.z, out.w};
+    for (int row = 0; row < 4; ++row) {
+      if (!dst[row]) {
+        continue;
+      }
+      const __m128 r = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(c[row], x), _mm_mul_ps(c[4 + row], y)),
+          _mm_add_ps(
+              _mm_mul_ps(c[8 + row], z), _mm_mul_ps(c[12 + row], w)));
+      _mm_storeu_ps(dst[row] + i, r);
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    const float x = in.x[i], y = in.y[i], z = in.z[i];
+    const float w = in.w ? in.w[i] : 1.0f;
+    float *dst[4] = {out.x, out.y, out.z, out.w};
+    for (int row = 0; row < 4; ++row) {
+      if (dst[row]) {
+        dst[row][i] = m[row] * x + m[4 + row] * y + m[8 + row] * z +
+                      m[12 + row] * w;
+      }
+    }
+  }
+}
+
+auto QuatToMat4(const Quat &q) -> Mat4 {
+  TrsSoaView view;
+  view.qx = &q.x;
+  view.qy = &q.y;
+  view.qz = &q.z;
+  view.qw = &q.w;
+  Mat4 out;
+  composeTrsScalar(view, 0, out.m);
+  return out;
+}
+
+void ComposeTrsBatch(const TrsSoaView &in, Mat4 *out, size_t count) {
+  size_t i = 0;
+#ifdef APP_SIMD_SSE2
+  // 4 个元素一组：每列的 xyzw 分量各占一个寄存器，
+  // 转置后正好是 4 个矩阵的同一列
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f);
+  const __m128 zero = _mm_setzero_ps();
+  auto load = [&](const float *p, __m128 fallback) {
+    return p ? _mm_loadu_ps(p + i) : fallback;
+  };
+  for (; i + 4 <= count; i += 4) {
+    const __m128 x = _mm_loadu_ps(in.qx + i);
+    const __m128 y = _mm_loadu_ps(in.qy + i);
+    const __m128 z = _mm_loadu_ps(in.qz + i);
+    const __m128 w = _mm_loadu_ps(in.qw + i);
+    const __m128 sx = load(in.sx, one);
+    const __m128 sy = load(in.sy, one);
+    const __m128 sz = load(in.sz, one);
+    const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y),
+                 zz = _mm_mul_ps(z, z);
+    const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z),
+                 yz = _mm_mul_ps(y, z);
+    const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y),
+                 wz = _mm_mul_ps(w, z);
+
+    __m128 cols[4][4] = {
+        {_mm_mul_ps(_mm_sub_ps(one,
+                        _mm_mul_ps(two, _mm_add_ps(yy, zz))),
+             sx),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx), zero},
+        {_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+            _mm_mul_ps(_mm_sub_ps(one,
+                           _mm_mul_ps(two, _mm_add_ps(xx, zz))),
+                sy),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy), zero},
+        {_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+            _mm_mul_ps(_mm_sub_ps(one,
+                           _mm_mul_ps(two, _mm_add_ps(xx, yy))),
+                sz),
+            zero},
+        {load(in.tx, zero), load(in.ty, zero), load(in.tz, zero), one},
+    };
+    for (int col = 0; col < 4; ++col) {
+      auto &c = cols[col];
+      _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+      for (int lane = 0; lane < 4; ++lane) {
+        _mm_storeu_ps(out[i + lane].m + col * 4, c[lane]);
+      }
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    composeTrsScalar(in, i, out[i].m);
+  }
+}
+
+auto SimdLevel() -> const char * {
+#if defined(APP_SIMD_AVX2)
+  return "AVX2";
+#elif defined(APP_SIMD_SSE2)
+  return "SSE2";
+#else
+  return "scalar";
+#endif
+}
+
+namespace {
+
+template <typename F>
+auto measureNs(uint32_t rounds, size_t count, F &&func) -> double {
+  const auto begin = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; ++r) {
+    func();
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - begin).count() /
+         (double(rounds) * double(count));
+}
+
+auto maxError(const float *a, const float *b, size_t n) -> float {
+  float error = 0.0f;
+  for (size_t i = 0; i < n; ++i) {
+    error = std::max(error, std::abs(a[i] - b[i]));
+  }
+  return error;
+}
+
+void report(const char *name, double glmNs, double simdNs, float error) {
+  std::cout << "  " << name << ": glm " << glmNs << " ns, simd "
+            << simdNs << " ns (" << glmNs / simdNs << "x, max error "
+            << error << ")\n";
+}
+
+} // namespace
+
+void BenchmarkMath(uint32_t count) {
+  // parent * local 需要至少两个
+  count = std::max(count, 2u);
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  const uint32_t rounds = std::max(1u, 20'000'000u / std::max(count, 1u));
+  volatile float sink = 0.0f;
+
+  // 随机 TRS 场景
+  std::vector<float> t[3], q[4], s[3];
+  for (auto &a : t) {
+    a.resize(count);
+  }
+  for (auto &a : q) {
+    a.resize(count);
+  }
+  for (auto &a : s) {
+    a.resize(count);
+  }
+  std::vector<glm::mat4> glmModels(count), glmOut(count);
+  std::vector<glm::quat> glmQuats(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    glm::quat quat = glm::normalize(
+        glm::quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+    glmQuats[i] = quat;
+    q[0][i] = quat.x;
+    q[1][i] = quat.y;
+    q[2][i] = quat.z;
+    q[3][i] = quat.w;
+    for (int k = 0; k < 3; ++k) {
+      t[k][i] = dist(rng) * 10.0f;
+      s[k][i] = 0.5f + std::abs(dist(rng));
+    }
+  }
+  TrsSoaView trs;
+  trs.tx = t[0].data();
+  trs.ty = t[1].data();
+  trs.tz = t[2].data();
+  trs.qx = q[0].data();
+  trs.qy = q[1].data();
+  trs.qz = q[2].data();
+  trs.qw = q[3].data();
+  trs.sx = s[0].data();
+  trs.sy = s[1].data();
+  trs.sz = s[2].data();
+  std::vector<Mat4> models(count), out(count);
+
+  std::cout << "math benchmark : " << count << " objects, " << SimdLevel()
+            << ", ns per object\n";
+
+  const double glmTrs = measureNs(rounds, count, [&] {
+    for (uint32_t i = 0; i < count; ++i) {
+      glmModels[i] =
+          glm::translate(glm::mat4(1.0f),
+              glm::vec3(t[0][i], t[1][i], t[2][i])) *
+          glm::mat4_cast(glmQuats[i]) *
+          glm::scale(glm::mat4(1.0f), glm::vec3(s[0][i], s[1][i], s[2][i]));
+    }
+    sink = sink + glmModels[count - 1][3][0];
+  });
+  const double simdTrs = measureNs(rounds, count, [&] {
+    ComposeTrsBatch(trs, models.data(), count);
+    sink = sink + models[count - 1].m[12];
+  });
+  report("T * R * S     ", glmTrs, simdTrs,
+      maxError(&glmModels[0][0][0], models[0].m, size_t(count) * 16));
+
+  const glm::mat4 viewProj =
+      glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f) *
+      glm::lookAt(glm::vec3(0.0f, 5.0f, 20.0f), glm::vec3(0.0f),
+          glm::vec3(0.0f, 1.0f, 0.0f));
+  const Mat4 vp = FromGlm(viewProj);
+  const double glmMvp = measureNs(rounds, count, [&] {
+    for (uint32_t i = 0; i < count; ++i) {
+      glmOut[i] = viewProj * glmModels[i];
+    }
+    sink = sink + glmOut[count - 1][3][0];
+  });
+  const double simdMvp = measureNs(rounds, count, [&] {
+    MulMat4Batch(vp, models.data(), out.data(), count);
+    sink = sink + out[count - 1].m[12];
+  });
+  report("viewProj * M  ", glmMvp, simdMvp,
+      maxError(&glmOut[0][0][0], out[0].m, size_t(count) * 16));
+
+  const double glmPairs = measureNs(rounds, count, [&] {
+    for (uint32_t i = 1; i < count; ++i) {
+      glmOut[i] = glmModels[i - 1] * glmModels[i];
+    }
+    sink = sink + glmOut[count - 1][3][0];
+  });
+  const double simdPairs = measureNs(rounds, count, [&] {
+    MulMat4Pairs(models.data(), models.data() + 1, out.data() + 1,
+        count - 1);
+    sink = sink + out[count - 1].m[12];
+  });
+  report("parent * local", glmPairs, simdPairs,
+      maxError(&glmOut[1][0][0], out[1].m, size_t(count - 1) * 16));
+
+  // 点变换：glm 用 AoS 的 vec4，内核用 SoA
+  std::vector<glm::vec4> glmPoints(count), glmClip(count);
+  std::vector<float> clip[4];
+  for (auto &a : clip) {
+    a.resize(count);
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    glmPoints[i] = glm::vec4(t[0][i], t[1][i], t[2][i], 1.0f);
+  }
+  const double glmPoint = measureNs(rounds, count, [&] {
+    for (uint32_t i = 0; i < count; ++i) {
+      glmClip[i] = viewProj * glmPoints[i];
+    }
+    sink = sink + glmClip[count - 1].w;
+  });
+  Vec4SoaView points;
+  points.x = t[0].data();
+  points.y = t[1].data();
+  points.z = t[2].data();
+  const Vec4SoaSpan clipSpan{
+      clip[0].data(), clip[1].data(), clip[2].data(), clip[3].data()};
+  const double simdPoint = measureNs(rounds, count, [&] {
+    TransformBatch(vp, points, clipSpan, count);
+    sink = sink + clip[3][count - 1];
+  });
+  float pointError = 0.0f;
+  for (uint32_t i = 0; i < count; ++i) {
+    for (int k = 0; k < 4; ++k) {
+      pointError =
+          std::max(pointError, std::abs(glmClip[i][k] - clip[k][i]));
+    }
+  }
+  report("viewProj * p  ", glmPoint, simdPoint, pointError);
+}
+
+} // namespace app
@@ -0,0 +1,61 @@
+#include "../header/pipelineStats.h"
+#include "../header/application.h"
+
+namespace app {
+
+PipelineStats::PipelineStats(uint32_t frameCount)
+    : recorded_(frameCount, false) {
+  auto &app = Application::GetInstance();
+  // 与 createDevice 中的开启条件一致
+  supported_ = app.phyDevice.getFeatures().pipelineStatisticsQuery;
+  if (!supported_) {
+    return;
+  }
+  vk::QueryPoolCreateInfo info;
+  info.setQueryType(vk::QueryType::ePipelineStatistics)
+      .setPipelineStatistics(vk::QueryPipelineStatisticFlagBits::
+              eFragmentShaderInvocations)
+      .setQueryCount(frameCount);
+  pool_ = app.device.createQueryPool(info);
+}
+
+PipelineStats::~PipelineStats() {
+  if (pool_) {
+    Application::GetInstance().device.destroyQueryPool(pool_);
+  }
+}
+
+void PipelineStats::Begin(vk::CommandBuffer cmdBuf, uint32_t frame) {
+  if (!supported_) {
+    return;
+  }
+  cmdBuf.resetQueryPool(pool_, frame, 1);
+  cmdBuf.beginQuery(pool_, frame, {});
+}
+
+void PipelineStats::End(vk::CommandBuffer cmdBuf, uint32_t frame) {
+  if (!supported_) {
+    return;
+  }
+  cmdBuf.endQuery(pool_, frame);
+  recorded_[frame] = true;
+}
+
+auto PipelineStats::FragmentInvocations(uint32_t frame)
+    -> std::optional<uint64_t> {
+  if (!supported_ || !recorded_[frame]) {
+    return std::nullopt;
+  }
+  recorded_[frame] = false;
+  uint64_t count = 0;
+  auto result =
+      Application::GetInstance().device.getQueryPoolResults(pool_,
+          frame, 1, sizeof(count), &count, sizeof(uint64_t),
+          vk::QueryResultFlagBits::e64);
+  if (result != vk::Result::eSuccess) {
+    return std::nullopt;
+  }
+  return count;
+}
+
+} // namespace app
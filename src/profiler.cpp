@@ -0,0 +1,62 @@
+#include "../header/profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+namespace app {
+
+StartupProfiler::StartupProfiler()
+    : start_(Clock::now()),
+      mainThread_(std::this_thread::get_id()) {}
+
+auto StartupProfiler::sinceStart(Clock::time_point t) const
+    -> double {
+  return std::chrono::duration<double, std::milli>(
+      t - start_)
+      .count();
+}
+
+void StartupProfiler::Record(const std::string &name,
+    Clock::time_point begin, Clock::time_point end) {
+  std::lock_guard lock(mutex_);
+  phases_.push_back({name, sinceStart(begin),
+      sinceStart(end),
+      std::this_thread::get_id() != mainThread_});
+}
+
+void StartupProfiler::MarkFirstFrame() {
+  {
+    std::lock_guard lock(mutex_);
+    if (firstFrameMs_ > 0) {
+      return;
+    }
+    firstFrameMs_ = sinceStart(Clock::now());
+  }
+  Report();
+}
+
+void StartupProfiler::Report() const {
+  std::lock_guard lock(mutex_);
+  auto phases = phases_;
+  std::sort(phases.begin(), phases.end(),
+      [](const Phase &a, const Phase &b) {
+        return a.beginMs < b.beginMs;
+      });
+
+  std::cout << "Startup ---------------------\n";
+  char line[128];
+  for (const auto &phase : phases) {
+    // * 表示在后台线程执行，与主线程重叠
+    std::snprintf(line, sizeof(line),
+        "%c %-22s %8.2f ms  [%8.2f - %8.2f]\n",
+        phase.background ? '*' : ' ', phase.name.c_str(),
+        phase.endMs - phase.beginMs, phase.beginMs,
+        phase.endMs);
+    std::cout << line;
+  }
+  std::snprintf(line, sizeof(line),
+      "  %-22s %8.2f ms\n", "first frame", firstFrameMs_);
+  std::cout << line;
+}
+
+} // namespace app
\ No newline at end of file
@@ -0,0 +1,604 @@
+#include "../header/renderGraph.h"
+#include "../header/application.h"
+#include <algorithm>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+
+namespace app {
+
+namespace {
+
+auto stateFor(RenderGraph::Access access) -> ResourceState {
+  using Access = RenderGraph::Access;
+  using Stage = vk::PipelineStageFlagBits2;
+  using Bits = vk::AccessFlagBits2;
+  switch (access) {
+  case Access::ColorAttachment:
+    return {Stage::eColorAttachmentOutput,
+        Bits::eColorAttachmentRead | Bits::eColorAttachmentWrite,
+        vk::ImageLayout::eColorAttachmentOptimal};
+  case Access::DepthAttachment:
+    return {Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+        Bits::eDepthStencilAttachmentRead |
+            Bits::eDepthStencilAttachmentWrite,
+        vk::ImageLayout::eDepthStencilAttachmentOptimal};
+  case Access::DepthRead:
+    return {Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+        Bits::eDepthStencilAttachmentRead,
+        vk::ImageLayout::eDepthStencilReadOnlyOptimal};
+  case Access::Sampled:
+    return {Stage::eFragmentShader | Stage::eComputeShader,
+        Bits::eShaderSampledRead,
+        vk::ImageLayout::eShaderReadOnlyOptimal};
+  case Access::StorageRead:
+    return {Stage::eComputeShader, Bits::eShaderStorageRead,
+        vk::ImageLayout::eGeneral};
+  case Access::StorageWrite:
+    return {Stage::eComputeShader,
+        Bits::eShaderStorageRead | Bits::eShaderStorageWrite,
+        vk::ImageLayout::eGeneral};
+  case Access::TransferSrc:
+    return ResourceState::TransferSrc();
+  case Access::TransferDst:
+    return ResourceState::TransferDst();
+  case Access::IndirectRead:
+    return {Stage::eDrawIndirect, Bits::eIndirectCommandRead,
+        vk::ImageLayout::eUndefined};
+  case Access::VertexRead:
+    return {Stage::eVertexAttributeInput,
+        Bits::eVertexAttributeRead | Bits::eIndexRead,
+        vk::ImageLayout::eUndefined};
+  }
+  return {};
+}
+
+auto usageFor(RenderGraph::Access access) -> vk::ImageUsageFlags {
+  using Access = RenderGraph::Access;
+  using Usage = vk::ImageUsageFlagBits;
+  switch (access) {
+  case Access::ColorAttachment:
+    return Usage::eColorAttachment;
+  case Access::DepthAttachment:
+  case Access::DepthRead:
+    return Usage::eDepthStencilAttachment;
+  case Access::Sampled:
+    return Usage::eSampled;
+  case Access::StorageRead:
+  case Access::StorageWrite:
+    return Usage::eStorage;
+  case Access::TransferSrc:
+    return Usage::eTransferSrc;
+  case Access::TransferDst:
+    return Usage::eTransferDst;
+  default:
+    return {};
+  }
+}
+
+// 只作附件的用法才能加 TRANSIENT_ATTACHMENT
+auto attachmentOnly(vk::ImageUsageFlags usage) -> bool {
+  constexpr vk::ImageUsageFlags attachments =
+      vk::ImageUsageFlagBits::eColorAttachment |
+      vk::ImageUsageFlagBits::eDepthStencilAttachment |
+      vk::ImageUsageFlagBits::eInputAttachment;
+  return usage && !(usage & ~attachments);
+}
+
+// 桌面 GPU 一般没有 lazily allocated 内存
+auto lazyMemoryType(uint32_t typeBits) -> std::optional<uint32_t> {
+  auto props =
+      Application::GetInstance().phyDevice.getMemoryProperties();
+  for (uint32_t i = 0; i < props.memoryTypeCount; ++i) {
+    if ((typeBits & (1u << i)) &&
+        (props.memoryTypes[i].propertyFlags &
+            vk::MemoryPropertyFlagBits::eLazilyAllocated)) {
+      return i;
+    }
+  }
+  return std::nullopt;
+}
+
+} // namespace
+
+auto RenderGraph::PassBuilder::Create(const std::string &name,
+    const TextureDesc &desc) -> ResourceId {
+  Resource resource;
+  resource.name = name;
+  resource.desc = desc;
+  graph_.resources_.push_back(resource);
+  const auto id =
+      static_cast<ResourceId>(graph_.resources_.size() - 1);
+  graph_.passes_[pass_].creates.push_back(id);
+  return id;
+}
+
+void RenderGraph::PassBuilder::Read(ResourceId id, Access access) {
+  graph_.passes_[pass_].uses.push_back({id, access, false});
+}
+
+void RenderGraph::PassBuilder::Write(ResourceId id, Access access) {
+  graph_.passes_[pass_].uses.push_back({id, access, true});
+}
+
+void RenderGraph::PassBuilder::SideEffect() {
+  graph_.passes_[pass_].sideEffect = true;
+}
+
+auto RenderGraph::Resources::Image(ResourceId id) const
+    -> vk::Image {
+  return graph_.resources_[id].image;
+}
+
+auto RenderGraph::Resources::View(ResourceId id) const
+    -> vk::ImageView {
+  return graph_.resources_[id].view;
+}
+
+auto RenderGraph::Resources::SampledView(ResourceId id) const
+    -> vk::ImageView {
+  const auto &resource = graph_.resources_[id];
+  return resource.sampledView ? resource.sampledView : resource.view;
+}
+
+auto RenderGraph::Resources::Buffer(ResourceId id) const
+    -> vk::Buffer {
+  return graph_.resources_[id].buffer;
+}
+
+auto RenderGraph::Resources::Desc(ResourceId id) const
+    -> const TextureDesc & {
+  return graph_.resources_[id].desc;
+}
+
+RenderGraph::~RenderGraph() {
+  Reset();
+}
+
+auto RenderGraph::ImportImage(const std::string &name,
+    const TextureDesc &desc, const ResourceState &initial,
+    const ResourceState &final) -> ResourceId {
+  Resource resource;
+  resource.name = name;
+  resource.imported = true;
+  resource.desc = desc;
+  resource.initial = initial;
+  resource.final = final;
+  resources_.push_back(resource);
+  return static_cast<ResourceId>(resources_.size() - 1);
+}
+
+auto RenderGraph::ImportBuffer(const std::string &name,
+    const ResourceState &initial, const ResourceState &final)
+    -> ResourceId {
+  Resource resource;
+  resource.name = name;
+  resource.imported = true;
+  resource.isBuffer = true;
+  resource.initial = initial;
+  resource.final = final;
+  resources_.push_back(resource);
+  return static_cast<ResourceId>(resources_.size() - 1);
+}
+
+void RenderGraph::SetImported(
+    ResourceId id, vk::Image image, vk::ImageView view) {
+  resources_[id].image = image;
+  resources_[id].view = view;
+}
+
+void RenderGraph::SetImported(ResourceId id, vk::Buffer buffer) {
+  resources_[id].buffer = buffer;
+}
+
+auto RenderGraph::AddPass(const std::string &name,
+    const SetupFunc &setup, ExecuteFunc execute) -> PassId {
+  if (compiled_) {
+    throw std::runtime_error("render graph already compiled");
+  }
+  Pass pass;
+  pass.name = name;
+  pass.execute = std::move(execute);
+  passes_.push_back(std::move(pass));
+  const auto id = static_cast<PassId>(passes_.size() - 1);
+  PassBuilder builder(*this, id);
+  setup(builder);
+  return id;
+}
+
+void RenderGraph::Compile() {
+  validate();
+  cull();
+  computeLifetimes();
+  allocateTransients();
+  planTransitions();
+  compiled_ = true;
+}
+
+void RenderGraph::validate() const {
+  // 同一 pass 的两次声明会在一个 pipelineBarrier2 里生成
+  // 两个顺序未定义的屏障，需要的状态应合并成一次声明
+  for (const auto &pass : passes_) {
+    for (size_t i = 0; i < pass.uses.size(); ++i) {
+      for (size_t j = i + 1; j < pass.uses.size(); ++j) {
+        if (pass.uses[i].id == pass.uses[j].id) {
+          throw std::runtime_error("render graph : " + pass.name +
+                                   " declares " +
+                                   resources_[pass.uses[i].id].name +
+                                   " more than once");
+        }
+      }
+    }
+  }
+}
+
+void RenderGraph::cull() {
+  // 从后往前：导入资源在图外可见，写它们的 pass 必须保留；
+  // 保留的 pass 读到的资源，最近一次写它的 pass 也要保留
+  std::vector<bool> needed(resources_.size(), false);
+  for (size_t i = 0; i < resources_.size(); ++i) {
+    needed[i] = resources_[i].imported;
+  }
+  for (size_t p = passes_.size(); p > 0; --p) {
+    auto &pass = passes_[p - 1];
+    pass.alive = pass.sideEffect;
+    for (const auto &use : pass.uses) {
+      pass.alive |= use.write && needed[use.id];
+    }
+    if (!pass.alive) {
+      continue;
+    }
+    for (const auto &use : pass.uses) {
+      if (use.write && !resources_[use.id].imported) {
+        needed[use.id] = false;
+      }
+    }
+    for (const auto &use : pass.uses) {
+      if (!use.write) {
+        needed[use.id] = true;
+      }
+    }
+  }
+
+  // 声明顺序就是合法的拓扑序：资源只能在创建之后被引用
+  order_.clear();
+  stats_ = Stats{};
+  for (PassId p = 0; p < passes_.size(); ++p) {
+    if (passes_[p].alive) {
+      order_.push_back(p);
+    } else {
+      stats_.culled++;
+    }
+  }
+  stats_.passes = static_cast<uint32_t>(order_.size());
+}
+
+void RenderGraph::computeLifetimes() {
+  std::vector<bool> written(resources_.size(), false);
+  for (uint32_t i = 0; i < order_.size(); ++i) {
+    const auto &pass = passes_[order_[i]];
+    for (const auto &use : pass.uses) {
+      auto &resource = resources_[use.id];
+      if (!use.write && !resource.imported && !written[use.id]) {
+        throw std::runtime_error("render graph : " + pass.name +
+                                 " reads " + resource.name +
+                                 " before it is written");
+      }
+      written[use.id] = written[use.id] || use.write;
+      resource.firstPass = std::min(resource.firstPass, i);
+      resource.lastPass = std::max(resource.lastPass, i);
+      resource.usage |= usageFor(use.access);
+    }
+  }
+}
+
+void RenderGraph::allocateTransients() {
+  auto &device = Application::GetInstance().device;
+
+  std::vector<ResourceId> transients;
+  for (ResourceId id = 0; id < resources_.size(); ++id) {
+    auto &resource = resources_[id];
+    if (resource.imported || resource.firstPass == ~0u) {
+      // 被剔除的 pass 创建的资源不分配
+      continue;
+    }
+    const auto &desc = resource.desc;
+    if (desc.memoryless && attachmentOnly(resource.usage)) {
+      resource.usage |= vk::ImageUsageFlagBits::eTransientAttachment;
+    }
+    vk::ImageCreateInfo createInfo;
+    createInfo.setImageType(vk::ImageType::e2D)
+        .setArrayLayers(1)
+        .setMipLevels(1)
+        .setExtent({desc.extent.width, desc.extent.height, 1})
+        .setFormat(desc.format)
+        .setTiling(vk::ImageTiling::eOptimal)
+        .setInitialLayout(vk::ImageLayout::eUndefined)
+        .setUsage(resource.usage)
+        .setSamples(desc.samples);
+    resource.image = device.createImage(createInfo);
+    transients.push_back(id);
+  }
+
+  // 大的先放，生命周期不重叠的资源共用同一块
+  std::vector<vk::MemoryRequirements> requirements(resources_.size());
+  for (auto id : transients) {
+    requirements[id] =
+        device.getImageMemoryRequirements(resources_[id].image);
+    stats_.transientBytes += requirements[id].size;
+  }
+  std::stable_sort(transients.begin(), transients.end(),
+      [&](ResourceId a, ResourceId b) {
+        return requirements[a].size > requirements[b].size;
+      });
+  for (auto id : transients) {
+    auto &resource = resources_[id];
+    const auto &req = requirements[id];
+    // lazily allocated 的内存只放同样 memoryless 的资源
+    const bool lazy =
+        (resource.usage &
+            vk::ImageUsageFlagBits::eTransientAttachment) &&
+        lazyMemoryType(req.memoryTypeBits).has_value();
+    int32_t chosen = -1;
+    for (size_t b = 0; b < blocks_.size() && chosen < 0; ++b) {
+      auto &block = blocks_[b];
+      if ((block.typeBits & req.memoryTypeBits) == 0 ||
+          block.lazy != lazy ||
+          (lazy && !lazyMemoryType(block.typeBits &
+                                   req.memoryTypeBits))) {
+        continue;
+      }
+      const bool overlaps = std::any_of(block.residents.begin(),
+          block.residents.end(), [&](ResourceId other) {
+            const auto &o = resources_[other];
+            return resource.firstPass <= o.lastPass &&
+                   o.firstPass <= resource.lastPass;
+          });
+      if (!overlaps) {
+        chosen = static_cast<int32_t>(b);
+      }
+    }
+    if (chosen < 0) {
+      blocks_.emplace_back();
+      blocks_.back().lazy = lazy;
+      chosen = static_cast<int32_t>(blocks_.size() - 1);
+    }
+    auto &block = blocks_[chosen];
+    block.size = std::max(block.size, req.size);
+    block.typeBits &= req.memoryTypeBits;
+    block.residents.push_back(id);
+    resource.block = chosen;
+  }
+
+  for (auto &block : blocks_) {
+    vk::MemoryAllocateInfo allocInfo;
+    allocInfo.setAllocationSize(block.size)
+        .setMemoryTypeIndex(block.lazy
+                                ? *lazyMemoryType(block.typeBits)
+                                : QueryBufferMemTypeIndex(block.typeBits,
+                                      vk::MemoryPropertyFlagBits::
+                                          eDeviceLocal)
+                                      .value());
+    block.memory = device.allocateMemory(allocInfo);
+    stats_.allocatedBytes += block.size;
+    if (block.lazy) {
+      stats_.lazyBytes += block.size;
+    }
+    for (auto id : block.residents) {
+      auto &resource = resources_[id];
+      // 同一块内的资源都从偏移 0 开始，对齐要求自然满足
+      device.bindImageMemory(resource.image, block.memory, 0);
+
+      vk::ImageViewCreateInfo viewInfo;
+      viewInfo.setImage(resource.image)
+          .setViewType(vk::ImageViewType::e2D)
+          .setFormat(resource.desc.format)
+          .setSubresourceRange(
+              {resource.desc.aspect, 0, 1, 0, 1});
+      resource.view = device.createImageView(viewInfo);
+      // 采样时一个 view 只能有一个 aspect
+      const auto depthStencil = vk::ImageAspectFlagBits::eDepth |
+                                vk::ImageAspectFlagBits::eStencil;
+      if ((resource.usage & vk::ImageUsageFlagBits::eSampled) &&
+          (resource.desc.aspect & depthStencil) == depthStencil) {
+        viewInfo.setSubresourceRange(
+            {vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1});
+        resource.sampledView = device.createImageView(viewInfo);
+      }
+    }
+  }
+}
+
+void RenderGraph::planTransitions() {
+  // 临时图像每帧从 undefined 开始，但显存可能刚被
+  // 同一块的其他资源（或上一帧）用过，要等它们的写完成
+  std::vector<ResourceState> blockStates(blocks_.size());
+  for (const auto &pass : passes_) {
+    if (!pass.alive) {
+      continue;
+    }
+    for (const auto &use : pass.uses) {
+      const auto &resource = resources_[use.id];
+      if (resource.block >= 0) {
+        auto &state = blockStates[resource.block];
+        const auto next = stateFor(use.access);
+        state.stage |= next.stage;
+        state.access |= next.Writes();
+      }
+    }
+  }
+
+  std::vector<ResourceState> states(resources_.size());
+  for (ResourceId id = 0; id < resources_.size(); ++id) {
+    const auto &resource = resources_[id];
+    if (resource.imported) {
+      states[id] = resource.initial;
+    } else if (resource.block >= 0) {
+      states[id] = blockStates[resource.block];
+      states[id].layout = vk::ImageLayout::eUndefined;
+    }
+  }
+
+  transitions_.assign(order_.size(), {});
+  for (size_t i = 0; i < order_.size(); ++i) {
+    for (const auto &use : passes_[order_[i]].uses) {
+      auto next = stateFor(use.access);
+      auto &state = states[use.id];
+      if (resources_[use.id].isBuffer) {
+        next.layout = state.layout;
+      }
+      const ResourceState before = state;
+      if (NeedsBarrier(state, next)) {
+        transitions_[i].push_back({use.id, before, next});
+        state = next;
+      }
+    }
+    stats_.barriers += transitions_[i].size();
+  }
+
+  finalTransitions_.clear();
+  for (ResourceId id = 0; id < resources_.size(); ++id) {
+    const auto &resource = resources_[id];
+    if (!resource.imported) {
+      continue;
+    }
+    auto next = resource.final;
+    if (resource.isBuffer) {
+      next.layout = states[id].layout;
+    }
+    const ResourceState before = states[id];
+    if (NeedsBarrier(states[id], next)) {
+      finalTransitions_.push_back({id, before, next});
+    }
+  }
+  stats_.barriers += finalTransitions_.size();
+}
+
+void RenderGraph::recordTransitions(vk::CommandBuffer cmdBuf,
+    const std::vector<Transition> &transitions) const {
+  std::vector<vk::ImageMemoryBarrier2> images;
+  std::vector<vk::BufferMemoryBarrier2> buffers;
+  for (const auto &t : transitions) {
+    const auto &resource = resources_[t.id];
+    if (resource.isBuffer) {
+      if (!resource.buffer) {
+        continue;
+      }
+      vk::BufferMemoryBarrier2 barrier;
+      barrier.setBuffer(resource.buffer)
+          .setOffset(0)
+          .setSize(VK_WHOLE_SIZE)
+          .setSrcStageMask(t.src.stage)
+          .setSrcAccessMask(t.src.Writes())
+          .setDstStageMask(t.dst.stage)
+          .setDstAccessMask(t.dst.access)
+          .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+          .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+      buffers.push_back(barrier);
+      continue;
+    }
+    if (!resource.image) {
+      continue;
+    }
+    vk::ImageMemoryBarrier2 barrier;
+    barrier.setImage(resource.image)
+        .setSrcStageMask(t.src.stage)
+        .setSrcAccessMask(t.src.Writes())
+        .setDstStageMask(t.dst.stage)
+        .setDstAccessMask(t.dst.access)
+        .setOldLayout(t.src.layout)
+        .setNewLayout(t.dst.layout)
+        .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setSubresourceRange({resource.desc.aspect, 0,
+            VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS});
+    images.push_back(barrier);
+  }
+  if (images.empty() && buffers.empty()) {
+    return;
+  }
+  vk::DependencyInfo dependency;
+  dependency.setImageMemoryBarriers(images)
+      .setBufferMemoryBarriers(buffers);
+  cmdBuf.pipelineBarrier2(dependency);
+}
+
+void RenderGraph::Execute(vk::CommandBuffer cmdBuf) {
+  if (!compiled_) {
+    Compile();
+  }
+  const Resources resources(*this);
+  for (size_t i = 0; i < order_.size(); ++i) {
+    recordTransitions(cmdBuf, transitions_[i]);
+    auto &pass = passes_[order_[i]];
+    if (pass.execute) {
+      pass.execute(cmdBuf, resources);
+    }
+  }
+  recordTransitions(cmdBuf, finalTransitions_);
+}
+
+void RenderGraph::Reset() {
+  Release()();
+}
+
+auto RenderGraph::Release() -> std::function<void()> {
+  std::vector<vk::ImageView> views;
+  std::vector<vk::Image> images;
+  std::vector<vk::DeviceMemory> memories;
+  for (auto &resource : resources_) {
+    if (resource.imported) {
+      continue;
+    }
+    views.push_back(resource.view);
+    if (resource.sampledView) {
+      views.push_back(resource.sampledView);
+    }
+    images.push_back(resource.image);
+  }
+  for (auto &block : blocks_) {
+    memories.push_back(block.memory);
+  }
+  resources_.clear();
+  passes_.clear();
+  order_.clear();
+  transitions_.clear();
+  finalTransitions_.clear();
+  blocks_.clear();
+  compiled_ = false;
+  stats_ = Stats{};
+
+  return [views = std::move(views), images = std::move(images),
+             memories = std::move(memories)] {
+    auto &device = Application::GetInstance().device;
+    for (auto view : views) {
+      device.destroyImageView(view);
+    }
+    for (auto image : images) {
+      device.destroyImage(image);
+    }
+    for (auto memory : memories) {
+      device.freeMemory(memory);
+    }
+  };
+}
+
+void RenderGraph::PrintPlan() const {
+  std::cout << "render graph : " << stats_.passes << " passes, "
+            << stats_.culled << " culled, " << stats_.barriers
+            << " barriers, transient memory "
+            << stats_.transientBytes / 1024 << " KiB -> "
+            << stats_.allocatedBytes / 1024 << " KiB ("
+            << stats_.lazyBytes / 1024 << " KiB lazy)\n";
+  for (size_t i = 0; i < order_.size(); ++i) {
+    std::cout << "  " << passes_[order_[i]].name;
+    for (const auto &t : transitions_[i]) {
+      std::cout << " [" << resources_[t.id].name << ' '
+                << vk::to_string(t.src.layout) << "->"
+                << vk::to_string(t.dst.layout) << ']';
+    }
+    std::cout << '\n';
+  }
+}
+
+} // namespace app
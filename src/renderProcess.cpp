@@ -6,45 +6,85 @@ namespace app {
 
 RenderProcess::RenderProcess() {
   layout = createLayout();
-  renderPass = createRenderPass();
-  graphicsPipeline = nullptr;
+  auto &info = Application::GetInstance().swapchain->info;
+  colorFormat = info.format.format;
+  depthFormat = info.depthFormat;
 }
 
 RenderProcess::~RenderProcess() {
   auto device = &Application::GetInstance().device;
-  device->destroyRenderPass(renderPass);
   device->destroyPipelineLayout(layout);
-  device->destroyPipeline(graphicsPipeline);
+  destroyPipelines();
 }
 
 void RenderProcess::RecreateGraphicsPipeline(
     const Shader &shader) {
-  if (graphicsPipeline) {
-    Application::GetInstance().device.destroyPipeline(
-        graphicsPipeline);
+  InstallPipelines(BuildPipelines(shader));
+}
+
+auto RenderProcess::BuildPipelines(const Shader &shader)
+    -> Pipelines {
+  Pipelines pipelines;
+  pipelines.opaque = createGraphicsPipeline(shader, Variant::Opaque);
+  pipelines.depthPrepass =
+      createGraphicsPipeline(shader, Variant::DepthPrepass);
+  pipelines.depthEqual =
+      createGraphicsPipeline(shader, Variant::DepthEqual);
+  return pipelines;
+}
+
+void RenderProcess::InstallPipelines(const Pipelines &pipelines) {
+  destroyPipelines();
+  auto &resources = *Application::GetInstance().resources;
+  graphicsPipeline = resources.AddPipeline(pipelines.opaque);
+  depthPrepassPipeline = resources.AddPipeline(pipelines.depthPrepass);
+  depthEqualPipeline = resources.AddPipeline(pipelines.depthEqual);
+}
+
+auto RenderProcess::SupportedSampleCount(uint32_t requested) const
+    -> vk::SampleCountFlagBits {
+  auto limits =
+      Application::GetInstance().phyDevice.getProperties().limits;
+  const auto supported = limits.framebufferColorSampleCounts &
+                         limits.framebufferDepthSampleCounts;
+  auto count = vk::SampleCountFlagBits::e1;
+  for (uint32_t bit = 1; bit <= requested && bit <= 64; bit <<= 1) {
+    const auto candidate = vk::SampleCountFlagBits(bit);
+    if (supported & candidate) {
+      count = candidate;
+    }
   }
-  graphicsPipeline = createGraphicsPipeline(shader);
+  return count;
 }
 
-void RenderProcess::RecreateRenderPass() {
-  if (renderPass) {
-    Application::GetInstance().device.destroyRenderPass(
-        renderPass);
+void RenderProcess::SetSampleCount(
+    vk::SampleCountFlagBits count, const Shader &shader) {
+  samples = count;
+  RecreateGraphicsPipeline(shader);
+}
+
+void RenderProcess::destroyPipelines() {
+  // 重建时旧管线可能还在在途的帧里使用，由登记表延迟销毁
+  auto &resources = *Application::GetInstance().resources;
+  for (auto *pipeline : {&graphicsPipeline, &depthPrepassPipeline,
+           &depthEqualPipeline}) {
+    resources.Destroy(*pipeline);
+    *pipeline = {};
   }
-  renderPass = createRenderPass();
 }
 
 auto RenderProcess::createLayout() -> vk::PipelineLayout {
   vk::PipelineLayoutCreateInfo createInfo;
-  auto layout = Application::GetInstance().shader->layouts;
-  createInfo.setSetLayouts(layout);
+  auto &shader = *Application::GetInstance().shader;
+  auto layout = shader.layouts;
+  auto ranges = shader.GetPushConstantRange();
+  createInfo.setSetLayouts(layout).setPushConstantRanges(ranges);
   return Application::GetInstance()
       .device.createPipelineLayout(createInfo);
 }
 
 auto RenderProcess::createGraphicsPipeline(
-    const Shader &shader) -> vk::Pipeline {
-  auto &app = Application::GetInstance();
+    const Shader &shader, Variant variant) -> vk::Pipeline {
   vk::GraphicsPipelineCreateInfo createInfo;
 
   // 0. shader prepare
@@ -75,16 +115,13 @@ auto RenderProcess::createGraphicsPipeline(
       vk::PrimitiveTopology::eTriangleList);
 
   // 3. viewport & scissor
+  // 动态设置，swapchain 尺寸变化时管线不用重建
   vk::PipelineViewportStateCreateInfo viewportInfo;
-  vk::Viewport viewport(0, 0,
-      static_cast<float>(
-          app.swapchain->info.imageExtent.width),
-      static_cast<float>(
-          app.swapchain->info.imageExtent.height),
-      0, 1);
-  vk::Rect2D scissor(
-      {0, 0}, app.swapchain->info.imageExtent);
-  viewportInfo.setViewports(viewport).setScissors(scissor);
+  viewportInfo.setViewportCount(1).setScissorCount(1);
+  std::array dynamicStates = {
+      vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+  vk::PipelineDynamicStateCreateInfo dynamicInfo;
+  dynamicInfo.setDynamicStates(dynamicStates);
 
   // 4. Rastrization
   vk::PipelineRasterizationStateCreateInfo rastInfo;
@@ -99,9 +136,19 @@ auto RenderProcess::createGraphicsPipeline(
   // 5 .multi sample
   vk::PipelineMultisampleStateCreateInfo multiSample;
   multiSample.setSampleShadingEnable(false)
-      .setRasterizationSamples(vk::SampleCountFlagBits::e1);
+      .setRasterizationSamples(samples);
 
   // 6. depth test
+  // 片元着色器不写深度也不 discard，驱动可以做 early-Z
+  // 相等的深度也通过，同一位置重复绘制时结果与不开深度一致
+  vk::PipelineDepthStencilStateCreateInfo depthInfo;
+  depthInfo.setDepthTestEnable(true)
+      .setDepthWriteEnable(variant != Variant::DepthEqual)
+      .setDepthCompareOp(variant == Variant::DepthEqual
+                             ? vk::CompareOp::eEqual
+                             : vk::CompareOp::eLessOrEqual)
+      .setDepthBoundsTestEnable(false)
+      .setStencilTestEnable(false);
 
   // 7. color blending
 
@@ -115,19 +162,31 @@ auto RenderProcess::createGraphicsPipeline(
 
   blendInfo.setLogicOpEnable(false).setAttachments(attachs);
 
-  // renderpass and layout
-  // createInfo.setRenderPass(renderPass).setLayout(layout);
+  // dynamic rendering：只声明附件格式，不绑定 RenderPass
+  vk::PipelineRenderingCreateInfo renderingInfo;
+  renderingInfo.setColorAttachmentFormats(colorFormat)
+      .setDepthAttachmentFormat(depthFormat);
+
+  // 预渲染没有颜色附件与片元着色器
+  const bool depthOnly = variant == Variant::DepthPrepass;
+  if (depthOnly) {
+    blendInfo.setAttachmentCount(0);
+    renderingInfo.setColorAttachmentCount(0);
+  }
 
   // create graphics pipeline
-  createInfo.setStages(stageCreateInfos)
+  createInfo.setStageCount(depthOnly ? 1 : 2)
+      .setPStages(stageCreateInfos.data())
       .setPVertexInputState(&vertexInputCreateInfo)
       .setPInputAssemblyState(&inputAss)
       .setPViewportState(&viewportInfo)
       .setPRasterizationState(&rastInfo)
       .setPMultisampleState(&multiSample)
+      .setPDepthStencilState(&depthInfo)
+      .setPDynamicState(&dynamicInfo)
       .setPColorBlendState(&blendInfo)
-      .setRenderPass(renderPass)
-      .setLayout(layout);
+      .setLayout(layout)
+      .setPNext(&renderingInfo);
 
   // 创建
   auto result = Application::GetInstance()
@@ -140,49 +199,4 @@ auto RenderProcess::createGraphicsPipeline(
   return result.value;
 }
 
-auto RenderProcess::createRenderPass() -> vk::RenderPass {
-  vk::RenderPassCreateInfo createInfo;
-
-  vk::SubpassDependency dependency;
-  dependency.setSrcSubpass(VK_SUBPASS_EXTERNAL)
-      .setDstSubpass(0)
-      .setSrcStageMask(
-          vk::PipelineStageFlagBits::eColorAttachmentOutput)
-      .setDstStageMask(
-          vk::PipelineStageFlagBits::eColorAttachmentOutput)
-      .setDstAccessMask(
-          vk::AccessFlagBits::eColorAttachmentWrite);
-
-  vk::AttachmentDescription AttachDescription;
-
-  AttachDescription
-      .setFormat(Application::GetInstance()
-                     .swapchain->info.format.format)
-      .setInitialLayout(vk::ImageLayout::eUndefined)
-      .setFinalLayout(vk::ImageLayout::ePresentSrcKHR)
-      .setLoadOp(vk::AttachmentLoadOp::eClear)
-      .setStoreOp(vk::AttachmentStoreOp::eStore)
-      .setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
-      .setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
-      .setSamples(vk::SampleCountFlagBits::e1);
-
-  vk::AttachmentReference reference;
-  reference
-      .setLayout(vk::ImageLayout::eColorAttachmentOptimal)
-      .setAttachment(0);
-
-  vk::SubpassDescription subpass;
-  subpass
-      .setPipelineBindPoint(
-          vk::PipelineBindPoint::eGraphics)
-      .setColorAttachments(reference);
-
-  createInfo.setSubpasses(subpass)
-      .setAttachments(AttachDescription)
-      .setDependencies(dependency);
-
-  return Application::GetInstance().device.createRenderPass(
-      createInfo);
-}
-
 } // namespace app
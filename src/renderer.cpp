@@ -1,27 +1,72 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
 
 #include <memory>
 #include <stdexcept>
+#include <thread>
 
 #include "../header/renderer.h"
 #include "../header/Application.h"
 #include "vertex.cpp"
 #include "vulkan/vulkan_structs.hpp"
+#include <string_view>
+#include <vulkan/vulkan_format_traits.hpp>
 
 namespace app {
 
+// 默认网格（四边形）的局部包围盒半边长
+static const glm::vec3 quadExtent(0.5f, 0.5f, 0.0f);
+
+// 与 cull.comp 的 Object 对应
+struct CullObject {
+  glm::vec4 center;
+  glm::vec4 extent;
+  uint32_t node;
+  uint32_t indexCount;
+  uint32_t firstIndex;
+  int32_t vertexOffset;
+};
+static_assert(sizeof(CullObject) == 48);
+
+// 与 cull.comp 的 CullParams 对应（std140）
+struct CullParams {
+  glm::mat4 viewProj;
+  glm::mat4 pyramidViewProj;
+  glm::vec4 planes[Frustum::PlaneCount];
+  glm::vec2 pyramidSize;
+  uint32_t objectCount;
+  uint32_t drawOffset;
+  uint32_t occlusion;
+  uint32_t padding[3];
+};
+static_assert(offsetof(CullParams, pyramidSize) == 224);
+static_assert(sizeof(CullParams) == 256);
+
+// 与 cull.comp 的 push constant 对应
+struct CullConstants {
+  uint32_t phase;
+};
+
 Renderer::Renderer(int maxFlightCount)
-    : maxFlightCount(maxFlightCount), curFrame(0) {
+    : maxFlightCount(maxFlightCount), curFrame(0),
+      resources(*Application::GetInstance().resources) {
   createFences();
   createSemaphores();
   createCmdBuffers();
   createBuffers();
   bufferData();
+  createScene();
   DescriptorSetManager::Init(maxFlightCount);
+  TextureManager::Init(TextureManager::Config{});
   createSampler();
   createTexture();
+  createStreamer();
+  gpuTimer = std::make_unique<GpuTimer>(maxFlightCount, SectionCount);
+  pipelineStats = std::make_unique<PipelineStats>(maxFlightCount);
   descriptorSets =
       DescriptorSetManager::Instance().AllocBufferSets(
           maxFlightCount);
@@ -30,13 +75,49 @@ Renderer::Renderer(int maxFlightCount)
 
 Renderer::~Renderer() {
   auto &device = Application::GetInstance().device;
-  device.destroySampler(sampler);
+  // 调用前设备已经空闲，剩余的回读直接写出
+  StopCapture();
+  for (int i = 0; i < static_cast<int>(pendingCaptures.size()); ++i) {
+    submitCapture(i);
+  }
+  finishCapture();
+  graph.Reset();
+  streamed.reset();
+  streamer.reset();
+  tiled.reset();
+  gpuTimer.reset();
+  pipelineStats.reset();
+  cullProcess.reset();
+  pyramid.reset();
+  asyncQueue.reset();
+  resources.Destroy(sampler);
+  resources.Destroy(baseLevelSampler);
   texture.reset();
+  TextureManager::Quit();
+  // 调用前设备已经空闲，纹理退休的描述符集要在池销毁前释放
+  Application::GetInstance().deletionQueue->Flush();
   DescriptorSetManager::Quit();
-  hostIndexsBuffer.reset();
-  deviceIndexsBuffer.reset();
-  hostVertexBuffer.reset();
-  deviceVertexBuffer.reset();
+  for (auto id : deviceUniformBuffers) {
+    Application::GetInstance().resourceTracker->Forget(
+        resources.Get(id).buffer);
+    resources.Destroy(id);
+  }
+  for (auto id : hostUniformBuffers) {
+    resources.Destroy(id);
+  }
+  for (auto id : instanceBuffers) {
+    resources.Destroy(id);
+  }
+  for (const auto &slot : cullSlots) {
+    for (auto id : {slot.objects, slot.draws, slot.count, slot.retest,
+             slot.params, slot.stats}) {
+      resources.Destroy(id);
+    }
+  }
+  for (auto id : {hostIndexsBuffer, deviceIndexsBuffer,
+           hostVertexBuffer, deviceVertexBuffer}) {
+    resources.Destroy(id);
+  }
   for (auto &sem : imageAvaliableSems) {
     device.destroySemaphore(sem);
   }
@@ -48,12 +129,27 @@ Renderer::~Renderer() {
   }
 }
 
+void Renderer::pollCompleted() {
+  auto &device = Application::GetInstance().device;
+  // 同一队列按提交顺序完成，取完成的 slot 里最大的帧序号
+  for (int i = 0; i < maxFlightCount; ++i) {
+    if (frameSerials[i] > completedFrame &&
+        device.getFenceStatus(fences[i]) == vk::Result::eSuccess) {
+      completedFrame = frameSerials[i];
+    }
+  }
+  Application::GetInstance().pacer.Completed(completedFrame);
+}
+
 void Renderer::Render() {
   auto &device = Application::GetInstance().device;
   auto &swapchain = Application::GetInstance().swapchain;
-  auto &renderProcess =
-      Application::GetInstance().renderProcess;
   auto &cmdMgr = Application::GetInstance().commandManager;
+  auto &pacer = Application::GetInstance().pacer;
+
+  // 限帧模式在这里睡到截止时间
+  pacer.BeginFrame();
+  snapshot_ = Application::GetInstance().snapshots.Consume();
 
   // 等待第一个 fence
   if (device.waitForFences(fences[curFrame], true,
@@ -61,99 +157,185 @@ void Renderer::Render() {
       vk::Result::eSuccess) {
     throw std::runtime_error("wait for fence failed");
   }
-  device.resetFences(fences[curFrame]);
-
-  auto acqResult =
-      device.acquireNextImageKHR(swapchain->swapchain,
-          std::numeric_limits<uint64_t>::max(),
-          imageAvaliableSems[curFrame]);
+  // 该 slot 上一次提交的帧已经完成，其他 slot 可能也完成了
+  pollCompleted();
+  auto &deletionQueue = *Application::GetInstance().deletionQueue;
+  deletionQueue.Collect(completedFrame);
+  // 按帧退休的 staging 块（图集上传）
+  Application::GetInstance().stagingRing->Reclaim(completedFrame);
+  // 从这里开始退休的对象都可能被本帧使用
+  deletionQueue.BeginFrame(frameIndex);
+  TextureManager::Instance().Update(frameIndex);
+  // 该帧的回读已经完成，交给截帧线程
+  submitCapture(curFrame);
+  if (captureStopping &&
+      std::all_of(pendingCaptures.begin(), pendingCaptures.end(),
+          [](int slot) { return slot < 0; })) {
+    finishCapture();
+  }
+  const auto gpuMs = gpuTimer->Read(curFrame);
+  stepBenchmark(frameSerials[curFrame], gpuMs);
+  stepOverdrawBenchmark(frameSerials[curFrame], gpuMs,
+      pipelineStats->FragmentInvocations(curFrame));
+  if (gpuCulling) {
+    readGpuCull(curFrame);
+  }
+  // 实例缓冲可能换成更大的，要在改写描述符集之前
+  updateScene(curFrame);
+  // 该 slot 的描述符集已经没有帧在用，可以改写
+  if (descriptorDirty[curFrame]) {
+    writeDescriptorSet(curFrame);
+  }
+  // 按预算上传已经解码好的纹理
+  streamer->Update();
+  if (streamed && !streamedResident &&
+      TextureStreamer::IsResident(streamed)) {
+    // 从占位纹理换成真正的图像，各 slot 轮到时改写
+    streamedResident = true;
+    updateDescriptorSets();
+  }
 
-  if (acqResult.result != vk::Result::eSuccess) {
-    throw std::runtime_error(
-        "device.acquireNextImageKHR failed!!!");
+  if (Application::GetInstance().framebufferResized &&
+      !recreateSwapchain()) {
+    return;
+  }
+  uint32_t imageIndex = 0;
+  try {
+    auto acqResult =
+        device.acquireNextImageKHR(swapchain->swapchain,
+            std::numeric_limits<uint64_t>::max(),
+            imageAvaliableSems[curFrame]);
+    // suboptimal 仍然可以渲染，present 之后再重建
+    if (acqResult.result != vk::Result::eSuccess &&
+        acqResult.result != vk::Result::eSuboptimalKHR) {
+      throw std::runtime_error(
+          "device.acquireNextImageKHR failed!!!");
+    }
+    // 获得需要写入的图像的下标
+    imageIndex = acqResult.value;
+  } catch (const vk::OutOfDateKHRError &) {
+    // 信号量没有被使用，fence 也还没有 reset，直接跳过这一帧
+    recreateSwapchain();
+    return;
   }
-  // 获得需要写入的图像的下标
-  auto imageIndex = acqResult.value;
+  // 确定会提交之后才 reset，跳过的帧不会让 fence 永远等不到
+  device.resetFences(fences[curFrame]);
 
   cmdBufs[curFrame].reset();
+  // 延迟模式：acquire 可能阻塞，之后再取一次最新快照
+  if (pacer.SamplesInputLate()) {
+    snapshot_ = Application::GetInstance().snapshots.Consume();
+  }
+  pacer.InputSampled(frameIndex);
   // 更新 MVP
   updateUniformBuffer(curFrame);
+  if (gpuCulling) {
+    // 金字塔跟随 swapchain 尺寸，要在 acquire（可能重建）之后
+    pyramid->Resize(swapchain->info.imageExtent);
+    updateGpuCull(curFrame);
+  }
   // begin
   vk::CommandBufferBeginInfo beginInfo;
   beginInfo.setFlags(
       vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
   cmdBufs[curFrame].begin(beginInfo);
-  {
-    vk::RenderPassBeginInfo renderPassBegin;
-    vk::Rect2D area;
-    area.setOffset({0, 0}).setExtent(
+  recordUniformUpload(cmdBufs[curFrame], curFrame);
+  if (tiled) {
+    // 缺失块的上传要在 render pass 之外录制
+    tiled->Update(cmdBufs[curFrame], curFrame, mvpMat_,
         swapchain->info.imageExtent);
-    vk::ClearValue clearValue;
-    clearValue.setColor(
-        vk::ClearColorValue(0.1f, 0.1f, 0.1f, 1.0f));
-    renderPassBegin.setRenderPass(renderProcess->renderPass)
-        .setRenderArea(area)
-        .setFramebuffer(swapchain->framebuffers[imageIndex])
-        .setClearValues(clearValue);
-
-    cmdBufs[curFrame].beginRenderPass(
-        renderPassBegin, vk::SubpassContents::eInline);
-    {
-      cmdBufs[curFrame].bindPipeline(
-          vk::PipelineBindPoint::eGraphics,
-          renderProcess->graphicsPipeline);
-      // vertex count, prim, first idx,
-      vk::DeviceSize offset = 0;
-      cmdBufs[curFrame].bindVertexBuffers(
-          0, deviceVertexBuffer->buffer, offset);
-      cmdBufs[curFrame].bindIndexBuffer(
-          deviceIndexsBuffer->buffer, 0,
-          vk::IndexType::eUint32);
-
-      if (curFrame > descriptorSets.size()) {
-        std::cerr << "Error : descriptorSets outflow!"
-                  << "\n";
-        throw std::runtime_error("descriptorSets outflow!");
-      }
-      cmdBufs[curFrame].bindDescriptorSets(
-          vk::PipelineBindPoint::eGraphics,
-          renderProcess->layout, 0,
-          {descriptorSets[curFrame].set}, {});
-
-      cmdBufs[curFrame].drawIndexed(
-          deviceIndexsBuffer->size / sizeof(uint32_t), 1, 0,
-          0, 0);
+  }
+  if (!graph.Compiled()) {
+    buildGraph();
+  }
+  graph.SetImported(backbuffer, swapchain->images[imageIndex],
+      swapchain->imageViews[imageIndex]);
+  if (gpuCulling) {
+    const auto &slot = cullSlots[curFrame];
+    graph.SetImported(drawArgs, resources.Get(slot.draws).buffer);
+    graph.SetImported(drawCount, resources.Get(slot.count).buffer);
+    graph.SetImported(retestFlags, resources.Get(slot.retest).buffer);
+    graph.SetImported(cullStats, resources.Get(slot.stats).buffer);
+  }
+  // 裁剪在计算队列上与前一帧的光栅化重叠，
+  // 该 slot 的缓冲与命令缓冲跟着这一帧的 fence 复用
+  uint64_t cullDone = 0;
+  if (asyncCull) {
+    // 描述符引用了金字塔，布局转换留在图形队列
+    pyramid->PrepareRead(cmdBufs[curFrame]);
+    cullDone = submitAsyncCull();
+  }
+  if (capture && !captureStopping) {
+    int slot = acquireCaptureSlot();
+    if (slot >= 0 && swapchain->info.imageExtent != captureExtent) {
+      captureSlots[slot]->busy.store(false);
+      slot = -1;
+    }
+    if (slot >= 0) {
+      pendingCaptures[curFrame] = slot;
+      graph.SetImported(
+          captureTarget, captureSlots[slot]->buffer->buffer);
+    } else {
+      // 所有回读缓冲都在编码中，丢弃这一帧
+      capture->NoteDropped();
+      graph.SetImported(captureTarget, vk::Buffer{});
     }
-    cmdBufs[curFrame].endRenderPass();
   }
+  buildOpaqueList();
+  gpuTimer->Begin(cmdBufs[curFrame], curFrame);
+  pipelineStats->Begin(cmdBufs[curFrame], curFrame);
+  graph.Execute(cmdBufs[curFrame]);
+  pipelineStats->End(cmdBufs[curFrame], curFrame);
+  gpuTimer->End(cmdBufs[curFrame], curFrame);
   cmdBufs[curFrame].end();
-  vk::PipelineStageFlags waitDstStageMask =
-      vk::PipelineStageFlagBits::eColorAttachmentOutput;
+  std::vector<vk::SemaphoreSubmitInfo> waits{
+      {imageAvaliableSems[curFrame], 0,
+          vk::PipelineStageFlagBits2::eColorAttachmentOutput}};
+  if (asyncCull) {
+    // 间接绘制与数量的回读都在这之后
+    waits.push_back(asyncQueue->Wait(cullDone,
+        vk::PipelineStageFlagBits2::eDrawIndirect |
+            vk::PipelineStageFlagBits2::eAllTransfer));
+  }
+  vk::SemaphoreSubmitInfo signal(renderFinishSems[curFrame], 0,
+      vk::PipelineStageFlagBits2::eAllCommands);
+  vk::CommandBufferSubmitInfo cmdInfo(cmdBufs[curFrame]);
 
-  vk::SubmitInfo submit;
-  submit.setWaitDstStageMask(waitDstStageMask)
-      .setWaitSemaphores(imageAvaliableSems[curFrame])
-      .setSignalSemaphores(renderFinishSems[curFrame])
-      .setCommandBuffers(cmdBufs[curFrame]);
+  vk::SubmitInfo2 submit;
+  submit.setWaitSemaphoreInfos(waits)
+      .setSignalSemaphoreInfos(signal)
+      .setCommandBufferInfos(cmdInfo);
 
-  Application::GetInstance().graphicQueue.submit(
+  Application::GetInstance().graphicQueue.submit2(
       submit, fences[curFrame]);
+  // 录制期间完成的帧在这里记下，延迟不含等待复用的时间
+  pollCompleted();
+  pacer.Submitted(frameIndex, completedFrame);
+  frameSerials[curFrame] = frameIndex++;
 
   vk::PresentInfoKHR present;
   present.setWaitSemaphores(renderFinishSems[curFrame])
       .setImageIndices(imageIndex)
       .setSwapchains(swapchain->swapchain);
 
-  auto result =
-      Application::GetInstance().presentQueue.presentKHR(
-          present);
-
-  if (result != vk::Result::eSuccess) {
-    throw std::runtime_error("image present failed!!!");
+  vk::Result result = vk::Result::eSuccess;
+  try {
+    result = Application::GetInstance().presentQueue.presentKHR(
+        present);
+  } catch (const vk::OutOfDateKHRError &) {
+    result = vk::Result::eErrorOutOfDateKHR;
   }
 
   curFrame = (curFrame + 1) % maxFlightCount;
 
+  if (result == vk::Result::eSuboptimalKHR ||
+      result == vk::Result::eErrorOutOfDateKHR ||
+      Application::GetInstance().framebufferResized) {
+    recreateSwapchain();
+  } else if (result != vk::Result::eSuccess) {
+    throw std::runtime_error("image present failed!!!");
+  }
+
   // CPU GPU 同步
 
   //   auto waitResult =
@@ -165,8 +347,423 @@ void Renderer::Render() {
   //   }
   //   device.resetFences(fences[curFrame]);
 }
+auto Renderer::recreateSwapchain() -> bool {
+  auto &app = Application::GetInstance();
+  const auto size = snapshot_.framebuffer;
+  // 最小化时尺寸为 0，不能创建 swapchain，等窗口恢复
+  if (size.width == 0 || size.height == 0) {
+    app.framebufferResized = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return false;
+  }
+  app.framebufferResized = false;
+
+  // 已提交的帧还在使用旧 swapchain 与旧的临时附件，
+  // 新 swapchain 通过 oldSwapchain 接管，旧对象交给延迟销毁
+  // （present 本身没有 fence，这里以最后一次提交的 fence 为准）
+  std::shared_ptr<Swapchain> old(std::move(app.swapchain));
+  app.swapchain = std::make_unique<Swapchain>(
+      size.width, size.height, old->swapchain);
+  app.deletionQueue->Retire([old]() mutable { old.reset(); });
+  app.deletionQueue->Retire(graph.Release());
+
+  // 颜色格式很少变化，旧管线同样延迟销毁
+  auto &renderProcess = app.renderProcess;
+  if (app.swapchain->info.format.format != renderProcess->colorFormat) {
+    renderProcess->colorFormat = app.swapchain->info.format.format;
+    renderProcess->RecreateGraphicsPipeline(*app.shader);
+  }
+  return true;
+}
+
+void Renderer::buildGraph() {
+  auto &app = Application::GetInstance();
+  auto &swapchain = app.swapchain;
+  RenderGraph::TextureDesc desc;
+  desc.extent = swapchain->info.imageExtent;
+  desc.format = swapchain->info.format.format;
+  // 等待 acquire 信号量的 stage 必须与第一次转换衔接
+  backbuffer = graph.ImportImage("backbuffer", desc,
+      {vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+          vk::AccessFlagBits2::eNone, vk::ImageLayout::eUndefined},
+      {vk::PipelineStageFlagBits2::eNone,
+          vk::AccessFlagBits2::eNone,
+          vk::ImageLayout::ePresentSrcKHR});
+  // 深度只在帧内使用，作为临时资源每帧从 undefined 开始
+  RenderGraph::TextureDesc depthDesc;
+  depthDesc.extent = swapchain->info.imageExtent;
+  depthDesc.format = swapchain->info.depthFormat;
+  depthDesc.aspect = swapchain->info.depthAspect;
+  depthDesc.samples = app.renderProcess->samples;
+  const bool msaa = depthDesc.samples != vk::SampleCountFlagBits::e1;
+  // 两阶段之间颜色与深度都要保存，多重采样的颜色只在片上
+  twoPhase = gpuCulling && occlusionCulling && !msaa && !depthPrepass;
+  // 后期阶段依赖本帧的深度，两阶段时整个裁剪留在图形队列
+  asyncCull = gpuCulling && asyncCompute && !twoPhase;
+  // 预渲染的深度要跨两次 rendering 保存，两阶段时还要构建金字塔
+  depthDesc.memoryless = !depthPrepass && !twoPhase;
+  RenderGraph::TextureDesc msaaDesc = desc;
+  msaaDesc.samples = depthDesc.samples;
+  msaaDesc.memoryless = true;
+
+  if (gpuCulling) {
+    // 每个 slot 一组缓冲，上一次使用它们的帧已经完成
+    const ResourceState indirect{
+        vk::PipelineStageFlagBits2::eDrawIndirect,
+        vk::AccessFlagBits2::eIndirectCommandRead,
+        vk::ImageLayout::eUndefined};
+    drawArgs = graph.ImportBuffer("draw args", indirect, indirect);
+    drawCount = graph.ImportBuffer("draw count", indirect, indirect);
+    retestFlags = graph.ImportBuffer("retest flags", {}, {});
+    // 异步时计算队列已经写好，信号量等待保证可见
+    if (!asyncCull) {
+      graph.AddPass(
+          "reset draw count",
+          [&](RenderGraph::PassBuilder &builder) {
+            builder.Write(drawCount, RenderGraph::Access::TransferDst);
+          },
+          [this](vk::CommandBuffer cmdBuf,
+              const RenderGraph::Resources &res) {
+            cmdBuf.fillBuffer(
+                res.Buffer(drawCount), 0, VK_WHOLE_SIZE, 0);
+          });
+      graph.AddPass(
+          "gpu cull",
+          [&](RenderGraph::PassBuilder &builder) {
+            builder.Write(drawCount, RenderGraph::Access::StorageWrite);
+            builder.Write(drawArgs, RenderGraph::Access::StorageWrite);
+            builder.Write(retestFlags, RenderGraph::Access::StorageWrite);
+          },
+          [this](vk::CommandBuffer cmdBuf, const RenderGraph::Resources &) {
+            recordGpuCull(cmdBuf, 0);
+          });
+    }
+  }
+  // 间接绘制的参数与数量
+  auto readDraws = [&](RenderGraph::PassBuilder &builder) {
+    if (gpuCulling) {
+      builder.Read(drawArgs, RenderGraph::Access::IndirectRead);
+      builder.Read(drawCount, RenderGraph::Access::IndirectRead);
+    }
+  };
+  if (depthPrepass) {
+    graph.AddPass(
+        "depth prepass",
+        [&](RenderGraph::PassBuilder &builder) {
+          depth = builder.Create("depth", depthDesc);
+          builder.Write(depth, RenderGraph::Access::DepthAttachment);
+          readDraws(builder);
+        },
+        [this](vk::CommandBuffer cmdBuf,
+            const RenderGraph::Resources &res) {
+          recordDepthPrepass(cmdBuf, res);
+        });
+  }
+  graph.AddPass(
+      "scene",
+      [&](RenderGraph::PassBuilder &builder) {
+        // 多重采样时 swapchain 图像是 resolve 目标，
+        // resolve 在颜色附件阶段写入，同步与直接渲染相同
+        builder.Write(
+            backbuffer, RenderGraph::Access::ColorAttachment);
+        if (msaa) {
+          msaaColor = builder.Create("msaa color", msaaDesc);
+          builder.Write(
+              msaaColor, RenderGraph::Access::ColorAttachment);
+        }
+        if (depthPrepass) {
+          builder.Read(depth, RenderGraph::Access::DepthRead);
+        } else {
+          depth = builder.Create("depth", depthDesc);
+          builder.Write(depth, RenderGraph::Access::DepthAttachment);
+        }
+        readDraws(builder);
+      },
+      [this](vk::CommandBuffer cmdBuf,
+          const RenderGraph::Resources &res) {
+        recordScene(cmdBuf, res);
+      });
+
+  if (twoPhase) {
+    // 金字塔不在帧图里，各级的屏障由 tracker 生成
+    graph.AddPass(
+        "hi-z build",
+        [&](RenderGraph::PassBuilder &builder) {
+          builder.Read(depth, RenderGraph::Access::Sampled);
+          builder.SideEffect();
+        },
+        [this](vk::CommandBuffer cmdBuf,
+            const RenderGraph::Resources &res) {
+          gpuTimer->BeginSection(cmdBuf, curFrame, SectionHiZBuild);
+          pyramid->Build(
+              cmdBuf, curFrame, res.SampledView(depth), mvpMat_);
+          gpuTimer->EndSection(cmdBuf, curFrame, SectionHiZBuild);
+        });
+    graph.AddPass(
+        "gpu cull late",
+        [&](RenderGraph::PassBuilder &builder) {
+          builder.Write(drawCount, RenderGraph::Access::StorageWrite);
+          builder.Write(drawArgs, RenderGraph::Access::StorageWrite);
+          builder.Read(retestFlags, RenderGraph::Access::StorageRead);
+        },
+        [this](vk::CommandBuffer cmdBuf, const RenderGraph::Resources &) {
+          recordGpuCull(cmdBuf, 1);
+        });
+    graph.AddPass(
+        "scene late",
+        [&](RenderGraph::PassBuilder &builder) {
+          builder.Write(
+              backbuffer, RenderGraph::Access::ColorAttachment);
+          builder.Write(depth, RenderGraph::Access::DepthAttachment);
+          readDraws(builder);
+        },
+        [this](vk::CommandBuffer cmdBuf,
+            const RenderGraph::Resources &res) {
+          recordScene(cmdBuf, res, 1);
+        });
+  }
+  if (gpuCulling) {
+    // 各阶段的数量拷回主机，该帧完成后统计
+    cullStats = graph.ImportBuffer("cull stats", {},
+        {vk::PipelineStageFlagBits2::eHost,
+            vk::AccessFlagBits2::eHostRead,
+            vk::ImageLayout::eUndefined});
+    graph.AddPass(
+        "cull stats",
+        [&](RenderGraph::PassBuilder &builder) {
+          builder.Read(drawCount, RenderGraph::Access::TransferSrc);
+          builder.Write(cullStats, RenderGraph::Access::TransferDst);
+          builder.SideEffect();
+        },
+        [this](vk::CommandBuffer cmdBuf,
+            const RenderGraph::Resources &res) {
+          vk::BufferCopy region;
+          region.setSize(sizeof(uint32_t) * 4);
+          cmdBuf.copyBuffer(
+              res.Buffer(drawCount), res.Buffer(cullStats), region);
+          cullSlots[curFrame].statsPending = true;
+        });
+  }
+
+  if (capture && !captureStopping) {
+    captureTarget = graph.ImportBuffer("capture", {},
+        {vk::PipelineStageFlagBits2::eHost,
+            vk::AccessFlagBits2::eHostRead,
+            vk::ImageLayout::eUndefined});
+    graph.AddPass(
+        "capture",
+        [&](RenderGraph::PassBuilder &builder) {
+          builder.Read(backbuffer, RenderGraph::Access::TransferSrc);
+          builder.Write(
+              captureTarget, RenderGraph::Access::TransferDst);
+          builder.SideEffect();
+        },
+        [this](vk::CommandBuffer cmdBuf,
+            const RenderGraph::Resources &res) {
+          if (res.Buffer(captureTarget)) {
+            recordCapture(cmdBuf, res.Image(backbuffer),
+                res.Buffer(captureTarget));
+          }
+        });
+  }
+  graph.Compile();
+  // 缩放窗口等都会重建，不要每次都刷屏
+  if (printGraph || !graphPrinted) {
+    graph.PrintPlan();
+    graphPrinted = true;
+  }
+}
+
+// 整数格式不能取平均
+static auto resolveModeFor(vk::Format format) -> vk::ResolveModeFlagBits {
+  const std::string_view numeric = vk::componentNumericFormat(format, 0);
+  if (numeric == "SINT" || numeric == "UINT") {
+    return vk::ResolveModeFlagBits::eSampleZero;
+  }
+  return vk::ResolveModeFlagBits::eAverage;
+}
+
+void Renderer::recordScene(vk::CommandBuffer cmdBuf,
+    const RenderGraph::Resources &res, uint32_t phase) {
+  auto &app = Application::GetInstance();
+  auto &renderProcess = app.renderProcess;
+
+  // 附件直接给 view，swapchain 重建时不用再建 framebuffer
+  vk::RenderingAttachmentInfo colorAttachment;
+  colorAttachment
+      .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
+      .setLoadOp(vk::AttachmentLoadOp::eClear)
+      .setClearValue(
+          vk::ClearColorValue(0.1f, 0.1f, 0.1f, 1.0f));
+  if (renderProcess->samples != vk::SampleCountFlagBits::e1) {
+    // 多重采样图像在 tile 上 resolve 后直接丢弃，不写回显存
+    colorAttachment.setImageView(res.View(msaaColor))
+        .setStoreOp(vk::AttachmentStoreOp::eDontCare)
+        .setResolveMode(resolveModeFor(renderProcess->colorFormat))
+        .setResolveImageView(res.View(backbuffer))
+        .setResolveImageLayout(
+            vk::ImageLayout::eColorAttachmentOptimal);
+  } else {
+    colorAttachment.setImageView(res.View(backbuffer))
+        .setStoreOp(vk::AttachmentStoreOp::eStore);
+  }
+  // 深度不需要保留到帧外
+  vk::RenderingAttachmentInfo depthAttachment;
+  depthAttachment.setImageView(res.View(depth))
+      .setClearValue(vk::ClearDepthStencilValue(1.0f, 0));
+  if (depthPrepass) {
+    // 预渲染已经写好深度，这里只读
+    depthAttachment
+        .setImageLayout(vk::ImageLayout::eDepthStencilReadOnlyOptimal)
+        .setLoadOp(vk::AttachmentLoadOp::eLoad)
+        .setStoreOp(vk::AttachmentStoreOp::eNone);
+  } else if (twoPhase) {
+    // 早期阶段的深度要构建金字塔，后期阶段在它之上继续绘制
+    depthAttachment
+        .setImageLayout(
+            vk::ImageLayout::eDepthStencilAttachmentOptimal)
+        .setLoadOp(phase == 0 ? vk::AttachmentLoadOp::eClear
+                              : vk::AttachmentLoadOp::eLoad)
+        .setStoreOp(phase == 0 ? vk::AttachmentStoreOp::eStore
+                               : vk::AttachmentStoreOp::eDontCare);
+  } else {
+    depthAttachment
+        .setImageLayout(
+            vk::ImageLayout::eDepthStencilAttachmentOptimal)
+        .setLoadOp(vk::AttachmentLoadOp::eClear)
+        .setStoreOp(vk::AttachmentStoreOp::eDontCare);
+  }
+  if (phase > 0) {
+    colorAttachment.setLoadOp(vk::AttachmentLoadOp::eLoad);
+  }
+  vk::RenderingInfo renderingInfo;
+  renderingInfo
+      .setRenderArea({{0, 0}, app.swapchain->info.imageExtent})
+      .setLayerCount(1)
+      .setColorAttachments(colorAttachment)
+      .setPDepthAttachment(&depthAttachment);
+
+  cmdBuf.beginRendering(renderingInfo);
+  recordDraws(cmdBuf,
+      depthPrepass ? renderProcess->depthEqualPipeline
+                   : renderProcess->graphicsPipeline,
+      phase);
+  cmdBuf.endRendering();
+}
+
+void Renderer::recordDepthPrepass(
+    vk::CommandBuffer cmdBuf, const RenderGraph::Resources &res) {
+  auto &app = Application::GetInstance();
+  vk::RenderingAttachmentInfo depthAttachment;
+  depthAttachment.setImageView(res.View(depth))
+      .setImageLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+      .setLoadOp(vk::AttachmentLoadOp::eClear)
+      .setStoreOp(vk::AttachmentStoreOp::eStore)
+      .setClearValue(vk::ClearDepthStencilValue(1.0f, 0));
+  vk::RenderingInfo renderingInfo;
+  renderingInfo
+      .setRenderArea({{0, 0}, app.swapchain->info.imageExtent})
+      .setLayerCount(1)
+      .setPDepthAttachment(&depthAttachment);
+
+  cmdBuf.beginRendering(renderingInfo);
+  recordDraws(cmdBuf, app.renderProcess->depthPrepassPipeline);
+  cmdBuf.endRendering();
+}
+
+void Renderer::recordDraws(
+    vk::CommandBuffer cmdBuf, PipelineId pipeline, uint32_t phase) {
+  auto &app = Application::GetInstance();
+  auto &renderProcess = app.renderProcess;
+  const auto extent = app.swapchain->info.imageExtent;
+  cmdBuf.bindPipeline(
+      vk::PipelineBindPoint::eGraphics, resources.Get(pipeline));
+  cmdBuf.setViewport(0, vk::Viewport(0, 0, float(extent.width),
+                            float(extent.height), 0, 1));
+  cmdBuf.setScissor(0, vk::Rect2D({0, 0}, extent));
+  cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+      renderProcess->layout, 0, {descriptorSets[curFrame].set}, {});
+
+  if (phase > 0 && !gpuDriven()) {
+    // CPU 列表在第一阶段已经画完
+    return;
+  }
+  if (tiled) {
+    const DrawConstants constants;
+    cmdBuf.pushConstants(renderProcess->layout,
+        vk::ShaderStageFlagBits::eVertex, 0, sizeof(constants),
+        &constants);
+    tiled->Draw(cmdBuf, curFrame);
+    return;
+  }
+  // vertex count, prim, first idx,
+  vk::DeviceSize offset = 0;
+  cmdBuf.bindVertexBuffers(
+      0, resources.Get(deviceVertexBuffer).buffer, offset);
+  cmdBuf.bindIndexBuffer(
+      resources.Get(deviceIndexsBuffer).buffer, 0,
+      vk::IndexType::eUint32);
+  if (gpuDriven()) {
+    // 可见物体的数量只有 GPU 知道，上限为场景节点数
+    DrawConstants constants;
+    constants.node = DrawConstants::InstanceNode;
+    cmdBuf.pushConstants(renderProcess->layout,
+        vk::ShaderStageFlagBits::eVertex, 0, sizeof(constants),
+        &constants);
+    const auto &slot = cullSlots[curFrame];
+    const vk::DeviceSize stride = sizeof(vk::DrawIndexedIndirectCommand);
+    cmdBuf.drawIndexedIndirectCount(resources.Get(slot.draws).buffer,
+        stride * slot.capacity * phase, resources.Get(slot.count).buffer,
+        sizeof(uint32_t) * phase, scene.Size(), stride);
+    return;
+  }
+  // 基准时同一个小四边形重复绘制，放大采样带宽的差异
+  const uint32_t instances = bench ? 256 : 1;
+  for (const auto &item : opaque.Items()) {
+    DrawConstants constants;
+    if (item.node < 0) {
+      constants.model = item.model;
+    } else {
+      constants.node = item.node;
+    }
+    cmdBuf.pushConstants(renderProcess->layout,
+        vk::ShaderStageFlagBits::eVertex, 0, sizeof(constants),
+        &constants);
+    cmdBuf.drawIndexed(
+        resources.Get(deviceIndexsBuffer).size / sizeof(uint32_t),
+        instances, 0, 0, 0);
+  }
+}
+
+void Renderer::buildOpaqueList() {
+  opaque.Clear();
+  if (overdraw) {
+    // 层层叠放且每层都盖满屏幕，最坏情况下每层都要着色
+    constexpr uint32_t Layers = 32;
+    for (uint32_t i = 0; i < Layers; ++i) {
+      auto model = glm::translate(glm::mat4(1.0f),
+          glm::vec3(0.0f, 0.0f, -0.06f * float(i)));
+      opaque.Add(glm::scale(model, glm::vec3(6.0f)));
+    }
+  } else if (bench) {
+    opaque.Add(glm::mat4(1.0f));
+  } else if (!gpuDriven()) {
+    // 包围盒与 MVP 在同一个空间（ubo.model 之前）
+    const auto stats =
+        culler.Cull(Frustum::FromMatrix(mvpMat_), visibleNodes);
+    culler.Report(stats);
+    for (uint32_t i : visibleNodes) {
+      opaque.Add(ToGlm(scene.World(i)), static_cast<int32_t>(i));
+    }
+  }
+  const bool worstCase = overdraw && overdraw->mode == 0;
+  opaque.Sort(sceneView_, worstCase ? DrawList::Order::BackToFront
+                                    : DrawList::Order::FrontToBack);
+}
+
 void Renderer::createFences() {
   fences.resize(maxFlightCount, nullptr);
+  frameSerials.assign(maxFlightCount, 0);
 
   for (auto &fence : fences) {
     vk::FenceCreateInfo fenceCreateInfo;
@@ -203,23 +800,23 @@ void Renderer::createCmdBuffers() {
 }
 
 void Renderer::createBuffers() {
-  hostVertexBuffer = std::make_unique<BufferPkg>(
+  hostVertexBuffer = resources.CreateBuffer(
       sizeof(vertices[0]) * vertices.size(),
       vk::BufferUsageFlagBits::eTransferSrc,
       vk::MemoryPropertyFlagBits::eHostVisible |
           vk::MemoryPropertyFlagBits::eHostCoherent);
-  deviceVertexBuffer = std::make_unique<BufferPkg>(
+  deviceVertexBuffer = resources.CreateBuffer(
       sizeof(vertices[0]) * vertices.size(),
       vk::BufferUsageFlagBits::eVertexBuffer |
           vk::BufferUsageFlagBits::eTransferDst,
       vk::MemoryPropertyFlagBits::eDeviceLocal);
 
-  hostIndexsBuffer = std::make_unique<BufferPkg>(
+  hostIndexsBuffer = resources.CreateBuffer(
       sizeof(indices[0]) * indices.size(),
       vk::BufferUsageFlagBits::eTransferSrc,
       vk::MemoryPropertyFlagBits::eHostVisible |
           vk::MemoryPropertyFlagBits::eHostCoherent);
-  deviceIndexsBuffer = std::make_unique<BufferPkg>(
+  deviceIndexsBuffer = resources.CreateBuffer(
       sizeof(indices[0]) * indices.size(),
       vk::BufferUsageFlagBits::eIndexBuffer |
           vk::BufferUsageFlagBits::eTransferDst,
@@ -227,85 +824,442 @@ void Renderer::createBuffers() {
 }
 
 void Renderer::bufferData() {
-  memcpy(hostVertexBuffer->map, vertices.data(),
+  auto &hostVertex = resources.Get(hostVertexBuffer);
+  memcpy(hostVertex.map, vertices.data(),
       sizeof(vertices[0]) * vertices.size());
 
-  copyBuffer(hostVertexBuffer->buffer,
-      deviceVertexBuffer->buffer, hostVertexBuffer->size, 0,
+  copyBuffer(hostVertex.buffer,
+      resources.Get(deviceVertexBuffer).buffer, hostVertex.size, 0,
       0);
 
-  memcpy(hostIndexsBuffer->map, indices.data(),
+  auto &hostIndex = resources.Get(hostIndexsBuffer);
+  memcpy(hostIndex.map, indices.data(),
       sizeof(indices[0]) * indices.size());
-  copyBuffer(hostIndexsBuffer->buffer,
-      deviceIndexsBuffer->buffer, hostIndexsBuffer->size, 0,
+  copyBuffer(hostIndex.buffer,
+      resources.Get(deviceIndexsBuffer).buffer, hostIndex.size, 0,
       0);
 
   hostUniformBuffers.resize(maxFlightCount);
   size_t size = sizeof(float) * 4 * 4 * 3;
   for (auto &buffer : hostUniformBuffers) {
-    buffer = std::make_unique<BufferPkg>(size,
+    buffer = resources.CreateBuffer(size,
         vk::BufferUsageFlagBits::eTransferSrc,
         vk::MemoryPropertyFlagBits::eHostVisible |
             vk::MemoryPropertyFlagBits::eHostCoherent);
   }
   deviceUniformBuffers.resize(maxFlightCount);
   for (auto &buffer : deviceUniformBuffers) {
-    buffer = std::make_unique<BufferPkg>(size,
+    buffer = resources.CreateBuffer(size,
         vk::BufferUsageFlagBits::eTransferDst |
             vk::BufferUsageFlagBits::eUniformBuffer,
         vk::MemoryPropertyFlagBits::eDeviceLocal);
+    // 每帧在帧命令缓冲里拷贝，屏障由 tracker 生成
+    Application::GetInstance().resourceTracker->Track(
+        resources.Get(buffer).buffer);
   }
-  for (uint32_t i = 0; i < maxFlightCount; ++i) {
-    copyBuffer(hostUniformBuffers[i]->buffer,
-        deviceUniformBuffers[i]->buffer,
-        hostUniformBuffers[i]->size, 0, 0);
+}
+
+void Renderer::createScene() {
+  sceneRoot = scene.AddNode();
+  // 四个卫星各带一个更小的子节点，只有卫星每帧移动，
+  // 子节点跟着父节点的子树一起重算
+  constexpr uint32_t Satellites = 4;
+  for (uint32_t i = 0; i < Satellites; ++i) {
+    const auto satellite = scene.AddNode(sceneRoot);
+    Scene::Transform moon;
+    moon.translation = glm::vec3(0.0f, 0.0f, 0.6f);
+    moon.scale = glm::vec3(0.5f);
+    scene.AddNode(satellite, moon);
+    satellites.push_back(satellite);
   }
+  instanceBuffers.resize(maxFlightCount);
+  instanceVersions.assign(maxFlightCount, 0);
 }
 
-void Renderer::copyBuffer(vk::Buffer &src, vk::Buffer &dst,
-    size_t size, size_t srcOffset, size_t dstOffset) {
-  auto cmdBuf =
-      Application::GetInstance()
-          .commandManager->CreateOneCommandBuffer();
+void Renderer::updateScene(uint32_t currentImage) {
+  const auto time = float(snapshot_.time);
+  for (size_t i = 0; i < satellites.size(); ++i) {
+    const float phase =
+        time * 0.8f + glm::radians(360.0f) * float(i) / satellites.size();
+    Scene::Transform local;
+    local.translation =
+        glm::vec3(std::cos(phase), std::sin(phase), 0.0f) * 0.8f;
+    local.rotation = glm::angleAxis(time * 2.0f, glm::vec3(0, 0, 1));
+    local.scale = glm::vec3(0.2f);
+    scene.SetLocal(satellites[i], local);
+  }
+  scene.Update();
+  // GPU 裁剪时不需要 CPU 侧的包围盒
+  if (!gpuCulling) {
+    updateBounds();
+  }
 
-  vk::CommandBufferBeginInfo begin;
-  begin.setFlags(
-      vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-  cmdBuf.begin(begin);
-  {
-    vk::BufferCopy region;
-    region.setSize(size)
-        .setSrcOffset(srcOffset)
-        .setDstOffset(dstOffset);
-    cmdBuf.copyBuffer(src, dst, region);
+  // 该 slot 的实例缓冲已经没有帧在用，可以直接写
+  auto &id = instanceBuffers[currentImage];
+  const size_t required = sizeof(Mat4) * std::max(scene.Size(), 1u);
+  if (!id || resources.Get(id).size < required) {
+    resources.Destroy(id);
+    // 异步裁剪在计算队列上也要读
+    id = resources.CreateBuffer(std::bit_ceil(required),
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCoherent,
+        true);
+    instanceVersions[currentImage] = 0;
+    descriptorDirty[currentImage] = true;
   }
-  cmdBuf.end();
+  instanceVersions[currentImage] = scene.WriteWorld(
+      static_cast<Mat4 *>(resources.Get(id).map),
+      instanceVersions[currentImage]);
+}
 
-  vk::SubmitInfo submit;
-  submit.setCommandBuffers(cmdBuf);
-  Application::GetInstance().graphicQueue.submit(submit);
+void Renderer::updateBounds() {
+  // 四边形的局部包围盒，变换后取各轴投影得到世界空间的包围盒
+  const glm::vec3 &localExtent = quadExtent;
+  auto bounds = [&](uint32_t i) {
+    const Mat4 &world = scene.World(i);
+    const float *m = world.m;
+    glm::vec3 extent;
+    for (int k = 0; k < 3; ++k) {
+      extent[k] = std::abs(m[k]) * localExtent.x +
+                  std::abs(m[4 + k]) * localExtent.y +
+                  std::abs(m[8 + k]) * localExtent.z;
+    }
+    return std::pair{glm::vec3(m[12], m[13], m[14]), extent};
+  };
+  if (scene.LastStats().relayout || culler.Size() != scene.Size()) {
+    // 重排后节点下标都变了，包围盒整体重建
+    culler.Clear();
+    for (uint32_t i = 0; i < scene.Size(); ++i) {
+      const auto [center, extent] = bounds(i);
+      culler.Add(center, extent);
+    }
+  } else {
+    for (const auto &range : scene.LastChanges()) {
+      for (uint32_t i = range.begin; i < range.end; ++i) {
+        const auto [center, extent] = bounds(i);
+        culler.Update(i, center, extent);
+      }
+    }
+  }
+  culler.Refit();
+}
+
+void Renderer::updateGpuCull(uint32_t currentImage) {
+  auto &slot = cullSlots[currentImage];
+  const uint32_t count = std::max(scene.Size(), 1u);
+  bool rewrite = false;
+  // 除了回读的数量，都可能被计算队列访问（异步裁剪）
+  if (!slot.params) {
+    slot.params = resources.CreateBuffer(sizeof(CullParams),
+        vk::BufferUsageFlagBits::eUniformBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCoherent,
+        true);
+    // 计数在帧内清零，这里只需要最后拷回的 4 个
+    slot.stats = resources.CreateBuffer(sizeof(uint32_t) * 4,
+        vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCoherent);
+    slot.count = resources.CreateBuffer(sizeof(uint32_t) * 4,
+        vk::BufferUsageFlagBits::eStorageBuffer |
+            vk::BufferUsageFlagBits::eIndirectBuffer |
+            vk::BufferUsageFlagBits::eTransferSrc |
+            vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal, true);
+    cullProcess->WriteBuffer(
+        slot.set, 3, resources.Get(slot.count).buffer);
+    cullProcess->WriteBuffer(
+        slot.set, 4, resources.Get(slot.params).buffer);
+  }
+  if (count > slot.capacity) {
+    // 该 slot 已经没有帧在用，旧缓冲交给延迟销毁
+    for (auto id : {slot.objects, slot.draws, slot.retest}) {
+      resources.Destroy(id);
+    }
+    slot.capacity = std::bit_ceil(count);
+    slot.objects = resources.CreateBuffer(
+        sizeof(CullObject) * slot.capacity,
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCoherent,
+        true);
+    // 早期与后期阶段各一半
+    slot.draws = resources.CreateBuffer(
+        sizeof(vk::DrawIndexedIndirectCommand) * slot.capacity * 2,
+        vk::BufferUsageFlagBits::eStorageBuffer |
+            vk::BufferUsageFlagBits::eIndirectBuffer,
+        vk::MemoryPropertyFlagBits::eDeviceLocal, true);
+    slot.retest = resources.CreateBuffer(sizeof(uint32_t) * slot.capacity,
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eDeviceLocal, true);
+    slot.layoutVersion = 0;
+    rewrite = true;
+  }
+  // 物体编号就是节点下标，只在重排时变化；
+  // 节点移动只改实例缓冲里的世界矩阵，这里不用重写
+  if (slot.layoutVersion != scene.LayoutVersion()) {
+    auto *objects =
+        static_cast<CullObject *>(resources.Get(slot.objects).map);
+    const auto indexCount = static_cast<uint32_t>(
+        resources.Get(deviceIndexsBuffer).size / sizeof(uint32_t));
+    for (uint32_t i = 0; i < scene.Size(); ++i) {
+      objects[i] = {glm::vec4(0.0f), glm::vec4(quadExtent, 0.0f), i,
+          indexCount, 0, 0};
+    }
+    slot.layoutVersion = scene.LayoutVersion();
+  }
+  if (rewrite || slot.instances != instanceBuffers[currentImage]) {
+    slot.instances = instanceBuffers[currentImage];
+    cullProcess->WriteBuffer(
+        slot.set, 0, resources.Get(slot.objects).buffer);
+    cullProcess->WriteBuffer(
+        slot.set, 1, resources.Get(slot.instances).buffer);
+    cullProcess->WriteBuffer(slot.set, 2, resources.Get(slot.draws).buffer);
+    cullProcess->WriteBuffer(
+        slot.set, 6, resources.Get(slot.retest).buffer);
+  }
+  if (slot.pyramidGeneration != pyramid->Generation()) {
+    slot.pyramidGeneration = pyramid->Generation();
+    cullProcess->WriteImage(slot.set, 5, pyramid->View(),
+        vk::ImageLayout::eGeneral, pyramid->Sampler());
+  }
+}
+
+void Renderer::recordGpuCull(vk::CommandBuffer cmdBuf, uint32_t phase) {
+  auto &slot = cullSlots[curFrame];
+  if (phase == 0) {
+    // 平面与实例缓冲里的世界矩阵在同一个空间（ubo.model 之前）
+    auto &params =
+        *static_cast<CullParams *>(resources.Get(slot.params).map);
+    const auto frustum = Frustum::FromMatrix(mvpMat_);
+    params.viewProj = mvpMat_;
+    params.pyramidViewProj = pyramid->ViewProj();
+    std::copy(std::begin(frustum.planes), std::end(frustum.planes),
+        params.planes);
+    params.pyramidSize = glm::vec2(
+        float(pyramid->Extent().width), float(pyramid->Extent().height));
+    params.objectCount = scene.Size();
+    params.drawOffset = slot.capacity;
+    params.occlusion = twoPhase && pyramid->Valid() ? 1 : 0;
+  }
+  const CullConstants constants{phase};
+  if (asyncCull) {
+    // 计时的 query 池在图形队列上重置，计算队列不计时
+    cullProcess->Bind(cmdBuf, slot.set);
+    cullProcess->Push(cmdBuf, constants);
+    cullProcess->DispatchFor(cmdBuf, scene.Size());
+    return;
+  }
+  // 早期阶段读上一帧的金字塔，后期阶段读刚构建的
+  pyramid->PrepareRead(cmdBuf);
+  const auto section = phase == 0 ? SectionCullEarly : SectionCullLate;
+  gpuTimer->BeginSection(cmdBuf, curFrame, section);
+  cullProcess->Bind(cmdBuf, slot.set);
+  cullProcess->Push(cmdBuf, constants);
+  cullProcess->DispatchFor(cmdBuf, scene.Size());
+  gpuTimer->EndSection(cmdBuf, curFrame, section);
+}
 
-  Application::GetInstance().device.waitIdle();
+auto Renderer::submitAsyncCull() -> uint64_t {
+  auto cmdBuf = asyncQueue->Begin(curFrame);
+  const auto count = resources.Get(cullSlots[curFrame].count).buffer;
+  cmdBuf.fillBuffer(count, 0, VK_WHOLE_SIZE, 0);
+  vk::BufferMemoryBarrier2 barrier;
+  barrier.setSrcStageMask(vk::PipelineStageFlagBits2::eClear)
+      .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+      .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+      .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageRead |
+                        vk::AccessFlagBits2::eShaderStorageWrite)
+      .setBuffer(count)
+      .setSize(VK_WHOLE_SIZE);
+  vk::DependencyInfo dependency;
+  dependency.setBufferMemoryBarriers(barrier);
+  cmdBuf.pipelineBarrier2(dependency);
+  recordGpuCull(cmdBuf, 0);
+  return asyncQueue->Submit(curFrame);
+}
 
-  Application::GetInstance().commandManager->FreeCmd(
-      cmdBuf);
+void Renderer::readGpuCull(uint32_t currentImage) {
+  auto &slot = cullSlots[currentImage];
+  auto &report = cullReport;
+  if (slot.statsPending) {
+    slot.statsPending = false;
+    const auto *counts =
+        static_cast<const uint32_t *>(resources.Get(slot.stats).map);
+    report.visible += counts[0] + counts[1];
+    report.late += counts[1];
+    report.inFrustum += counts[2];
+    report.occluded += counts[3];
+    report.frames++;
+  }
+  for (uint32_t i = 0; i < SectionCount; ++i) {
+    if (auto ms = gpuTimer->ReadSection(currentImage, i)) {
+      report.ms[i] += *ms;
+      report.timed[i]++;
+    }
+  }
+  const auto now = std::chrono::steady_clock::now();
+  if (report.frames == 0) {
+    report.start = now;
+    return;
+  }
+  if (now - report.start < std::chrono::seconds(1)) {
+    return;
+  }
+  auto average = [&](uint32_t i) {
+    return report.timed[i] ? report.ms[i] / report.timed[i] : 0.0;
+  };
+  const double frames = report.frames;
+  std::cout << "gpu cull : " << report.visible / frames << " visible / "
+            << report.inFrustum / frames << " in frustum";
+  if (twoPhase) {
+    std::cout << " (" << report.occluded / frames << " occluded, "
+              << report.late / frames << " disoccluded)";
+  }
+  if (report.timed[SectionCullEarly] || report.timed[SectionCullLate]) {
+    std::cout << ", cull "
+              << average(SectionCullEarly) + average(SectionCullLate)
+              << " ms";
+  }
+  if (twoPhase) {
+    std::cout << ", hi-z build " << average(SectionHiZBuild) << " ms";
+  }
+  std::cout << '\n';
+  report = CullReport{};
+  report.start = now;
+}
+
+auto Renderer::gpuDriven() const -> bool {
+  return gpuCulling && !bench && !overdraw && !tiled;
+}
+
+void Renderer::SetGpuCulling(bool enable) {
+  if (gpuCulling == enable) {
+    return;
+  }
+  auto &app = Application::GetInstance();
+  if (enable && !cullProcess) {
+    // 与 createDevice 中的开启条件一致
+    const auto features = app.phyDevice.getFeatures();
+    const auto features12 =
+        app.phyDevice
+            .getFeatures2<vk::PhysicalDeviceFeatures2,
+                vk::PhysicalDeviceVulkan12Features>()
+            .get<vk::PhysicalDeviceVulkan12Features>();
+    if (!features.multiDrawIndirect ||
+        !features.drawIndirectFirstInstance ||
+        !features12.drawIndirectCount) {
+      std::cerr << "gpu culling : no indirect count draw support, "
+                   "keep culling on CPU\n";
+      return;
+    }
+    // 物体、实例、绘制参数、绘制数量、裁剪参数、深度金字塔、重测标记
+    cullProcess =
+        std::make_unique<ComputeProcess>(readSpvFile("spv/cull.spv"));
+    // 没有开启遮挡裁剪时也要绑定，只是不会构建
+    pyramid = std::make_unique<DepthPyramid>(maxFlightCount);
+    const auto sets = cullProcess->AllocSets(maxFlightCount);
+    cullSlots.resize(maxFlightCount);
+    for (int i = 0; i < maxFlightCount; ++i) {
+      cullSlots[i].set = sets[i];
+    }
+  }
+  gpuCulling = enable;
+  if (enable) {
+    // 开启期间不更新 CPU 侧的包围盒，关闭后整体重建
+    culler.Clear();
+  }
+  // 帧图多了 / 少了裁剪 pass
+  app.deletionQueue->Retire(graph.Release());
+  std::cout << "gpu culling : " << (enable ? "on" : "off") << '\n';
+}
+
+void Renderer::SetOcclusionCulling(bool enable) {
+  if (enable) {
+    SetGpuCulling(true);
+    if (!gpuCulling) {
+      return;
+    }
+  }
+  if (occlusionCulling == enable) {
+    return;
+  }
+  occlusionCulling = enable;
+  // 帧图多了金字塔构建与后期阶段
+  Application::GetInstance().deletionQueue->Retire(graph.Release());
+  std::cout << "occlusion culling : " << (enable ? "on" : "off") << '\n';
+}
+
+void Renderer::SetAsyncCompute(bool enable) {
+  if (enable) {
+    SetGpuCulling(true);
+    if (!gpuCulling) {
+      return;
+    }
+    if (!AsyncCompute::Supported()) {
+      std::cerr << "async compute : no dedicated compute queue family, "
+                   "keep culling on graphics queue\n";
+      return;
+    }
+    if (!asyncQueue) {
+      asyncQueue = std::make_unique<AsyncCompute>(maxFlightCount);
+    }
+  }
+  if (asyncCompute == enable) {
+    return;
+  }
+  asyncCompute = enable;
+  // 帧图少了 / 多了清零与裁剪 pass
+  Application::GetInstance().deletionQueue->Retire(graph.Release());
+  std::cout << "async compute : " << (enable ? "on" : "off") << '\n';
+}
+
+void Renderer::SpawnObjects(uint32_t count) {
+  // 铺在四边形下方的平面上，边长随数量增长，大部分落在视锥外
+  const auto side =
+      static_cast<uint32_t>(std::ceil(std::sqrt(double(count))));
+  constexpr float Spacing = 0.3f;
+  const float half = 0.5f * Spacing * float(side);
+  for (uint32_t i = 0; i < count; ++i) {
+    Scene::Transform local;
+    local.translation = glm::vec3(Spacing * float(i % side) - half,
+        Spacing * float(i / side) - half, -0.5f);
+    local.scale = glm::vec3(0.2f);
+    scene.AddNode(sceneRoot, local);
+  }
+}
+
+void Renderer::copyBuffer(vk::Buffer &src, vk::Buffer &dst,
+    size_t size, size_t srcOffset, size_t dstOffset) {
+  auto &app = Application::GetInstance();
+  app.commandManager->ExecuteCmd(
+      app.graphicQueue, [&](vk::CommandBuffer cmdBuf) {
+        vk::BufferCopy region;
+        region.setSize(size)
+            .setSrcOffset(srcOffset)
+            .setDstOffset(dstOffset);
+        cmdBuf.copyBuffer(src, dst, region);
+      });
 }
 
 void Renderer::updateUniformBuffer(uint32_t currentImage) {
   auto &swapchainExtentInfo =
       Application::GetInstance()
           .swapchain->info.imageExtent;
-  static auto startTime =
-      std::chrono::high_resolution_clock::now();
-  auto currentTime =
-      std::chrono::high_resolution_clock::now();
-  float time = std::chrono::duration<float,
-      std::chrono::seconds::period>(currentTime - startTime)
-                   .count();
+  const auto time = float(snapshot_.time);
   MVP ubo;
-  ubo.model = glm::rotate(glm::mat4(1.0f),
-      time * glm::radians(90.0f),
-      glm::vec3(0.0f, 0.0f, 1.0f));
+  ubo.model = snapshot_.model;
+  if (bench) {
+    // 固定不动并缩小到几十个像素，纹理被大幅缩小采样
+    ubo.model =
+        glm::scale(glm::mat4(1.0f), glm::vec3(0.08f));
+  } else if (tiled) {
+    // 在 1x ~ 64x 之间来回缩放，覆盖金字塔的各级
+    const float zoom =
+        std::exp2(3.0f - 3.0f * std::cos(time * 0.2f));
+    ubo.model = glm::scale(glm::mat4(1.0f), glm::vec3(zoom));
+  }
   ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f),
       glm::vec3(0.0f, 0.0f, 0.0f),
       glm::vec3(0.0f, 0.0f, 1.0f));
@@ -313,59 +1267,113 @@ void Renderer::updateUniformBuffer(uint32_t currentImage) {
       swapchainExtentInfo.width /
           (float)swapchainExtentInfo.height,
       0.1f, 10.0f);
+  if (overdraw) {
+    // 正对层叠的四边形
+    ubo.model = glm::mat4(1.0f);
+    ubo.view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f),
+        glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  }
   ubo.project[1][1] *= -1;
-  memcpy(hostUniformBuffers[currentImage]->map, &ubo,
+  mvpMat_ = ubo.project * ubo.view * ubo.model;
+  sceneView_ = ubo.view * ubo.model;
+  // 该 slot 上一帧已经完成，staging 可以直接覆盖
+  memcpy(resources.Get(hostUniformBuffers[currentImage]).map, &ubo,
       sizeof(ubo));
-  copyBuffer(hostUniformBuffers[currentImage]->buffer,
-      deviceUniformBuffers[currentImage]->buffer,
-      hostUniformBuffers[currentImage]->size, 0, 0);
 }
 
-// bind uniform
+void Renderer::recordUniformUpload(
+    vk::CommandBuffer cmdBuf, uint32_t currentImage) {
+  auto &tracker = *Application::GetInstance().resourceTracker;
+  auto &src = resources.Get(hostUniformBuffers[currentImage]);
+  auto dst = resources.Get(deviceUniformBuffers[currentImage]).buffer;
+  tracker.Use(dst, ResourceState::TransferDst());
+  tracker.Flush(cmdBuf);
+  vk::BufferCopy region;
+  region.setSize(src.size);
+  cmdBuf.copyBuffer(src.buffer, dst, region);
+  tracker.Use(dst, {vk::PipelineStageFlagBits2::eVertexShader,
+                       vk::AccessFlagBits2::eUniformRead});
+  tracker.Flush(cmdBuf);
+}
+
+// 描述符集可能还被在途的帧使用，只做标记，
+// 每个 slot 在自己的 fence 返回后再改写
 void Renderer::updateDescriptorSets() {
-  for (size_t i = 0; i < descriptorSets.size(); i++) {
-    // bind MVP buffer
-    vk::DescriptorBufferInfo bufferInfo1;
-    bufferInfo1.setBuffer(deviceUniformBuffers[i]->buffer)
-        .setOffset(0)
-        .setRange(sizeof(MVP));
-
-    // bind sampler
-    vk::DescriptorImageInfo imageInfo;
-    imageInfo
-        .setImageLayout(
-            vk::ImageLayout::eShaderReadOnlyOptimal)
-        .setImageView(texture->view)
-        .setSampler(sampler);
-
-    std::array<vk::WriteDescriptorSet, 2> writeInfos;
-    writeInfos[0]
-        .setBufferInfo(bufferInfo1)
-        .setDstBinding(0)
-        .setDescriptorType(
-            vk::DescriptorType::eUniformBuffer)
-        .setDescriptorCount(1)
-        .setDstArrayElement(0)
-        .setDstSet(descriptorSets[i].set);
-
-    writeInfos[1]
-        .setImageInfo(imageInfo)
-        .setDstBinding(1)
-        .setDstArrayElement(0)
-        .setDstSet(descriptorSets[i].set)
-        .setDescriptorCount(1)
-        .setDescriptorType(
-            vk::DescriptorType::eCombinedImageSampler);
-
-    Application::GetInstance().device.updateDescriptorSets(
-        writeInfos, {});
-  }
+  descriptorDirty.assign(descriptorSets.size(), true);
+}
+
+// bind uniform
+void Renderer::writeDescriptorSet(size_t i) {
+  descriptorDirty[i] = false;
+  // bind MVP buffer
+  vk::DescriptorBufferInfo bufferInfo1;
+  bufferInfo1.setBuffer(resources.Get(deviceUniformBuffers[i]).buffer)
+      .setOffset(0)
+      .setRange(sizeof(MVP));
+
+  // bind sampler
+  vk::DescriptorImageInfo imageInfo;
+  imageInfo
+      .setImageLayout(
+          vk::ImageLayout::eShaderReadOnlyOptimal)
+      .setImageView(tiled      ? tiled->View()
+                    : streamed ? streamer->View(streamed)
+                               : texture->view)
+      .setSampler(activeSampler());
+
+  // 场景节点的世界矩阵
+  vk::DescriptorBufferInfo instanceInfo;
+  instanceInfo.setBuffer(resources.Get(instanceBuffers[i]).buffer)
+      .setOffset(0)
+      .setRange(VK_WHOLE_SIZE);
+
+  std::array<vk::WriteDescriptorSet, 3> writeInfos;
+  writeInfos[0]
+      .setBufferInfo(bufferInfo1)
+      .setDstBinding(0)
+      .setDescriptorType(
+          vk::DescriptorType::eUniformBuffer)
+      .setDescriptorCount(1)
+      .setDstArrayElement(0)
+      .setDstSet(descriptorSets[i].set);
+
+  writeInfos[1]
+      .setImageInfo(imageInfo)
+      .setDstBinding(1)
+      .setDstArrayElement(0)
+      .setDstSet(descriptorSets[i].set)
+      .setDescriptorCount(1)
+      .setDescriptorType(
+          vk::DescriptorType::eCombinedImageSampler);
+
+  writeInfos[2]
+      .setBufferInfo(instanceInfo)
+      .setDstBinding(2)
+      .setDstArrayElement(0)
+      .setDstSet(descriptorSets[i].set)
+      .setDescriptorCount(1)
+      .setDescriptorType(vk::DescriptorType::eStorageBuffer);
+
+  Application::GetInstance().device.updateDescriptorSets(
+      writeInfos, {});
 }
 
 auto Renderer::createTexture() -> void {
-  texture = std::make_unique<Texture>(
-      "resources/RT.png", sampler);
+  auto &app = Application::GetInstance();
+  auto scope = app.startup.Measure("texture upload");
+  // 优先使用启动时后台解码好的图像
+  texture = TextureManager::Instance().Load(
+      DefaultTexturePath, [&] {
+        return app.preload.texture.valid()
+                   ? app.preload.texture.get()
+                   : LoadImageData(DefaultTexturePath);
+      });
 }
+auto Renderer::createStreamer() -> void {
+  streamer = std::make_unique<TextureStreamer>(
+      resources.Get(sampler), TextureStreamer::Config{});
+}
+
 auto Renderer::createSampler() -> void {
   vk::SamplerCreateInfo createInfo;
   createInfo.setMagFilter(vk::Filter::eLinear)
@@ -377,9 +1385,341 @@ auto Renderer::createSampler() -> void {
       .setBorderColor(vk::BorderColor::eIntOpaqueBlack)
       .setUnnormalizedCoordinates(false)
       .setCompareEnable(false)
-      .setMipmapMode(vk::SamplerMipmapMode::eLinear);
-  sampler = Application::GetInstance().device.createSampler(
-      createInfo);
+      .setMipmapMode(vk::SamplerMipmapMode::eLinear)
+      .setMipLodBias(0.0f)
+      .setMinLod(0.0f)
+      // 不额外限制，由每张纹理 view 的层数决定
+      .setMaxLod(VK_LOD_CLAMP_NONE);
+  sampler = resources.CreateSampler(createInfo);
+  createInfo.setMaxLod(0.0f);
+  baseLevelSampler = resources.CreateSampler(createInfo);
+}
+
+void Renderer::ShowTiledImage(const std::string &path) {
+  // 旧的金字塔由析构交给延迟销毁
+  tiled = std::make_unique<TiledImage>(
+      path, TiledImage::Config{}, maxFlightCount);
+  updateDescriptorSets();
+}
+
+void Renderer::ShowStreamedTexture(const std::string &path) {
+  // 旧的请求还没完成时取消，已驻留的纹理随句柄释放
+  if (streamed) {
+    streamer->Cancel(streamed);
+  }
+  streamed = streamer->Load(path, 1);
+  streamedResident = false;
+  updateDescriptorSets();
+}
+
+auto Renderer::activeSampler() const -> vk::Sampler {
+  return resources.Get(
+      bench && !bench->mipmapped ? baseLevelSampler : sampler);
+}
+
+void Renderer::StartMinifyBenchmark(uint32_t framesPerMode) {
+  if (!gpuTimer->Supported()) {
+    std::cerr << "minify benchmark : queue has no timestamp "
+                 "support\n";
+    return;
+  }
+  bench = MinifyBench{};
+  bench->framesPerMode = framesPerMode;
+  bench->modeStart = frameIndex;
+  updateDescriptorSets();
+}
+
+void Renderer::stepBenchmark(
+    uint64_t frame, std::optional<double> gpuMs) {
+  if (!bench) {
+    return;
+  }
+  auto &b = *bench;
+  const int mode = b.mipmapped ? 1 : 0;
+  // 切换之前录制的帧属于上一种模式，丢弃
+  if (frame < b.modeStart) {
+    return;
+  }
+  // 前几帧包含流式上传等干扰，不计入
+  if (b.warmup < 30) {
+    b.warmup++;
+    return;
+  }
+  if (gpuMs) {
+    b.gpuMs[mode] += *gpuMs;
+    b.samples[mode]++;
+  }
+  if (b.samples[mode] < b.framesPerMode) {
+    return;
+  }
+
+  auto &app = Application::GetInstance();
+  if (!b.mipmapped) {
+    b.mipmapped = true;
+    b.warmup = 0;
+    b.modeStart = frameIndex;
+    updateDescriptorSets();
+    return;
+  }
+
+  const auto extent = app.swapchain->info.imageExtent;
+  std::cout << "minify benchmark : " << texture->width << "x"
+            << texture->height << " texture, "
+            << texture->mipLevels << " mips, 256 quads at "
+            << extent.width << "x" << extent.height << "\n";
+  std::cout << "  base level only : "
+            << b.gpuMs[0] / b.samples[0] << " ms/frame\n";
+  std::cout << "  mipmapped       : "
+            << b.gpuMs[1] / b.samples[1] << " ms/frame\n";
+  bench.reset();
+  updateDescriptorSets();
+  glfwSetWindowShouldClose(app.window, GLFW_TRUE);
+}
+
+void Renderer::SetMsaa(uint32_t samples) {
+  auto &app = Application::GetInstance();
+  const auto count = app.renderProcess->SupportedSampleCount(samples);
+  if (count == app.renderProcess->samples) {
+    return;
+  }
+  // 旧管线与旧的多重采样附件都交给延迟销毁
+  app.renderProcess->SetSampleCount(count, *app.shader);
+  app.deletionQueue->Retire(graph.Release());
+  std::cout << "msaa : " << vk::to_string(count) << '\n';
+}
+
+void Renderer::SetDepthPrepass(bool enable) {
+  if (depthPrepass == enable) {
+    return;
+  }
+  // 帧图结构变化，旧的临时深度图可能仍在使用
+  depthPrepass = enable;
+  Application::GetInstance().deletionQueue->Retire(graph.Release());
+}
+
+void Renderer::StartOverdrawBenchmark(uint32_t framesPerMode) {
+  if (!gpuTimer->Supported()) {
+    std::cerr << "overdraw benchmark : queue has no timestamp "
+                 "support\n";
+    return;
+  }
+  if (!pipelineStats->Supported()) {
+    std::cerr << "overdraw benchmark : no pipeline statistics, "
+                 "only GPU time is reported\n";
+  }
+  overdraw = OverdrawBench{};
+  overdraw->framesPerMode = framesPerMode;
+  overdraw->modeStart = frameIndex;
+  overdraw->prepassBefore = depthPrepass;
+  SetDepthPrepass(false);
+}
+
+void Renderer::stepOverdrawBenchmark(uint64_t frame,
+    std::optional<double> gpuMs, std::optional<uint64_t> fragments) {
+  if (!overdraw) {
+    return;
+  }
+  auto &b = *overdraw;
+  if (frame < b.modeStart) {
+    return;
+  }
+  if (b.warmup < 30) {
+    b.warmup++;
+    return;
+  }
+  if (gpuMs) {
+    b.gpuMs[b.mode] += *gpuMs;
+    b.samples[b.mode]++;
+  }
+  if (fragments) {
+    b.fragments[b.mode] += *fragments;
+    b.fragmentSamples[b.mode]++;
+  }
+  if (b.samples[b.mode] < b.framesPerMode) {
+    return;
+  }
+
+  auto &app = Application::GetInstance();
+  if (b.mode + 1 < OverdrawBench::Modes) {
+    b.mode++;
+    b.warmup = 0;
+    b.modeStart = frameIndex;
+    SetDepthPrepass(b.mode == 2);
+    return;
+  }
+
+  const auto extent = app.swapchain->info.imageExtent;
+  const double pixels = double(extent.width) * extent.height;
+  std::cout << "overdraw benchmark : 32 full-screen layers at "
+            << extent.width << "x" << extent.height << "\n";
+  const char *names[OverdrawBench::Modes] = {
+      "back to front  ", "front to back  ", "depth prepass  "};
+  const double worst = b.fragmentSamples[0] > 0
+                           ? double(b.fragments[0]) / b.fragmentSamples[0]
+                           : 0.0;
+  for (int i = 0; i < OverdrawBench::Modes; ++i) {
+    std::cout << "  " << names[i] << ": " << b.gpuMs[i] / b.samples[i]
+              << " ms/frame";
+    if (b.fragmentSamples[i] > 0) {
+      const double perFrame =
+          double(b.fragments[i]) / b.fragmentSamples[i];
+      std::cout << ", " << perFrame / pixels << " fragments/pixel";
+      if (i > 0 && worst > 0) {
+        std::cout << " (" << 100.0 * (1.0 - perFrame / worst)
+                  << "% saved)";
+      }
+    }
+    std::cout << "\n";
+  }
+  const bool prepass = b.prepassBefore;
+  overdraw.reset();
+  SetDepthPrepass(prepass);
+  glfwSetWindowShouldClose(app.window, GLFW_TRUE);
+}
+
+static auto isBgra8Format(vk::Format format) -> bool {
+  switch (format) {
+  case vk::Format::eB8G8R8A8Unorm:
+  case vk::Format::eB8G8R8A8Snorm:
+  case vk::Format::eB8G8R8A8Uint:
+  case vk::Format::eB8G8R8A8Sint:
+  case vk::Format::eB8G8R8A8Srgb:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static auto isRgba8Format(vk::Format format) -> bool {
+  switch (format) {
+  case vk::Format::eR8G8B8A8Unorm:
+  case vk::Format::eR8G8B8A8Snorm:
+  case vk::Format::eR8G8B8A8Uint:
+  case vk::Format::eR8G8B8A8Sint:
+  case vk::Format::eR8G8B8A8Srgb:
+    return true;
+  default:
+    return false;
+  }
+}
+
+void Renderer::StartCapture(
+    const FrameCapture::Config &config) {
+  auto &swapchain = Application::GetInstance().swapchain;
+  auto &info = swapchain->info;
+  if (!(info.usage & vk::ImageUsageFlagBits::eTransferSrc)) {
+    throw std::runtime_error(
+        "swapchain image can not be copied for capture");
+  }
+  if (!isRgba8Format(info.format.format) &&
+      !isBgra8Format(info.format.format)) {
+    throw std::runtime_error(
+        "capture only supports 8 bit RGBA/BGRA swapchain");
+  }
+  // 上一次截帧还在途的回读直接丢弃
+  finishCapture();
+  capture = std::make_unique<FrameCapture>(config);
+  // 多了回读 pass，帧图要重建
+  Application::GetInstance().deletionQueue->Retire(graph.Release());
+
+  // in-flight 帧 + 排队中的帧 + 正在编码的帧
+  const size_t slotCount = maxFlightCount +
+                           capture->QueueCapacity() +
+                           capture->WorkerCount();
+  captureExtent = info.imageExtent;
+  const size_t size = size_t(info.imageExtent.width) *
+                      info.imageExtent.height * 4;
+  captureSlots.resize(slotCount);
+  // 回读优先使用带 cache 的内存，CPU 读取快得多
+  constexpr auto Coherent = vk::MemoryPropertyFlagBits::eHostVisible |
+                            vk::MemoryPropertyFlagBits::eHostCoherent;
+  const auto memory = PickBufferMemory(
+      vk::BufferUsageFlagBits::eTransferDst,
+      {Coherent | vk::MemoryPropertyFlagBits::eHostCached, Coherent});
+  for (auto &slot : captureSlots) {
+    slot = std::make_unique<CaptureSlot>();
+    slot->buffer = std::make_unique<BufferPkg>(
+        size, vk::BufferUsageFlagBits::eTransferDst, memory);
+  }
+  pendingCaptures.assign(maxFlightCount, -1);
+}
+
+void Renderer::StopCapture() {
+  if (!capture || captureStopping) {
+    return;
+  }
+  // 不再录制回读 pass，旧帧图交给延迟销毁；
+  // 已经提交的回读在各自的 fence 返回后照常写出，全部交出后再收尾
+  captureStopping = true;
+  Application::GetInstance().deletionQueue->Retire(graph.Release());
+  if (std::all_of(pendingCaptures.begin(), pendingCaptures.end(),
+          [](int slot) { return slot < 0; })) {
+    finishCapture();
+  }
+}
+
+void Renderer::finishCapture() {
+  captureStopping = false;
+  if (!capture) {
+    return;
+  }
+  // 析构时等待 worker 写完，之后才能释放回读缓冲；
+  // 缓冲析构交给延迟销毁，在途帧写完后才真正释放
+  capture.reset();
+  captureSlots.clear();
+  pendingCaptures.clear();
+}
+
+auto Renderer::acquireCaptureSlot() -> int {
+  for (size_t i = 0; i < captureSlots.size(); ++i) {
+    if (!captureSlots[i]->busy.load(
+            std::memory_order_acquire)) {
+      captureSlots[i]->busy.store(true);
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+void Renderer::submitCapture(int frame) {
+  if (!capture || pendingCaptures[frame] < 0) {
+    return;
+  }
+  auto &slot = *captureSlots[pendingCaptures[frame]];
+  pendingCaptures[frame] = -1;
+
+  auto &info = Application::GetInstance().swapchain->info;
+  FrameCapture::Frame f;
+  f.pixels = static_cast<const uint8_t *>(slot.buffer->map);
+  f.width = captureExtent.width;
+  f.height = captureExtent.height;
+  f.rowPitch = f.width * 4;
+  f.bgra = isBgra8Format(info.format.format);
+  f.busy = &slot.busy;
+  if (!capture->Submit(f)) {
+    slot.busy.store(false);
+  }
+}
+
+// 布局转换与对 host 可见的屏障由帧图生成
+void Renderer::recordCapture(
+    vk::CommandBuffer cmdBuf, vk::Image image, vk::Buffer dst) {
+  auto &swapchain = Application::GetInstance().swapchain;
+  vk::ImageSubresourceLayers layers;
+  layers.setAspectMask(vk::ImageAspectFlagBits::eColor)
+      .setMipLevel(0)
+      .setBaseArrayLayer(0)
+      .setLayerCount(1);
+  vk::BufferImageCopy region;
+  region.setBufferOffset(0)
+      .setBufferRowLength(0)
+      .setBufferImageHeight(0)
+      .setImageSubresource(layers)
+      .setImageOffset({0, 0, 0})
+      .setImageExtent({swapchain->info.imageExtent.width,
+          swapchain->info.imageExtent.height, 1});
+  cmdBuf.copyImageToBuffer(
+      image, vk::ImageLayout::eTransferSrcOptimal, dst, region);
 }
 
 } // namespace app
@@ -0,0 +1,125 @@
+#include "../header/resourcePool.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+
+namespace app {
+
+namespace {
+
+// 与 BufferPkg 大小相近的记录
+struct Record {
+  uint64_t buffer = 0;
+  uint64_t memory = 0;
+  void *map = nullptr;
+  size_t size = 0;
+  size_t requireSize = 0;
+};
+
+template <typename F>
+auto measureNs(uint32_t rounds, uint64_t ops, F &&func) -> double {
+  const auto begin = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; ++r) {
+    func();
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - begin).count() /
+         (double(rounds) * double(ops));
+}
+
+} // namespace
+
+void BenchmarkHandles(uint32_t count) {
+  std::mt19937 rng(42);
+
+  // 模拟运行一段时间后的堆：对象之间夹着其他分配，
+  // 创建顺序与访问顺序无关
+  std::vector<std::unique_ptr<Record>> owned;
+  std::vector<std::unique_ptr<char[]>> noise;
+  Pool<Record> pool;
+  std::vector<Pool<Record>::Id> ids;
+  owned.reserve(count);
+  ids.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    noise.push_back(std::make_unique<char[]>(16 + rng() % 256));
+    owned.push_back(std::make_unique<Record>());
+    owned.back()->size = i;
+    ids.push_back(pool.Emplace());
+    pool.Get(ids.back()).size = i;
+  }
+  // 删掉一半噪声留下空洞，再把一半对象删除重建，槽位被复用
+  for (size_t i = 0; i < noise.size(); i += 2) {
+    noise[i].reset();
+  }
+  uint32_t stale = 0;
+  for (uint32_t i = 0; i < count; i += 2) {
+    const auto old = ids[i];
+    pool.Erase(old);
+    ids[i] = pool.Emplace();
+    pool.Get(ids[i]).size = i;
+    stale += pool.TryGet(old) == nullptr ? 1 : 0;
+    owned[i] = std::make_unique<Record>();
+    owned[i]->size = i;
+  }
+
+  // 绘制列表按随机顺序引用资源
+  std::vector<uint32_t> order(count);
+  std::iota(order.begin(), order.end(), 0u);
+  std::shuffle(order.begin(), order.end(), rng);
+  std::vector<Record *> pointers(count);
+  std::vector<Pool<Record>::Id> handles(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    pointers[i] = owned[order[i]].get();
+    handles[i] = ids[order[i]];
+  }
+
+  const uint32_t rounds = std::max(1u, 20'000'000u / std::max(count, 1u));
+  volatile size_t sink = 0;
+  const double pointerLookup = measureNs(rounds, count, [&] {
+    size_t sum = 0;
+    for (auto *record : pointers) {
+      sum += record->size;
+    }
+    sink = sink + sum;
+  });
+  const double handleLookup = measureNs(rounds, count, [&] {
+    size_t sum = 0;
+    for (auto id : handles) {
+      sum += pool.Get(id).size;
+    }
+    sink = sink + sum;
+  });
+  // 遍历全部：指针按持有顺序逐个解引用，池直接扫数组
+  const double pointerIterate = measureNs(rounds, count, [&] {
+    size_t sum = 0;
+    for (auto &record : owned) {
+      sum += record->size;
+    }
+    sink = sink + sum;
+  });
+  const double poolIterate = measureNs(rounds, count, [&] {
+    size_t sum = 0;
+    for (auto &record : pool) {
+      sum += record.size;
+    }
+    sink = sink + sum;
+  });
+
+  std::cout << "handle benchmark : " << count << " records, "
+            << sizeof(Record) << " bytes each"
+#ifndef NDEBUG
+            << " (debug, generation checked on every Get)"
+#endif
+            << "\n";
+  std::cout << "  random lookup   : unique_ptr " << pointerLookup
+            << " ns, handle " << handleLookup << " ns\n";
+  std::cout << "  iterate all     : unique_ptr " << pointerIterate
+            << " ns, pool " << poolIterate << " ns\n";
+  std::cout << "  stale handles detected : " << stale << " / "
+            << (count + 1) / 2 << "\n";
+}
+
+} // namespace app
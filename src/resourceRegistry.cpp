@@ -0,0 +1,54 @@
+#include "../header/resourceRegistry.h"
+#include "../header/application.h"
+
+namespace app {
+
+ResourceRegistry::~ResourceRegistry() {
+  auto &queue = *Application::GetInstance().deletionQueue;
+  for (auto sampler : samplers_) {
+    queue.Retire(sampler);
+  }
+  for (auto pipeline : pipelines_) {
+    queue.Retire(pipeline);
+  }
+  // 缓冲在自己的析构里退休
+}
+
+auto ResourceRegistry::CreateBuffer(size_t size,
+    vk::BufferUsageFlags usage, vk::MemoryPropertyFlags property,
+    bool shared) -> BufferId {
+  return buffers_.Emplace(size, usage, property, shared);
+}
+
+auto ResourceRegistry::CreateSampler(const vk::SamplerCreateInfo &info)
+    -> SamplerId {
+  return samplers_.Emplace(
+      Application::GetInstance().device.createSampler(info));
+}
+
+auto ResourceRegistry::AddPipeline(vk::Pipeline pipeline) -> PipelineId {
+  return pipelines_.Emplace(pipeline);
+}
+
+void ResourceRegistry::Destroy(BufferId id) {
+  if (id) {
+    buffers_.Erase(id);
+  }
+}
+
+void ResourceRegistry::Destroy(SamplerId id) {
+  if (id) {
+    Application::GetInstance().deletionQueue->Retire(samplers_.Get(id));
+    samplers_.Erase(id);
+  }
+}
+
+void ResourceRegistry::Destroy(PipelineId id) {
+  if (id) {
+    Application::GetInstance().deletionQueue->Retire(
+        pipelines_.Get(id));
+    pipelines_.Erase(id);
+  }
+}
+
+} // namespace app
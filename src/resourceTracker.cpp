@@ -0,0 +1,305 @@
+#include "../header/resourceTracker.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace app {
+
+namespace {
+
+constexpr vk::AccessFlags2 WriteAccess =
+    vk::AccessFlagBits2::eShaderWrite |
+    vk::AccessFlagBits2::eShaderStorageWrite |
+    vk::AccessFlagBits2::eColorAttachmentWrite |
+    vk::AccessFlagBits2::eDepthStencilAttachmentWrite |
+    vk::AccessFlagBits2::eTransferWrite |
+    vk::AccessFlagBits2::eHostWrite |
+    vk::AccessFlagBits2::eMemoryWrite;
+
+auto hasWrite(vk::AccessFlags2 access) -> bool {
+  return static_cast<bool>(access & WriteAccess);
+}
+
+// 除子资源范围外完全相同的两个屏障可以合并
+auto sameBarrier(const vk::ImageMemoryBarrier2 &a,
+    const vk::ImageMemoryBarrier2 &b) -> bool {
+  return a.image == b.image && a.srcStageMask == b.srcStageMask &&
+         a.srcAccessMask == b.srcAccessMask &&
+         a.dstStageMask == b.dstStageMask &&
+         a.dstAccessMask == b.dstAccessMask &&
+         a.oldLayout == b.oldLayout && a.newLayout == b.newLayout;
+}
+
+} // namespace
+
+auto ResourceState::TransferDst() -> ResourceState {
+  return {vk::PipelineStageFlagBits2::eTransfer,
+      vk::AccessFlagBits2::eTransferWrite,
+      vk::ImageLayout::eTransferDstOptimal};
+}
+
+auto ResourceState::TransferSrc() -> ResourceState {
+  return {vk::PipelineStageFlagBits2::eTransfer,
+      vk::AccessFlagBits2::eTransferRead,
+      vk::ImageLayout::eTransferSrcOptimal};
+}
+
+auto ResourceState::FragmentRead() -> ResourceState {
+  return {vk::PipelineStageFlagBits2::eFragmentShader,
+      vk::AccessFlagBits2::eShaderSampledRead,
+      vk::ImageLayout::eShaderReadOnlyOptimal};
+}
+
+auto ResourceState::Writes() const -> vk::AccessFlags2 {
+  return access & WriteAccess;
+}
+
+auto NeedsBarrier(ResourceState &current, const ResourceState &next)
+    -> bool {
+  const bool fresh =
+      current.stage == vk::PipelineStageFlagBits2::eNone;
+  if (current.layout == next.layout &&
+      (fresh || (!hasWrite(current.access) &&
+                    !hasWrite(next.access)))) {
+    // 读后读不需要同步，记住所有读者，后面的写要等它们
+    current.stage |= next.stage;
+    current.access |= next.access;
+    return false;
+  }
+  return true;
+}
+
+void ResourceTracker::Track(vk::Image image, uint32_t mipLevels,
+    uint32_t layers, vk::ImageAspectFlags aspect,
+    const ResourceState &initial) {
+  ImageEntry entry;
+  entry.levels = mipLevels;
+  entry.layers = layers;
+  entry.aspect = aspect;
+  entry.states.assign(size_t(mipLevels) * layers, initial);
+  entry.pending.assign(entry.states.size(), -1);
+  images_[image] = std::move(entry);
+}
+
+void ResourceTracker::Track(
+    vk::Buffer buffer, const ResourceState &initial) {
+  buffers_[buffer] = {initial, -1};
+}
+
+void ResourceTracker::Forget(vk::Image image) {
+  images_.erase(image);
+  // 暂存的屏障不能再引用已销毁的图像
+  pendingImages_.erase(
+      std::remove_if(pendingImages_.begin(), pendingImages_.end(),
+          [&](const PendingImage &p) { return p.image == image; }),
+      pendingImages_.end());
+  for (auto &[handle, entry] : images_) {
+    std::fill(entry.pending.begin(), entry.pending.end(), -1);
+  }
+  for (size_t i = 0; i < pendingImages_.size(); ++i) {
+    const auto &p = pendingImages_[i];
+    auto &entry = images_.at(p.image);
+    entry.pending[size_t(p.layer) * entry.levels + p.level] =
+        static_cast<int32_t>(i);
+  }
+}
+
+void ResourceTracker::Forget(vk::Buffer buffer) {
+  auto it = buffers_.find(buffer);
+  if (it == buffers_.end()) {
+    return;
+  }
+  if (it->second.pending >= 0) {
+    // 已经没有命令会访问它，屏障失去意义
+    pendingBuffers_[it->second.pending].setDstStageMask(
+        vk::PipelineStageFlagBits2::eNone);
+  }
+  buffers_.erase(it);
+}
+
+void ResourceTracker::Use(vk::Image image,
+    const ResourceState &next, uint32_t baseLevel,
+    uint32_t levelCount, uint32_t baseLayer,
+    uint32_t layerCount) {
+  auto it = images_.find(image);
+  if (it == images_.end()) {
+    throw std::runtime_error("image is not tracked");
+  }
+  auto &entry = it->second;
+  const uint32_t levelEnd = levelCount == VK_REMAINING_MIP_LEVELS
+                                ? entry.levels
+                                : baseLevel + levelCount;
+  const uint32_t layerEnd = layerCount == VK_REMAINING_ARRAY_LAYERS
+                                ? entry.layers
+                                : baseLayer + layerCount;
+
+  for (uint32_t layer = baseLayer; layer < layerEnd; ++layer) {
+    for (uint32_t level = baseLevel; level < levelEnd; ++level) {
+      const size_t index = size_t(layer) * entry.levels + level;
+      auto &state = entry.states[index];
+      const int32_t pending = entry.pending[index];
+
+      if (pending >= 0) {
+        // 两次 Use 之间没有录制命令，直接改写暂存的屏障
+        auto &barrier = pendingImages_[pending].barrier;
+        if (!NeedsBarrier(state, next)) {
+          barrier.dstStageMask |= next.stage;
+          barrier.dstAccessMask |= next.access;
+        } else {
+          barrier.setNewLayout(next.layout)
+              .setDstStageMask(next.stage)
+              .setDstAccessMask(next.access);
+          state = next;
+        }
+        stats_.merged++;
+        continue;
+      }
+      if (!NeedsBarrier(state, next)) {
+        continue;
+      }
+
+      vk::ImageMemoryBarrier2 barrier;
+      barrier.setImage(image)
+          .setSrcStageMask(state.stage)
+          // 读操作不需要 flush，只保留写
+          .setSrcAccessMask(state.access & WriteAccess)
+          .setDstStageMask(next.stage)
+          .setDstAccessMask(next.access)
+          .setOldLayout(state.layout)
+          .setNewLayout(next.layout)
+          .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+          .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+          .setSubresourceRange(
+              {entry.aspect, level, 1, layer, 1});
+      entry.pending[index] =
+          static_cast<int32_t>(pendingImages_.size());
+      pendingImages_.push_back({image, level, layer, barrier});
+      state = next;
+    }
+  }
+}
+
+void ResourceTracker::Use(
+    vk::Buffer buffer, const ResourceState &next) {
+  auto it = buffers_.find(buffer);
+  if (it == buffers_.end()) {
+    throw std::runtime_error("buffer is not tracked");
+  }
+  auto &entry = it->second;
+  ResourceState target = next;
+  target.layout = entry.state.layout;
+
+  if (entry.pending >= 0) {
+    auto &barrier = pendingBuffers_[entry.pending];
+    if (!NeedsBarrier(entry.state, target)) {
+      barrier.dstStageMask |= next.stage;
+      barrier.dstAccessMask |= next.access;
+    } else {
+      barrier.setDstStageMask(next.stage)
+          .setDstAccessMask(next.access);
+      entry.state = target;
+    }
+    stats_.merged++;
+    return;
+  }
+  if (!NeedsBarrier(entry.state, target)) {
+    return;
+  }
+
+  vk::BufferMemoryBarrier2 barrier;
+  barrier.setBuffer(buffer)
+      .setOffset(0)
+      .setSize(VK_WHOLE_SIZE)
+      .setSrcStageMask(entry.state.stage)
+      .setSrcAccessMask(entry.state.access & WriteAccess)
+      .setDstStageMask(next.stage)
+      .setDstAccessMask(next.access)
+      .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+  entry.pending = static_cast<int32_t>(pendingBuffers_.size());
+  pendingBuffers_.push_back(barrier);
+  entry.state = target;
+}
+
+void ResourceTracker::Flush(vk::CommandBuffer cmdBuf) {
+  for (auto &[handle, entry] : buffers_) {
+    entry.pending = -1;
+  }
+  std::vector<vk::BufferMemoryBarrier2> bufferBarriers;
+  for (const auto &barrier : pendingBuffers_) {
+    if (barrier.dstStageMask != vk::PipelineStageFlagBits2::eNone) {
+      bufferBarriers.push_back(barrier);
+    }
+  }
+  pendingBuffers_.clear();
+
+  for (const auto &p : pendingImages_) {
+    auto &entry = images_.at(p.image);
+    entry.pending[size_t(p.layer) * entry.levels + p.level] = -1;
+  }
+  std::sort(pendingImages_.begin(), pendingImages_.end(),
+      [](const PendingImage &a, const PendingImage &b) {
+        if (a.image != b.image) {
+          return VkImage(a.image) < VkImage(b.image);
+        }
+        if (a.layer != b.layer) {
+          return a.layer < b.layer;
+        }
+        return a.level < b.level;
+      });
+
+  // 先合并同一层里相邻的 mip，再合并 mip 范围相同的相邻层
+  std::vector<vk::ImageMemoryBarrier2> levelMerged;
+  for (const auto &p : pendingImages_) {
+    if (!levelMerged.empty()) {
+      auto &last = levelMerged.back();
+      auto &range = last.subresourceRange;
+      if (sameBarrier(last, p.barrier) &&
+          range.baseArrayLayer == p.layer &&
+          range.baseMipLevel + range.levelCount == p.level) {
+        range.levelCount++;
+        stats_.merged++;
+        continue;
+      }
+    }
+    levelMerged.push_back(p.barrier);
+  }
+  pendingImages_.clear();
+
+  std::vector<vk::ImageMemoryBarrier2> imageBarriers;
+  for (const auto &barrier : levelMerged) {
+    if (!imageBarriers.empty()) {
+      auto &last = imageBarriers.back();
+      auto &range = last.subresourceRange;
+      const auto &next = barrier.subresourceRange;
+      if (sameBarrier(last, barrier) &&
+          range.baseMipLevel == next.baseMipLevel &&
+          range.levelCount == next.levelCount &&
+          range.baseArrayLayer + range.layerCount ==
+              next.baseArrayLayer) {
+        range.layerCount += next.layerCount;
+        stats_.merged++;
+        continue;
+      }
+    }
+    imageBarriers.push_back(barrier);
+  }
+
+  if (imageBarriers.empty() && bufferBarriers.empty()) {
+    return;
+  }
+  vk::DependencyInfo dependency;
+  dependency.setImageMemoryBarriers(imageBarriers)
+      .setBufferMemoryBarriers(bufferBarriers);
+  cmdBuf.pipelineBarrier2(dependency);
+  stats_.flushes++;
+  stats_.imageBarriers += imageBarriers.size();
+  stats_.bufferBarriers += bufferBarriers.size();
+}
+
+auto ResourceTracker::State(vk::Image image, uint32_t level,
+    uint32_t layer) const -> const ResourceState & {
+  const auto &entry = images_.at(image);
+  return entry.states[size_t(layer) * entry.levels + level];
+}
+
+} // namespace app
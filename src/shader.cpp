@@ -1,5 +1,6 @@
 #include "../header/application.h"
 #include "../header/shader.h"
+#include "../header/drawList.h"
 #include "../header/math.h"
 #include "glm/fwd.hpp"
 
@@ -67,7 +68,7 @@ void Shader::initDescriptorSetLayouts() {
   //           .device.createDescriptorSetLayout(fragCreateInfo));
 
   vk::DescriptorSetLayoutCreateInfo CreateInfo;
-  std::array<vk::DescriptorSetLayoutBinding, 2> Binding;
+  std::array<vk::DescriptorSetLayoutBinding, 3> Binding;
   Binding[0]
       .setBinding(0)
       .setDescriptorCount(1)
@@ -80,6 +81,13 @@ void Shader::initDescriptorSetLayouts() {
       .setDescriptorType(
           vk::DescriptorType::eCombinedImageSampler)
       .setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+  // 场景节点的世界矩阵
+  Binding[2]
+      .setBinding(2)
+      .setDescriptorCount(1)
+      .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+      .setStageFlags(vk::ShaderStageFlagBits::eVertex);
   CreateInfo.setBindings(Binding);
   layouts.push_back(
       Application::GetInstance()
@@ -88,15 +96,12 @@ void Shader::initDescriptorSetLayouts() {
 
 auto Shader::GetPushConstantRange() const
     -> std::vector<vk::PushConstantRange> {
-  std::vector<vk::PushConstantRange> ranges(2);
+  // 顶点着色器的每次绘制模型矩阵与场景节点下标
+  std::vector<vk::PushConstantRange> ranges(1);
   ranges[0]
       .setOffset(0)
-      .setSize(sizeof(glm::mat4))
+      .setSize(sizeof(DrawConstants))
       .setStageFlags(vk::ShaderStageFlagBits::eVertex);
-  ranges[1]
-      .setOffset(sizeof(glm::mat4))
-      .setSize(sizeof(glm::vec3))
-      .setStageFlags(vk::ShaderStageFlagBits::eFragment);
   return ranges;
 }
 
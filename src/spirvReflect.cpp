@@ -0,0 +1,402 @@
+#include "../header/spirvReflect.h"
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace app {
+
+namespace {
+
+// SPIR-V 规范中的编号，只列出用到的
+constexpr uint32_t Magic = 0x07230203;
+constexpr uint32_t HeaderWords = 5;
+
+enum Op : uint32_t {
+  OpExecutionMode = 16,
+  OpTypeInt = 21,
+  OpTypeFloat = 22,
+  OpTypeVector = 23,
+  OpTypeMatrix = 24,
+  OpTypeImage = 25,
+  OpTypeSampler = 26,
+  OpTypeSampledImage = 27,
+  OpTypeArray = 28,
+  OpTypeRuntimeArray = 29,
+  OpTypeStruct = 30,
+  OpTypePointer = 32,
+  OpConstant = 43,
+  OpVariable = 59,
+  OpDecorate = 71,
+  OpMemberDecorate = 72,
+};
+
+enum Decoration : uint32_t {
+  DecorationBufferBlock = 3,
+  DecorationArrayStride = 6,
+  DecorationMatrixStride = 7,
+  DecorationBinding = 33,
+  DecorationDescriptorSet = 34,
+  DecorationOffset = 35,
+};
+
+enum StorageClass : uint32_t {
+  StorageUniformConstant = 0,
+  StorageUniform = 2,
+  StoragePushConstant = 9,
+  StorageStorageBuffer = 12,
+};
+
+constexpr uint32_t ExecutionModeLocalSize = 17;
+constexpr uint32_t DimBuffer = 5;
+// 规范的通用上限
+constexpr uint32_t MaxStructMembers = 16383;
+
+// 操作数不足说明模块损坏，直接拒绝
+void expectOperands(uint32_t count, uint32_t need) {
+  if (count < need) {
+    throw std::runtime_error("spir-v instruction has too few operands");
+  }
+}
+
+// 类型指令去掉结果 id 之后至少要有的操作数
+auto typeOperands(uint32_t op) -> uint32_t {
+  switch (op) {
+  case OpTypeFloat:
+  case OpTypeSampledImage:
+  case OpTypeRuntimeArray:
+    return 1;
+  case OpTypeInt:
+  case OpTypeVector:
+  case OpTypeMatrix:
+  case OpTypeArray:
+  case OpTypePointer:
+    return 2;
+  case OpTypeImage:
+    // 采样类型、维度、深度、数组、多重采样、sampled、格式
+    return 7;
+  default:
+    return 0;
+  }
+}
+
+// 类型指令去掉结果 id 之后的操作数
+struct Type {
+  uint32_t op = 0;
+  std::vector<uint32_t> operands;
+
+  [[nodiscard]] auto At(size_t i) const -> uint32_t {
+    if (i >= operands.size()) {
+      throw std::runtime_error("spir-v type operand out of range");
+    }
+    return operands[i];
+  }
+};
+
+struct Decorations {
+  std::optional<uint32_t> binding;
+  std::optional<uint32_t> set;
+  bool bufferBlock = false;
+  uint32_t arrayStride = 0;
+};
+
+struct Member {
+  uint32_t offset = 0;
+  uint32_t matrixStride = 0;
+};
+
+struct Variable {
+  uint32_t pointer;
+  uint32_t storage;
+};
+
+class Module {
+public:
+  explicit Module(const std::string &spv) {
+    if (spv.size() % 4 != 0 || spv.size() < HeaderWords * 4) {
+      throw std::runtime_error("spir-v size is not a word multiple");
+    }
+    std::vector<uint32_t> words(spv.size() / 4);
+    std::memcpy(words.data(), spv.data(), spv.size());
+    if (words[0] != Magic) {
+      throw std::runtime_error("spir-v magic mismatch");
+    }
+    for (size_t i = HeaderWords; i < words.size();) {
+      const uint32_t count = words[i] >> 16;
+      if (count == 0 || i + count > words.size()) {
+        throw std::runtime_error("spir-v instruction out of range");
+      }
+      parse(words[i] & 0xffff, &words[i + 1], count - 1);
+      i += count;
+    }
+  }
+
+  auto Reflect() const -> ComputeReflection {
+    ComputeReflection result;
+    result.localSize = localSize_;
+    for (const auto &[id, variable] : variables_) {
+      const auto &pointee = typeOf(pointerTarget(variable.pointer));
+      if (variable.storage == StoragePushConstant) {
+        result.pushConstantSize = sizeOf(pointerTarget(variable.pointer));
+        continue;
+      }
+      if (variable.storage != StorageUniformConstant &&
+          variable.storage != StorageUniform &&
+          variable.storage != StorageStorageBuffer) {
+        continue;
+      }
+      const auto found = decorations_.find(id);
+      if (found == decorations_.end() || !found->second.binding) {
+        throw std::runtime_error("spir-v resource without binding");
+      }
+      if (found->second.set.value_or(0) != 0) {
+        throw std::runtime_error("compute shader only supports set 0");
+      }
+      // 描述符数组：元素类型决定描述符类型
+      uint32_t type = pointerTarget(variable.pointer);
+      uint32_t count = 1;
+      if (pointee.op == OpTypeArray) {
+        type = pointee.At(0);
+        count = constant(pointee.At(1));
+      } else if (pointee.op == OpTypeRuntimeArray) {
+        throw std::runtime_error("unsized descriptor arrays unsupported");
+      }
+      vk::DescriptorSetLayoutBinding binding;
+      binding.setBinding(*found->second.binding)
+          .setDescriptorType(descriptorType(type, variable.storage))
+          .setDescriptorCount(count)
+          .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+      result.bindings.push_back(binding);
+    }
+    std::sort(result.bindings.begin(), result.bindings.end(),
+        [](const auto &a, const auto &b) { return a.binding < b.binding; });
+    return result;
+  }
+
+private:
+  std::unordered_map<uint32_t, Type> types_;
+  std::unordered_map<uint32_t, uint32_t> constants_;
+  std::unordered_map<uint32_t, Decorations> decorations_;
+  std::unordered_map<uint32_t, std::vector<Member>> members_;
+  // 按出现顺序，保证反射结果稳定
+  std::vector<std::pair<uint32_t, Variable>> variables_;
+  std::array<uint32_t, 3> localSize_{1, 1, 1};
+
+  void parse(uint32_t op, const uint32_t *args, uint32_t count) {
+    switch (op) {
+    case OpExecutionMode:
+      if (count >= 5 && args[1] == ExecutionModeLocalSize) {
+        localSize_ = {args[2], args[3], args[4]};
+      }
+      break;
+    case OpTypeInt:
+    case OpTypeFloat:
+    case OpTypeVector:
+    case OpTypeMatrix:
+    case OpTypeImage:
+    case OpTypeSampler:
+    case OpTypeSampledImage:
+    case OpTypeArray:
+    case OpTypeRuntimeArray:
+    case OpTypeStruct:
+    case OpTypePointer:
+      expectOperands(count, 1 + typeOperands(op));
+      declareType(op, args[0], {args + 1, args + count});
+      break;
+    case OpConstant:
+      // 只需要数组长度，取低 32 位
+      if (count >= 3) {
+        constants_[args[1]] = args[2];
+      }
+      break;
+    case OpVariable:
+      // 结果类型、结果 id、存储类型
+      expectOperands(count, 3);
+      variables_.push_back({args[1], {args[0], args[2]}});
+      break;
+    case OpDecorate:
+      expectOperands(count, 2);
+      decorate(args[0], args[1], count > 2 ? args[2] : 0);
+      break;
+    case OpMemberDecorate: {
+      // 结构体、成员下标、修饰，Offset / MatrixStride 还带一个值
+      expectOperands(count, 3);
+      if (args[1] >= MaxStructMembers) {
+        throw std::runtime_error("spir-v member index out of range");
+      }
+      if (args[2] == DecorationOffset ||
+          args[2] == DecorationMatrixStride) {
+        expectOperands(count, 4);
+      }
+      auto &members = members_[args[0]];
+      if (members.size() <= args[1]) {
+        members.resize(args[1] + 1);
+      }
+      if (args[2] == DecorationOffset) {
+        members[args[1]].offset = args[3];
+      } else if (args[2] == DecorationMatrixStride) {
+        members[args[1]].matrixStride = args[3];
+      }
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  void declareType(uint32_t op, uint32_t id,
+      std::vector<uint32_t> operands) {
+    if (types_.count(id)) {
+      throw std::runtime_error("spir-v type redeclared");
+    }
+    // 元素 / 成员类型必须先声明，sizeOf 递归时就不会有环
+    // （指针可以前向声明，但不会被 sizeOf 展开）
+    size_t components = 0;
+    switch (op) {
+    case OpTypeVector:
+    case OpTypeMatrix:
+    case OpTypeArray:
+    case OpTypeRuntimeArray:
+    case OpTypeSampledImage:
+      components = 1;
+      break;
+    case OpTypeStruct:
+      components = operands.size();
+      break;
+    default:
+      break;
+    }
+    for (size_t i = 0; i < components; ++i) {
+      typeOf(operands[i]);
+    }
+    types_[id] = {op, std::move(operands)};
+  }
+
+  void decorate(uint32_t id, uint32_t decoration, uint32_t value) {
+    auto &d = decorations_[id];
+    switch (decoration) {
+    case DecorationBufferBlock:
+      d.bufferBlock = true;
+      break;
+    case DecorationArrayStride:
+      d.arrayStride = value;
+      break;
+    case DecorationBinding:
+      d.binding = value;
+      break;
+    case DecorationDescriptorSet:
+      d.set = value;
+      break;
+    default:
+      break;
+    }
+  }
+
+  auto typeOf(uint32_t id) const -> const Type & {
+    const auto found = types_.find(id);
+    if (found == types_.end()) {
+      throw std::runtime_error("spir-v type not declared");
+    }
+    return found->second;
+  }
+
+  auto pointerTarget(uint32_t pointer) const -> uint32_t {
+    const auto &type = typeOf(pointer);
+    if (type.op != OpTypePointer) {
+      throw std::runtime_error("spir-v variable is not a pointer");
+    }
+    return type.At(1);
+  }
+
+  auto constant(uint32_t id) const -> uint32_t {
+    const auto found = constants_.find(id);
+    if (found == constants_.end()) {
+      throw std::runtime_error("spir-v array length is not a constant");
+    }
+    return found->second;
+  }
+
+  auto decorated(uint32_t id) const -> Decorations {
+    const auto found = decorations_.find(id);
+    return found == decorations_.end() ? Decorations{} : found->second;
+  }
+
+  auto descriptorType(uint32_t id, uint32_t storage) const
+      -> vk::DescriptorType {
+    const auto &type = typeOf(id);
+    if (storage == StorageStorageBuffer) {
+      return vk::DescriptorType::eStorageBuffer;
+    }
+    if (storage == StorageUniform) {
+      // 旧版本的 SSBO 是 Uniform + BufferBlock
+      return decorated(id).bufferBlock
+                 ? vk::DescriptorType::eStorageBuffer
+                 : vk::DescriptorType::eUniformBuffer;
+    }
+    switch (type.op) {
+    case OpTypeSampler:
+      return vk::DescriptorType::eSampler;
+    case OpTypeSampledImage:
+      return vk::DescriptorType::eCombinedImageSampler;
+    case OpTypeImage: {
+      // 操作数：采样类型、维度、深度、数组、多重采样、sampled
+      const bool buffer = type.At(1) == DimBuffer;
+      if (type.At(5) == 2) {
+        return buffer ? vk::DescriptorType::eStorageTexelBuffer
+                      : vk::DescriptorType::eStorageImage;
+      }
+      return buffer ? vk::DescriptorType::eUniformTexelBuffer
+                    : vk::DescriptorType::eSampledImage;
+    }
+    default:
+      throw std::runtime_error("unsupported spir-v descriptor type");
+    }
+  }
+
+  // 按成员的 Offset / 数组的 ArrayStride 计算，与 std430 一致
+  auto sizeOf(uint32_t id, uint32_t matrixStride = 0) const -> uint32_t {
+    const auto &type = typeOf(id);
+    switch (type.op) {
+    case OpTypeInt:
+    case OpTypeFloat:
+      return type.At(0) / 8;
+    case OpTypeVector:
+      return type.At(1) * sizeOf(type.At(0));
+    case OpTypeMatrix: {
+      const uint32_t column = sizeOf(type.At(0));
+      return type.At(1) * std::max(matrixStride, column);
+    }
+    case OpTypeArray: {
+      const uint32_t stride = decorated(id).arrayStride;
+      return constant(type.At(1)) *
+             (stride ? stride : sizeOf(type.At(0)));
+    }
+    case OpTypeRuntimeArray:
+      return 0;
+    case OpTypeStruct: {
+      const auto found = members_.find(id);
+      uint32_t size = 0;
+      for (size_t i = 0; i < type.operands.size(); ++i) {
+        Member member;
+        if (found != members_.end() && i < found->second.size()) {
+          member = found->second[i];
+        }
+        size = std::max(size,
+            member.offset + sizeOf(type.operands[i], member.matrixStride));
+      }
+      return size;
+    }
+    default:
+      throw std::runtime_error("unsupported spir-v block member type");
+    }
+  }
+};
+
+} // namespace
+
+auto ReflectCompute(const std::string &spv) -> ComputeReflection {
+  return Module(spv).Reflect();
+}
+
+} // namespace app
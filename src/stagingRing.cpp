@@ -0,0 +1,109 @@
+#include "../header/stagingRing.h"
+#include <stdexcept>
+
+namespace app {
+
+StagingRing::StagingRing(vk::DeviceSize size) {
+  // 不支持线性 blit 时 CPU 要回读这里的像素生成 mip，
+  // write-combined 内存读起来非常慢，优先带 cache 的内存
+  constexpr auto Coherent = vk::MemoryPropertyFlagBits::eHostVisible |
+                            vk::MemoryPropertyFlagBits::eHostCoherent;
+  const auto memory = PickBufferMemory(
+      vk::BufferUsageFlagBits::eTransferSrc,
+      {Coherent | vk::MemoryPropertyFlagBits::eHostCached, Coherent});
+  buffer_ = std::make_unique<BufferPkg>(
+      size, vk::BufferUsageFlagBits::eTransferSrc, memory);
+}
+
+auto StagingRing::Allocate(vk::DeviceSize size,
+    vk::DeviceSize alignment) -> std::optional<Block> {
+  const vk::DeviceSize capacity = buffer_->size;
+  if (size == 0 || size > capacity) {
+    return std::nullopt;
+  }
+  auto align = [alignment](vk::DeviceSize v) {
+    return (v + alignment - 1) / alignment * alignment;
+  };
+
+  std::lock_guard lock(mutex_);
+  vk::DeviceSize begin;
+  if (entries_.empty()) {
+    begin = 0;
+  } else {
+    const vk::DeviceSize tail = entries_.front().begin;
+    if (head_ > tail) {
+      // 空闲区间 [head, capacity) 与 [0, tail)
+      begin = align(head_);
+      if (begin + size > capacity) {
+        if (size > tail) {
+          return std::nullopt;
+        }
+        begin = 0;
+      }
+    } else {
+      // 已经绕回，空闲区间 [head, tail)
+      begin = align(head_);
+      if (begin + size > tail) {
+        return std::nullopt;
+      }
+    }
+  }
+
+  entries_.push_back({begin, begin + size, Unsubmitted});
+  head_ = begin + size;
+
+  Block block;
+  block.buffer = buffer_->buffer;
+  block.offset = begin;
+  block.size = size;
+  block.ptr = static_cast<uint8_t *>(buffer_->map) + begin;
+  return block;
+}
+
+void StagingRing::setBatch(const Block &block, uint64_t batch) {
+  std::lock_guard lock(mutex_);
+  // 正常情况下块按顺序提交，从后往前找更快
+  for (auto it = entries_.rbegin(); it != entries_.rend();
+       ++it) {
+    if (it->begin == block.offset) {
+      it->batch = batch;
+      return;
+    }
+  }
+  throw std::runtime_error("staging block not found");
+}
+
+void StagingRing::Retire(const Block &block, uint64_t batch) {
+  setBatch(block, batch);
+}
+
+void StagingRing::Free(const Block &block) {
+  setBatch(block, 0);
+  // 同步上传的块用完就还，不必等下一次 Reclaim
+  Reclaim(0);
+}
+
+void StagingRing::Reclaim(uint64_t completed) {
+  std::lock_guard lock(mutex_);
+  while (!entries_.empty() &&
+         entries_.front().batch <= completed) {
+    entries_.pop_front();
+  }
+  if (entries_.empty()) {
+    head_ = 0;
+  }
+}
+
+auto StagingRing::Used() const -> vk::DeviceSize {
+  std::lock_guard lock(mutex_);
+  if (entries_.empty()) {
+    return 0;
+  }
+  const vk::DeviceSize tail = entries_.front().begin;
+  if (head_ > tail) {
+    return head_ - tail;
+  }
+  return buffer_->size - tail + head_;
+}
+
+} // namespace app
\ No newline at end of file
@@ -1,16 +1,18 @@
 #include "../header/swapchain.h"
 #include "../header/application.h"
+#include <algorithm>
+#include <limits>
 
 namespace app {
 
-Swapchain::Swapchain(uint32_t width, uint32_t height) {
+Swapchain::Swapchain(uint32_t width, uint32_t height,
+    vk::SwapchainKHR oldSwapchain) {
   queryInfo(width, height);
 
   vk::SwapchainCreateInfoKHR createInfo;
   createInfo.setClipped(true)
       .setImageArrayLayers(1)
-      .setImageUsage(
-          vk::ImageUsageFlagBits::eColorAttachment)
+      .setImageUsage(info.usage)
       .setCompositeAlpha(
           vk::CompositeAlphaFlagBitsKHR::eOpaque)
       .setSurface(Application::GetInstance().surface)
@@ -19,7 +21,8 @@ Swapchain::Swapchain(uint32_t width, uint32_t height) {
       .setImageExtent(info.imageExtent)
       .setMinImageCount(info.imageCount)
       .setPreTransform(info.transform)
-      .setPresentMode(info.present);
+      .setPresentMode(info.present)
+      .setOldSwapchain(oldSwapchain);
 
   auto &queueIndicecs =
       Application::GetInstance().queueFamilyIndices;
@@ -43,10 +46,6 @@ Swapchain::Swapchain(uint32_t width, uint32_t height) {
 }
 
 Swapchain::~Swapchain() {
-  for (auto &framebuffer : framebuffers) {
-    Application::GetInstance().device.destroyFramebuffer(
-        framebuffer);
-  }
   for (auto &view : imageViews) {
     Application::GetInstance().device.destroyImageView(
         view);
@@ -71,28 +70,55 @@ void Swapchain::queryInfo(uint32_t width, uint32_t height) {
 
   auto capabilities =
       phyDevice.getSurfaceCapabilitiesKHR(surface);
-  info.imageCount =
-      std::clamp<uint32_t>(2, capabilities.minImageCount,
-          capabilities.maxImageCount);
+  auto &pacer = Application::GetInstance().pacer;
+  info.imageCount = pacer.ChooseImageCount(capabilities);
 
-  info.imageExtent.width = std::clamp<uint32_t>(width,
-      capabilities.minImageExtent.width,
-      capabilities.minImageExtent.width);
-  info.imageExtent.height = std::clamp<uint32_t>(height,
-      capabilities.minImageExtent.height,
-      capabilities.minImageExtent.height);
+  // currentExtent 为特殊值时尺寸由 swapchain 决定
+  if (capabilities.currentExtent.width !=
+      std::numeric_limits<uint32_t>::max()) {
+    info.imageExtent = capabilities.currentExtent;
+  } else {
+    info.imageExtent.width = std::clamp<uint32_t>(width,
+        capabilities.minImageExtent.width,
+        capabilities.maxImageExtent.width);
+    info.imageExtent.height = std::clamp<uint32_t>(height,
+        capabilities.minImageExtent.height,
+        capabilities.maxImageExtent.height);
+  }
 
   info.transform = capabilities.currentTransform;
 
+  // 支持的话允许拷贝出 swapchain 图像（截帧）
+  info.usage = vk::ImageUsageFlagBits::eColorAttachment;
+  if (capabilities.supportedUsageFlags &
+      vk::ImageUsageFlagBits::eTransferSrc) {
+    info.usage |= vk::ImageUsageFlagBits::eTransferSrc;
+  }
+
   auto presents =
       phyDevice.getSurfacePresentModesKHR(surface);
-  info.present = vk::PresentModeKHR::eFifo;
-  for (const auto &present : presents) {
-    if (present == vk::PresentModeKHR::eMailbox) {
-      info.present = present;
-      break;
+  info.present = pacer.ChoosePresentMode(presents);
+  pickDepthFormat();
+}
+
+// 优先纯深度格式，不行再退到带模板的
+void Swapchain::pickDepthFormat() {
+  auto &phyDevice = Application::GetInstance().phyDevice;
+  constexpr std::array candidates = {vk::Format::eD32Sfloat,
+      vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint};
+  for (auto format : candidates) {
+    auto props = phyDevice.getFormatProperties(format);
+    if (props.optimalTilingFeatures &
+        vk::FormatFeatureFlagBits::eDepthStencilAttachment) {
+      info.depthFormat = format;
+      info.depthAspect = vk::ImageAspectFlagBits::eDepth;
+      if (format != vk::Format::eD32Sfloat) {
+        info.depthAspect |= vk::ImageAspectFlagBits::eStencil;
+      }
+      return;
     }
   }
+  throw std::runtime_error("no supported depth format");
 }
 
 void Swapchain::getImages() {
@@ -123,23 +149,4 @@ void Swapchain::createImageViews() {
   }
 }
 
-void Swapchain::createFrameBuffers() {
-  auto &width = info.imageExtent.width,
-       &height = info.imageExtent.height;
-  framebuffers.resize(images.size());
-  for (size_t i = 0; i < images.size(); ++i) {
-    vk::FramebufferCreateInfo createInfo;
-    // 需要 renderProcess
-    createInfo.setAttachments(imageViews[i])
-        .setWidth(width)
-        .setHeight(height)
-        .setRenderPass(Application::GetInstance()
-                           .renderProcess->renderPass)
-        .setLayers(1);
-    framebuffers[i] =
-        Application::GetInstance().device.createFramebuffer(
-            createInfo);
-  }
-}
-
-} // namespace app
\ No newline at end of file
+} // namespace app
@@ -1,27 +1,57 @@
 #include "../header/texture.h"
 #include "../header/application.h"
+#include "../header/colorConvert.h"
 #include "vulkan/vulkan_handles.hpp"
+#include <algorithm>
+#include <bit>
 #include <cstdlib>
-#define STB_IMAGE_IMPLEMENTATION
-#include "../external/stb_image.h"
+#include <iostream>
+#include <optional>
+#include <utility>
+#include <vector>
 
 namespace app {
 
 Texture::Texture(
     std::string_view filename, vk::Sampler sampler) {
-  int w, h, channel;
-  stbi_uc *pixels = stbi_load(
-      filename.data(), &w, &h, &channel, STBI_rgb_alpha);
-  size_t size = w * h * 4;
-
-  if (!pixels) {
-    std::cerr << "image load failed\n";
-    throw std::runtime_error("image load failed");
-    exit(EXIT_FAILURE);
+  // 解码后直接写入 staging ring，省掉中间的堆图像与 memcpy
+  auto &ring = *Application::GetInstance().stagingRing;
+  std::optional<StagingRing::Block> block;
+  std::optional<DecodeInfo> info;
+  try {
+    info = DecodeImageInto(
+        filename, [&](uint32_t w, uint32_t h) -> uint8_t * {
+          block = ring.Allocate(vk::DeviceSize(w) * h * 4);
+          return block ? static_cast<uint8_t *>(block->ptr)
+                       : nullptr;
+        });
+  } catch (const std::runtime_error &) {
+    if (block) {
+      ring.Free(*block);
+    }
+    throw;
   }
-  init(pixels, w, h, sampler);
+  if (!info) {
+    // staging 空间不够，退回到堆上解码
+    auto image = LoadImageData(filename);
+    init(image.pixels.get(), image.width, image.height,
+        sampler);
+    return;
+  }
+  std::cout << "Texture " << filename << " : " << info->width
+            << "x" << info->height << ", copied "
+            << info->bytesCopied << " bytes (before "
+            << info->legacyBytesCopied << ")\n";
+
+  create(info->width, info->height, true);
+  upload(block->buffer, block->offset,
+      static_cast<const uint8_t *>(block->ptr));
+  ring.Free(*block);
+}
 
-  stbi_image_free(pixels);
+Texture::Texture(const ImageData &image, vk::Sampler sampler) {
+  init(image.pixels.get(), image.width, image.height,
+      sampler);
 }
 
 Texture::Texture(void *data, unsigned int w, unsigned int h,
@@ -29,47 +59,258 @@ Texture::Texture(void *data, unsigned int w, unsigned int h,
   init(data, w, h, sampler);
 }
 
-void Texture::init(void *data, uint32_t w, uint32_t h,
-    vk::Sampler sampler) {
-  const uint32_t size = w * h * 4;
-  std::unique_ptr<BufferPkg> buffer(new BufferPkg(size,
-      vk::BufferUsageFlagBits::eTransferSrc,
-      vk::MemoryPropertyFlagBits::eHostCoherent |
-          vk::MemoryPropertyFlagBits::eHostVisible));
-  memcpy(buffer->map, data, size);
+Texture::Texture(uint32_t w, uint32_t h, bool mipmapped) {
+  create(w, h, mipmapped);
+}
 
-  createImage(w, h);
+auto Texture::MipLevelsFor(uint32_t w, uint32_t h)
+    -> uint32_t {
+  return std::bit_width(std::max(std::max(w, h), 1u));
+}
+
+auto Texture::SupportsLinearBlit() -> bool {
+  static const bool supported = [] {
+    auto props =
+        Application::GetInstance().phyDevice.getFormatProperties(
+            vk::Format::eR8G8B8A8Srgb);
+    const auto required =
+        vk::FormatFeatureFlagBits::eBlitSrc |
+        vk::FormatFeatureFlagBits::eBlitDst |
+        vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+    return (props.optimalTilingFeatures & required) == required;
+  }();
+  return supported;
+}
+
+Texture::Texture(const TextureCache &cache) {
+  width = cache.Width();
+  height = cache.Height();
+  mipLevels = static_cast<uint32_t>(cache.Levels().size());
+  format = ToVkFormat(cache.Format());
+  createStorage();
+
+  std::vector<vk::BufferImageCopy> regions;
+  for (uint32_t level = 0; level < mipLevels; ++level) {
+    const auto &info = cache.Levels()[level];
+    vk::BufferImageCopy region;
+    region.setBufferOffset(info.offset)
+        .setBufferRowLength(0)
+        .setBufferImageHeight(0)
+        .setImageSubresource(
+            {vk::ImageAspectFlagBits::eColor, level, 0, 1})
+        .setImageOffset({0, 0, 0})
+        .setImageExtent({info.width, info.height, 1});
+    regions.push_back(region);
+  }
+  // 所有层连续存放，从映射的文件一次拷进 staging
+  withStaging(cache.Data(), cache.DataSize(),
+      [&](vk::Buffer buffer, vk::DeviceSize base) {
+        for (auto &region : regions) {
+          region.setBufferOffset(base + region.bufferOffset);
+        }
+        auto &app = Application::GetInstance();
+        app.commandManager->ExecuteCmd(
+            app.graphicQueue, [&](vk::CommandBuffer cmdBuf) {
+              auto &tracker = *app.resourceTracker;
+              tracker.Use(image, ResourceState::TransferDst());
+              tracker.Flush(cmdBuf);
+              cmdBuf.copyBufferToImage(buffer, image,
+                  vk::ImageLayout::eTransferDstOptimal, regions);
+              tracker.Use(image, ResourceState::FragmentRead());
+              tracker.Flush(cmdBuf);
+            });
+      });
+}
+
+void Texture::create(uint32_t w, uint32_t h, bool mipmapped) {
+  width = w;
+  height = h;
+  mipLevels = mipmapped ? MipLevelsFor(w, h) : 1;
+  createStorage();
+}
+
+void Texture::createStorage() {
+  createImage(width, height);
   allocMemory();
   Application::GetInstance().device.bindImageMemory(
       image, memory, 0);
+  createImageView();
+  Application::GetInstance().resourceTracker->Track(
+      image, mipLevels);
+}
 
-  transitionImageLayoutFromUndefine2Dst();
-  transformData2Image(*buffer, w, h);
-  transitionImageLayoutFromDst2Optimal();
+void Texture::upload(vk::Buffer buffer, vk::DeviceSize offset,
+    const uint8_t *pixels) {
+  // 不支持线性 blit 时 CPU 生成其余层，和第 0 层一起拷贝
+  std::vector<vk::BufferImageCopy> regions;
+  std::vector<uint8_t> chain;
+  if (mipLevels > 1 && !SupportsLinearBlit()) {
+    chain = generateMipmapsOnCpu(pixels, regions);
+  }
 
-  createImageView();
+  // 整个上传只录制一个命令缓冲：转换、拷贝（blit）、转换
+  auto record = [&](vk::Buffer chainBuffer,
+                    vk::DeviceSize chainOffset) {
+    auto &app = Application::GetInstance();
+    app.commandManager->ExecuteCmd(
+        app.graphicQueue, [&](vk::CommandBuffer cmdBuf) {
+          auto &tracker = *app.resourceTracker;
+          tracker.Use(image, ResourceState::TransferDst());
+          tracker.Flush(cmdBuf);
+          recordCopy(cmdBuf, buffer, offset);
+          if (!regions.empty()) {
+            for (auto &region : regions) {
+              region.setBufferOffset(
+                  chainOffset + region.bufferOffset);
+            }
+            cmdBuf.copyBufferToImage(chainBuffer, image,
+                vk::ImageLayout::eTransferDstOptimal, regions);
+          } else if (mipLevels > 1) {
+            RecordMipmaps(cmdBuf);
+          }
+          // blit 链已经转换过时不会再生成屏障
+          tracker.Use(image, ResourceState::FragmentRead());
+          tracker.Flush(cmdBuf);
+        });
+  };
+  if (chain.empty()) {
+    record(nullptr, 0);
+    return;
+  }
+  withStaging(chain.data(), chain.size(), record);
+}
+
+void Texture::RecordMipmaps(vk::CommandBuffer cmdBuf) {
+  auto &tracker = *Application::GetInstance().resourceTracker;
+  auto w = static_cast<int32_t>(width);
+  auto h = static_cast<int32_t>(height);
+  for (uint32_t level = 1; level < mipLevels; ++level) {
+    // 上一层写完后作为 blit 的源
+    tracker.Use(image, ResourceState::TransferSrc(), level - 1, 1);
+    tracker.Flush(cmdBuf);
+
+    const int32_t nextW = std::max(w / 2, 1);
+    const int32_t nextH = std::max(h / 2, 1);
+    vk::ImageBlit blit;
+    blit.setSrcSubresource({vk::ImageAspectFlagBits::eColor,
+            level - 1, 0, 1})
+        .setSrcOffsets({vk::Offset3D{0, 0, 0},
+            vk::Offset3D{w, h, 1}})
+        .setDstSubresource(
+            {vk::ImageAspectFlagBits::eColor, level, 0, 1})
+        .setDstOffsets({vk::Offset3D{0, 0, 0},
+            vk::Offset3D{nextW, nextH, 1}});
+    cmdBuf.blitImage(image, vk::ImageLayout::eTransferSrcOptimal,
+        image, vk::ImageLayout::eTransferDstOptimal, blit,
+        vk::Filter::eLinear);
+    w = nextW;
+    h = nextH;
+  }
+
+  // 前面各层是 TransferSrc、最后一层是 TransferDst，
+  // 合并成一次屏障交给着色器
+  tracker.Use(image, ResourceState::FragmentRead());
+  tracker.Flush(cmdBuf);
+}
+
+auto Texture::generateMipmapsOnCpu(const uint8_t *pixels,
+    std::vector<vk::BufferImageCopy> &regions)
+    -> std::vector<uint8_t> {
+  // 逐级盒式滤波，所有层放进同一块内存，
+  // regions 的偏移相对于返回数据的起点
+  std::vector<vk::DeviceSize> offsets;
+  vk::DeviceSize total = 0;
+  uint32_t w = width;
+  uint32_t h = height;
+  for (uint32_t level = 1; level < mipLevels; ++level) {
+    w = std::max(w / 2, 1u);
+    h = std::max(h / 2, 1u);
+    offsets.push_back(total);
+    vk::BufferImageCopy region;
+    region.setBufferOffset(total)
+        .setBufferRowLength(0)
+        .setBufferImageHeight(0)
+        .setImageSubresource(
+            {vk::ImageAspectFlagBits::eColor, level, 0, 1})
+        .setImageOffset({0, 0, 0})
+        .setImageExtent({w, h, 1});
+    regions.push_back(region);
+    total += vk::DeviceSize(w) * h * 4;
+  }
+
+  std::vector<uint8_t> chain(total);
+  const uint8_t *src = pixels;
+  w = width;
+  h = height;
+  for (size_t i = 0; i < regions.size(); ++i) {
+    uint8_t *dst = chain.data() + offsets[i];
+    DownsampleSRGBA2x2(src, w, h, dst);
+    src = dst;
+    w = std::max(w / 2, 1u);
+    h = std::max(h / 2, 1u);
+  }
+  return chain;
+}
+
+void Texture::init(void *data, uint32_t w, uint32_t h,
+    vk::Sampler sampler) {
+  create(w, h, true);
+  const auto *pixels = static_cast<const uint8_t *>(data);
+  withStaging(data, vk::DeviceSize(w) * h * 4,
+      [&](vk::Buffer buffer, vk::DeviceSize offset) {
+        upload(buffer, offset, pixels);
+      });
   // set = DescriptorSetManager::Instance().AllocImageSet();
   // updateDescriptorSet(sampler);
 }
 
+Texture::Texture(Texture &&other) noexcept {
+  *this = std::move(other);
+}
+
+// 交换，原来的资源随 other 析构
+auto Texture::operator=(Texture &&other) noexcept -> Texture & {
+  std::swap(image, other.image);
+  std::swap(memory, other.memory);
+  std::swap(view, other.view);
+  std::swap(set, other.set);
+  std::swap(width, other.width);
+  std::swap(height, other.height);
+  std::swap(mipLevels, other.mipLevels);
+  std::swap(format, other.format);
+  std::swap(memorySize, other.memorySize);
+  return *this;
+}
+
 Texture::~Texture() {
-  auto &device = Application::GetInstance().device;
-  DescriptorSetManager::Instance().FreeImageSet(set);
-  device.destroyImageView(view);
-  device.freeMemory(memory);
-  device.destroyImage(image);
+  if (!image) {
+    return;
+  }
+  auto &app = Application::GetInstance();
+  app.resourceTracker->Forget(image);
+  // 描述符集与图像可能仍被在途的帧引用
+  auto &queue = *app.deletionQueue;
+  if (set.set) {
+    queue.Retire([set = set] {
+      DescriptorSetManager::Instance().FreeImageSet(set);
+    });
+  }
+  queue.Retire(view);
+  queue.Retire(image);
+  queue.Retire(memory);
 }
 
 void Texture::createImage(uint32_t w, uint32_t h) {
   vk::ImageCreateInfo createInfo;
   createInfo.setImageType(vk::ImageType::e2D)
       .setArrayLayers(1)
-      .setMipLevels(1)
+      .setMipLevels(mipLevels)
       .setExtent({w, h, 1})
-      .setFormat(vk::Format::eR8G8B8A8Srgb)
+      .setFormat(format)
       .setTiling(vk::ImageTiling::eOptimal)
       .setInitialLayout(vk::ImageLayout::eUndefined)
       .setUsage(vk::ImageUsageFlagBits::eTransferDst |
+                vk::ImageUsageFlagBits::eTransferSrc |
                 vk::ImageUsageFlagBits::eSampled)
       .setSamples(vk::SampleCountFlagBits::e1);
   image = Application::GetInstance().device.createImage(
@@ -83,93 +324,50 @@ void Texture::allocMemory() {
   auto requirements =
       device.getImageMemoryRequirements(image);
   allocInfo.setAllocationSize(requirements.size);
+  memorySize = requirements.size;
 
   auto index =
       QueryBufferMemTypeIndex(requirements.memoryTypeBits,
           vk::MemoryPropertyFlagBits::eDeviceLocal);
-  allocInfo.setMemoryTypeIndex(index);
+  allocInfo.setMemoryTypeIndex(index.value());
 
   memory = device.allocateMemory(allocInfo);
 }
 
-void Texture::transformData2Image(
-    BufferPkg &buffer, uint32_t w, uint32_t h) {
-  Application::GetInstance().commandManager->ExecuteCmd(
-      Application::GetInstance().graphicQueue,
-      [&](vk::CommandBuffer cmdBuf) {
-        vk::BufferImageCopy region;
-        vk::ImageSubresourceLayers subsource;
-        subsource
-            .setAspectMask(vk::ImageAspectFlagBits::eColor)
-            .setBaseArrayLayer(0)
-            .setMipLevel(0)
-            .setLayerCount(1);
-        region.setBufferImageHeight(0)
-            .setBufferOffset(0)
-            .setImageOffset(0)
-            .setImageExtent({w, h, 1})
-            .setBufferRowLength(0)
-            .setImageSubresource(subsource);
-        cmdBuf.copyBufferToImage(buffer.buffer, image,
-            vk::ImageLayout::eTransferDstOptimal, region);
-      });
-}
-
-void Texture::transitionImageLayoutFromUndefine2Dst() {
-  Application::GetInstance().commandManager->ExecuteCmd(
-      Application::GetInstance().graphicQueue,
-      [&](vk::CommandBuffer cmdBuf) {
-        vk::ImageMemoryBarrier barrier;
-        vk::ImageSubresourceRange range;
-        range.setLayerCount(1)
-            .setBaseArrayLayer(0)
-            .setLevelCount(1)
-            .setBaseMipLevel(0)
-            .setAspectMask(vk::ImageAspectFlagBits::eColor);
-        barrier.setImage(image)
-            .setOldLayout(vk::ImageLayout::eUndefined)
-            .setNewLayout(
-                vk::ImageLayout::eTransferDstOptimal)
-            .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
-            .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
-            .setDstAccessMask(
-                (vk::AccessFlagBits::eTransferWrite))
-            .setSubresourceRange(range);
-        cmdBuf.pipelineBarrier(
-            vk::PipelineStageFlagBits::eTopOfPipe,
-            vk::PipelineStageFlagBits::eTransfer, {}, {},
-            nullptr, barrier);
-      });
+void Texture::recordCopy(vk::CommandBuffer cmdBuf,
+    vk::Buffer buffer, vk::DeviceSize offset) {
+  vk::BufferImageCopy region;
+  vk::ImageSubresourceLayers subsource;
+  subsource.setAspectMask(vk::ImageAspectFlagBits::eColor)
+      .setBaseArrayLayer(0)
+      .setMipLevel(0)
+      .setLayerCount(1);
+  region.setBufferImageHeight(0)
+      .setBufferOffset(offset)
+      .setImageOffset(0)
+      .setImageExtent({width, height, 1})
+      .setBufferRowLength(0)
+      .setImageSubresource(subsource);
+  cmdBuf.copyBufferToImage(buffer, image,
+      vk::ImageLayout::eTransferDstOptimal, region);
 }
 
-void Texture::transitionImageLayoutFromDst2Optimal() {
-  Application::GetInstance().commandManager->ExecuteCmd(
-      Application::GetInstance().graphicQueue,
-      [&](vk::CommandBuffer cmdBuf) {
-        vk::ImageMemoryBarrier barrier;
-        vk::ImageSubresourceRange range;
-        range.setLayerCount(1)
-            .setBaseArrayLayer(0)
-            .setLevelCount(1)
-            .setBaseMipLevel(0)
-            .setAspectMask(vk::ImageAspectFlagBits::eColor);
-        barrier.setImage(image)
-            .setOldLayout(
-                vk::ImageLayout::eTransferDstOptimal)
-            .setNewLayout(
-                vk::ImageLayout::eShaderReadOnlyOptimal)
-            .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
-            .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
-            .setSrcAccessMask(
-                (vk::AccessFlagBits::eTransferWrite))
-            .setDstAccessMask(
-                (vk::AccessFlagBits::eShaderRead))
-            .setSubresourceRange(range);
-        cmdBuf.pipelineBarrier(
-            vk::PipelineStageFlagBits::eTransfer,
-            vk::PipelineStageFlagBits::eFragmentShader, {},
-            {}, nullptr, barrier);
-      });
+void Texture::withStaging(const void *data, vk::DeviceSize size,
+    const std::function<void(vk::Buffer, vk::DeviceSize)> &func) {
+  auto &ring = *Application::GetInstance().stagingRing;
+  if (auto block = ring.Allocate(size)) {
+    memcpy(block->ptr, data, size);
+    func(block->buffer, block->offset);
+    // ExecuteCmd 返回时拷贝已经完成
+    ring.Free(*block);
+    return;
+  }
+  // 超过 staging ring 的大图单独申请
+  BufferPkg buffer(size, vk::BufferUsageFlagBits::eTransferSrc,
+      vk::MemoryPropertyFlagBits::eHostCoherent |
+          vk::MemoryPropertyFlagBits::eHostVisible);
+  memcpy(buffer.map, data, size);
+  func(buffer.buffer, 0);
 }
 
 void Texture::createImageView() {
@@ -179,12 +377,12 @@ void Texture::createImageView() {
   range.setAspectMask(vk::ImageAspectFlagBits::eColor)
       .setBaseArrayLayer(0)
       .setLayerCount(1)
-      .setLevelCount(1)
+      .setLevelCount(mipLevels)
       .setBaseMipLevel(0);
   createInfo.setImage(image)
       .setViewType(vk::ImageViewType::e2D)
       .setComponents(mapping)
-      .setFormat(vk::Format::eR8G8B8A8Srgb)
+      .setFormat(format)
       .setSubresourceRange(range);
   view = Application::GetInstance().device.createImageView(
       createInfo);
@@ -209,35 +407,4 @@ void Texture::updateDescriptorSet(vk::Sampler sampler) {
       writer, {});
 }
 
-// std::unique_ptr<TextureManager> TextureManager::instance_
-// = nullptr;
-
-// Texture *TextureManager::Load(const std::string
-// &filename) {
-//   datas_.push_back(std::unique_ptr<Texture>(new
-//   Texture(filename))); return datas_.back().get();
-// }
-
-// Texture *TextureManager::Create(void *data, uint32_t w,
-// uint32_t h) {
-//   datas_.push_back(std::unique_ptr<Texture>(new
-//   Texture(data, w, h))); return datas_.back().get();
-// }
-
-// void TextureManager::Clear() {
-//   datas_.clear();
-// }
-
-// void TextureManager::Destroy(Texture *texture) {
-//   auto it = std::find_if(datas_.begin(), datas_.end(),
-//   [&](const std::unique_ptr<Texture> &t) {
-//     return t.get() == texture;
-//   });
-//   if (it != datas_.end()) {
-//     Application::GetInstance().device.waitIdle();
-//     datas_.erase(it);
-//     return;
-//   }
-// }
-
 } // namespace app
\ No newline at end of file
@@ -0,0 +1,500 @@
+#include "../header/textureAtlas.h"
+#include "../header/application.h"
+#include "../header/buffer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+
+namespace app {
+
+SkylinePacker::SkylinePacker(uint32_t width, uint32_t height)
+    : width_(width), height_(height) {
+  Clear();
+}
+
+void SkylinePacker::Clear() {
+  skyline_.assign(1, Segment{0, 0, width_});
+  usedArea_ = 0;
+}
+
+auto SkylinePacker::fit(size_t index, uint32_t w, uint32_t h) const
+    -> std::optional<uint32_t> {
+  const uint32_t x = skyline_[index].x;
+  if (x + w > width_) {
+    return std::nullopt;
+  }
+  uint32_t y = 0;
+  uint32_t remaining = w;
+  for (size_t i = index; remaining > 0; ++i) {
+    y = std::max(y, skyline_[i].y);
+    if (y + h > height_) {
+      return std::nullopt;
+    }
+    remaining -= std::min(remaining, skyline_[i].width);
+  }
+  return y;
+}
+
+auto SkylinePacker::Insert(uint32_t w, uint32_t h)
+    -> std::optional<Rect> {
+  // bottom-left：顶边最低优先，其次选更窄的段减少浪费
+  size_t bestIndex = skyline_.size();
+  uint32_t bestTop = ~0u;
+  uint32_t bestWidth = ~0u;
+  uint32_t bestY = 0;
+  for (size_t i = 0; i < skyline_.size(); ++i) {
+    auto y = fit(i, w, h);
+    if (!y) {
+      continue;
+    }
+    const uint32_t top = *y + h;
+    if (top < bestTop ||
+        (top == bestTop && skyline_[i].width < bestWidth)) {
+      bestIndex = i;
+      bestTop = top;
+      bestWidth = skyline_[i].width;
+      bestY = *y;
+    }
+  }
+  if (bestIndex == skyline_.size()) {
+    return std::nullopt;
+  }
+  Rect rect{skyline_[bestIndex].x, bestY, w, h};
+  place(bestIndex, rect);
+  usedArea_ += uint64_t(w) * h;
+  return rect;
+}
+
+void SkylinePacker::place(size_t index, const Rect &rect) {
+  skyline_.insert(skyline_.begin() + index,
+      Segment{rect.x, rect.y + rect.h, rect.w});
+
+  // 被新段覆盖的部分裁掉
+  const uint32_t right = rect.x + rect.w;
+  for (size_t i = index + 1; i < skyline_.size();) {
+    auto &segment = skyline_[i];
+    if (segment.x >= right) {
+      break;
+    }
+    const uint32_t overlap = right - segment.x;
+    if (segment.width <= overlap) {
+      skyline_.erase(skyline_.begin() + i);
+      continue;
+    }
+    segment.x += overlap;
+    segment.width -= overlap;
+    break;
+  }
+
+  // 合并等高的相邻段
+  for (size_t i = 0; i + 1 < skyline_.size();) {
+    if (skyline_[i].y == skyline_[i + 1].y) {
+      skyline_[i].width += skyline_[i + 1].width;
+      skyline_.erase(skyline_.begin() + i + 1);
+    } else {
+      ++i;
+    }
+  }
+}
+
+TextureAtlas::TextureAtlas(const Config &config)
+    : config_(config) {
+  packers_.assign(config_.layers,
+      SkylinePacker(config_.size, config_.size));
+  storage_ = createStorage();
+}
+
+TextureAtlas::~TextureAtlas() {
+  auto &ring = *Application::GetInstance().stagingRing;
+  for (auto &copy : pending_) {
+    ring.Free(copy.block);
+  }
+  destroyStorage(storage_);
+}
+
+auto TextureAtlas::Add(const void *pixels, uint32_t w,
+    uint32_t h) -> std::optional<Id> {
+  if (w == 0 || h == 0) {
+    return std::nullopt;
+  }
+  const uint32_t pad = config_.padding;
+  auto &ring = *Application::GetInstance().stagingRing;
+  const vk::DeviceSize size =
+      vk::DeviceSize(w + pad * 2) * (h + pad * 2) * 4;
+  // 先占 staging，满了就等之前的 Flush 所在帧完成
+  auto block = ring.Allocate(size);
+  if (!block) {
+    return std::nullopt;
+  }
+  auto slot = allocate(w + pad * 2, h + pad * 2);
+  if (!slot) {
+    ring.Free(*block);
+    return std::nullopt;
+  }
+  auto [layer, rect] = *slot;
+
+  // 写入带 padding 的图块：四周重复最外圈像素
+  const auto *src = static_cast<const uint8_t *>(pixels);
+  auto *dst = static_cast<uint8_t *>(block->ptr);
+  for (uint32_t y = 0; y < rect.h; ++y) {
+    const uint32_t sy =
+        std::min(std::max(y, pad) - pad, h - 1);
+    const uint8_t *row = src + size_t(sy) * w * 4;
+    uint8_t *out = dst + size_t(y) * rect.w * 4;
+    for (uint32_t x = 0; x < pad; ++x) {
+      std::memcpy(out + x * 4, row, 4);
+      std::memcpy(out + (pad + w + x) * 4, row + (w - 1) * 4, 4);
+    }
+    std::memcpy(out + pad * 4, row, size_t(w) * 4);
+  }
+  pending_.push_back({*block, layer, rect});
+
+  const Id id = nextId_++;
+  entries_[id] = {layer, rect, makeRegion(layer, rect)};
+  return id;
+}
+
+void TextureAtlas::Remove(Id id) {
+  entries_.erase(id);
+}
+
+auto TextureAtlas::Get(Id id) const -> const Region & {
+  return entries_.at(id).region;
+}
+
+void TextureAtlas::Flush(vk::CommandBuffer cmdBuf, uint64_t frame) {
+  auto &tracker = *Application::GetInstance().resourceTracker;
+  if (pending_.empty() && storage_.cleared) {
+    return;
+  }
+  tracker.Use(storage_.image, ResourceState::TransferDst());
+  tracker.Flush(cmdBuf);
+  clear(cmdBuf, storage_);
+
+  auto &ring = *Application::GetInstance().stagingRing;
+  for (const auto &copy : pending_) {
+    vk::BufferImageCopy region;
+    region.setBufferOffset(copy.block.offset)
+        .setBufferRowLength(0)
+        .setBufferImageHeight(0)
+        .setImageSubresource(
+            {vk::ImageAspectFlagBits::eColor, 0, copy.layer, 1})
+        .setImageOffset({static_cast<int32_t>(copy.rect.x),
+            static_cast<int32_t>(copy.rect.y), 0})
+        .setImageExtent({copy.rect.w, copy.rect.h, 1});
+    cmdBuf.copyBufferToImage(copy.block.buffer, storage_.image,
+        vk::ImageLayout::eTransferDstOptimal, region);
+    // 该帧在 GPU 上完成后由 Reclaim 回收
+    ring.Retire(copy.block, frame);
+  }
+  pending_.clear();
+
+  tracker.Use(storage_.image, ResourceState::FragmentRead());
+  tracker.Flush(cmdBuf);
+}
+
+void TextureAtlas::Repack(vk::CommandBuffer cmdBuf, uint64_t frame) {
+  Flush(cmdBuf, frame);
+
+  // 高的先放，skyline 更平整
+  std::vector<std::pair<Id, Entry *>> order;
+  order.reserve(entries_.size());
+  for (auto &[id, entry] : entries_) {
+    order.emplace_back(id, &entry);
+  }
+  std::sort(order.begin(), order.end(),
+      [](const auto &a, const auto &b) {
+        if (a.second->rect.h != b.second->rect.h) {
+          return a.second->rect.h > b.second->rect.h;
+        }
+        return a.second->rect.w > b.second->rect.w;
+      });
+
+  auto oldPackers = std::move(packers_);
+  packers_.assign(config_.layers,
+      SkylinePacker(config_.size, config_.size));
+  std::vector<vk::ImageCopy> copies;
+  std::vector<Entry> moved;
+  moved.reserve(order.size());
+  for (auto &[id, entry] : order) {
+    auto slot = allocate(entry->rect.w, entry->rect.h);
+    if (!slot) {
+      // 极少见：重新排序后反而放不下，保持原样
+      packers_ = std::move(oldPackers);
+      return;
+    }
+    Entry next{slot->first, slot->second,
+        makeRegion(slot->first, slot->second)};
+    vk::ImageCopy copy;
+    copy.setSrcSubresource(
+            {vk::ImageAspectFlagBits::eColor, 0, entry->layer, 1})
+        .setSrcOffset({static_cast<int32_t>(entry->rect.x),
+            static_cast<int32_t>(entry->rect.y), 0})
+        .setDstSubresource(
+            {vk::ImageAspectFlagBits::eColor, 0, next.layer, 1})
+        .setDstOffset({static_cast<int32_t>(next.rect.x),
+            static_cast<int32_t>(next.rect.y), 0})
+        .setExtent({entry->rect.w, entry->rect.h, 1});
+    copies.push_back(copy);
+    moved.push_back(next);
+  }
+
+  auto &tracker = *Application::GetInstance().resourceTracker;
+  Storage next = createStorage();
+  tracker.Use(storage_.image, ResourceState::TransferSrc());
+  tracker.Use(next.image, ResourceState::TransferDst());
+  tracker.Flush(cmdBuf);
+  clear(cmdBuf, next);
+  if (!copies.empty()) {
+    // 清空与拷贝都写新图像，中间要一次屏障
+    tracker.Use(next.image, ResourceState::TransferDst());
+    tracker.Flush(cmdBuf);
+    cmdBuf.copyImage(storage_.image,
+        vk::ImageLayout::eTransferSrcOptimal, next.image,
+        vk::ImageLayout::eTransferDstOptimal, copies);
+  }
+  tracker.Use(next.image, ResourceState::FragmentRead());
+  tracker.Flush(cmdBuf);
+
+  // 之前的帧和本帧的拷贝还在读旧图像，交给延迟销毁
+  destroyStorage(storage_);
+  storage_ = next;
+  for (size_t i = 0; i < order.size(); ++i) {
+    *order[i].second = moved[i];
+  }
+  generation_++;
+}
+
+auto TextureAtlas::Occupancy() const -> double {
+  uint64_t live = 0;
+  for (const auto &[id, entry] : entries_) {
+    live += uint64_t(entry.rect.w) * entry.rect.h;
+  }
+  uint32_t usedLayers = 0;
+  for (const auto &packer : packers_) {
+    usedLayers += packer.UsedArea() > 0 ? 1 : 0;
+  }
+  if (usedLayers == 0) {
+    return 0.0;
+  }
+  return double(live) /
+         (double(config_.size) * config_.size * usedLayers);
+}
+
+auto TextureAtlas::allocate(uint32_t w, uint32_t h)
+    -> std::optional<std::pair<uint32_t, SkylinePacker::Rect>> {
+  // 优先塞进前面的层，已用层越少越好
+  for (uint32_t layer = 0; layer < packers_.size(); ++layer) {
+    if (auto rect = packers_[layer].Insert(w, h)) {
+      return std::make_pair(layer, *rect);
+    }
+  }
+  return std::nullopt;
+}
+
+auto TextureAtlas::makeRegion(uint32_t layer,
+    const SkylinePacker::Rect &rect) const -> Region {
+  const float scale = 1.0f / float(config_.size);
+  const uint32_t pad = config_.padding;
+  Region region;
+  region.layer = layer;
+  region.u0 = float(rect.x + pad) * scale;
+  region.v0 = float(rect.y + pad) * scale;
+  region.u1 = float(rect.x + rect.w - pad) * scale;
+  region.v1 = float(rect.y + rect.h - pad) * scale;
+  return region;
+}
+
+auto TextureAtlas::createStorage() -> Storage {
+  auto &app = Application::GetInstance();
+  auto &device = app.device;
+  Storage storage;
+
+  vk::ImageCreateInfo createInfo;
+  createInfo.setImageType(vk::ImageType::e2D)
+      .setArrayLayers(config_.layers)
+      .setMipLevels(1)
+      .setExtent({config_.size, config_.size, 1})
+      .setFormat(vk::Format::eR8G8B8A8Srgb)
+      .setTiling(vk::ImageTiling::eOptimal)
+      .setInitialLayout(vk::ImageLayout::eUndefined)
+      .setUsage(vk::ImageUsageFlagBits::eTransferDst |
+                vk::ImageUsageFlagBits::eTransferSrc |
+                vk::ImageUsageFlagBits::eSampled)
+      .setSamples(vk::SampleCountFlagBits::e1);
+  storage.image = device.createImage(createInfo);
+
+  auto requirements =
+      device.getImageMemoryRequirements(storage.image);
+  vk::MemoryAllocateInfo allocInfo;
+  allocInfo.setAllocationSize(requirements.size)
+      .setMemoryTypeIndex(
+          QueryBufferMemTypeIndex(requirements.memoryTypeBits,
+              vk::MemoryPropertyFlagBits::eDeviceLocal)
+              .value());
+  storage.memory = device.allocateMemory(allocInfo);
+  device.bindImageMemory(storage.image, storage.memory, 0);
+
+  vk::ImageSubresourceRange range;
+  range.setAspectMask(vk::ImageAspectFlagBits::eColor)
+      .setBaseMipLevel(0)
+      .setLevelCount(1)
+      .setBaseArrayLayer(0)
+      .setLayerCount(config_.layers);
+  vk::ImageViewCreateInfo viewInfo;
+  viewInfo.setImage(storage.image)
+      .setViewType(vk::ImageViewType::e2DArray)
+      .setFormat(vk::Format::eR8G8B8A8Srgb)
+      .setSubresourceRange(range);
+  storage.view = device.createImageView(viewInfo);
+
+  // 内容在第一次 Flush 时清空
+  app.resourceTracker->Track(storage.image, 1, config_.layers);
+  return storage;
+}
+
+void TextureAtlas::clear(vk::CommandBuffer cmdBuf, Storage &storage) {
+  if (storage.cleared) {
+    return;
+  }
+  // 清成透明，没写过的区域采样到的也是确定的值
+  vk::ImageSubresourceRange range;
+  range.setAspectMask(vk::ImageAspectFlagBits::eColor)
+      .setBaseMipLevel(0)
+      .setLevelCount(1)
+      .setBaseArrayLayer(0)
+      .setLayerCount(config_.layers);
+  cmdBuf.clearColorImage(storage.image,
+      vk::ImageLayout::eTransferDstOptimal,
+      vk::ClearColorValue(0.0f, 0.0f, 0.0f, 0.0f), range);
+  storage.cleared = true;
+  // 后面的拷贝会覆盖清空的结果，要等清空完成
+  if (!pending_.empty()) {
+    auto &tracker = *Application::GetInstance().resourceTracker;
+    tracker.Use(storage.image, ResourceState::TransferDst());
+    tracker.Flush(cmdBuf);
+  }
+}
+
+void TextureAtlas::destroyStorage(Storage &storage) {
+  auto &app = Application::GetInstance();
+  app.resourceTracker->Forget(storage.image);
+  auto &queue = *app.deletionQueue;
+  queue.Retire(storage.view);
+  queue.Retire(storage.image);
+  queue.Retire(storage.memory);
+  storage = {};
+}
+
+void BenchmarkAtlas(uint32_t count) {
+  using Clock = std::chrono::steady_clock;
+  auto msSince = [](Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+        Clock::now() - start)
+        .count();
+  };
+
+  // 在进入渲染循环之前运行，没有在途帧：每步用一次性命令缓冲
+  // 提交并等待，完成后按当前帧序号回收 staging
+  auto &app = Application::GetInstance();
+  const uint64_t frame = app.renderer->FrameIndex();
+  auto submit = [&](const std::function<void(vk::CommandBuffer)> &record) {
+    const auto start = Clock::now();
+    app.commandManager->ExecuteCmd(app.graphicQueue, record);
+    app.stagingRing->Reclaim(frame);
+    return msSince(start);
+  };
+
+  TextureAtlas::Config config;
+  TextureAtlas atlas(config);
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<uint32_t> side(8, 48);
+  std::vector<uint8_t> pixels(48 * 48 * 4);
+  double flushMs = 0;
+  auto flush = [&](vk::CommandBuffer cmdBuf) {
+    atlas.Flush(cmdBuf, frame);
+  };
+  auto addRandom = [&]() -> std::optional<TextureAtlas::Id> {
+    const uint32_t w = side(rng);
+    const uint32_t h = side(rng);
+    std::fill(pixels.begin(), pixels.end(),
+        static_cast<uint8_t>(rng()));
+    auto id = atlas.Add(pixels.data(), w, h);
+    if (!id && atlas.HasPending()) {
+      // 可能是 staging 满了，提交之前的再试一次
+      flushMs += submit(flush);
+      id = atlas.Add(pixels.data(), w, h);
+    }
+    return id;
+  };
+
+  std::vector<TextureAtlas::Id> ids;
+  auto start = Clock::now();
+  for (uint32_t i = 0; i < count; ++i) {
+    if (auto id = addRandom()) {
+      ids.push_back(*id);
+    }
+  }
+  const double addMs = msSince(start) - flushMs;
+  flushMs += submit(flush);
+  const double filled = atlas.Occupancy();
+  const size_t placed = ids.size();
+
+  // 随机删掉一半，留下碎片
+  std::shuffle(ids.begin(), ids.end(), rng);
+  const size_t kept = ids.size() - ids.size() / 2;
+  for (size_t i = kept; i < ids.size(); ++i) {
+    atlas.Remove(ids[i]);
+  }
+  ids.resize(kept);
+  const double fragmented = atlas.Occupancy();
+
+  const double repackMs = submit(
+      [&](vk::CommandBuffer cmdBuf) { atlas.Repack(cmdBuf, frame); });
+  const double repacked = atlas.Occupancy();
+
+  // 同一层内不含 padding 的区域不能相交
+  const float size = float(config.size);
+  auto pixelsOf = [size](float uv) {
+    return static_cast<int64_t>(std::lround(uv * size));
+  };
+  uint32_t overlaps = 0;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    const auto &a = atlas.Get(ids[i]);
+    for (size_t j = i + 1; j < ids.size(); ++j) {
+      const auto &b = atlas.Get(ids[j]);
+      if (a.layer == b.layer &&
+          pixelsOf(a.u0) < pixelsOf(b.u1) &&
+          pixelsOf(b.u0) < pixelsOf(a.u1) &&
+          pixelsOf(a.v0) < pixelsOf(b.v1) &&
+          pixelsOf(b.v0) < pixelsOf(a.v1)) {
+        overlaps++;
+      }
+    }
+  }
+
+  // 重新装箱腾出的空间还能放多少张
+  uint32_t refilled = 0;
+  while (refilled < count && addRandom()) {
+    refilled++;
+  }
+  submit(flush);
+
+  std::cout << "atlas benchmark : " << placed << " / "
+            << count << " images fit, " << config.layers << " x "
+            << config.size << "^2 layers\n";
+  std::cout << "  add " << addMs << " ms, flush " << flushMs
+            << " ms, repack " << repackMs
+            << " ms (flush / repack include the GPU wait)\n";
+  std::cout << "  occupancy : filled " << filled
+            << ", half removed " << fragmented << ", repacked "
+            << repacked << "\n";
+  std::cout << "  overlaps after repack : " << overlaps
+            << ", added after repack : " << refilled << "\n";
+}
+
+} // namespace app
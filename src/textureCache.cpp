@@ -0,0 +1,433 @@
+#include "../header/textureCache.h"
+#include "../header/application.h"
+#include "../header/blockCompress.h"
+#include "../header/colorConvert.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace app {
+
+namespace {
+
+constexpr char Magic[4] = {'T', 'C', 'C', 'H'};
+constexpr uint32_t Version = 2;
+constexpr uint64_t DataAlignment = 16;
+
+// 文件布局：Header，levelCount 个 FileLevel，对齐后是数据
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t format;
+  uint32_t levelCount;
+  uint64_t dataOffset;
+  uint64_t sourceSize;
+  int64_t sourceTime;
+};
+
+struct FileLevel {
+  uint64_t offset;
+  uint64_t size;
+  uint32_t width;
+  uint32_t height;
+};
+
+struct SourceStamp {
+  uint64_t size;
+  int64_t time;
+};
+
+auto stampOf(std::string_view source) -> std::optional<SourceStamp> {
+  std::error_code ec;
+  std::filesystem::path path(source);
+  auto size = std::filesystem::file_size(path, ec);
+  if (ec) {
+    return std::nullopt;
+  }
+  auto time = std::filesystem::last_write_time(path, ec);
+  if (ec) {
+    return std::nullopt;
+  }
+  return SourceStamp{static_cast<uint64_t>(size),
+      static_cast<int64_t>(time.time_since_epoch().count())};
+}
+
+auto blockBytes(BlockFormat format) -> size_t {
+  return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+auto isOpaque(const ImageData &image) -> bool {
+  const size_t count = size_t(image.width) * image.height;
+  const uint8_t *pixels = image.pixels.get();
+  for (size_t i = 0; i < count; ++i) {
+    if (pixels[i * 4 + 3] != 255) {
+      return false;
+    }
+  }
+  return true;
+}
+
+auto megabytes(uint64_t bytes) -> double {
+  return double(bytes) / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+auto ToVkFormat(BlockFormat format) -> vk::Format {
+  switch (format) {
+  case BlockFormat::BC1:
+    return vk::Format::eBc1RgbaSrgbBlock;
+  case BlockFormat::BC7:
+    return vk::Format::eBc7SrgbBlock;
+  case BlockFormat::Astc4x4:
+    return vk::Format::eAstc4x4SrgbBlock;
+  default:
+    return vk::Format::eR8G8B8A8Srgb;
+  }
+}
+
+auto BlockFormatName(BlockFormat format) -> const char * {
+  switch (format) {
+  case BlockFormat::BC1:
+    return "bc1";
+  case BlockFormat::BC7:
+    return "bc7";
+  case BlockFormat::Astc4x4:
+    return "astc";
+  default:
+    return "rgba8";
+  }
+}
+
+auto ParseBlockFormat(std::string_view name)
+    -> std::optional<BlockFormat> {
+  for (auto format : {BlockFormat::Rgba8, BlockFormat::BC1,
+           BlockFormat::BC7, BlockFormat::Astc4x4}) {
+    if (name == BlockFormatName(format)) {
+      return format;
+    }
+  }
+  return std::nullopt;
+}
+
+auto BitsPerTexel(BlockFormat format) -> uint32_t {
+  switch (format) {
+  case BlockFormat::BC1:
+    return 4;
+  case BlockFormat::BC7:
+  case BlockFormat::Astc4x4:
+    return 8;
+  default:
+    return 32;
+  }
+}
+
+auto SupportedBlockFormats() -> std::vector<BlockFormat> {
+  auto &phyDevice = Application::GetInstance().phyDevice;
+  auto features = phyDevice.getFeatures();
+  auto sampleable = [&](BlockFormat format) {
+    auto props = phyDevice.getFormatProperties(ToVkFormat(format));
+    return static_cast<bool>(props.optimalTilingFeatures &
+                             vk::FormatFeatureFlagBits::eSampledImage);
+  };
+
+  std::vector<BlockFormat> formats;
+  if (features.textureCompressionBC) {
+    for (auto format : {BlockFormat::BC7, BlockFormat::BC1}) {
+      if (sampleable(format)) {
+        formats.push_back(format);
+      }
+    }
+  }
+  if (features.textureCompressionASTC_LDR &&
+      sampleable(BlockFormat::Astc4x4)) {
+    formats.push_back(BlockFormat::Astc4x4);
+  }
+  return formats;
+}
+
+#ifdef _WIN32
+auto MappedFile::Open(const std::string &path)
+    -> std::unique_ptr<MappedFile> {
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ,
+      FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return nullptr;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    return nullptr;
+  }
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    CloseHandle(file);
+    return nullptr;
+  }
+  void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!data) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return nullptr;
+  }
+  std::unique_ptr<MappedFile> mapped(new MappedFile());
+  mapped->data_ = static_cast<const uint8_t *>(data);
+  mapped->size_ = static_cast<size_t>(size.QuadPart);
+  mapped->file_ = file;
+  mapped->mapping_ = mapping;
+  return mapped;
+}
+
+MappedFile::~MappedFile() {
+  UnmapViewOfFile(data_);
+  CloseHandle(mapping_);
+  CloseHandle(file_);
+}
+#else
+auto MappedFile::Open(const std::string &path)
+    -> std::unique_ptr<MappedFile> {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st {};
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return nullptr;
+  }
+  void *data = mmap(nullptr, static_cast<size_t>(st.st_size),
+      PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    ::close(fd);
+    return nullptr;
+  }
+  // 整个文件马上会顺序拷贝进 staging
+  madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+  std::unique_ptr<MappedFile> mapped(new MappedFile());
+  mapped->data_ = static_cast<const uint8_t *>(data);
+  mapped->size_ = static_cast<size_t>(st.st_size);
+  mapped->fd_ = fd;
+  return mapped;
+}
+
+MappedFile::~MappedFile() {
+  munmap(const_cast<uint8_t *>(data_), size_);
+  ::close(fd_);
+}
+#endif
+
+auto TextureCache::PathFor(std::string_view source,
+    BlockFormat format) -> std::string {
+  std::string name(source);
+  std::replace_if(
+      name.begin(), name.end(),
+      [](char c) { return c == '/' || c == '\\' || c == ':'; },
+      '_');
+  return "cache/" + name + "." + BlockFormatName(format) +
+         ".tcache";
+}
+
+auto TextureCache::Open(std::string_view source,
+    BlockFormat format) -> std::unique_ptr<TextureCache> {
+  auto stamp = stampOf(source);
+  if (!stamp) {
+    return nullptr;
+  }
+  auto file = MappedFile::Open(PathFor(source, format));
+  if (!file || file->Size() < sizeof(FileHeader)) {
+    return nullptr;
+  }
+
+  FileHeader header;
+  std::memcpy(&header, file->Data(), sizeof(header));
+  if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+      header.version != Version ||
+      header.format != static_cast<uint32_t>(format) ||
+      header.levelCount == 0 ||
+      header.sourceSize != stamp->size ||
+      header.sourceTime != stamp->time) {
+    // 源文件改过或者格式不对，需要重新生成
+    return nullptr;
+  }
+  const uint64_t tableEnd =
+      sizeof(FileHeader) + header.levelCount * sizeof(FileLevel);
+  if (tableEnd > header.dataOffset ||
+      header.dataOffset > file->Size()) {
+    return nullptr;
+  }
+
+  auto cache = std::unique_ptr<TextureCache>(new TextureCache());
+  cache->format_ = format;
+  cache->levels_.resize(header.levelCount);
+  for (uint32_t i = 0; i < header.levelCount; ++i) {
+    FileLevel level;
+    std::memcpy(&level,
+        file->Data() + sizeof(FileHeader) + i * sizeof(FileLevel),
+        sizeof(level));
+    if (header.dataOffset + level.offset + level.size >
+        file->Size()) {
+      return nullptr;
+    }
+    cache->levels_[i] = {
+        level.offset, level.size, level.width, level.height};
+  }
+  cache->file_ = std::move(file);
+  cache->dataOffset_ = header.dataOffset;
+  return cache;
+}
+
+auto TextureCache::Build(std::string_view source,
+    BlockFormat format, const ImageData &image) -> bool {
+  if (format != BlockFormat::BC1 && format != BlockFormat::BC7) {
+    std::cerr << "texture cache : can not encode "
+              << BlockFormatName(format) << '\n';
+    return false;
+  }
+  if (format == BlockFormat::BC1 && !isOpaque(image)) {
+    return false;
+  }
+  auto stamp = stampOf(source);
+  if (!stamp) {
+    return false;
+  }
+
+  // 先在 CPU 上生成整条 mip 链，再逐级压缩
+  std::vector<FileLevel> levels;
+  std::vector<uint8_t> data;
+  std::vector<uint8_t> current(image.pixels.get(),
+      image.pixels.get() + size_t(image.width) * image.height * 4);
+  std::vector<uint8_t> next;
+  uint32_t w = image.width;
+  uint32_t h = image.height;
+  for (;;) {
+    const uint64_t size = uint64_t(BlockCount(w)) * BlockCount(h) *
+                          blockBytes(format);
+    FileLevel level{data.size(), size, w, h};
+    levels.push_back(level);
+    data.resize(data.size() + size);
+    CompressImage(current.data(), w, h, blockBytes(format),
+        data.data() + level.offset);
+    if (w == 1 && h == 1) {
+      break;
+    }
+    next.resize(size_t(std::max(w / 2, 1u)) *
+                std::max(h / 2, 1u) * 4);
+    DownsampleSRGBA2x2(current.data(), w, h, next.data());
+    current.swap(next);
+    w = std::max(w / 2, 1u);
+    h = std::max(h / 2, 1u);
+  }
+
+  FileHeader header{};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = Version;
+  header.format = static_cast<uint32_t>(format);
+  header.levelCount = static_cast<uint32_t>(levels.size());
+  const uint64_t tableEnd =
+      sizeof(FileHeader) + levels.size() * sizeof(FileLevel);
+  header.dataOffset =
+      (tableEnd + DataAlignment - 1) / DataAlignment * DataAlignment;
+  header.sourceSize = stamp->size;
+  header.sourceTime = stamp->time;
+
+  const auto path = PathFor(source, format);
+  std::error_code ec;
+  std::filesystem::create_directories(
+      std::filesystem::path(path).parent_path(), ec);
+  // 先写临时文件再改名，避免中断时留下半个缓存
+  const auto temp = path + ".tmp";
+  {
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      std::cerr << "texture cache : can not write " << temp
+                << '\n';
+      return false;
+    }
+    file.write(reinterpret_cast<const char *>(&header),
+        sizeof(header));
+    file.write(reinterpret_cast<const char *>(levels.data()),
+        static_cast<std::streamsize>(
+            levels.size() * sizeof(FileLevel)));
+    const std::vector<char> padding(header.dataOffset - tableEnd, 0);
+    file.write(padding.data(),
+        static_cast<std::streamsize>(padding.size()));
+    file.write(reinterpret_cast<const char *>(data.data()),
+        static_cast<std::streamsize>(data.size()));
+    if (!file) {
+      return false;
+    }
+  }
+  std::filesystem::rename(temp, path, ec);
+  return !ec;
+}
+
+auto TextureCache::Data() const -> const uint8_t * {
+  return file_->Data() + dataOffset_;
+}
+
+auto TextureCache::DataSize() const -> uint64_t {
+  const auto &last = levels_.back();
+  return last.offset + last.size;
+}
+
+void TextureCache::PrintFootprint(std::string_view source) const {
+  uint64_t rgbaBytes = 0;
+  for (const auto &level : levels_) {
+    rgbaBytes += uint64_t(level.width) * level.height * 4;
+  }
+  const uint32_t bits = BitsPerTexel(format_);
+  std::cout << std::fixed << std::setprecision(2)
+            << "texture cache : " << source << " "
+            << BlockFormatName(format_) << " " << Width() << "x"
+            << Height() << ", " << levels_.size() << " mips, "
+            << megabytes(DataSize()) << " MB (rgba8 "
+            << megabytes(rgbaBytes) << " MB), sampling "
+            << bits << " vs 32 bits/texel, "
+            << 32.0 / bits << "x less bandwidth\n";
+  std::cout.unsetf(std::ios::floatfield);
+}
+
+auto LoadTextureCache(std::string_view source,
+    const std::function<const ImageData &()> &decode)
+    -> std::unique_ptr<TextureCache> {
+  auto formats = SupportedBlockFormats();
+  for (auto format : formats) {
+    if (auto cache = TextureCache::Open(source, format)) {
+      return cache;
+    }
+  }
+
+  const ImageData *image = nullptr;
+  for (auto format : formats) {
+    if (format == BlockFormat::Astc4x4) {
+      continue;
+    }
+    if (!image) {
+      image = &decode();
+    }
+    if (TextureCache::Build(source, format, *image)) {
+      return TextureCache::Open(source, format);
+    }
+  }
+  return nullptr;
+}
+
+} // namespace app
@@ -0,0 +1,197 @@
+#include "../header/textureManager.h"
+#include "../header/application.h"
+#include <algorithm>
+#include <iostream>
+
+namespace app {
+
+std::unique_ptr<TextureManager> TextureManager::instance =
+    nullptr;
+
+namespace {
+
+// 尺寸作为标记，像素相同但宽高不同的图像不会相撞
+auto imageTag(uint32_t w, uint32_t h) -> uint64_t {
+  return (uint64_t(w) << 32) | h;
+}
+
+} // namespace
+
+TextureManager::TextureManager(const Config &config)
+    : config_(config) {}
+
+TextureManager::~TextureManager() {
+  entries_.clear();
+}
+
+auto TextureManager::Load(std::string_view path,
+    const std::function<ImageData()> &decode)
+    -> TextureHandle {
+  std::lock_guard lock(mutex_);
+  stats_.requests++;
+  if (auto it = paths_.find(std::string(path));
+      it != paths_.end()) {
+    stats_.pathHits++;
+    return acquire(it->second, {});
+  }
+
+  // 生成压缩缓存失败时退回 RGBA8，图像只解码一次
+  std::optional<ImageData> image;
+  auto decodeImage = [&]() -> const ImageData & {
+    if (!image) {
+      image = decode ? decode() : LoadImageData(path);
+    }
+    return *image;
+  };
+  if (auto cache = LoadTextureCache(path, decodeImage)) {
+    // 编码器是确定的，压缩数据相同即内容相同
+    const auto key = keyOf(cache->Data(), cache->DataSize(),
+        static_cast<uint64_t>(cache->Format()));
+    if (auto id = find(key)) {
+      stats_.contentHits++;
+      return acquire(*id, path);
+    }
+    cache->PrintFootprint(path);
+    return insert(key, std::make_shared<Texture>(*cache), path);
+  }
+
+  const auto &pixels = decodeImage();
+  const auto key = keyOf(pixels.pixels.get(),
+      size_t(pixels.width) * pixels.height * 4,
+      imageTag(pixels.width, pixels.height));
+  if (auto id = find(key)) {
+    stats_.contentHits++;
+    return acquire(*id, path);
+  }
+  return insert(key,
+      std::make_shared<Texture>(pixels, vk::Sampler{}), path);
+}
+
+auto TextureManager::Create(const void *pixels, uint32_t w,
+    uint32_t h) -> TextureHandle {
+  std::lock_guard lock(mutex_);
+  stats_.requests++;
+  const auto key = keyOf(pixels, size_t(w) * h * 4, imageTag(w, h));
+  if (auto id = find(key)) {
+    stats_.contentHits++;
+    return acquire(*id, {});
+  }
+  return insert(key,
+      std::make_shared<Texture>(
+          const_cast<void *>(pixels), w, h, vk::Sampler{}),
+      {});
+}
+
+void TextureManager::SetBudget(vk::DeviceSize bytes) {
+  std::lock_guard lock(mutex_);
+  config_.vramBudget = bytes;
+  evict();
+}
+
+void TextureManager::Update(uint64_t frame) {
+  std::lock_guard lock(mutex_);
+  frame_ = frame;
+  // 仍有句柄的纹理视为本帧在用
+  for (auto &[id, entry] : entries_) {
+    if (entry.texture.use_count() > 1) {
+      entry.lastUsed = frame;
+    }
+  }
+  evict();
+}
+
+auto TextureManager::GetStats() const -> Stats {
+  std::lock_guard lock(mutex_);
+  Stats stats = stats_;
+  stats.textureCount = entries_.size();
+  return stats;
+}
+
+void TextureManager::PrintStats() const {
+  const auto stats = GetStats();
+  vk::DeviceSize budget;
+  {
+    std::lock_guard lock(mutex_);
+    budget = config_.vramBudget;
+  }
+  constexpr double MiB = 1024.0 * 1024.0;
+  std::cout << "textures : " << stats.textureCount << " resident, "
+            << stats.residentBytes / MiB << " / " << budget / MiB
+            << " MiB, hit rate " << stats.HitRate() * 100.0 << "% ("
+            << stats.pathHits << " path, " << stats.contentHits
+            << " content, " << stats.misses << " miss, "
+            << stats.evictions << " evicted)\n";
+}
+
+auto TextureManager::keyOf(const void *data, size_t size,
+    uint64_t tag) -> ContentKey {
+  return {HashBytes128(data, size, tag), size, tag};
+}
+
+auto TextureManager::find(const ContentKey &key) const
+    -> std::optional<uint64_t> {
+  const auto found = contents_.find(key);
+  if (found == contents_.end()) {
+    return std::nullopt;
+  }
+  return found->second;
+}
+
+auto TextureManager::acquire(uint64_t id,
+    std::string_view path) -> TextureHandle {
+  auto &entry = entries_.at(id);
+  entry.lastUsed = frame_;
+  if (!path.empty()) {
+    entry.paths.emplace_back(path);
+    paths_.emplace(std::string(path), id);
+  }
+  return entry.texture;
+}
+
+auto TextureManager::insert(const ContentKey &key,
+    TextureHandle texture, std::string_view path) -> TextureHandle {
+  stats_.misses++;
+  stats_.residentBytes += texture->memorySize;
+  const uint64_t id = nextId_++;
+  Entry entry;
+  entry.texture = std::move(texture);
+  entry.key = key;
+  entries_.emplace(id, std::move(entry));
+  contents_.emplace(key, id);
+  auto handle = acquire(id, path);
+  evict();
+  return handle;
+}
+
+void TextureManager::evict() {
+  while (stats_.residentBytes > config_.vramBudget) {
+    // 只淘汰没有外部句柄的纹理，取最久没用的
+    auto victim = entries_.end();
+    for (auto it = entries_.begin(); it != entries_.end();
+         ++it) {
+      if (it->second.texture.use_count() > 1) {
+        continue;
+      }
+      if (victim == entries_.end() ||
+          it->second.lastUsed < victim->second.lastUsed) {
+        victim = it;
+      }
+    }
+    if (victim == entries_.end()) {
+      // 全部在用，只能暂时超出预算
+      return;
+    }
+
+    auto &entry = victim->second;
+    for (const auto &path : entry.paths) {
+      paths_.erase(path);
+    }
+    contents_.erase(entry.key);
+    stats_.residentBytes -= entry.texture->memorySize;
+    stats_.evictions++;
+    // 析构会等引用它的帧完成后再销毁 GPU 对象
+    entries_.erase(victim);
+  }
+}
+
+} // namespace app
@@ -0,0 +1,397 @@
+#include "../header/textureStreamer.h"
+#include "../header/application.h"
+#include <algorithm>
+#include <cstring>
+
+namespace app {
+
+namespace {
+
+constexpr size_t BatchCount = 3;
+
+} // namespace
+
+TextureStreamer::TextureStreamer(
+    vk::Sampler sampler, const Config &config)
+    : ring_(config.stagingSize), config_(config) {
+  auto &app = Application::GetInstance();
+
+  // 2x2 灰色 / 品红棋盘格，一眼能看出还没加载完
+  uint32_t checker[4] = {
+      0xFFFF00FF, 0xFF808080, 0xFF808080, 0xFFFF00FF};
+  placeholder_ =
+      std::make_unique<Texture>(checker, 2, 2, sampler);
+
+  batches_.resize(BatchCount);
+  for (auto &batch : batches_) {
+    batch.cmdBuf =
+        app.commandManager->CreateOneCommandBuffer();
+    vk::FenceCreateInfo info;
+    info.setFlags(vk::FenceCreateFlagBits::eSignaled);
+    batch.fence = app.device.createFence(info);
+  }
+
+  for (uint32_t i = 0; i < config_.workerCount; ++i) {
+    workers_.emplace_back([this] { workerLoop(); });
+  }
+}
+
+TextureStreamer::~TextureStreamer() {
+  {
+    std::lock_guard lock(queueMutex_);
+    stop_ = true;
+  }
+  queueCond_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+
+  auto &app = Application::GetInstance();
+  for (auto &batch : batches_) {
+    if (batch.submitted) {
+      (void)app.device.waitForFences(batch.fence, true,
+          std::numeric_limits<uint64_t>::max());
+    }
+    app.commandManager->FreeCmd(batch.cmdBuf);
+    app.device.destroyFence(batch.fence);
+  }
+  ring_.Reclaim(batchCounter_);
+}
+
+auto TextureStreamer::Load(const std::string &path,
+    int priority) -> Handle {
+  auto request = std::make_shared<Request>();
+  request->path = path;
+  request->priority = priority;
+  {
+    std::lock_guard lock(queueMutex_);
+    request->order = nextOrder_++;
+    queue_.push(request);
+  }
+  queueCond_.notify_one();
+  stats_.requested++;
+  return request;
+}
+
+void TextureStreamer::Cancel(const Handle &handle) {
+  auto state = handle->state.load();
+  // 已经驻留或失败的请求不再处理
+  while (state != State::Resident &&
+         state != State::Cancelled && state != State::Failed) {
+    if (handle->state.compare_exchange_weak(
+            state, State::Cancelled)) {
+      stats_.cancelled++;
+      return;
+    }
+  }
+}
+
+void TextureStreamer::SetUploadBudget(vk::DeviceSize bytes) {
+  config_.uploadBudget = bytes;
+}
+
+auto TextureStreamer::View(const Handle &handle) const
+    -> vk::ImageView {
+  if (IsResident(handle)) {
+    return handle->texture->view;
+  }
+  return placeholder_->view;
+}
+
+auto TextureStreamer::GetStats() const -> Stats {
+  Stats stats = stats_;
+  stats.failed = failed_.load();
+  return stats;
+}
+
+void TextureStreamer::workerLoop() {
+  for (;;) {
+    Handle request;
+    {
+      std::unique_lock lock(queueMutex_);
+      queueCond_.wait(
+          lock, [this] { return stop_ || !queue_.empty(); });
+      if (stop_) {
+        return;
+      }
+      request = queue_.top();
+      queue_.pop();
+    }
+
+    auto expected = State::Queued;
+    if (!request->state.compare_exchange_strong(
+            expected, State::Decoding)) {
+      // 排队期间被取消
+      continue;
+    }
+    try {
+      decode(*request);
+    } catch (const std::exception &) {
+      request->state.store(State::Failed);
+      failed_++;
+      continue;
+    }
+
+    expected = State::Decoding;
+    if (!request->state.compare_exchange_strong(
+            expected, State::Decoded)) {
+      // GPU 还没用过这块 staging，直接归还
+      if (request->staging) {
+        ring_.Free(*request->staging);
+        request->staging.reset();
+      }
+      request->image = ImageData{};
+      continue;
+    }
+    std::lock_guard lock(decodedMutex_);
+    decoded_.push_back(std::move(request));
+  }
+}
+
+void TextureStreamer::decode(Request &request) {
+  // 单张图最多占 ring 的 1/4，避免大图把上传饿死
+  const vk::DeviceSize limit = ring_.Size() / 4;
+  std::optional<StagingRing::Block> block;
+  std::optional<DecodeInfo> info;
+  try {
+    info = DecodeImageInto(request.path,
+        [&](uint32_t w, uint32_t h) -> uint8_t * {
+          const vk::DeviceSize size = vk::DeviceSize(w) * h * 4;
+          if (size <= limit) {
+            block = ring_.Allocate(size);
+          }
+          return block ? static_cast<uint8_t *>(block->ptr)
+                       : nullptr;
+        });
+  } catch (const std::exception &) {
+    if (block) {
+      ring_.Free(*block);
+    }
+    throw;
+  }
+
+  if (info) {
+    request.image.width = info->width;
+    request.image.height = info->height;
+    request.staging = block;
+    return;
+  }
+  request.image = LoadImageData(request.path);
+}
+
+void TextureStreamer::Update() {
+  reclaimBatches();
+
+  {
+    std::lock_guard lock(decodedMutex_);
+    for (auto &request : decoded_) {
+      uploading_.push_back(std::move(request));
+    }
+    decoded_.clear();
+  }
+
+  stats_.uploadedLastFrame = 0;
+  auto &batch = batches_[nextBatch_];
+  if (batch.submitted || uploading_.empty()) {
+    // 上一轮还在 GPU 上执行，本帧不再提交
+    return;
+  }
+  recordUploads(batch);
+  nextBatch_ = (nextBatch_ + 1) % batches_.size();
+}
+
+void TextureStreamer::reclaimBatches() {
+  auto &device = Application::GetInstance().device;
+  for (auto &batch : batches_) {
+    if (!batch.submitted ||
+        device.getFenceStatus(batch.fence) !=
+            vk::Result::eSuccess) {
+      continue;
+    }
+    completedBatch_ = std::max(completedBatch_, batch.id);
+    for (auto &request : batch.completing) {
+      auto expected = State::Uploading;
+      if (request->state.compare_exchange_strong(
+              expected, State::Resident)) {
+        stats_.resident++;
+      } else {
+        // 上传期间被取消，GPU 已经用完可以直接销毁
+        request->texture.reset();
+      }
+    }
+    batch.completing.clear();
+    batch.retired.clear();
+    batch.submitted = false;
+  }
+  // 同一队列按提交顺序完成，更早的批次也一定完成了
+  ring_.Reclaim(completedBatch_);
+}
+
+void TextureStreamer::recordUploads(Batch &batch) {
+  batch.cmdBuf.reset();
+  vk::CommandBufferBeginInfo beginInfo;
+  beginInfo.setFlags(
+      vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+  batch.cmdBuf.begin(beginInfo);
+
+  std::stable_sort(uploading_.begin(), uploading_.end(),
+      Compare{});
+  std::reverse(uploading_.begin(), uploading_.end());
+
+  bool recorded = false;
+  vk::DeviceSize budget = config_.uploadBudget;
+  for (auto &request : uploading_) {
+    auto state = request->state.load();
+    if (state == State::Cancelled) {
+      retire(batch, request);
+      continue;
+    }
+    if (budget == 0) {
+      continue;
+    }
+    auto bytes = uploadRows(batch, *request, budget);
+    budget -= std::min(budget, bytes);
+    recorded |= bytes > 0;
+
+    if (request->uploadedRows == request->image.height) {
+      // 第 0 层传完，同一批次内 blit 出其余 mip
+      request->texture->RecordMipmaps(batch.cmdBuf);
+      // CPU 端像素已经全部进入 staging
+      if (request->staging) {
+        batch.staging.push_back(*request->staging);
+        request->staging.reset();
+      }
+      request->image = ImageData{};
+      batch.completing.push_back(request);
+      request = nullptr;
+    }
+  }
+  uploading_.erase(std::remove(uploading_.begin(),
+                       uploading_.end(), nullptr),
+      uploading_.end());
+  stats_.uploadedLastFrame = config_.uploadBudget - budget;
+
+  batch.cmdBuf.end();
+  // 交出的 staging 可能还被之前的批次读取，即使本批次
+  // 没有录制拷贝也要提交，让它们跟着这个 fence 回收
+  if (!recorded && batch.retired.empty() && batch.staging.empty()) {
+    return;
+  }
+  submit(batch);
+}
+
+void TextureStreamer::submit(Batch &batch) {
+  auto &app = Application::GetInstance();
+  app.device.resetFences(batch.fence);
+  vk::SubmitInfo info;
+  info.setCommandBuffers(batch.cmdBuf);
+  app.graphicQueue.submit(info, batch.fence);
+  // 提交成功后才分配批次号，staging 只按真正提交的批次回收
+  batch.id = ++batchCounter_;
+  batch.submitted = true;
+  for (const auto &block : batch.staging) {
+    ring_.Retire(block, batch.id);
+  }
+  batch.staging.clear();
+}
+
+auto TextureStreamer::uploadRows(Batch &batch,
+    Request &request, vk::DeviceSize budget)
+    -> vk::DeviceSize {
+  const auto &image = request.image;
+  const vk::DeviceSize rowBytes =
+      vk::DeviceSize(image.width) * 4;
+
+  auto rows = static_cast<uint32_t>(
+      std::min<vk::DeviceSize>(
+          image.height - request.uploadedRows,
+          budget / rowBytes));
+  if (rows == 0) {
+    // 单行超过预算时，帧内第一个上传至少推进一行
+    if (budget != config_.uploadBudget) {
+      return 0;
+    }
+    rows = 1;
+  }
+
+  // 已经写入 staging 的图不需要再分配和拷贝
+  std::optional<StagingRing::Block> block;
+  vk::DeviceSize offset = 0;
+  if (request.staging) {
+    offset =
+        request.staging->offset + request.uploadedRows * rowBytes;
+  } else {
+    while (rows > 0 &&
+           !(block = ring_.Allocate(rows * rowBytes))) {
+      rows /= 2;
+    }
+    if (!block) {
+      return 0;
+    }
+    offset = block->offset;
+  }
+
+  if (!request.texture) {
+    auto expected = State::Decoded;
+    if (!request.state.compare_exchange_strong(
+            expected, State::Uploading)) {
+      if (block) {
+        ring_.Free(*block);
+      }
+      return 0;
+    }
+    // 按行分批上传时 CPU 上没有完整图像，
+    // 不支持 blit 的格式只保留第 0 层
+    request.texture = std::make_unique<Texture>(image.width,
+        image.height, Texture::SupportsLinearBlit());
+    auto &tracker = *Application::GetInstance().resourceTracker;
+    tracker.Use(
+        request.texture->image, ResourceState::TransferDst());
+    tracker.Flush(batch.cmdBuf);
+  }
+
+  if (block) {
+    std::memcpy(block->ptr,
+        image.pixels.get() + request.uploadedRows * rowBytes,
+        rows * rowBytes);
+  }
+
+  vk::ImageSubresourceLayers layers;
+  layers.setAspectMask(vk::ImageAspectFlagBits::eColor)
+      .setMipLevel(0)
+      .setBaseArrayLayer(0)
+      .setLayerCount(1);
+  vk::BufferImageCopy region;
+  region.setBufferOffset(offset)
+      .setBufferRowLength(0)
+      .setBufferImageHeight(0)
+      .setImageSubresource(layers)
+      .setImageOffset(
+          {0, static_cast<int32_t>(request.uploadedRows), 0})
+      .setImageExtent({image.width, rows, 1});
+  const vk::Buffer buffer =
+      block ? block->buffer : request.staging->buffer;
+  batch.cmdBuf.copyBufferToImage(buffer, request.texture->image,
+      vk::ImageLayout::eTransferDstOptimal, region);
+  if (block) {
+    batch.staging.push_back(*block);
+  }
+
+  request.uploadedRows += rows;
+  return rows * rowBytes;
+}
+
+void TextureStreamer::retire(Batch &batch, Handle &request) {
+  // 之前的批次可能还在写这张图，跟随本批次一起销毁
+  if (request->texture) {
+    batch.retired.push_back(std::move(request->texture));
+  }
+  if (request->staging) {
+    batch.staging.push_back(*request->staging);
+    request->staging.reset();
+  }
+  request->image = ImageData{};
+  request = nullptr;
+}
+
+} // namespace app
\ No newline at end of file
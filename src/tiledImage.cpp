@@ -0,0 +1,521 @@
+#include "../header/tiledImage.h"
+#include "../header/application.h"
+#include "../header/colorConvert.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace app {
+
+namespace {
+
+constexpr char Magic[4] = {'T', 'P', 'Y', 'R'};
+constexpr uint32_t Version = 1;
+constexpr uint32_t Border = 1;
+
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t tileSize;
+  uint32_t border;
+  uint32_t levelCount;
+  uint32_t reserved;
+  uint64_t dataOffset;
+};
+
+struct FileLevel {
+  uint32_t width;
+  uint32_t height;
+  uint32_t tilesX;
+  uint32_t tilesY;
+  uint64_t firstTile;
+};
+
+auto tilesFor(uint32_t texels, uint32_t tileSize) -> uint32_t {
+  return (texels + tileSize - 1) / tileSize;
+}
+
+} // namespace
+
+auto BuildTilePyramid(const ImageData &image,
+    const std::string &output, uint32_t tileSize) -> bool {
+  std::vector<FileLevel> levels;
+  uint64_t tileCount = 0;
+  uint32_t w = image.width;
+  uint32_t h = image.height;
+  for (;;) {
+    FileLevel level{w, h, tilesFor(w, tileSize),
+        tilesFor(h, tileSize), tileCount};
+    levels.push_back(level);
+    tileCount += uint64_t(level.tilesX) * level.tilesY;
+    // 最高一级只有一块，作为常驻的兜底
+    if (w <= tileSize && h <= tileSize) {
+      break;
+    }
+    w = std::max(w / 2, 1u);
+    h = std::max(h / 2, 1u);
+  }
+
+  FileHeader header{};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = Version;
+  header.width = image.width;
+  header.height = image.height;
+  header.tileSize = tileSize;
+  header.border = Border;
+  header.levelCount = static_cast<uint32_t>(levels.size());
+  const uint64_t tableEnd =
+      sizeof(FileHeader) + levels.size() * sizeof(FileLevel);
+  header.dataOffset = (tableEnd + 15) / 16 * 16;
+
+  std::ofstream file(output, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+  file.write(reinterpret_cast<const char *>(&header),
+      sizeof(header));
+  file.write(reinterpret_cast<const char *>(levels.data()),
+      static_cast<std::streamsize>(
+          levels.size() * sizeof(FileLevel)));
+  const std::vector<char> padding(header.dataOffset - tableEnd, 0);
+  file.write(padding.data(),
+      static_cast<std::streamsize>(padding.size()));
+
+  const uint32_t slot = tileSize + Border * 2;
+  std::vector<uint8_t> tile(size_t(slot) * slot * 4);
+  std::vector<uint8_t> current(image.pixels.get(),
+      image.pixels.get() + size_t(image.width) * image.height * 4);
+  std::vector<uint8_t> next;
+  for (const auto &level : levels) {
+    for (uint32_t ty = 0; ty < level.tilesY; ++ty) {
+      for (uint32_t tx = 0; tx < level.tilesX; ++tx) {
+        // 边框取相邻块的像素，超出图像的部分重复边缘
+        for (uint32_t y = 0; y < slot; ++y) {
+          const int64_t sy = std::clamp<int64_t>(
+              int64_t(ty) * tileSize + y - Border, 0,
+              level.height - 1);
+          for (uint32_t x = 0; x < slot; ++x) {
+            const int64_t sx = std::clamp<int64_t>(
+                int64_t(tx) * tileSize + x - Border, 0,
+                level.width - 1);
+            std::memcpy(tile.data() + (size_t(y) * slot + x) * 4,
+                current.data() + (sy * level.width + sx) * 4, 4);
+          }
+        }
+        file.write(reinterpret_cast<const char *>(tile.data()),
+            static_cast<std::streamsize>(tile.size()));
+      }
+    }
+    if (&level != &levels.back()) {
+      next.resize(size_t(std::max(level.width / 2, 1u)) *
+                  std::max(level.height / 2, 1u) * 4);
+      DownsampleSRGBA2x2(
+          current.data(), level.width, level.height, next.data());
+      current.swap(next);
+    }
+  }
+  return static_cast<bool>(file);
+}
+
+TiledImage::TiledImage(const std::string &path,
+    const Config &config, uint32_t frameCount)
+    : config_(config) {
+  file_ = MappedFile::Open(path);
+  if (!file_ || file_->Size() < sizeof(FileHeader)) {
+    throw std::runtime_error("tile pyramid open failed");
+  }
+  FileHeader header;
+  std::memcpy(&header, file_->Data(), sizeof(header));
+  if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+      header.version != Version || header.levelCount == 0) {
+    throw std::runtime_error("invalid tile pyramid");
+  }
+  tileSize_ = header.tileSize;
+  border_ = header.border;
+  slotSize_ = tileSize_ + border_ * 2;
+  dataOffset_ = header.dataOffset;
+
+  levels_.resize(header.levelCount);
+  for (uint32_t i = 0; i < header.levelCount; ++i) {
+    FileLevel level;
+    std::memcpy(&level,
+        file_->Data() + sizeof(FileHeader) + i * sizeof(FileLevel),
+        sizeof(level));
+    levels_[i] = {level.width, level.height, level.tilesX,
+        level.tilesY, level.firstTile};
+  }
+  const auto &top = levels_.back();
+  const uint64_t tileCount =
+      top.firstTile + uint64_t(top.tilesX) * top.tilesY;
+  const uint64_t tileBytes = uint64_t(slotSize_) * slotSize_ * 4;
+  if (dataOffset_ + tileCount * tileBytes > file_->Size()) {
+    throw std::runtime_error("truncated tile pyramid");
+  }
+  const uint32_t slotCount =
+      config_.slotsPerSide * config_.slotsPerSide;
+  indirection_.reserve(slotCount);
+  slots_.resize(slotCount);
+  for (uint32_t i = slotCount; i > 0; --i) {
+    freeSlots_.push_back(i - 1);
+  }
+  createCache();
+
+  frames_.resize(frameCount);
+  for (auto &frame : frames_) {
+    frame.staging = std::make_unique<BufferPkg>(
+        config_.uploadsPerFrame * tileBytes,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCoherent);
+    frame.vertices = std::make_unique<BufferPkg>(
+        sizeof(Vertex) * 4 * config_.maxQuads,
+        vk::BufferUsageFlagBits::eVertexBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCoherent);
+  }
+  indices_ = std::make_unique<BufferPkg>(
+      sizeof(uint32_t) * 6 * config_.maxQuads,
+      vk::BufferUsageFlagBits::eIndexBuffer,
+      vk::MemoryPropertyFlagBits::eHostVisible |
+          vk::MemoryPropertyFlagBits::eHostCoherent);
+  auto *index = static_cast<uint32_t *>(indices_->map);
+  for (uint32_t q = 0; q < config_.maxQuads; ++q) {
+    const uint32_t base = q * 4;
+    const uint32_t quad[6] = {
+        base, base + 1, base + 2, base + 2, base + 3, base};
+    std::memcpy(index + q * 6, quad, sizeof(quad));
+  }
+}
+
+TiledImage::~TiledImage() {
+  auto &app = Application::GetInstance();
+  frames_.clear();
+  indices_.reset();
+  app.resourceTracker->Forget(image_);
+  // 切换图片时不等设备空闲，缓存图像交给延迟销毁
+  auto &queue = *app.deletionQueue;
+  queue.Retire(view_);
+  queue.Retire(image_);
+  queue.Retire(memory_);
+}
+
+auto TiledImage::tileData(uint64_t index) const
+    -> const uint8_t * {
+  const uint64_t tileBytes = uint64_t(slotSize_) * slotSize_ * 4;
+  return file_->Data() + dataOffset_ + index * tileBytes;
+}
+
+void TiledImage::createCache() {
+  auto &app = Application::GetInstance();
+  auto &device = app.device;
+  const uint32_t size = config_.slotsPerSide * slotSize_;
+
+  vk::ImageCreateInfo createInfo;
+  createInfo.setImageType(vk::ImageType::e2D)
+      .setArrayLayers(1)
+      .setMipLevels(1)
+      .setExtent({size, size, 1})
+      .setFormat(vk::Format::eR8G8B8A8Srgb)
+      .setTiling(vk::ImageTiling::eOptimal)
+      .setInitialLayout(vk::ImageLayout::eUndefined)
+      .setUsage(vk::ImageUsageFlagBits::eTransferDst |
+                vk::ImageUsageFlagBits::eSampled)
+      .setSamples(vk::SampleCountFlagBits::e1);
+  image_ = device.createImage(createInfo);
+
+  auto requirements = device.getImageMemoryRequirements(image_);
+  vk::MemoryAllocateInfo allocInfo;
+  allocInfo.setAllocationSize(requirements.size)
+      .setMemoryTypeIndex(
+          QueryBufferMemTypeIndex(requirements.memoryTypeBits,
+              vk::MemoryPropertyFlagBits::eDeviceLocal)
+              .value());
+  memory_ = device.allocateMemory(allocInfo);
+  device.bindImageMemory(image_, memory_, 0);
+
+  vk::ImageSubresourceRange range;
+  range.setAspectMask(vk::ImageAspectFlagBits::eColor)
+      .setBaseMipLevel(0)
+      .setLevelCount(1)
+      .setBaseArrayLayer(0)
+      .setLayerCount(1);
+  vk::ImageViewCreateInfo viewInfo;
+  viewInfo.setImage(image_)
+      .setViewType(vk::ImageViewType::e2D)
+      .setFormat(vk::Format::eR8G8B8A8Srgb)
+      .setSubresourceRange(range);
+  view_ = device.createImageView(viewInfo);
+
+  // 布局转换在第一次 Update 时录制进帧命令缓冲
+  app.resourceTracker->Track(image_, 1);
+}
+
+void TiledImage::select(const glm::mat4 &mvp,
+    vk::Extent2D viewport, std::vector<TileId> &visible) const {
+  const auto &base = levels_.front();
+  const float aspect = float(base.height) / float(base.width);
+
+  std::vector<TileId> stack;
+  const auto topLevel = static_cast<uint32_t>(levels_.size() - 1);
+  for (uint32_t y = 0; y < levels_[topLevel].tilesY; ++y) {
+    for (uint32_t x = 0; x < levels_[topLevel].tilesX; ++x) {
+      stack.push_back({topLevel, x, y});
+    }
+  }
+
+  while (!stack.empty()) {
+    const TileId id = stack.back();
+    stack.pop_back();
+    const auto &level = levels_[id.level];
+    const uint32_t x0 = id.x * tileSize_;
+    const uint32_t y0 = id.y * tileSize_;
+    const uint32_t x1 = std::min(x0 + tileSize_, level.width);
+    const uint32_t y1 = std::min(y0 + tileSize_, level.height);
+
+    // 模型空间：宽度归一化到 [-0.5, 0.5]
+    const float u[2] = {float(x0) / level.width - 0.5f,
+        float(x1) / level.width - 0.5f};
+    const float v[2] = {(float(y0) / level.height - 0.5f) * aspect,
+        (float(y1) / level.height - 0.5f) * aspect};
+    glm::vec4 clip[4] = {mvp * glm::vec4(u[0], v[0], 0, 1),
+        mvp * glm::vec4(u[1], v[0], 0, 1),
+        mvp * glm::vec4(u[1], v[1], 0, 1),
+        mvp * glm::vec4(u[0], v[1], 0, 1)};
+
+    // 四个角都在同一个裁剪面外面则不可见
+    auto outside = [&](auto test) {
+      return std::all_of(std::begin(clip), std::end(clip), test);
+    };
+    if (outside([](const glm::vec4 &c) { return c.x < -c.w; }) ||
+        outside([](const glm::vec4 &c) { return c.x > c.w; }) ||
+        outside([](const glm::vec4 &c) { return c.y < -c.w; }) ||
+        outside([](const glm::vec4 &c) { return c.y > c.w; }) ||
+        outside([](const glm::vec4 &c) { return c.z < 0; }) ||
+        outside([](const glm::vec4 &c) { return c.z > c.w; })) {
+      continue;
+    }
+
+    bool refine = id.level > 0 &&
+                  visible.size() + stack.size() + 4 <=
+                      config_.maxQuads;
+    if (refine) {
+      bool behind = std::any_of(std::begin(clip), std::end(clip),
+          [](const glm::vec4 &c) { return c.w <= 1e-5f; });
+      if (!behind) {
+        // 屏幕上的最长边（像素）比块的纹素还少就够清晰了
+        float pixels = 0;
+        for (int i = 0; i < 4; ++i) {
+          const auto &a = clip[i];
+          const auto &b = clip[(i + 1) % 4];
+          const float dx =
+              (a.x / a.w - b.x / b.w) * 0.5f * viewport.width;
+          const float dy =
+              (a.y / a.w - b.y / b.w) * 0.5f * viewport.height;
+          pixels = std::max(pixels, std::sqrt(dx * dx + dy * dy));
+        }
+        refine = pixels > float(std::max(x1 - x0, y1 - y0));
+      }
+    }
+    if (!refine) {
+      visible.push_back(id);
+      continue;
+    }
+    const auto &child = levels_[id.level - 1];
+    for (uint32_t cy = id.y * 2; cy < id.y * 2 + 2; ++cy) {
+      for (uint32_t cx = id.x * 2; cx < id.x * 2 + 2; ++cx) {
+        if (cx < child.tilesX && cy < child.tilesY) {
+          stack.push_back({id.level - 1, cx, cy});
+        }
+      }
+    }
+  }
+}
+
+auto TiledImage::acquireSlot() -> int32_t {
+  if (!freeSlots_.empty()) {
+    const uint32_t slot = freeSlots_.back();
+    freeSlots_.pop_back();
+    return static_cast<int32_t>(slot);
+  }
+  // 淘汰本帧没用到的最久未用槽，最高一级的块常驻
+  const auto root = static_cast<int64_t>(levels_.back().firstTile);
+  int32_t victim = -1;
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    const auto &slot = slots_[i];
+    if (slot.tile == root || slot.lastUsed == frame_) {
+      continue;
+    }
+    if (victim < 0 || slot.lastUsed < slots_[victim].lastUsed) {
+      victim = static_cast<int32_t>(i);
+    }
+  }
+  if (victim >= 0) {
+    indirection_.erase(static_cast<uint64_t>(slots_[victim].tile));
+    slots_[victim].tile = -1;
+    stats_.evictions++;
+  }
+  return victim;
+}
+
+void TiledImage::Update(vk::CommandBuffer cmdBuf, uint32_t frame,
+    const glm::mat4 &mvp, vk::Extent2D viewport) {
+  frame_++;
+  auto &data = frames_[frame];
+  std::vector<TileId> visible;
+  select(mvp, viewport, visible);
+  stats_.visibleTiles = static_cast<uint32_t>(visible.size());
+
+  // 可见块以及它们正在替代显示的祖先都算本帧使用
+  std::vector<TileId> missing;
+  for (const auto &id : visible) {
+    TileId cur = id;
+    for (;;) {
+      const int32_t slot = slotOf(tileIndex(cur));
+      if (slot >= 0) {
+        slots_[slot].lastUsed = frame_;
+        break;
+      }
+      if (cur.level == id.level) {
+        missing.push_back(cur);
+      }
+      if (cur.level + 1 == levels_.size()) {
+        break;
+      }
+      cur = {cur.level + 1, cur.x / 2, cur.y / 2};
+    }
+  }
+  // 兜底的最高一级最先上传，其余粗的优先
+  const TileId root{static_cast<uint32_t>(levels_.size() - 1), 0, 0};
+  if (slotOf(tileIndex(root)) < 0) {
+    missing.insert(missing.begin(), root);
+  }
+  std::stable_sort(missing.begin(), missing.end(),
+      [](const TileId &a, const TileId &b) {
+        return a.level > b.level;
+      });
+
+  const uint64_t tileBytes = uint64_t(slotSize_) * slotSize_ * 4;
+  std::vector<vk::BufferImageCopy> regions;
+  for (const auto &id : missing) {
+    if (regions.size() == config_.uploadsPerFrame) {
+      break;
+    }
+    const uint64_t index = tileIndex(id);
+    if (slotOf(index) >= 0) {
+      continue;
+    }
+    const int32_t slot = acquireSlot();
+    if (slot < 0) {
+      break;
+    }
+    const vk::DeviceSize offset = regions.size() * tileBytes;
+    std::memcpy(static_cast<uint8_t *>(data.staging->map) + offset,
+        tileData(index), tileBytes);
+    const uint32_t sx = uint32_t(slot) % config_.slotsPerSide;
+    const uint32_t sy = uint32_t(slot) / config_.slotsPerSide;
+    vk::BufferImageCopy region;
+    region.setBufferOffset(offset)
+        .setBufferRowLength(0)
+        .setBufferImageHeight(0)
+        .setImageSubresource(
+            {vk::ImageAspectFlagBits::eColor, 0, 0, 1})
+        .setImageOffset({static_cast<int32_t>(sx * slotSize_),
+            static_cast<int32_t>(sy * slotSize_), 0})
+        .setImageExtent({slotSize_, slotSize_, 1});
+    regions.push_back(region);
+    indirection_[index] = slot;
+    slots_[slot] = {static_cast<int64_t>(index), frame_};
+  }
+  stats_.uploadsLastFrame = static_cast<uint32_t>(regions.size());
+  stats_.residentTiles =
+      static_cast<uint32_t>(slots_.size() - freeSlots_.size());
+
+  auto &tracker = *Application::GetInstance().resourceTracker;
+  if (!regions.empty()) {
+    // 被淘汰的槽可能还在被上一帧采样，由跟踪器等待读者
+    tracker.Use(image_, ResourceState::TransferDst());
+    tracker.Flush(cmdBuf);
+    cmdBuf.copyBufferToImage(data.staging->buffer, image_,
+        vk::ImageLayout::eTransferDstOptimal, regions);
+  }
+  // 已经可采样时（读后读）不会生成屏障
+  tracker.Use(image_, ResourceState::FragmentRead());
+  tracker.Flush(cmdBuf);
+
+  auto *vertices = static_cast<Vertex *>(data.vertices->map);
+  data.quadCount = 0;
+  for (const auto &id : visible) {
+    if (data.quadCount == config_.maxQuads) {
+      break;
+    }
+    emitQuad(id, vertices + data.quadCount * 4);
+    data.quadCount++;
+  }
+}
+
+void TiledImage::Draw(vk::CommandBuffer cmdBuf, uint32_t frame) {
+  auto &data = frames_[frame];
+  if (data.quadCount == 0) {
+    return;
+  }
+  vk::DeviceSize offset = 0;
+  cmdBuf.bindVertexBuffers(0, data.vertices->buffer, offset);
+  cmdBuf.bindIndexBuffer(indices_->buffer, 0, vk::IndexType::eUint32);
+  cmdBuf.drawIndexed(data.quadCount * 6, 1, 0, 0, 0);
+}
+
+void TiledImage::emitQuad(const TileId &id, Vertex *out) const {
+  // 找到最近的已驻留祖先（至少最高一级常驻）
+  TileId cur = id;
+  uint32_t shift = 0;
+  while (slotOf(tileIndex(cur)) < 0 &&
+         cur.level + 1 < levels_.size()) {
+    cur = {cur.level + 1, cur.x / 2, cur.y / 2};
+    shift++;
+  }
+  const int32_t slot = slotOf(tileIndex(cur));
+
+  const auto &level = levels_[id.level];
+  const auto &base = levels_.front();
+  const float aspect = float(base.height) / float(base.width);
+  const uint32_t x0 = id.x * tileSize_;
+  const uint32_t y0 = id.y * tileSize_;
+  const uint32_t x1 = std::min(x0 + tileSize_, level.width);
+  const uint32_t y1 = std::min(y0 + tileSize_, level.height);
+  const float px[2] = {float(x0) / level.width - 0.5f,
+      float(x1) / level.width - 0.5f};
+  const float py[2] = {(float(y0) / level.height - 0.5f) * aspect,
+      (float(y1) / level.height - 0.5f) * aspect};
+
+  float tu[2] = {0, 0};
+  float tv[2] = {0, 0};
+  if (slot >= 0) {
+    // 本块在祖先块里占的纹素范围
+    const float scale = 1.0f / float(1u << shift);
+    const float cacheSize = float(config_.slotsPerSide * slotSize_);
+    const float ox = float(uint32_t(slot) % config_.slotsPerSide *
+                               slotSize_ +
+                           border_) -
+                     float(cur.x * tileSize_);
+    const float oy = float(uint32_t(slot) / config_.slotsPerSide *
+                               slotSize_ +
+                           border_) -
+                     float(cur.y * tileSize_);
+    tu[0] = (ox + float(x0) * scale) / cacheSize;
+    tu[1] = (ox + float(x1) * scale) / cacheSize;
+    tv[0] = (oy + float(y0) * scale) / cacheSize;
+    tv[1] = (oy + float(y1) * scale) / cacheSize;
+  }
+
+  const glm::vec3 white(1.0f);
+  out[0] = {{px[0], py[0]}, white, {tu[0], tv[0]}};
+  out[1] = {{px[1], py[0]}, white, {tu[1], tv[0]}};
+  out[2] = {{px[1], py[1]}, white, {tu[1], tv[1]}};
+  out[3] = {{px[0], py[1]}, white, {tu[0], tv[1]}};
+}
+
+} // namespace app
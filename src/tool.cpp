@@ -1,4 +1,5 @@
 #include "../header/tool.h"
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
@@ -25,4 +26,51 @@ auto readSpvFile(const std::string &filename)
 
   return content;
 }
+
+namespace {
+inline auto mix(uint64_t v) -> uint64_t {
+  v ^= v >> 33;
+  v *= 0xff51afd7ed558ccdull;
+  v ^= v >> 33;
+  v *= 0xc4ceb9fe1a85ec53ull;
+  v ^= v >> 33;
+  return v;
+}
+} // namespace
+
+auto HashBytes(const void *data, size_t size, uint64_t seed)
+    -> uint64_t {
+  constexpr uint64_t Prime = 0x9e3779b97f4a7c15ull;
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  uint64_t hash = seed ^ (size * Prime);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, 8);
+    hash = (hash ^ mix(word)) * Prime;
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, bytes + i, size - i);
+  return mix(hash ^ mix(tail));
+}
+
+auto HashBytes128(const void *data, size_t size, uint64_t seed)
+    -> Hash128 {
+  constexpr uint64_t Prime0 = 0x9e3779b97f4a7c15ull;
+  constexpr uint64_t Prime1 = 0xc2b2ae3d27d4eb4full;
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  uint64_t h0 = seed ^ (size * Prime0);
+  uint64_t h1 = ~seed ^ (size * Prime1);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, 8);
+    h0 = (h0 ^ mix(word)) * Prime0;
+    // 第二条链先把字旋转再混合，与第一条不相关
+    h1 = (h1 ^ mix((word << 29 | word >> 35) + Prime1)) * Prime1;
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, bytes + i, size - i);
+  return {mix(h0 ^ mix(tail)), mix(h1 ^ mix(tail + Prime1))};
+}
 } // namespace app